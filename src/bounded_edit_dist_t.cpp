@@ -34,6 +34,7 @@ where `Name` has edit distance within 6 of "Vladimir Iosifovich Levenshtein".
 
 */
 #include "common.h"
+#include "levenshtein/dispatch.h"
 
 // Error messages.
 // MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
@@ -60,6 +61,19 @@ constexpr const auto BOUNDED_EDIT_DIST_T_ARG_TYPE_ERROR_LEN = std::size(BOUNDED_
 UDF_SIGNATURES(bounded_edit_dist_t)
 
 
+struct BoundedEditDistTPersistant {
+    int *buffer; // Takes ownership of this buffer
+    // Index of the argument that is a constant string, or -1 if neither or both are.
+    int constant_arg = -1;
+    // Chooses the kernel for each call. See `levenshtein/dispatch.h`.
+    levenshtein::Dispatcher<true> dispatcher;
+
+    explicit BoundedEditDistTPersistant(int *buffer): buffer(buffer){}
+
+    ~BoundedEditDistTPersistant(){ delete[] this->buffer; }
+};
+
+
 [[maybe_unused]]
 int bounded_edit_dist_t_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
     // We require 3 arguments:
@@ -73,12 +87,24 @@ int bounded_edit_dist_t_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
         return 1;
     }
 
-    // Attempt to preallocate a buffer.
-    initid->ptr = (char *)new(std::nothrow) int[DAMLEV_MAX_EDIT_DIST];
-    if (initid->ptr == nullptr) {
+    // Initialize persistent data
+    int* buffer = new (std::nothrow) int[DAMLEV_MAX_EDIT_DIST];
+    BoundedEditDistTPersistant *data = buffer ? new (std::nothrow) BoundedEditDistTPersistant(buffer) : nullptr;
+    // If memory allocation failed
+    if (!data) {
+        delete[] buffer;
         strncpy(message, BOUNDED_EDIT_DIST_T_MEM_ERROR, BOUNDED_EDIT_DIST_T_MEM_ERROR_LEN);
         return 1;
     }
+    initid->ptr = reinterpret_cast<char*>(data);
+
+    // Constant arguments are already available in `_init`. If exactly one of the strings is a
+    // constant, it is the query, which the dispatcher prepares once for every row.
+    if (args->args[0] && !args->args[1]) {
+        data->constant_arg = 0;
+    } else if (args->args[1] && !args->args[0]) {
+        data->constant_arg = 1;
+    }
 
     // There are two error states possible within the function itself:
     //    1. Negative max distance provided
@@ -95,191 +121,46 @@ int bounded_edit_dist_t_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
 
 [[maybe_unused]]
 void bounded_edit_dist_t_deinit(UDF_INIT *initid) {
-    delete[] reinterpret_cast<int*>(initid->ptr);
+    // As `BoundedEditDistTPersistant` owns its buffer, `~BoundedEditDistTPersistant` handles buffer deallocation.
+    delete reinterpret_cast<BoundedEditDistTPersistant*>(initid->ptr);
 }
 
 [[maybe_unused]]
 long long bounded_edit_dist_t(UDF_INIT *initid, UDF_ARGS *args, [[maybe_unused]] char *is_null, char *error) {
-
 #ifdef PRINT_DEBUG
     std::cout << "bounded_edit_dist_t" << "\n";
 #endif
-#ifdef CAPTURE_METRICS
-    PerformanceMetrics &metrics = performance_metrics[1];
-#endif
 
     // Fetch preallocated buffer. The only difference between min_edit_dist_t and bounded_edit_dist_t is that min_edit_dist_t also persists
     // the max and updates it right before the final return statement.
-    int *buffer = reinterpret_cast<int *>(initid->ptr);
+    BoundedEditDistTPersistant *data = reinterpret_cast<BoundedEditDistTPersistant *>(initid->ptr);
+    int *buffer = data->buffer;
     int max     = static_cast<int>(std::max(args->lengths[0], args->lengths[1]));
 
     // Validate max distance and update.
     // This code is common to algorithms with limits.
 #include "validate_max.h"
 
-    // The pre-algorithm code is the same for all algorithm variants. It handles
-    //     - basic setup & initialization
-    //     - trimming of common prefix/suffix
-#include "prealgorithm.h"
+    UdfInstrument instrument{1, args};
 
-    // Check if buffer size required exceeds available buffer size. This algorithm needs
-    // a buffer of size 2*(m+1). Because of trimming, m may be smaller than the length
-    // of the longest string.
-    if( 2*(m+1) > DAMLEV_BUFFER_SIZE ) {
-#ifdef CAPTURE_METRICS
-        metrics.buffer_exceeded++;
-        metrics.total_time += call_timer.elapsed();
-#endif
-        return 0;
+    // Handle null strings
+    if (!args->args[0] || !args->args[1]) {
+        instrument.length_exit();
+        return instrument.returns(static_cast<long long>(std::max(args->lengths[0], args->lengths[1])));
     }
 
-    // We keep track of only two rows for this algorithm. See below for details.
-    int *current  = buffer;
-    int *previous = buffer + m + 1;
-    std::iota(previous, previous + m + 1, 0);
-
-    int previous_previous_cell = 0;
-    int previous_cell          = 0;
-    int current_cell           = 0;
-
-    const int m_n = m-n; // We use this a lot.
-
-
-    // Keeping track of start and end is slightly faster than keeping track of
-    // right/left band for reasons I don't understand.
-    // first cell computed
-    int start_j = 1;
-    // last cell computed, +1 because we start at second row (index 1)
-    int end_j   = std::min((max + m_n) / 2 + 1, m);
-
-#ifdef PRINT_DEBUG
-    // Print the matrix header
-    std::cout << "     ";
-    for(int k = 0; k < m; k++) std::cout << " " << query[k] << " ";
-    std::cout << "\n  ";
-    for(int k = 0; k <= m; k++) std::cout << (k < 10? " ": "") << k << " ";
-    std::cout << "\n";
-#endif
-
-    // Main loop to calculate the Damerau-Levenshtein distance
-    for (int i = 1; i <= n; ++i) {
-        // The order of these initializations is crucial. This comes first so the value in the buffer isn't overwritten.
-        previous_cell = current[start_j-1]; // = matrix(i-1, 0)
-
-        // Initialize first column
-        // if (start_j == 1) // This line seems to make no difference.
-        current[0] = i;
-        // previous[0] = i;
-
-        // Assume anything outside the band contains more than max. The only cells outside the
-        // band we actually look at are positions (i,start_j-1) and  (i,end_j+1), so we
-        // pre-fill it with max + 1.
-        // if (start_j > 1) current[start_j-1] = max + 1;
-        // if (end_j   < m) current[end_j]     = max + 1;
-
-#ifdef PRINT_DEBUG
-        // Print column header
-        std::cout << subject[i - 1] << (i<10? "  ": " ") << i << " ";
-        for(int k = 1; k <= start_j-2; k++) std::cout << " . ";
-        if (start_j > 1) std::cout << (max < 9? " " : "")  << max + 1 << " ";
-#endif
-
-        // Main inner loop
-        for (int j = start_j; j <= end_j; ++j) {
-            /*
-            At the start of the computation of matrix(i, j) we have:
-                current[p]  = {  matrix(i, p)     for p < j
-                              {  matrix(i-1, p)   for p >= j
-                previous[p] = {  matrix(i-1, p)   for p < j - 2
-                              {  matrix(i-2, p)   for p >= j - 2
-                previous_cell          = matrix(i-1, j-1)
-                previous_previous_cell = matrix(i-1, j-2)
-
-            To compute matrix(i, j), we need to use the following:
-                matrix(i  , j-1) = current[j-1]
-                matrix(i-2, j-2) = previous[j-2]
-                matrix(i-1, j-1) = previous_cell
-                matrix(i-1, j  ) = current[j]
-            */
-
-            int cost     = (subject[i - 1] == query[j - 1]) ? 0 : 1;
-            current_cell = std::min({current[j]    + 1,
-                                     current[j-1]  + 1,
-                                     previous_cell + cost});
-
-            // Check for transpositions
-            if (i > 1 && j > 1 && subject[i - 1] == query[j - 2] && subject[i - 2] == query[j - 1]) {
-                current_cell = std::min(current_cell, previous[j-2] + cost);
-            }
-
-            /*
-            We compute current_cell = matrix(i, j) and then perform the update for the next iteration:
-                previous[j-2]          <-- previous_previous_cell := matrix(i-1, j-2)
-                previous_previous_cell <-- previous_cell          := matrix(i-1, j-1)
-                previous_cell          <-- current[j]             := matrix(i-1, j)
-                current[j]             <-- current_cell           := matrix(i, j)
-            */
-
-            if(j>1){
-                previous[j-2]      = previous_previous_cell;
-            }
-            previous_previous_cell = previous_cell;
-            previous_cell          = current[j];
-            current[j]             = current_cell;
-
-#ifdef PRINT_DEBUG
-            std::cout << (current_cell < 10 ? " ": "") << current_cell << " ";
-#endif
-#ifdef CAPTURE_METRICS
-            metrics.cells_computed++;
-#endif
-        }
-#ifdef PRINT_DEBUG
-        if (end_j < m) std::cout << (max < 9? " " : "") << max + 1 << " ";
-        for(int k = end_j+2; k <= m; k++) std::cout << " . ";
-        std::cout << "   " << start_j << " <= j <= " << end_j << "\n";
-#endif
-
-        // See if we can make the band narrower based on the row just computed.
-        while(
-            // end_j < m && // This should always be true
-                end_j > 0
-                // Have to subtract one in the following as next character might make transposition
-                && current[end_j] + std::abs(end_j - i - m_n) - 1 > max
-                ) {
-            end_j--;
-        }
-        // Increment for next row
-        end_j = std::min(m, end_j + 1);
-
-        // The starting point is a little different. It is "sticky" unless we
-        // can prove it can shrink. Think of it as, both start and end do
-        // the most conservative thing.
-        while(
-                start_j <= end_j
-                // Have to subtract one in the following as next character might make transposition
-                && std::abs(i + m_n - start_j) + current[start_j] - 1 > max
-                ) {
-            start_j++;
-        }
-
-        if (end_j < start_j) {
-#ifdef CAPTURE_METRICS
-            metrics.early_exit++;
-            metrics.algorithm_time += algorithm_timer.elapsed();
-            metrics.total_time += call_timer.elapsed();
-#endif
-#ifdef PRINT_DEBUG
-            std::cout << "EMPTY BAND: " << start_j << " <= j <= " << end_j << '\n';
-#endif
-            return max + 1;
-        }
+    // The constant query is prepared on the first row that has it, since in `_init` the lengths
+    // of the arguments are only their maximum lengths.
+    if (data->constant_arg >= 0 && !data->dispatcher.has_constant_query()) {
+        data->dispatcher.set_constant_query(string_arg(args, data->constant_arg));
     }
 
-    // Return the final Damerau-Levenshtein distance
-#ifdef CAPTURE_METRICS
-    metrics.algorithm_time += algorithm_timer.elapsed();
-    metrics.total_time += call_timer.elapsed();
-#endif
-    return std::min(max + 1, current_cell);
+    // The kernels live in `levenshtein/levenshtein.h` and `levenshtein/batch.h`.
+    int distance = data->dispatcher.distance(string_arg(args, 0), string_arg(args, 1), max,
+                                             {buffer, DAMLEV_MAX_EDIT_DIST}, instrument);
+    // The buffer is too small for these strings.
+    if (distance == levenshtein::BUFFER_EXCEEDED) {
+        return instrument.returns(0);
+    }
+    return instrument.returns(distance);
 }
@@ -8,6 +8,7 @@ Common definitions needed for every algorithm:
   - sanity limits on BUFFER_SIZE, DAMLEV_MAX_EDIT_DIST
   - `set_error(..)` function
   - UDF_SIGNATURES macro
+  - `UdfInstrument`, which connects the kernels to the runtime counters, probes, metrics, and debug printing
 
 */
 
@@ -24,11 +25,19 @@ Common definitions needed for every algorithm:
 #include <numeric>
 #include <limits>
 #include <climits>
+#include <cmath>
+#include <type_traits>
 #include <mysql.h>
 
+#include "levenshtein/levenshtein.h"
+#include "probes.h"
+#include "stats.h"
+
 #ifdef CAPTURE_METRICS
 #include "metrics.hpp"
 #include "benchtime.hpp"
+#elif defined(TRACE_BAND)
+#error "TRACE_BAND needs CAPTURE_METRICS"
 #endif
 
 /// Concatenate preprocessor tokens A and B without expanding macro definitions
@@ -55,6 +64,7 @@ constexpr int DAMLEV_MAX_EDIT_DIST = std::max(0, std::min(16384, DAMLEV_BUFFER_S
 
 #ifdef PRINT_DEBUG
 #include <iostream>
+#include "levenshtein/print_matrix.h"
 #endif
 
 // Define set_error as an inline function
@@ -63,6 +73,12 @@ void set_error(char *error, const char *message) {
     strncpy(error, message, MYSQL_ERRMSG_SIZE);
 }
 
+/// String argument `index` as a `std::string_view`. The caller checks that it isn't null.
+inline
+std::string_view string_arg(const UDF_ARGS *args, int index) {
+    return {args->args[index], args->lengths[index]};
+}
+
 #define UDF_SIGNATURES_TYPE(algorithm, type) \
     extern "C" { \
         [[maybe_unused]] int MACRO_CONCAT(algorithm, _init)(UDF_INIT *initid, UDF_ARGS *args, char *message); \
@@ -71,3 +87,204 @@ void set_error(char *error, const char *message) {
     }
 
 #define UDF_SIGNATURES(algorithm) UDF_SIGNATURES_TYPE(algorithm, long long)
+
+/// The instrument the UDFs pass to the kernels in `levenshtein/levenshtein.h`. It always keeps the
+/// runtime counters of `stats.h`, adding up the call in a local `Totals` and adding that, and the
+/// cycles the call took, to this thread's shard when it is destroyed, along with the call itself if
+/// it is one of the slowest (see `slow_calls.h`). It also fires the USDT probes of `probes.h`. With
+/// `CAPTURE_METRICS`, `TRACE_BAND`, and `PRINT_DEBUG` it does more. The lifetime of the object is
+/// the call: construct it once the arguments have been validated, and return through `returns()`.
+class UdfInstrument: public levenshtein::NoInstrumentation {
+public:
+    /// `algorithm` is the index of the UDF's slot in `performance_metrics` and in `stats.h`. The
+    /// call's latency is filed under the length of the longer of the first two arguments.
+    UdfInstrument(int algorithm, const UDF_ARGS *args)
+        : shard(runtime_stats::shard())
+        , args(args)
+        , algorithm(algorithm)
+        , length_class(runtime_stats::length_class(std::max(args->lengths[0], args->lengths[1])))
+#ifdef CAPTURE_METRICS
+        , metrics(performance_metrics[algorithm])
+#ifdef CAPTURE_PERF_COUNTERS
+        , perf_counters(metrics)
+#endif
+#ifdef TRACE_BAND
+        , band_trace(band_traces[algorithm])
+#endif
+#endif
+    {
+        call.calls = 1;
+#ifdef CAPTURE_METRICS
+        metrics.call_count++;
+        call_timer.start();
+#endif
+#ifdef TRACE_BAND
+        band_trace.reset();
+#endif
+        DAMLEV_PROBE3(entry, runtime_stats::FUNCTION_NAMES[algorithm], args->lengths[0], args->lengths[1]);
+        start_cycles = runtime_stats::read_cycles();
+    }
+
+    ~UdfInstrument() {
+        DAMLEV_PROBE6(return, runtime_stats::FUNCTION_NAMES[algorithm], result, args->lengths[0], args->lengths[1],
+                      cutoff, call.cells);
+        if (shard) {
+            std::uint64_t cycles = runtime_stats::read_cycles() - start_cycles;
+            shard->latency[algorithm][length_class].record(cycles);
+            shard->functions[algorithm].add(call);
+            if (shard->slow_calls[algorithm].wants(cycles)) record_slow_call(cycles);
+        }
+#ifdef CAPTURE_METRICS
+        metrics.total_time += call_timer.elapsed();
+#endif
+#ifdef TRACE_BAND
+        band_profiles[algorithm].add(band_trace);
+#endif
+    }
+
+    UdfInstrument(const UdfInstrument &) = delete;
+    UdfInstrument &operator=(const UdfInstrument &) = delete;
+
+    /// Passes the UDF's result through, keeping it for the `return` probe. Similarities are kept in
+    /// millionths, since the probes only take integers.
+    template<class Result>
+    Result returns(Result value) {
+        if constexpr (std::is_floating_point_v<Result>) {
+            result = std::llround(value*1e6);
+        } else {
+            result = value;
+        }
+        return value;
+    }
+
+    void length_exit() {
+        call.length_exits++;
+        DAMLEV_PROBE3(length_exit, runtime_stats::FUNCTION_NAMES[algorithm], args->lengths[0], args->lengths[1]);
+#ifdef CAPTURE_METRICS
+        metrics.exit_length_difference++;
+#endif
+#ifdef TRACE_BAND
+        band_trace.length_exit();
+#endif
+    }
+
+    void buffer_exceeded() {
+        call.buffer_exceeded++;
+#ifdef CAPTURE_METRICS
+        metrics.buffer_exceeded++;
+#endif
+    }
+
+    void start([[maybe_unused]] std::string_view subject, [[maybe_unused]] std::string_view query,
+               int max) {
+        cutoff = max;
+#ifdef CAPTURE_METRICS
+        algorithm_timer.start();
+#endif
+#ifdef TRACE_BAND
+        band_trace.start(subject, query, max);
+#endif
+#ifdef PRINT_DEBUG
+        print_matrix.start(subject, query, max);
+#endif
+    }
+
+    void row([[maybe_unused]] int i, int start_j, int end_j, [[maybe_unused]] const int *row) {
+        band_width  = std::max(0, end_j - start_j + 1);
+        call.cells += static_cast<std::uint64_t>(band_width);
+#ifdef CAPTURE_METRICS
+        metrics.cells_computed += band_width;
+#endif
+#ifdef TRACE_BAND
+        band_trace.row(i, start_j, end_j, row);
+#endif
+#ifdef PRINT_DEBUG
+        print_matrix.row(i, start_j, end_j, row);
+#endif
+    }
+
+    void columns(int count, int height) {
+        // The bit-parallel kernel computes whole columns, so its band is the whole column.
+        band_width  = height;
+        call.cells += static_cast<std::uint64_t>(count)*static_cast<std::uint64_t>(height);
+#ifdef CAPTURE_METRICS
+        metrics.cells_computed += static_cast<std::uint64_t>(count)*static_cast<std::uint64_t>(height);
+#endif
+#ifdef TRACE_BAND
+        band_trace.columns(count, height);
+#endif
+    }
+
+    void early_exit([[maybe_unused]] int i) {
+        call.early_exits++;
+        DAMLEV_PROBE3(early_exit, runtime_stats::FUNCTION_NAMES[algorithm], i, cutoff);
+#ifdef CAPTURE_METRICS
+        metrics.early_exit++;
+        metrics.algorithm_time += algorithm_timer.elapsed();
+#endif
+#ifdef TRACE_BAND
+        band_trace.early_exit(i);
+#endif
+#ifdef PRINT_DEBUG
+        print_matrix.early_exit(i);
+#endif
+    }
+
+    void done([[maybe_unused]] int distance) {
+#ifdef CAPTURE_METRICS
+        metrics.algorithm_time += algorithm_timer.elapsed();
+#endif
+    }
+
+private:
+    runtime_stats::Shard  *shard; // Null if the thread's shard couldn't be allocated
+    const UDF_ARGS        *args;
+    int                    algorithm;
+    int                    length_class;
+    runtime_stats::Totals  call;
+    std::uint64_t          start_cycles;
+    int                    cutoff     = -1;
+    int                    band_width = -1; // Of the last row (or column) computed
+    long long              result     = -1; // What the UDF returns, for the `return` probe
+
+    // The slow path of the destructor, for the rare call slower than those already logged.
+    void record_slow_call(std::uint64_t cycles) {
+        runtime_stats::SlowCall slow;
+        slow.cycles         = cycles;
+        slow.cells          = call.cells;
+        slow.subject_length = static_cast<std::uint32_t>(args->lengths[0]);
+        slow.query_length   = static_cast<std::uint32_t>(args->lengths[1]);
+        slow.cutoff         = cutoff;
+        slow.band_width     = band_width;
+        if (args->args[0]) slow.subject_hash = runtime_stats::input_hash(string_arg(args, 0));
+        if (args->args[1]) slow.query_hash   = runtime_stats::input_hash(string_arg(args, 1));
+#ifdef CAPTURE_SLOW_CALL_INPUTS
+        slow.inputs_captured = 1;
+        if (args->args[0]) {
+            std::memcpy(slow.subject_prefix, args->args[0],
+                        std::min<std::size_t>(args->lengths[0], runtime_stats::SLOW_CALL_PREFIX));
+        }
+        if (args->args[1]) {
+            std::memcpy(slow.query_prefix, args->args[1],
+                        std::min<std::size_t>(args->lengths[1], runtime_stats::SLOW_CALL_PREFIX));
+        }
+#endif
+        shard->slow_calls[algorithm].record(slow);
+    }
+#ifdef CAPTURE_METRICS
+    PerformanceMetrics &metrics;
+    Timer call_timer;
+    Timer algorithm_timer;
+#ifdef CAPTURE_PERF_COUNTERS
+    // Reads the counters before `call_timer` starts and after it stops, so that the reads aren't
+    // part of the call's time.
+    PerfCounterScope perf_counters;
+#endif
+#ifdef TRACE_BAND
+    levenshtein::BandTrace &band_trace; // This UDF's, reused from call to call
+#endif
+#endif
+#ifdef PRINT_DEBUG
+    levenshtein::PrintMatrix print_matrix;
+#endif
+};
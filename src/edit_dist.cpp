@@ -24,10 +24,6 @@ where `Name` has edit distance within 6 of "Vladimir Iosifovich Levenshtein".
 */
 #include "common.h"
 
-#ifdef PRINT_DEBUG
-void printMatrix(const int* dp, int n, int m, const std::string_view& S1, const std::string_view& S2);
-#endif
-
 
 // Error messages.
 // MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
@@ -95,106 +91,24 @@ long long edit_dist(UDF_INIT *initid, UDF_ARGS *args, [[maybe_unused]] char *is_
 #ifdef PRINT_DEBUG
     std::cout << "edit_dist" << "\n";
 #endif
-#ifdef CAPTURE_METRICS
-    PerformanceMetrics &metrics = performance_metrics[2];
-#endif
-
-    // Fetch preallocated buffer. The only difference between min_edit_dist and lev is that min_edit_dist also persists
-    // the max and updates it right before the final return statement.
-    int *buffer   = reinterpret_cast<int *>(initid->ptr);
-
-    // The pre-algorithm code is the same for all algorithm variants. It handles
-    //     - basic setup & initialization
-    //     - trimming of common prefix/suffix
-#define SUPPRESS_MAX_CHECK
-#include "prealgorithm.h"
-#undef SUPPRESS_MAX_CHECK
-
-    // Check if buffer size required exceeds available buffer size. This algorithm needs
-    // a buffer of size (m+1). Because of trimming, this may be smaller than the length
-    // of the longest string.
-    if( m+1 > DAMLEV_BUFFER_SIZE ) {
-#ifdef CAPTURE_METRICS
-        metrics.buffer_exceeded++;
-        metrics.total_time += call_timer.elapsed();
-#endif
-        return 0;
-    }
-
-    int current_cell = 0;
-
-#ifdef PRINT_DEBUG
-    // Print the matrix header
-    std::cout << "     ";
-    for(int k = 0; k < m; k++) std::cout << " " << query[k] << " ";
-    std::cout << "\n  ";
-    for(int k = 0; k <= m; k++) std::cout << (k < 10? " ": "") << k << " ";
-    std::cout << "\n";
-#endif
 
-    // Main loop to calculate the Levenshtein distance
-    for (int i = 1; i <= n; ++i) {
+    // Fetch preallocated buffer.
+    int *buffer = reinterpret_cast<int *>(initid->ptr);
 
+    UdfInstrument instrument{2, args};
 
-        // We use only a single "row" instead of a full matrix. Let's call it cell[*].
-        // The current cell, cell[j], is matrix position (row, col) = (i, j).  To compute
-        // this cell, we need matrix(i-1, j), matrix(i, j-1), and matrix(i-1, j-1). When
-        // computing the current cell value,
-        //               (  matrix(i, p)    for p < j
-        //     cell[p] = |
-        //               (  matrix(i-1, p)   for p >= j.
-        // Thus, before we overwrite cell[j], it contains matrix(i-1, j). In the previous
-        // iteration, we overwrote matrix(i-1, j-1) with the value of matrix(i, j-1). Thus,
-        // we need to keep the value in cell[j] before overwriting it for use in the next
-        // iteration. We store it in the variable `previous_cell`. The invariant is that
-        // `previous_cell` = matrix(i-1, j-1).
-        int previous_cell = i-1; // = buffer[start_j-1];
-
-        // Initialize first column
-        buffer[0] = i;
-
-#ifdef PRINT_DEBUG
-        // Print column header
-        std::cout << subject[i - 1] << (i<10? "  ": " ") << i << " ";
-        // for(int k = 1; k <= start_j-2; k++) std::cout << " . ";
-        // if (start_j > 1) std::cout << (max < 9? " " : "")  << max + 1 << " ";
-#endif
-
-        // Main inner loop
-        for (int j = 1; j <= m; ++j) {
-            int cost          = (subject[i - 1] == query[j - 1]) ? 0 : 1;
-            // See the declaration of `previous_cell` for an explanation of this.
-            // `previous_cell` = matrix(i-1, j-1)
-            //       cell[j-1] = matrix(i, j-1)
-            //         cell[j] = matrix(i-1, j)
-            current_cell = std::min({buffer[j] + 1,
-                                     buffer[j - 1] + 1,
-                                     previous_cell + cost});
-
-            previous_cell      = buffer[j];    // Save cell value for next iteration
-            buffer[j]          = current_cell; // Overwrite
-
-#ifdef PRINT_DEBUG
-            std::cout << (current_cell < 10 ? " ": "") << current_cell << " ";
-#endif
-#ifdef CAPTURE_METRICS
-            metrics.cells_computed++;
-#endif
-        }
-
-#ifdef PRINT_DEBUG
-        // if (end_j < m) std::cout << (max < 9? " " : "") << max + 1 << " ";
-        // for(int k = end_j+2; k <= m; k++) std::cout << " . ";
-        // std::cout << "   " << start_j << " <= j <= " << end_j << "\n";
-        std::cout << "\n";
-#endif
-
+    // Handle null strings
+    if (!args->args[0] || !args->args[1]) {
+        instrument.length_exit();
+        return instrument.returns(static_cast<long long>(std::max(args->lengths[0], args->lengths[1])));
     }
 
-    // Return the final Levenshtein distance
-#ifdef CAPTURE_METRICS
-    metrics.algorithm_time += algorithm_timer.elapsed();
-    metrics.total_time += call_timer.elapsed();
-#endif
-    return static_cast<long long>(current_cell);
+    // The algorithm itself lives in `levenshtein/levenshtein.h`.
+    int distance = levenshtein::edit_dist(string_arg(args, 0), string_arg(args, 1),
+                                          {buffer, DAMLEV_MAX_EDIT_DIST}, instrument);
+    // The buffer is too small for these strings.
+    if (distance == levenshtein::BUFFER_EXCEEDED) {
+        return instrument.returns(0);
+    }
+    return instrument.returns(distance);
 }
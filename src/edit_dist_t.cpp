@@ -91,128 +91,27 @@ void edit_dist_t_deinit(UDF_INIT *initid) {
 
 [[maybe_unused]]
 long long edit_dist_t(UDF_INIT *initid, UDF_ARGS *args, [[maybe_unused]] char *is_null, [[maybe_unused]] char *error) {
-
 #ifdef PRINT_DEBUG
     std::cout << "edit_dist_t" << "\n";
 #endif
-#ifdef CAPTURE_METRICS
-    PerformanceMetrics &metrics = performance_metrics[3];
-#endif
 
     // Fetch preallocated buffer.
-    int *buffer   = reinterpret_cast<int *>(initid->ptr);
-
-    // The pre-algorithm code is the same for all algorithm variants. It handles
-    //     - basic setup & initialization
-    //     - trimming of common prefix/suffix
-#define SUPPRESS_MAX_CHECK
-#include "prealgorithm.h"
-#undef SUPPRESS_MAX_CHECK
-
-    // Check if buffer size required exceeds available buffer size. This algorithm needs
-    // a buffer of size 2*(m+1). Because of trimming, m may be smaller than the length
-    // of the longest string.
-    if( 2*(m+1) > DAMLEV_BUFFER_SIZE ) {
-#ifdef CAPTURE_METRICS
-        metrics.buffer_exceeded++;
-        metrics.total_time += call_timer.elapsed();
-#endif
-        return 0;
-    }
-
-    // We keep track of only two rows for this algorithm. See below for details.
-    int *current  = buffer;
-    int *previous = buffer + m + 1;
-    std::iota(previous, previous + m + 1, 0);
+    int *buffer = reinterpret_cast<int *>(initid->ptr);
 
-    int previous_cell          = 0;
-    int previous_previous_cell = 0;
-    int current_cell           = 0;
+    UdfInstrument instrument{3, args};
 
-#ifdef PRINT_DEBUG
-    // Print the matrix header
-    std::cout << "     ";
-    for(int k = 0; k < m; k++) std::cout << " " << query[k] << " ";
-    std::cout << "\n  ";
-    for(int k = 0; k <= m; k++) std::cout << (k < 10? " ": "") << k << " ";
-    std::cout << "\n";
-#endif
-
-    // Main loop to calculate the Damerau-Levenshtein distance
-    for (int i = 1; i <= n; ++i) {
-        // Initialize first column
-        current[0] = i;
-        previous_cell = i-1; // = matrix(i-1, 0)
-
-#ifdef PRINT_DEBUG
-        // Print column header
-        std::cout << subject[i - 1] << (i<10? "  ": " ") << i << " ";
-        // for(int k = 1; k <= start_j-2; k++) std::cout << " . ";
-        // if (start_j > 1) std::cout << (max < 9? " " : "")  << max + 1 << " ";
-#endif
-
-        for (int j = 1; j <= m; ++j) {
-            /*
-            At the start of the computation of matrix(i, j) we have:
-                current[p]  = {  matrix(i, p)     for p < j
-                              {  matrix(i-1, p)   for p >= j
-                previous[p] = {  matrix(i-1, p)   for p < j - 2
-                              {  matrix(i-2, p)   for p >= j - 2
-                previous_cell          = matrix(i-1, j-1)
-                previous_previous_cell = matrix(i-1, j-2)
-
-            To compute matrix(i, j), we need to use the following:
-                matrix(i  , j-1) = current[j-1]
-                matrix(i-2, j-2) = previous[j-2]
-                matrix(i-1, j-1) = previous_cell
-                matrix(i-1, j  ) = current[j]
-            */
-
-            int cost     = (subject[i - 1] == query[j - 1]) ? 0 : 1;
-            current_cell = std::min({current[j]    + 1,
-                                     current[j-1]  + 1,
-                                     previous_cell + cost});
-
-            // Check for transpositions
-            if (i > 1 && j > 1 && subject[i - 1] == query[j - 2] && subject[i - 2] == query[j - 1]) {
-                current_cell = std::min(current_cell, previous[j-2] + cost);
-            }
-
-            /*
-            We compute current_cell = matrix(i, j) and then perform the update for the next iteration:
-                previous[j-2]          <-- previous_previous_cell := matrix(i-1, j-2)
-                previous_previous_cell <-- previous_cell          := matrix(i-1, j-1)
-                previous_cell          <-- current[j]             := matrix(i-1, j)
-                current[j]             <-- current_cell           := matrix(i, j)
-            */
-
-            if(j>1){
-                previous[j-2]      = previous_previous_cell;
-            }
-            previous_previous_cell = previous_cell;
-            previous_cell          = current[j];
-            current[j]             = current_cell;
-
-#ifdef PRINT_DEBUG
-            std::cout << (current_cell < 10 ? " ": "") << current_cell << " ";
-#endif
-#ifdef CAPTURE_METRICS
-            metrics.cells_computed++;
-#endif
-        }
-
-#ifdef PRINT_DEBUG
-        // if (end_j < m) std::cout << max + 1 << " ";
-        // for(int k = end_j+2; k <= m; k++) std::cout << ". ";
-        // std::cout << "   " << start_j << " <= j <= " << end_j << "\n";
-        std::cout << '\n';
-#endif
+    // Handle null strings
+    if (!args->args[0] || !args->args[1]) {
+        instrument.length_exit();
+        return instrument.returns(static_cast<long long>(std::max(args->lengths[0], args->lengths[1])));
     }
 
-    // Return the final Damerau-Levenshtein distance
-#ifdef CAPTURE_METRICS
-    metrics.algorithm_time += algorithm_timer.elapsed();
-    metrics.total_time += call_timer.elapsed();
-#endif
-    return static_cast<long long>(current_cell);
+    // The algorithm itself lives in `levenshtein/levenshtein.h`.
+    int distance = levenshtein::edit_dist_t(string_arg(args, 0), string_arg(args, 1),
+                                            {buffer, DAMLEV_MAX_EDIT_DIST}, instrument);
+    // The buffer is too small for these strings.
+    if (distance == levenshtein::BUFFER_EXCEEDED) {
+        return instrument.returns(0);
+    }
+    return instrument.returns(distance);
 }
@@ -0,0 +1,155 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Latency histograms for the runtime counters of `stats.h`.
+
+A call is timed with the CPU's cycle counter (`rdtsc` on x86, `cntvct_el0` on ARM), which is a
+couple dozen cycles to read, rather than with `std::chrono`, which can be a system call's worth.
+The counts are converted to nanoseconds only when they are reported, by comparing the cycle counter
+to `std::chrono::steady_clock` over the time since the library was loaded. That assumes a counter
+that ticks at a constant rate, which every x86 processor of the last fifteen years and every ARMv8
+one has. Elsewhere we fall back to `steady_clock`.
+
+The histograms are log-linear, like HdrHistogram: the values below 8 each get a bucket, and each
+power of two above that is split into 8 equal buckets. A value is thus known to within 1/8 of
+itself, which is plenty to tell a p99 from a p50, in 304 buckets that cover up to 2^40 cycles
+(several minutes). Longer calls are counted in the last bucket.
+
+Latency depends mostly on the lengths of the strings, so each function has a histogram for each
+class of length, by the longer of the two strings (see `LENGTH_CLASS_NAMES`).
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace runtime_stats {
+
+/// The cycle counter, or nanoseconds on platforms without one we can read from user space.
+inline std::uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t cycles;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(cycles));
+    return cycles;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/// Both clocks at the time the library was loaded, to calibrate the one against the other.
+struct ClockOrigin {
+    std::uint64_t cycles;
+    std::chrono::steady_clock::time_point time;
+
+    static ClockOrigin now() { return {read_cycles(), std::chrono::steady_clock::now()}; }
+};
+
+inline const ClockOrigin clock_origin = ClockOrigin::now();
+
+/// Cycles of `read_cycles()` per nanosecond, measured over the time since the library was loaded.
+/// If that was less than 10ms ago, first waits until it wasn't, so the measurement means something.
+inline double cycles_per_ns() {
+    constexpr auto MIN_INTERVAL = std::chrono::milliseconds(10);
+    auto since = std::chrono::steady_clock::now() - clock_origin.time;
+    if (since < MIN_INTERVAL) std::this_thread::sleep_for(MIN_INTERVAL - since);
+
+    ClockOrigin now = ClockOrigin::now();
+    double ns = std::chrono::duration<double, std::nano>(now.time - clock_origin.time).count();
+    return ns > 0 ? static_cast<double>(now.cycles - clock_origin.cycles)/ns : 1.0;
+}
+
+/// The classes of length the latencies are kept by, by the length of the longer string.
+constexpr int LENGTH_CLASS_COUNT = 4;
+constexpr const char *LENGTH_CLASS_NAMES[LENGTH_CLASS_COUNT] = {"0-16", "17-64", "65-256", "257+"};
+
+inline int length_class(std::size_t length) {
+    return length <= 16 ? 0 : length <= 64 ? 1 : length <= 256 ? 2 : 3;
+}
+
+constexpr int LATENCY_SUB_BUCKET_BITS = 3;
+constexpr int LATENCY_SUB_BUCKETS     = 1 << LATENCY_SUB_BUCKET_BITS;
+constexpr int LATENCY_MAX_BITS        = 40;
+constexpr int LATENCY_BUCKET_COUNT    = (LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS + 1)*LATENCY_SUB_BUCKETS;
+
+/// The bucket of `cycles`. The first `LATENCY_SUB_BUCKETS` values have a bucket each; above that,
+/// the top `LATENCY_SUB_BUCKET_BITS + 1` bits of the value pick the bucket within its power of two.
+inline int latency_bucket(std::uint64_t cycles) {
+    if (cycles < static_cast<std::uint64_t>(LATENCY_SUB_BUCKETS)) return static_cast<int>(cycles);
+    if (cycles >> LATENCY_MAX_BITS) return LATENCY_BUCKET_COUNT - 1;
+    int msb   = 63 - __builtin_clzll(cycles);
+    int shift = msb - LATENCY_SUB_BUCKET_BITS;
+    return (shift + 1)*LATENCY_SUB_BUCKETS + static_cast<int>(cycles >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+/// The largest value that lands in `bucket`.
+inline std::uint64_t latency_bucket_limit(int bucket) {
+    int octave = bucket/LATENCY_SUB_BUCKETS;
+    if (octave == 0) return static_cast<std::uint64_t>(bucket);
+    std::uint64_t sub = bucket%LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS;
+    return ((sub + 1) << (octave - 1)) - 1;
+}
+
+/// A plain copy of a histogram, for adding up and reporting.
+struct LatencyCounts {
+    std::uint64_t buckets[LATENCY_BUCKET_COUNT] = {};
+
+    LatencyCounts &operator+=(const LatencyCounts &other) {
+        for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) buckets[b] += other.buckets[b];
+        return *this;
+    }
+
+    LatencyCounts &operator-=(const LatencyCounts &other) {
+        for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) buckets[b] -= other.buckets[b];
+        return *this;
+    }
+
+    std::uint64_t count() const {
+        std::uint64_t total = 0;
+        for (std::uint64_t n: buckets) total += n;
+        return total;
+    }
+
+    /// The smallest bucket limit, in cycles, that at least `fraction` of the values are at or
+    /// below. 0 if there are no values.
+    std::uint64_t percentile(double fraction) const {
+        std::uint64_t total = count();
+        if (total == 0) return 0;
+        auto rank = static_cast<std::uint64_t>(fraction*static_cast<double>(total));
+        if (rank < 1) rank = 1;
+        std::uint64_t seen = 0;
+        for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+            seen += buckets[b];
+            if (seen >= rank) return latency_bucket_limit(b);
+        }
+        return latency_bucket_limit(LATENCY_BUCKET_COUNT - 1);
+    }
+};
+
+/// A histogram only one thread records into, like the `Counters` of `stats.h`.
+struct LatencyHistogram {
+    std::atomic<std::uint64_t> buckets[LATENCY_BUCKET_COUNT] = {};
+
+    void record(std::uint64_t cycles) {
+        std::atomic<std::uint64_t> &bucket = buckets[latency_bucket(cycles)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void load(LatencyCounts &counts) const {
+        for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) counts.buckets[b] = buckets[b].load(std::memory_order_relaxed);
+    }
+};
+
+} // namespace runtime_stats
@@ -0,0 +1,233 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Tracing how the band of the banded kernels evolves, and adding the traces up into a profile.
+
+`bounded_edit_dist` and `bounded_edit_dist_t` narrow the band `start_j..end_j` after every row by
+the rules in `doc/OptimizatingEditDistance.md`, and stop when it is empty. `BandTrace` is an
+instrument that records, for one call, the width of the band in each row, the row after which the
+band emptied, and the bound the kernel was given. `BandProfile` adds traces up into
+
+  - the mean band width by relative row position, in tenths of the subject, as a fraction of the
+    row, so that calls of different lengths can be compared;
+  - the distribution of the row the band emptied at, in the same tenths;
+  - the cells the kernel computed, next to the cells each of the simpler rules of the document
+    would have computed for the same calls: the full matrix, the constant band of width
+    `2*max + 1`, and the constant band of width `max + m-n + 1`, which reaches `(max + m-n)/2`
+    either side of the diagonal. A fourth row counts a skewed band, which reaches `(max - m-n)/2`
+    left of the diagonal and `(max + m-n)/2` right of it, so it is only about `max + 1` wide.
+
+The last is how well the dynamic narrowing pays for itself on a given set of strings. The constant
+bands are counted without early exits, which they can only have with an extra check per row.
+
+Calls that took the bit-parallel kernel of `batch.h`, as a `Dispatcher` (`dispatch.h`) may choose,
+have no band. They are counted apart, with the cells of the columns they computed.
+
+The `levbands` tool profiles the kernels on a word list, and the UDFs feed a profile per function
+when compiled with `TRACE_BAND` (see `tests/metrics.hpp`).
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include "instrument.h"
+
+namespace levenshtein {
+
+/// The band of one call of a banded kernel. It can be reused: `start` clears it.
+class BandTrace: public NoInstrumentation {
+public:
+    /// Clears the trace before a call that may not reach `start`.
+    void reset() {
+        widths.clear();
+        n = m = max = 0;
+        exit_row = -1;
+        started = length_exited = bit_parallel = false;
+        bit_parallel_cells = 0;
+    }
+
+    void length_exit() { length_exited = true; }
+
+    void start(std::string_view subject, std::string_view query, int max) {
+        widths.clear();
+        n         = static_cast<int>(subject.length());
+        m         = static_cast<int>(query.length());
+        this->max = max;
+        exit_row  = -1;
+        started   = true;
+        bit_parallel       = false;
+        bit_parallel_cells = 0;
+    }
+
+    void row(int i, int start_j, int end_j, const int *) {
+        // A kernel that resumes from rows it kept (`prefix_cache.h`) starts after row 1. The rows
+        // it didn't compute count as empty.
+        if (static_cast<std::size_t>(i) > widths.size() + 1) widths.resize(static_cast<std::size_t>(i) - 1, 0);
+        widths.push_back(std::max(0, end_j - start_j + 1));
+    }
+
+    void columns(int count, int height) {
+        bit_parallel       = true;
+        bit_parallel_cells = static_cast<std::uint64_t>(count)*static_cast<std::uint64_t>(height);
+    }
+
+    void early_exit(int i) { exit_row = i; }
+
+    std::vector<int> widths;        // The band width of each row computed, from row 1
+    int              n        = 0;  // Rows, the length of the shorter string
+    int              m        = 0;  // Columns, the length of the longer string
+    int              max      = 0;  // The bound
+    int              exit_row = -1; // The row after which the band emptied, or -1
+    bool             started       = false;
+    bool             length_exited = false;
+    bool             bit_parallel  = false; // Columns instead of rows, and no band
+    std::uint64_t    bit_parallel_cells = 0;
+};
+
+/// Traces added up. See the top of this file.
+class BandProfile {
+public:
+    static constexpr int POSITIONS = 10;
+
+    std::uint64_t calls        = 0;
+    std::uint64_t length_exits = 0;
+    std::uint64_t early_exits  = 0;
+    std::uint64_t traced       = 0; // Calls that reached the banded DP
+    std::uint64_t bit_parallel = 0; // Calls that took the bit-parallel kernel instead
+
+    double        width_fraction_sum[POSITIONS] = {}; // Band width over m, summed over rows
+    std::uint64_t rows[POSITIONS]               = {};
+    std::uint64_t exit_positions[POSITIONS]     = {};
+
+    std::uint64_t cells_dynamic  = 0;
+    std::uint64_t cells_full     = 0;
+    std::uint64_t cells_constant = 0; // Band of width 2*max + 1
+    std::uint64_t cells_tight    = 0; // Band of width max + m-n + 1
+    std::uint64_t cells_skewed   = 0; // Band from (max - m-n)/2 left to (max + m-n)/2 right
+
+    std::uint64_t cells_bit_parallel = 0; // Of the bit-parallel calls, in none of the above
+
+    void add(const BandTrace &trace) {
+        calls++;
+        if (trace.length_exited) length_exits++;
+        if (!trace.started || trace.n == 0 || trace.m == 0) return;
+        if (trace.bit_parallel) {
+            bit_parallel++;
+            cells_bit_parallel += trace.bit_parallel_cells;
+            return;
+        }
+        traced++;
+
+        const int n = trace.n, m = trace.m, max = trace.max, m_n = m - n;
+        for (std::size_t r = 0; r < trace.widths.size(); r++) {
+            int position = position_of(static_cast<int>(r), n);
+            width_fraction_sum[position] += static_cast<double>(trace.widths[r])/m;
+            rows[position]++;
+            cells_dynamic += static_cast<std::uint64_t>(trace.widths[r]);
+        }
+        if (trace.exit_row >= 0) {
+            early_exits++;
+            exit_positions[position_of(trace.exit_row - 1, n)]++;
+        }
+
+        cells_full += static_cast<std::uint64_t>(n)*static_cast<std::uint64_t>(m);
+        const int half = (max + m_n)/2, left = std::max(0, (max - m_n)/2);
+        for (int i = 1; i <= n; i++) {
+            cells_constant += band_cells(i - max, i + max, m);
+            cells_tight    += band_cells(i - half, i + half, m);
+            cells_skewed   += band_cells(i - left, i + half, m);
+        }
+    }
+
+    BandProfile &operator+=(const BandProfile &other) {
+        calls        += other.calls;
+        length_exits += other.length_exits;
+        early_exits  += other.early_exits;
+        traced       += other.traced;
+        bit_parallel += other.bit_parallel;
+        for (int p = 0; p < POSITIONS; p++) {
+            width_fraction_sum[p] += other.width_fraction_sum[p];
+            rows[p]               += other.rows[p];
+            exit_positions[p]     += other.exit_positions[p];
+        }
+        cells_dynamic  += other.cells_dynamic;
+        cells_full     += other.cells_full;
+        cells_constant += other.cells_constant;
+        cells_tight    += other.cells_tight;
+        cells_skewed   += other.cells_skewed;
+        cells_bit_parallel += other.cells_bit_parallel;
+        return *this;
+    }
+
+    /// Prints the profile as a few small tables.
+    void print(std::ostream &out, std::string_view name) const {
+        out << name << ": " << calls << " calls, " << length_exits << " length exits, " << traced
+            << " reached the banded DP, " << early_exits << " exited early\n";
+        if (bit_parallel > 0) {
+            out << "  " << bit_parallel << " calls took the bit-parallel kernel, computing " << cells_bit_parallel
+                << " cells\n";
+        }
+        if (traced == 0) return;
+
+        std::ios_base::fmtflags flags = out.flags();
+        std::streamsize precision     = out.precision();
+        out << "  row position      ";
+        for (int p = 0; p < POSITIONS; p++) out << std::setw(7) << (p*100/POSITIONS) << "%";
+        out << "\n  mean band width   ";
+        for (int p = 0; p < POSITIONS; p++) {
+            if (rows[p] == 0) {
+                out << std::setw(8) << "-";
+            } else {
+                out << std::setw(7) << std::fixed << std::setprecision(1)
+                    << 100.0*width_fraction_sum[p]/static_cast<double>(rows[p]) << "%";
+            }
+        }
+        out << "\n  early exits       ";
+        for (int p = 0; p < POSITIONS; p++) {
+            out << std::setw(7) << std::fixed << std::setprecision(1)
+                << 100.0*static_cast<double>(exit_positions[p])/static_cast<double>(traced) << "%";
+        }
+        out << "\n  cells computed by\n";
+        print_cells(out, "full matrix", cells_full);
+        print_cells(out, "band 2*max+1", cells_constant);
+        print_cells(out, "band max+m-n+1", cells_tight);
+        print_cells(out, "skewed band", cells_skewed);
+        print_cells(out, "dynamic band", cells_dynamic);
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    /// The tenth of the `n` rows that row index `r`, from 0, is in.
+    static int position_of(int r, int n) {
+        return std::clamp(static_cast<int>(static_cast<std::int64_t>(r)*POSITIONS/n), 0, POSITIONS - 1);
+    }
+
+    /// The cells of columns `first..last` within `1..m`.
+    static std::uint64_t band_cells(int first, int last, int m) {
+        first = std::max(first, 1);
+        last  = std::min(last, m);
+        return last >= first ? static_cast<std::uint64_t>(last - first + 1) : 0;
+    }
+
+    /// One line of the cells table: the count, and the count as a percentage of the full matrix.
+    void print_cells(std::ostream &out, const char *label, std::uint64_t cells) const {
+        char text[96];
+        std::snprintf(text, sizeof text, "    %-16s %16llu %7.1f%%\n", label, static_cast<unsigned long long>(cells),
+                      cells_full ? 100.0*static_cast<double>(cells)/static_cast<double>(cells_full) : 0.0);
+        out << text;
+    }
+};
+
+} // namespace levenshtein
@@ -0,0 +1,303 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+One query against many subjects.
+
+The single-pair kernels in `levenshtein.h` start from scratch on every call. When the same query
+is compared against a whole list of subjects, most of that setup can be done once. `PreparedQuery`
+does it: for queries of up to 64 characters it builds the bit masks of the bit-parallel algorithm
+of Myers (1999), in the formulation of Hyyrö (2003), which also covers transpositions. The
+dynamic programming matrix is then computed a column at a time, 64 cells per machine word, in a
+handful of word operations per character of the subject, and without any workspace. Longer
+queries fall back to the banded kernels.
+
+On top of that are the batch functions:
+
+    distances(query, subjects, k, out, workspace)    out[i] = bounded_edit_dist(query, subjects[i], k)
+    best_match(query, subjects, k, workspace)        the closest subject, tightening k as it goes
+
+and their `_t` counterparts for Damerau-Levenshtein (optimal string alignment) distance. Each
+also takes a `LengthPartitionedDictionary` (`dictionary.h`) in place of the subjects. Then only the
+entries whose length is within `k` of the query's are compared, and `best_match` visits the
+lengths nearest the query's first, so that as its bound tightens it can stop sooner. Results
+follow the conventions of `levenshtein.h`, including `BUFFER_EXCEEDED` for the long-query fallback.
+While the kernel works on one subject, the characters of a subject a few places further along are
+prefetched, since in a large batch they are rarely in cache.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#include "dictionary.h"
+#include "levenshtein.h"
+#include "span.h"
+
+namespace levenshtein {
+
+/// A query with the per-query setup of the batch kernels already done. It refers to the query's
+/// characters, which must outlive it.
+class PreparedQuery {
+public:
+    /// The longest query the bit-parallel kernels handle. Longer queries use the banded kernels.
+    static constexpr int MAX_BIT_PARALLEL_LENGTH = 64;
+
+    /// Not `explicit`, so a plain string can be passed to the batch functions. It is then
+    /// prepared once per batch instead of once per subject.
+    template<class String, class = std::enable_if_t<std::is_convertible_v<const String &, std::string_view>>>
+    PreparedQuery(const String &text): query(std::string_view{text}) {
+        if (bit_parallel()) {
+            // masks[c] has bit i set when query[i] == c.
+            for (std::size_t i = 0; i < query.length(); i++) {
+                masks[static_cast<unsigned char>(query[i])] |= std::uint64_t{1} << i;
+            }
+        }
+    }
+
+    std::string_view text() const { return query; }
+
+    bool bit_parallel() const {
+        return !query.empty() && query.length() <= static_cast<std::size_t>(MAX_BIT_PARALLEL_LENGTH);
+    }
+
+    /// The distance from the query to `subject` if it is at most `max`, otherwise `max + 1`, with
+    /// the conventions of `bounded_edit_dist` (or `bounded_edit_dist_t`). `workspace` is only used
+    /// by the fallback for long queries.
+    template<bool transpositions, class Instrument = NoInstrumentation>
+    int distance(std::string_view subject, int max, Workspace workspace, Instrument &&instrument = Instrument{}) const {
+        if (!bit_parallel()) {
+            return transpositions ? bounded_edit_dist_t(query, subject, max, workspace, instrument)
+                                  : bounded_edit_dist(query, subject, max, workspace, instrument);
+        }
+
+        // The same exits as every other kernel. `prealgorithm()` may swap its arguments, but the
+        // bit-parallel kernel doesn't care which string is longer, so we give it copies.
+        std::string_view shorter = subject, longer = query;
+        int result;
+        if (prealgorithm(shorter, longer, max, result, instrument)) return result;
+
+        return bit_parallel_distance<transpositions>(subject, max, instrument);
+    }
+
+private:
+    std::string_view                query;
+    std::array<std::uint64_t, 256> masks{};
+
+    /*
+    Column `j` of the DP matrix (the query runs down the rows, the subject across the columns) is
+    represented by its vertical differences D[i][j] - D[i-1][j], each of which is -1, 0, or +1:
+    bit `i` of `VP` is set where the difference in row `i+1` is +1, and of `VN` where it is -1.
+    Processing a character of the subject turns column `j-1` into column `j` with a constant
+    number of word operations. We track the bottom cell, D[m][j], in `score`.
+    */
+    template<bool transpositions, class Instrument>
+    int bit_parallel_distance(std::string_view subject, int max, Instrument &instrument) const {
+        const int m = static_cast<int>(query.length());
+        const int n = static_cast<int>(subject.length());
+        const std::uint64_t last = std::uint64_t{1} << (m - 1);
+
+        instrument.start(subject, query, max);
+
+        std::uint64_t VP = ~std::uint64_t{0};
+        std::uint64_t VN = 0;
+        std::uint64_t D0 = 0;           // Diagonal zero-differences of the previous column
+        std::uint64_t previous_eq = 0;  // Match mask of the previous subject character
+        int score = m;                  // D[m][0]
+
+        for (int j = 0; j < n; j++) {
+            const std::uint64_t eq = masks[static_cast<unsigned char>(subject[j])];
+
+            if (transpositions) {
+                // A transposition makes the diagonal difference zero where the characters match
+                // crosswise and the cell two steps back along the diagonal wasn't already equal.
+                std::uint64_t TR = (((~D0) & eq) << 1) & previous_eq;
+                D0 = (((eq & VP) + VP) ^ VP) | eq | VN | TR;
+                previous_eq = eq;
+            } else {
+                std::uint64_t X = eq | VN;
+                D0 = (((X & VP) + VP) ^ VP) | X;
+            }
+
+            std::uint64_t HP = VN | ~(D0 | VP);
+            std::uint64_t HN = D0 & VP;
+            score += (HP & last) ? 1 : 0;
+            score -= (HN & last) ? 1 : 0;
+
+            // Row 0 is D[0][j] = j, so the horizontal difference entering the top is always +1.
+            HP = (HP << 1) | 1;
+            HN = HN << 1;
+            VP = HN | ~(D0 | HP);
+            VN = HP & D0;
+
+            // Each remaining column can lower the score by at most one.
+            if (score - (n - 1 - j) > max) {
+                instrument.columns(j + 1, m);
+                instrument.early_exit(j + 1);
+                return max + 1;
+            }
+        }
+
+        score = std::min(score, max + 1);
+        instrument.columns(n, m);
+        instrument.done(score);
+        return score;
+    }
+};
+
+/// The closest subject found by `best_match()`. `index` is `NOT_FOUND` if no subject was within
+/// the cutoff, and then `distance` is the cutoff plus one.
+struct Match {
+    static constexpr std::size_t NOT_FOUND = static_cast<std::size_t>(-1);
+
+    std::size_t index;
+    int         distance;
+};
+
+namespace detail {
+
+/// How many subjects ahead of the current one to prefetch.
+constexpr std::size_t PREFETCH_DISTANCE = 8;
+
+inline void prefetch([[maybe_unused]] const char *address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#endif
+}
+
+template<bool transpositions>
+void distances(const PreparedQuery &query, Span<const std::string_view> subjects, int k, int *out,
+               Workspace workspace) {
+    const std::size_t count = subjects.size();
+    for (std::size_t i = 0; i < count; i++) {
+        if (i + PREFETCH_DISTANCE < count) prefetch(subjects[i + PREFETCH_DISTANCE].data());
+        out[i] = query.distance<transpositions>(subjects[i], k, workspace);
+    }
+}
+
+template<bool transpositions>
+Match best_match(const PreparedQuery &query, Span<const std::string_view> subjects, int k, Workspace workspace) {
+    Match best{Match::NOT_FOUND, k + 1};
+    int bound = k;
+    const std::size_t count = subjects.size();
+    for (std::size_t i = 0; i < count; i++) {
+        if (i + PREFETCH_DISTANCE < count) prefetch(subjects[i + PREFETCH_DISTANCE].data());
+        int distance = query.distance<transpositions>(subjects[i], bound, workspace);
+        // Like `min_edit_dist`, the bound only ever tightens, so later subjects get cheaper.
+        if (distance != BUFFER_EXCEEDED && distance <= bound) {
+            bound = distance;
+            if (distance < best.distance) best = {i, distance};
+            if (distance == 0) break; // Nothing can beat an exact match.
+        }
+    }
+    return best;
+}
+
+/// What `distance()` returns for a subject of `length` characters that isn't a candidate for a
+/// query of `query_length` characters with cutoff `k`: the lengths alone decide it.
+inline int length_only_distance(int query_length, int length, int k) {
+    return query_length == 0 || length == 0 ? std::max(query_length, length) : k + 1;
+}
+
+template<bool transpositions>
+void distances(const PreparedQuery &query, const LengthPartitionedDictionary &dictionary, int k, int *out,
+               Workspace workspace) {
+    const int m = static_cast<int>(query.text().length());
+    for (int length = 0; length <= dictionary.max_length(); length++) {
+        if (k >= 0 && length >= m - k && length <= m + k) continue;
+        const int result = length_only_distance(m, length, k);
+        dictionary.for_each_of_length(length, [&](std::string_view, LengthPartitionedDictionary::Id id) {
+            out[id] = result;
+        });
+    }
+    dictionary.for_each_candidate(query.text(), k, [&](std::string_view subject, LengthPartitionedDictionary::Id id) {
+        out[id] = query.distance<transpositions>(subject, k, workspace);
+    });
+}
+
+template<bool transpositions>
+Match best_match(const PreparedQuery &query, const LengthPartitionedDictionary &dictionary, int k,
+                 Workspace workspace) {
+    Match best{Match::NOT_FOUND, k + 1};
+    int bound = k;
+    const int m = static_cast<int>(query.text().length());
+    // The lengths nearest the query's first. A match at distance `d` rules out every length more
+    // than `d` away, so the walk stops as soon as the offset passes the bound.
+    const int farthest = std::max(m, dictionary.max_length());
+    for (int offset = 0; offset <= std::min(bound, farthest); offset++) {
+        for (int length: {m - offset, m + offset}) {
+            dictionary.for_each_of_length(length, [&](std::string_view subject, LengthPartitionedDictionary::Id id) {
+                int distance = query.distance<transpositions>(subject, bound, workspace);
+                if (distance == BUFFER_EXCEEDED || distance > bound) return;
+                bound = distance;
+                // The entries aren't in input order, so an equally close one replaces the best
+                // match if it came first there.
+                if (distance < best.distance || id < best.index) best = {id, distance};
+            });
+            if (offset == 0) break;
+        }
+    }
+    return best;
+}
+
+} // namespace detail
+
+/// Sets `out[i]` to the Levenshtein distance between `query` and `subjects[i]` if it is at most
+/// `k`, otherwise `k + 1`. `out` must have room for `subjects.size()` results.
+inline void distances(const PreparedQuery &query, Span<const std::string_view> subjects, int k, int *out,
+                      Workspace workspace) {
+    detail::distances<false>(query, subjects, k, out, workspace);
+}
+
+/// As `distances()`, but for Damerau-Levenshtein distance.
+inline void distances_t(const PreparedQuery &query, Span<const std::string_view> subjects, int k, int *out,
+                        Workspace workspace) {
+    detail::distances<true>(query, subjects, k, out, workspace);
+}
+
+/// The first subject with the smallest Levenshtein distance to `query`, provided it is at most `k`.
+inline Match best_match(const PreparedQuery &query, Span<const std::string_view> subjects, int k,
+                        Workspace workspace) {
+    return detail::best_match<false>(query, subjects, k, workspace);
+}
+
+/// As `best_match()`, but for Damerau-Levenshtein distance.
+inline Match best_match_t(const PreparedQuery &query, Span<const std::string_view> subjects, int k,
+                          Workspace workspace) {
+    return detail::best_match<true>(query, subjects, k, workspace);
+}
+
+/// As `distances()`, over the entries of `dictionary`: `out[id]` is the result for the entry with
+/// index `id` in the input the dictionary was built from. Only the candidates are compared.
+inline void distances(const PreparedQuery &query, const LengthPartitionedDictionary &dictionary, int k, int *out,
+                      Workspace workspace) {
+    detail::distances<false>(query, dictionary, k, out, workspace);
+}
+
+/// As `distances()` over a dictionary, but for Damerau-Levenshtein distance.
+inline void distances_t(const PreparedQuery &query, const LengthPartitionedDictionary &dictionary, int k, int *out,
+                        Workspace workspace) {
+    detail::distances<true>(query, dictionary, k, out, workspace);
+}
+
+/// As `best_match()`, over the entries of `dictionary`. `index` is the entry's index in the input
+/// the dictionary was built from, and the result is the same as `best_match()` over that input.
+inline Match best_match(const PreparedQuery &query, const LengthPartitionedDictionary &dictionary, int k,
+                        Workspace workspace) {
+    return detail::best_match<false>(query, dictionary, k, workspace);
+}
+
+/// As `best_match()` over a dictionary, but for Damerau-Levenshtein distance.
+inline Match best_match_t(const PreparedQuery &query, const LengthPartitionedDictionary &dictionary, int k,
+                          Workspace workspace) {
+    return detail::best_match<true>(query, dictionary, k, workspace);
+}
+
+} // namespace levenshtein
@@ -0,0 +1,196 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Clustering a list of strings into groups of near duplicates.
+
+Two strings are linked if they are within `k` edits of each other, or, for `cluster_similarity_t`,
+if their similarity in the sense of `similarity_t` is at least a threshold. The clusters are the
+connected components of the links, so a string can end up in the same cluster as another it isn't
+directly linked to: "Salmo trutta", "Salmo truta", and "Salmo trta" form one cluster at `k = 1`.
+
+Finding the links is a self-join, filtered with the segment index of `segment_index.h` so that
+only pairs sharing a segment are compared. Each pair is considered once, from its shorter string
+(or, for two strings of the same length, from the one that comes first). For a similarity
+threshold the cutoff is proportional to the length of the longer string, so each length of the
+index gets its own cutoff.
+
+The links are merged into a concurrent union-find as the threads find them. A set is represented
+by its smallest member, and each parent pointer is an atomic word: `unite()` links the larger root
+under the smaller with a compare-and-swap that fails if the root stopped being a root in the
+meantime, and `find()` halves the path as it goes. Since only connectivity matters, a pair already
+in the same set isn't verified at all, which saves most of the work in large clusters.
+
+The result is one cluster ID per string: the index of the first string of its cluster. The
+strings are numbered with 32 bits. Besides the strings, the memory needed is the segment index and
+one word per string.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "levenshtein.h"
+#include "parallel_search.h"
+#include "segment_index.h"
+#include "span.h"
+
+namespace levenshtein {
+
+/// A union-find that several threads can update at once, without locks.
+class ConcurrentUnionFind {
+public:
+    explicit ConcurrentUnionFind(std::size_t size): parents(new std::atomic<std::uint32_t>[size]) {
+        for (std::size_t i = 0; i < size; i++) {
+            parents[i].store(static_cast<std::uint32_t>(i), std::memory_order_relaxed);
+        }
+    }
+
+    /// The root of the set containing `x`. While other threads are uniting sets, it may be out of
+    /// date as soon as it is returned, but it was the root at some point during the call.
+    std::uint32_t find(std::uint32_t x) {
+        for (;;) {
+            std::uint32_t parent = parents[x].load(std::memory_order_acquire);
+            if (parent == x) return x;
+            std::uint32_t grandparent = parents[parent].load(std::memory_order_acquire);
+            // Path halving. If another thread got there first, its pointer is at least as good.
+            if (parent != grandparent) {
+                parents[x].compare_exchange_weak(parent, grandparent, std::memory_order_release,
+                                                 std::memory_order_relaxed);
+            }
+            x = grandparent;
+        }
+    }
+
+    /// Merges the sets containing `a` and `b`. Returns `false` if they were already the same set.
+    bool unite(std::uint32_t a, std::uint32_t b) {
+        for (;;) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return false;
+            if (a < b) std::swap(a, b);
+            // Link the larger root under the smaller, provided it is still a root.
+            std::uint32_t expected = a;
+            if (parents[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel)) return true;
+        }
+    }
+
+    bool same(std::uint32_t a, std::uint32_t b) {
+        for (;;) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return true;
+            // `a` may have been linked under another root since we found it.
+            if (parents[a].load(std::memory_order_acquire) == a) return false;
+        }
+    }
+
+private:
+    std::unique_ptr<std::atomic<std::uint32_t>[]> parents;
+};
+
+namespace detail {
+
+/// `max_edits(length)` is the cutoff for a pair whose longer string has length `length`.
+template<bool transpositions, class MaxEdits>
+std::vector<std::uint32_t> cluster(Span<const std::string_view> strings, MaxEdits max_edits, SearchOptions options) {
+    const std::size_t count = strings.size();
+    std::vector<std::uint32_t> clusters(count);
+    if (count == 0) return clusters;
+
+    const std::size_t chunk_size = std::max<std::size_t>(options.chunk_size, 1);
+    const std::size_t chunks     = (count + chunk_size - 1)/chunk_size;
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    const SegmentIndex index{strings, transpositions, max_edits, threads};
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, chunks));
+
+    std::size_t longest = 0;
+    for (auto string: strings) longest = std::max(longest, string.length());
+    const int workspace_ints = workspace_size(longest, transpositions);
+
+    ConcurrentUnionFind      sets{count};
+    std::atomic<std::size_t> next_chunk{0};
+
+    auto work = [&]() {
+        Buffer                     buffer{workspace_ints};
+        std::vector<std::uint32_t> candidates;
+
+        for (std::size_t chunk; (chunk = next_chunk.fetch_add(1)) < chunks;) {
+            const std::size_t end = std::min(count, (chunk + 1)*chunk_size);
+            for (std::size_t i = chunk*chunk_size; i < end; i++) {
+                const std::string_view string = strings[i];
+                const int n = static_cast<int>(string.length());
+
+                // Only partners at least as long, so that each pair is considered once. The index
+                // skips the lengths too far away for their cutoff.
+                candidates.clear();
+                index.candidates(string, n, static_cast<int>(longest), candidates);
+                std::sort(candidates.begin(), candidates.end());
+                candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+                const PreparedQuery query{string};
+                const auto self = static_cast<std::uint32_t>(i);
+                for (std::uint32_t j: candidates) {
+                    const int length = static_cast<int>(strings[j].length());
+                    if (length == n && j <= self) continue;
+                    if (sets.same(self, j)) continue;
+
+                    const int max = max_edits(length);
+                    if (max < 0) continue;
+                    int distance  = query.distance<transpositions>(strings[j], max, buffer);
+                    if (distance != BUFFER_EXCEEDED && distance <= max) sets.unite(self, j);
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned worker = 1; worker < threads; worker++) pool.emplace_back(work);
+    work();
+    for (auto &thread: pool) thread.join();
+
+    for (std::size_t i = 0; i < count; i++) clusters[i] = sets.find(static_cast<std::uint32_t>(i));
+    return clusters;
+}
+
+} // namespace detail
+
+/// Clusters `strings` by Levenshtein distance at most `k`. Returns, for each string, the index of
+/// the first string of its cluster.
+inline std::vector<std::uint32_t> cluster(Span<const std::string_view> strings, int k, SearchOptions options = {}) {
+    return detail::cluster<false>(strings, [k](int) { return k; }, options);
+}
+
+/// As `cluster()`, but for Damerau-Levenshtein distance.
+inline std::vector<std::uint32_t> cluster_t(Span<const std::string_view> strings, int k, SearchOptions options = {}) {
+    return detail::cluster<true>(strings, [k](int) { return k; }, options);
+}
+
+/// Clusters `strings`, linking two strings if their similarity `1 - edit_dist_t(a, b)/max(|a|, |b|)`,
+/// as computed by `similarity_t()`, is at least `similarity`. Returns, for each string, the index
+/// of the first string of its cluster.
+inline std::vector<std::uint32_t> cluster_similarity_t(Span<const std::string_view> strings, double similarity,
+                                                       SearchOptions options = {}) {
+    return detail::cluster<true>(strings, [similarity](int length) {
+        // `similarity_to_max_edits()` can round down past an exact boundary, such as 1 edit in 5
+        // at similarity 0.8.
+        int max = similarity_to_max_edits(similarity, length);
+        if (length > 0 && edits_to_similarity(max + 1, length) >= similarity) max++;
+        return max;
+    }, options);
+}
+
+} // namespace levenshtein
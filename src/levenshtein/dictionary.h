@@ -0,0 +1,163 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+A dictionary of strings laid out in contiguous per-length buckets.
+
+The edit distance between two strings is at least the difference of their lengths, so a query of
+length `m` can only match entries whose length is in `[m-k, m+k]`. The UDFs discover this one row
+at a time, after paying for the call. This container sorts the entries by length once, up front,
+so that a search can skip every impossible length class without ever touching those entries.
+
+Layout:
+
+    characters:   | len 0 | len 1 entries | len 2 entries   | ... | len L entries            |
+    bucket_start: position of the first entry of each length, plus one past the end
+    char_start:   offset into `characters` of the first entry of each length
+    ids:          the position of each entry in the original input
+
+Within a bucket every entry has the same width, so entry `p` of length `len` lives at
+`char_start[len] + (p - bucket_start[len])*len`. There is no per-entry offset table, and the
+entries a query needs to look at are a single contiguous range of positions.
+
+The batch functions of `batch.h` and `parallel_search.h` take a dictionary in place of a span of
+subjects, and then only compare the query with the candidates.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace levenshtein {
+
+class LengthPartitionedDictionary {
+public:
+    /// The index of an entry in the container the dictionary was built from.
+    using Id = std::uint32_t;
+
+    /// A half open range `[begin, end)` of positions within the dictionary.
+    struct Range {
+        std::size_t begin;
+        std::size_t end;
+
+        std::size_t size() const { return end - begin; }
+        bool empty() const { return begin == end; }
+    };
+
+    LengthPartitionedDictionary() = default;
+
+    /// Builds the dictionary from any container of things convertible to `std::string_view`. The
+    /// characters are copied, so `words` need not outlive the dictionary.
+    template<class Container>
+    explicit LengthPartitionedDictionary(const Container &words) {
+        // Counting sort by length. First pass: histogram of lengths.
+        std::size_t total_chars = 0;
+        std::vector<std::size_t> counts;
+        for (const auto &word: words) {
+            std::size_t length = std::string_view(word).length();
+            if (length + 1 > counts.size()) {
+                counts.resize(length + 1, 0);
+            }
+            counts[length]++;
+            total_chars += length;
+        }
+
+        bucket_start.assign(counts.size() + 1, 0);
+        char_start.assign(counts.size() + 1, 0);
+        for (std::size_t length = 0; length < counts.size(); length++) {
+            bucket_start[length + 1] = bucket_start[length] + counts[length];
+            char_start[length + 1]   = char_start[length] + counts[length]*length;
+        }
+
+        // Second pass: place each word at the next free slot of its bucket.
+        characters.resize(total_chars);
+        ids.resize(bucket_start.back());
+        std::vector<std::size_t> next(bucket_start.begin(), bucket_start.end() - 1);
+        Id id = 0;
+        for (const auto &word: words) {
+            std::string_view text{word};
+            std::size_t position = next[text.length()]++;
+            std::copy(text.begin(), text.end(), characters.begin() + offset_of(position, text.length()));
+            ids[position] = id++;
+        }
+    }
+
+    /// The number of entries.
+    std::size_t size() const { return ids.size(); }
+    bool empty() const { return ids.empty(); }
+
+    /// The length of the longest entry, or 0 if the dictionary is empty.
+    int max_length() const { return bucket_start.size() < 2 ? 0 : static_cast<int>(bucket_start.size()) - 2; }
+
+    /// The entry at `position`. Positions are in bucket order, not input order.
+    std::string_view operator[](std::size_t position) const {
+        std::size_t length = length_at(position);
+        return {characters.data() + offset_of(position, length), length};
+    }
+
+    /// The index in the original input of the entry at `position`.
+    Id id(std::size_t position) const { return ids[position]; }
+
+    /// The positions of all entries of exactly `length` characters.
+    Range bucket(int length) const {
+        if (length < 0 || length > max_length() || empty()) return {0, 0};
+        return {bucket_start[length], bucket_start[length + 1]};
+    }
+
+    /// The positions of all entries whose length is within `k` of `query_length`, that is, every
+    /// entry that can possibly be within `k` edits of a query of that length. Because buckets are
+    /// stored in increasing order of length, this is a single contiguous range.
+    Range candidates(int query_length, int k) const {
+        if (empty() || k < 0) return {0, 0};
+        int lowest  = std::max(0, query_length - k);
+        int highest = std::min(max_length(), query_length + k);
+        if (lowest > highest) return {0, 0};
+        return {bucket_start[lowest], bucket_start[highest + 1]};
+    }
+
+    /// Calls `f(entry, id)` for every entry that can possibly be within `k` edits of `query`.
+    template<class F>
+    void for_each_candidate(std::string_view query, int k, F &&f) const {
+        if (empty() || k < 0) return;
+        int lowest  = std::max(0, static_cast<int>(query.length()) - k);
+        int highest = std::min(max_length(), static_cast<int>(query.length()) + k);
+        for (int length = lowest; length <= highest; length++) for_each_of_length(length, f);
+    }
+
+    /// Calls `f(entry, id)` for every entry of exactly `length` characters.
+    template<class F>
+    void for_each_of_length(int length, F &&f) const {
+        if (length < 0 || length > max_length() || empty()) return;
+        // The width is a loop constant rather than a lookup per entry.
+        const char *text = characters.data() + char_start[length];
+        for (std::size_t position = bucket_start[length]; position < bucket_start[length + 1]; position++) {
+            f(std::string_view{text, static_cast<std::size_t>(length)}, ids[position]);
+            text += length;
+        }
+    }
+
+private:
+    std::vector<char>        characters;   // All entries, concatenated in bucket order
+    std::vector<std::size_t> bucket_start; // Position of the first entry of each length, plus the end
+    std::vector<std::size_t> char_start;   // Offset in `characters` of the first entry of each length
+    std::vector<Id>          ids;          // Original input index of each position
+
+    /// The length of the entry at `position`, found by binary search over the bucket table.
+    std::size_t length_at(std::size_t position) const {
+        auto bucket = std::upper_bound(bucket_start.begin(), bucket_start.end(), position);
+        return static_cast<std::size_t>(std::distance(bucket_start.begin(), bucket)) - 1;
+    }
+
+    std::size_t offset_of(std::size_t position, std::size_t length) const {
+        return char_start[length] + (position - bucket_start[length])*length;
+    }
+};
+
+} // namespace levenshtein
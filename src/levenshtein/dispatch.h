@@ -0,0 +1,184 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Choosing a kernel for each call.
+
+No one kernel computes a bounded distance fastest for every pair of strings:
+
+  - The banded kernels of `levenshtein.h` compute only the cells within reach of the cutoff and
+    stop when the band empties, so they cost about the length of the strings times the width of
+    the band. They win for small cutoffs.
+  - The bit-parallel kernel of `PreparedQuery` (`batch.h`) computes a whole column of up to 64
+    cells in a few word operations whatever the cutoff, but first builds a table of bit masks for
+    the query. It wins for larger cutoffs, and more often when the query is the same on every
+    call, as a constant argument of a UDF is, since the table is then built once.
+
+`doc/Benchmarks.md` shows where they cross. `Dispatcher` chooses between them on each call from
+the length of the longer string, the cutoff, and whether the query is the constant it was given.
+It looks up what each kernel would cost in `DISPATCH_COSTS`, a table of nanoseconds per call for
+classes of length and cutoff measured by `microbench --calibrate`, and takes the cheapest. The
+table is in `dispatch_costs.h`. To measure it again on the machine the plugin runs on:
+
+    cmake --build build --target calibrate-dispatch
+
+Strings longer than `PreparedQuery::MAX_BIT_PARALLEL_LENGTH` always go to the banded kernels, and
+so do comparisons decided by the lengths alone. The choice only changes how long a call takes:
+every kernel returns the same result, which `tests/difffuzz.cpp` checks.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "batch.h"
+#include "levenshtein.h"
+
+namespace levenshtein {
+
+/// The kernels a `Dispatcher` chooses between.
+enum class DispatchKernel {
+    banded,       // `bounded_edit_dist(_t)`
+    bit_parallel, // A `PreparedQuery` built for the call
+    prepared,     // The `PreparedQuery` of the constant query
+};
+constexpr int DISPATCH_KERNEL_COUNT = 3;
+constexpr const char *DISPATCH_KERNEL_NAMES[DISPATCH_KERNEL_COUNT] = {"banded", "bit_parallel", "prepared"};
+
+/// The classes of the cost table, by their largest length (of the longer string) and cutoff.
+/// Cutoffs beyond the last go in the last class.
+constexpr int DISPATCH_LENGTHS[] = {4, 8, 16, 32, 64};
+constexpr int DISPATCH_CUTOFFS[] = {0, 1, 2, 4, 8, 16};
+constexpr int DISPATCH_LENGTH_CLASSES = static_cast<int>(std::size(DISPATCH_LENGTHS));
+constexpr int DISPATCH_CUTOFF_CLASSES = static_cast<int>(std::size(DISPATCH_CUTOFFS));
+
+inline int dispatch_length_class(std::size_t length) {
+    int c = 0;
+    while (c < DISPATCH_LENGTH_CLASSES - 1 && static_cast<int>(length) > DISPATCH_LENGTHS[c]) c++;
+    return c;
+}
+
+inline int dispatch_cutoff_class(int max) {
+    int c = 0;
+    while (c < DISPATCH_CUTOFF_CLASSES - 1 && max > DISPATCH_CUTOFFS[c]) c++;
+    return c;
+}
+
+} // namespace levenshtein
+
+#include "dispatch_costs.h"
+
+namespace levenshtein {
+
+static_assert(std::size(DISPATCH_COSTS) == 2
+              && std::size(DISPATCH_COSTS[0]) == DISPATCH_KERNEL_COUNT
+              && std::size(DISPATCH_COSTS[0][0]) == DISPATCH_LENGTH_CLASSES
+              && std::size(DISPATCH_COSTS[0][0][0]) == DISPATCH_CUTOFF_CLASSES,
+              "dispatch_costs.h is for other classes; run `microbench --calibrate` again");
+
+/// `transpositions` selects Damerau-Levenshtein (optimal string alignment) distance instead of
+/// Levenshtein distance. A `Dispatcher` refers to its own copy of the constant query, so it can't
+/// be copied or moved.
+template<bool transpositions>
+class Dispatcher {
+public:
+    Dispatcher() = default;
+    Dispatcher(const Dispatcher &) = delete;
+    Dispatcher &operator=(const Dispatcher &) = delete;
+
+    /// Prepares `query` for the calls to come, which are expected to compare it with something
+    /// else each time. Calls with another query still get the right answer. Returns `false`, and
+    /// carries on without a constant query, if it can't allocate the copy.
+    bool set_constant_query(std::string_view query) noexcept {
+        prepared.reset();
+        try {
+            constant.assign(query);
+        } catch (const std::bad_alloc &) {
+            constant.clear();
+            return false;
+        }
+        prepared.emplace(constant);
+        return true;
+    }
+
+    bool has_constant_query() const { return prepared.has_value(); }
+
+    /// The kernel `distance()` uses for these strings and cutoff.
+    DispatchKernel choose(std::string_view a, std::string_view b, int max) const {
+        std::string_view subject;
+        return choose(a, b, max, subject);
+    }
+
+    /// The distance between `a` and `b` if it is at most `max`, otherwise `max + 1`, with the
+    /// conventions of `bounded_edit_dist` (or `bounded_edit_dist_t`), from the cheapest kernel.
+    template<class Instrument = NoInstrumentation>
+    int distance(std::string_view a, std::string_view b, int max, Workspace workspace,
+                 Instrument &&instrument = Instrument{}) const {
+        std::string_view subject;
+        switch (choose(a, b, max, subject)) {
+            case DispatchKernel::prepared:
+                return prepared->template distance<transpositions>(subject, max, workspace, instrument);
+            case DispatchKernel::bit_parallel: {
+                const PreparedQuery query{b};
+                return query.template distance<transpositions>(a, max, workspace, instrument);
+            }
+            case DispatchKernel::banded:
+            default:
+                return transpositions ? bounded_edit_dist_t(a, b, max, workspace, instrument)
+                                      : bounded_edit_dist(a, b, max, workspace, instrument);
+        }
+    }
+
+    /// `similarity_t()`, with the kernel chosen as for `distance()`.
+    template<class Instrument = NoInstrumentation>
+    double similarity(std::string_view a, std::string_view b, double similarity, Workspace workspace,
+                      Instrument &&instrument = Instrument{}) const {
+        static_assert(transpositions, "similarity_t is defined by Damerau-Levenshtein distance");
+        const int m = static_cast<int>(std::max(a.length(), b.length()));
+        if (m == 0) return 1.0;
+
+        const int max = similarity_to_max_edits(similarity, m);
+        int result    = distance(a, b, max, workspace, instrument);
+        if (result == BUFFER_EXCEEDED) return BUFFER_EXCEEDED;
+        return std::max(0.0, edits_to_similarity(std::min(result, max + 1), m));
+    }
+
+private:
+    std::string                  constant;
+    std::optional<PreparedQuery> prepared; // Of `constant`
+
+    /// Also sets `subject` to the string that isn't the constant query, for `prepared`.
+    DispatchKernel choose(std::string_view a, std::string_view b, int max, std::string_view &subject) const {
+        const std::size_t n = std::min(a.length(), b.length());
+        const std::size_t m = std::max(a.length(), b.length());
+        if (n == 0 || max < 0 || m - n > static_cast<std::size_t>(max)
+            || m > static_cast<std::size_t>(PreparedQuery::MAX_BIT_PARALLEL_LENGTH)) {
+            return DispatchKernel::banded;
+        }
+
+        DispatchKernel bit_parallel = DispatchKernel::bit_parallel;
+        if (prepared && b == constant) {
+            bit_parallel = DispatchKernel::prepared;
+            subject      = a;
+        } else if (prepared && a == constant) {
+            bit_parallel = DispatchKernel::prepared;
+            subject      = b;
+        }
+        const auto &costs  = DISPATCH_COSTS[transpositions];
+        const int   length = dispatch_length_class(m);
+        const int   cutoff = dispatch_cutoff_class(max);
+        const float banded = costs[static_cast<int>(DispatchKernel::banded)][length][cutoff];
+        return costs[static_cast<int>(bit_parallel)][length][cutoff] < banded ? bit_parallel : DispatchKernel::banded;
+    }
+};
+
+} // namespace levenshtein
@@ -0,0 +1,65 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Generated by `microbench --calibrate`; see `dispatch.h`. Do not edit.
+
+Edits [1,4,16], alphabets [4,26], 4096 pairs in groups of 64, 3 trials of 20 ms.
+
+*/
+
+#pragma once
+
+namespace levenshtein {
+
+/// Nanoseconds per call of each `DispatchKernel` by transpositions, length class, and cutoff class.
+constexpr float DISPATCH_COSTS[2][3][5][6] = {
+    { // Levenshtein
+        { // banded: bounded_edit_dist
+            {15.8f, 43.8f, 71.1f, 87.3f, 84.9f, 83.3f}, // length <= 4
+            {22.2f, 67.5f, 110.4f, 174.8f, 223.8f, 221.3f}, // length <= 8
+            {38.4f, 119.1f, 189.7f, 306.6f, 497.0f, 704.9f}, // length <= 16
+            {62.9f, 196.4f, 296.8f, 489.2f, 809.8f, 1418.3f}, // length <= 32
+            {112.6f, 353.8f, 525.9f, 900.3f, 1484.6f, 2813.4f}, // length <= 64
+        },
+        { // bit_parallel: prepared_each
+            {60.1f, 72.9f, 78.3f, 79.7f, 84.3f, 83.1f}, // length <= 4
+            {73.4f, 95.9f, 104.2f, 110.1f, 111.2f, 113.8f}, // length <= 8
+            {99.0f, 136.7f, 151.9f, 170.0f, 182.4f, 177.8f}, // length <= 16
+            {135.4f, 200.6f, 235.7f, 258.3f, 284.7f, 294.8f}, // length <= 32
+            {215.9f, 338.3f, 387.5f, 448.7f, 490.0f, 540.7f}, // length <= 64
+        },
+        { // prepared: prepared
+            {12.2f, 26.8f, 32.1f, 34.7f, 35.0f, 33.5f}, // length <= 4
+            {16.8f, 40.1f, 49.3f, 55.6f, 57.2f, 55.9f}, // length <= 8
+            {25.9f, 65.4f, 83.4f, 97.7f, 106.9f, 108.8f}, // length <= 16
+            {40.9f, 108.9f, 138.1f, 169.9f, 192.4f, 199.2f}, // length <= 32
+            {70.5f, 194.1f, 247.5f, 308.2f, 351.1f, 382.1f}, // length <= 64
+        },
+    },
+    { // Damerau-Levenshtein
+        { // banded: bounded_edit_dist_t
+            {33.9f, 86.3f, 120.2f, 146.9f, 157.3f, 160.9f}, // length <= 4
+            {52.7f, 153.6f, 229.0f, 360.4f, 507.7f, 511.7f}, // length <= 8
+            {92.2f, 256.7f, 412.6f, 665.0f, 1145.7f, 1601.4f}, // length <= 16
+            {152.4f, 432.7f, 649.2f, 1103.1f, 2042.0f, 3476.0f}, // length <= 32
+            {294.8f, 773.4f, 1203.6f, 1977.5f, 3623.6f, 6874.2f}, // length <= 64
+        },
+        { // bit_parallel: prepared_each_t
+            {62.1f, 74.7f, 80.5f, 85.0f, 84.6f, 83.1f}, // length <= 4
+            {73.2f, 96.6f, 108.1f, 116.2f, 116.8f, 116.2f}, // length <= 8
+            {100.1f, 140.4f, 157.4f, 175.2f, 183.4f, 187.9f}, // length <= 16
+            {137.6f, 216.4f, 244.2f, 275.9f, 297.0f, 309.0f}, // length <= 32
+            {220.2f, 362.7f, 418.3f, 493.2f, 522.9f, 560.2f}, // length <= 64
+        },
+        { // prepared: prepared_t
+            {8.6f, 22.0f, 29.8f, 32.0f, 32.6f, 32.5f}, // length <= 4
+            {12.9f, 38.3f, 49.6f, 58.1f, 60.5f, 63.1f}, // length <= 8
+            {21.9f, 66.3f, 85.9f, 101.9f, 118.0f, 116.6f}, // length <= 16
+            {38.5f, 119.5f, 144.4f, 183.0f, 205.0f, 214.5f}, // length <= 32
+            {71.4f, 225.8f, 275.1f, 346.7f, 386.9f, 419.1f}, // length <= 64
+        },
+    },
+};
+
+} // namespace levenshtein
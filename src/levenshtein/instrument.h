@@ -0,0 +1,49 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Instrumentation hooks for the kernels in `levenshtein.h`.
+
+Every kernel takes an `Instrument` as its last argument and calls it at a handful of fixed points.
+The default, `NoInstrumentation`, does nothing, and because the hooks are empty inline functions
+the compiler removes them entirely. This is how metrics, debug printing, and any other
+observation of the algorithm get in without a copy of the kernel for each.
+
+The hooks, in the order they can be called:
+
+    length_exit()                       The answer followed from the lengths alone.
+    buffer_exceeded()                   The workspace is too small; the kernel gives up.
+    start(subject, query, max)          The DP is about to begin. `subject` is the shorter string.
+    row(i, start_j, end_j, row)         Row `i` has been computed for columns `start_j..end_j`.
+                                        `row[j]` is the value of cell `(i, j)` in that range.
+    columns(count, height)              Instead of rows, the bit-parallel kernel of `batch.h`
+                                        computed `count` whole columns of `height` cells, a word at
+                                        a time. Called once, before `early_exit` or `done`.
+    early_exit(i)                       The band became empty after row `i` (or, for the
+                                        bit-parallel kernel, the distance exceeded the bound
+                                        after column `i`).
+    done(distance)                      The DP ran to completion.
+
+An instrument need only define the hooks it cares about if it derives from `NoInstrumentation`.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <string_view>
+
+namespace levenshtein {
+
+struct NoInstrumentation {
+    void length_exit() {}
+    void buffer_exceeded() {}
+    void start(std::string_view, std::string_view, int) {}
+    void row(int, int, int, const int *) {}
+    void columns(int, int) {}
+    void early_exit(int) {}
+    void done(int) {}
+};
+
+} // namespace levenshtein
@@ -0,0 +1,583 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+The edit distance kernels, independent of MySQL.
+
+Each UDF in the `.cpp` files of `src/` is a thin shim over one of these functions: it unpacks
+`UDF_ARGS`, validates arguments, and translates the results below into the conventions of the UDF
+interface. C++ code that wants the same algorithms without marshalling arguments through
+`UDF_ARGS` can include this header directly:
+
+    levenshtein::Buffer buffer{levenshtein::workspace_size(longest, true)};
+    int d = levenshtein::bounded_edit_dist_t(name, "Vladimir Iosifovich Levenshtein", 6, buffer);
+
+Conventions:
+
+  - Strings are `std::string_view`s. Either argument may be the longer one.
+  - The caller provides the scratch memory as a `Workspace`. The kernels never allocate. If the
+    workspace is too small for the strings, they return `BUFFER_EXCEEDED`.
+  - Bounded kernels return the distance if it is at most `max` and `max + 1` otherwise. `max`
+    must not be negative.
+  - If one string is empty, the distance kernels return the length of the other one, regardless
+    of `max`. This is what the UDFs have always done.
+  - Every kernel takes an optional `Instrument`, described in `instrument.h`.
+
+The public functions are a `prealgorithm()` that handles everything that can be decided from the
+lengths alone, followed by one of the `core::` kernels. Both halves are exposed so that callers who
+already know the preconditions hold can skip the first half.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <string_view>
+#include <vector>
+
+#include "instrument.h"
+
+namespace levenshtein {
+
+/// Returned by every kernel when the workspace is too small for the strings being compared.
+constexpr int BUFFER_EXCEEDED = -1;
+
+/// Caller-provided scratch memory for a kernel. The kernels do not take ownership of `buffer`,
+/// and its contents on entry don't matter.
+struct Workspace {
+    int *buffer;
+    int  size; // In `int`s, not bytes
+};
+
+/// The number of `int`s of workspace needed to compare two strings, the longer of which has
+/// `longer_length` characters. The transposition variants keep two rows instead of one.
+constexpr int workspace_size(std::size_t longer_length, bool transpositions) {
+    return (transpositions ? 2 : 1)*(static_cast<int>(longer_length) + 1);
+}
+
+/// An owning workspace, for callers who don't already manage their own memory. Unlike the
+/// kernels, the constructor allocates and can throw.
+class Buffer {
+public:
+    explicit Buffer(int size): cells(static_cast<std::size_t>(std::max(size, 0))) {}
+
+    Workspace workspace() { return {cells.data(), static_cast<int>(cells.size())}; }
+    operator Workspace() { return workspace(); }
+
+private:
+    std::vector<int> cells;
+};
+
+/// Converts minimum allowed similarity to maximum allowed number of edits for a given string length.
+/// Assumes similarity is in the interval [0.0, 1.0].
+inline constexpr int similarity_to_max_edits(double similarity, int length) {
+    return static_cast<int>((1.0 - similarity) * static_cast<double>(length));
+}
+
+/// The inverse of the above. Converts number of edits for a given string length to a similarity score.
+inline constexpr double edits_to_similarity(int edits, int length) {
+    return 1.0 - static_cast<double>(edits) / static_cast<double>(length);
+}
+
+/// Passed as `max` to `prealgorithm()` by the unbounded kernels. No length difference exceeds it.
+constexpr int UNBOUNDED = std::numeric_limits<int>::max();
+
+/// The setup shared by every kernel. Swaps the strings if necessary so that `subject` is the
+/// shorter one, and answers the comparison outright if the lengths alone decide it. Returns `true`
+/// and sets `result` in that case; otherwise the caller goes on to one of the `core::` kernels.
+template<class Instrument>
+inline bool prealgorithm(std::string_view &subject, std::string_view &query, int max, int &result,
+                         Instrument &instrument) {
+    // Ensure 'subject' is the smaller string for efficiency
+    if (query.length() < subject.length()) {
+        std::swap(subject, query);
+    }
+
+    const int n = static_cast<int>(subject.length()); // Cast size_type to int
+    const int m = static_cast<int>(query.length());   // Cast size_type to int
+
+    if (n == 0) {
+        instrument.length_exit();
+        result = m;
+        return true;
+    }
+
+    // Distance is at least the difference in the lengths of the strings.
+    if (m - n > max) {
+        instrument.length_exit();
+        result = max + 1; // Return max+1 by convention.
+        return true;
+    }
+
+    return false;
+}
+
+/*
+The kernels proper. Each requires that
+
+  - `subject` is not longer than `query`,
+  - `subject` is not empty,
+  - `buffer` has room for `workspace_size(query.length(), transpositions)` ints,
+  - and, for the bounded kernels, `query.length() - subject.length() <= max`,
+
+all of which the public functions below check before calling them.
+*/
+namespace core {
+
+template<class Instrument>
+int edit_dist(std::string_view subject, std::string_view query, int *buffer, Instrument &instrument) {
+    const int n = static_cast<int>(subject.length());
+    const int m = static_cast<int>(query.length());
+
+    instrument.start(subject, query, m);
+    std::iota(buffer, buffer + m + 1, 0);
+
+    int current_cell = 0;
+
+    // Main loop to calculate the Levenshtein distance
+    for (int i = 1; i <= n; ++i) {
+        // We use only a single "row" instead of a full matrix. Let's call it cell[*].
+        // The current cell, cell[j], is matrix position (row, col) = (i, j).  To compute
+        // this cell, we need matrix(i-1, j), matrix(i, j-1), and matrix(i-1, j-1). When
+        // computing the current cell value,
+        //               (  matrix(i, p)    for p < j
+        //     cell[p] = |
+        //               (  matrix(i-1, p)   for p >= j.
+        // Thus, before we overwrite cell[j], it contains matrix(i-1, j). In the previous
+        // iteration, we overwrote matrix(i-1, j-1) with the value of matrix(i, j-1). Thus,
+        // we need to keep the value in cell[j] before overwriting it for use in the next
+        // iteration. We store it in the variable `previous_cell`. The invariant is that
+        // `previous_cell` = matrix(i-1, j-1).
+        int previous_cell = i - 1; // = buffer[start_j-1];
+
+        // Initialize first column
+        buffer[0] = i;
+
+        // Main inner loop
+        for (int j = 1; j <= m; ++j) {
+            int cost = (subject[i - 1] == query[j - 1]) ? 0 : 1;
+            // See the declaration of `previous_cell` for an explanation of this.
+            // `previous_cell` = matrix(i-1, j-1)
+            //       cell[j-1] = matrix(i, j-1)
+            //         cell[j] = matrix(i-1, j)
+            current_cell = std::min({buffer[j] + 1,
+                                     buffer[j - 1] + 1,
+                                     previous_cell + cost});
+
+            previous_cell = buffer[j];    // Save cell value for next iteration
+            buffer[j]     = current_cell; // Overwrite
+        }
+
+        instrument.row(i, 1, m, buffer);
+    }
+
+    instrument.done(current_cell);
+    return current_cell;
+}
+
+template<class Instrument>
+int edit_dist_t(std::string_view subject, std::string_view query, int *buffer, Instrument &instrument) {
+    const int n = static_cast<int>(subject.length());
+    const int m = static_cast<int>(query.length());
+
+    instrument.start(subject, query, m);
+
+    // We keep track of only two rows for this algorithm. See below for details.
+    int *current  = buffer;
+    int *previous = buffer + m + 1;
+    std::iota(current, current + m + 1, 0);
+    std::iota(previous, previous + m + 1, 0);
+
+    int previous_cell          = 0;
+    int previous_previous_cell = 0;
+    int current_cell           = 0;
+
+    // Main loop to calculate the Damerau-Levenshtein distance
+    for (int i = 1; i <= n; ++i) {
+        // Initialize first column
+        current[0]    = i;
+        previous_cell = i - 1; // = matrix(i-1, 0)
+
+        // Main inner loop
+        for (int j = 1; j <= m; ++j) {
+            /*
+            At the start of the computation of matrix(i, j) we have:
+                current[p]  = {  matrix(i, p)     for p < j
+                              {  matrix(i-1, p)   for p >= j
+                previous[p] = {  matrix(i-1, p)   for p < j - 2
+                              {  matrix(i-2, p)   for p >= j - 2
+                previous_cell          = matrix(i-1, j-1)
+                previous_previous_cell = matrix(i-1, j-2)
+
+            To compute matrix(i, j), we need to use the following:
+                matrix(i  , j-1) = current[j-1]
+                matrix(i-2, j-2) = previous[j-2]
+                matrix(i-1, j-1) = previous_cell
+                matrix(i-1, j  ) = current[j]
+            */
+
+            int cost     = (subject[i - 1] == query[j - 1]) ? 0 : 1;
+            current_cell = std::min({current[j]    + 1,
+                                     current[j-1]  + 1,
+                                     previous_cell + cost});
+
+            // Check for transpositions
+            if (i > 1 && j > 1 && subject[i - 1] == query[j - 2] && subject[i - 2] == query[j - 1]) {
+                current_cell = std::min(current_cell, previous[j-2] + cost);
+            }
+
+            /*
+            We compute current_cell = matrix(i, j) and then perform the update for the next iteration:
+                previous[j-2]          <-- previous_previous_cell := matrix(i-1, j-2)
+                previous_previous_cell <-- previous_cell          := matrix(i-1, j-1)
+                previous_cell          <-- current[j]             := matrix(i-1, j)
+                current[j]             <-- current_cell           := matrix(i, j)
+            */
+
+            if (j > 1) {
+                previous[j-2]      = previous_previous_cell;
+            }
+            previous_previous_cell = previous_cell;
+            previous_cell          = current[j];
+            current[j]             = current_cell;
+        }
+
+        instrument.row(i, 1, m, current);
+    }
+
+    instrument.done(current_cell);
+    return current_cell;
+}
+
+template<class Instrument>
+int bounded_edit_dist(std::string_view subject, std::string_view query, int max, int *buffer,
+                      Instrument &instrument) {
+    const int n = static_cast<int>(subject.length());
+    const int m = static_cast<int>(query.length());
+
+    instrument.start(subject, query, max);
+    std::iota(buffer, buffer + m + 1, 0);
+
+    // int previous_cell = 0;
+    int current_cell  = 0;
+
+    /*
+    The quantity `max_d - (m-n)` represents the remaining cost budget after accounting for the `(m-n)` insertions
+    we know are required. It is possible for there to be additional insertions beyond the required `(m-n)`
+    insertions, but for every additional insertion beyond the `(m-n)`, there will have to be a corresponding
+    deletion for the strings to end up the same length. Therefore, for every additional insertion, the total cost
+    will be 2, one for the insertion and one for the corresponding deletion. There can be at most `(max_d -
+    (m-n))/2`, because $2\times$ `(max_d - (m-n))/2` $=$ `max_d - (m-n)`, our remaining cost budget.
+
+    As we move along in our computation, we will "spend" more and more of our remaining cost budget, allowing us to
+    narrow our band even farther.
+
+    The diagonal cells of the matrix *starting from the upper left corner* represent when the strings are the same
+    length. The diagonal cells of the matrix *starting from the lower right corner* represent when the strings have the
+    same number of characters remaining (to be inserted or substituted). You can think of this second diagonal as where
+    you are after spending the `(m-n)` inserts into the shorter string to obtain the longer string (or equivalently, the
+    deletions from the longer string to obtain the shorter string). We shall call it the *right diagonal*.
+
+    After computing a row, we have additional information about our remaining cost budget. The cell `curr[stop_column -
+    1]` represents both the insertions needed to reach the right diagonal, the additional insertions to reach
+    `stop_column-1`, and any additional edits that may have occurred. But recall that for every insertion beyond the
+    right diagonal (beyond `(m-n)` insertions) must necessarily be paired with a deletion. The number of additional
+    insertions at `stop_column - 1` is `(stop_column-1) - (m-n)`. Therefore,  `curr[stop_column - 1] + (stop_column-1) -
+    (m-n)` is a lower bound on the final number of edits required to transform one string into the other.  We require
+    this lower bound to be no greater than `max_d`: `curr[stop_column - 1] + (stop_column-1) - (m-n) <= max_d`. What
+    should `stop_column` be? Solving the inequality for `stop_column`, we have `stop_column <= max_d -
+    curr[stop_column-1] + (m-n) + 1`. We can compute the RHS value explicitly, and if `stop_column` is too large, we
+    decrement it and recheck the inequality (since the RHS depends on `stop_column`), and continue decrementing
+    `stop_column` until the inequality holds. If ever `start_column == stop_column-1` (the case of an "empty band"), we
+    know we will exceed `max_d`.
+    */
+
+    const int m_n = m-n; // We use this a lot.
+
+    // Keeping track of start and end is slightly faster than keeping track of
+    // right/left band for reasons I don't understand.
+    // first cell computed
+    int start_j = 1;
+    // last cell computed, +1 because we start at second row (index 1)
+    int end_j   = std::min((max + m_n) / 2 + 1, m);
+
+    // Main loop to calculate the Levenshtein distance
+    for (int i = 1; i <= n; ++i) {
+        // We use only a single "row" instead of a full matrix. Let's call it cell[*].
+        // The current cell, cell[j], is matrix position (row, col) = (i, j).  To compute
+        // this cell, we need matrix(i-1, j), matrix(i, j-1), and matrix(i-1, j-1). When
+        // computing the current cell value,
+        //               (  matrix(i, p)    for p < j
+        //     cell[p] = |
+        //               (  matrix(i-1, p)   for p >= j.
+        // Thus, before we overwrite cell[j], it contains matrix(i-1, j). In the previous
+        // iteration, we overwrote matrix(i-1, j-1) with the value of matrix(i, j-1). Thus,
+        // we need to keep the value in cell[j] before overwriting it for use in the next
+        // iteration. We store it in the variable `previous_cell`. The invariant is that
+        // `previous_cell` = matrix(i-1, j-1).
+
+        // The order of these initializations is crucial. This comes first so the value in the buffer isn't overwritten.
+        int previous_cell = buffer[start_j-1];
+
+        // Initialize first column
+        // if (start_j == 1) // This line seems to make no difference.
+        buffer[0] = i;
+
+        // Assume anything outside the band contains more than max. The only cells outside the
+        // band we actually look at are positions (i,start_j-1) and  (i,end_j+1), so we
+        // pre-fill it with max + 1.
+        // if (start_j > 1) buffer[start_j-1] = max + 1;
+        // if (end_j   < m) buffer[end_j+1]   = max + 1;
+
+        // Main inner loop
+        for (int j = start_j; j <= end_j; ++j) {
+            int cost = (subject[i - 1] == query[j - 1]) ? 0 : 1;
+            // See the declaration of `previous_cell` for an explanation of this.
+            // `previous_cell` = matrix(i-1, j-1)
+            //       cell[j-1] = matrix(i, j-1)
+            //         cell[j] = matrix(i-1, j)
+            current_cell = std::min({buffer[j]   + 1,
+                                     buffer[j-1] + 1,
+                                     previous_cell + cost});
+
+            previous_cell = buffer[j];    // Save cell value for next iteration
+            buffer[j]     = current_cell; // Overwrite
+        }
+
+        instrument.row(i, start_j, end_j, buffer);
+
+        // See if we can make the band narrower based on the row just computed.
+        while(
+                // end_j < m && // This should always be true
+                end_j > 0
+                && buffer[end_j] + std::abs(end_j - i - m_n) > max
+              ) {
+            end_j--;
+        }
+        // Increment for next row
+        end_j = std::min(m, end_j + 1);
+
+        // The starting point is a little different. It is "sticky" unless we
+        // can prove it can shrink. Think of it as, both start and end do
+        // the most conservative thing.
+        while(
+                start_j <= end_j
+                && std::abs(i + m_n - start_j) + buffer[start_j] > max
+              ) {
+            start_j++;
+        }
+
+        if (end_j < start_j) {
+            instrument.early_exit(i);
+            return max + 1;
+        }
+    }
+
+    // Return the final Levenshtein distance
+    current_cell = std::min(max + 1, current_cell); //buffer[m];
+    instrument.done(current_cell);
+    return current_cell;
+}
+
+template<class Instrument>
+int bounded_edit_dist_t(std::string_view subject, std::string_view query, int max, int *buffer,
+                        Instrument &instrument) {
+    const int n = static_cast<int>(subject.length());
+    const int m = static_cast<int>(query.length());
+
+    instrument.start(subject, query, max);
+
+    // We keep track of only two rows for this algorithm. See below for details.
+    int *current  = buffer;
+    int *previous = buffer + m + 1;
+    std::iota(current, current + m + 1, 0);
+    std::iota(previous, previous + m + 1, 0);
+
+    int previous_previous_cell = 0;
+    int previous_cell          = 0;
+    int current_cell           = 0;
+
+    const int m_n = m-n; // We use this a lot.
+
+    // Keeping track of start and end is slightly faster than keeping track of
+    // right/left band for reasons I don't understand.
+    // first cell computed
+    int start_j = 1;
+    // last cell computed, +1 because we start at second row (index 1)
+    int end_j   = std::min((max + m_n) / 2 + 1, m);
+
+    // Main loop to calculate the Damerau-Levenshtein distance
+    for (int i = 1; i <= n; ++i) {
+        // The order of these initializations is crucial. This comes first so the value in the buffer isn't overwritten.
+        previous_cell = current[start_j-1]; // = matrix(i-1, 0)
+
+        // Initialize first column
+        // if (start_j == 1) // This line seems to make no difference.
+        current[0] = i;
+
+        // Assume anything outside the band contains more than max. The only cells outside the
+        // band we actually look at are positions (i,start_j-1) and  (i,end_j+1), so we
+        // pre-fill it with max + 1.
+        // if (start_j > 1) current[start_j-1] = max + 1;
+        // if (end_j   < m) current[end_j]     = max + 1;
+
+        // Main inner loop
+        for (int j = start_j; j <= end_j; ++j) {
+            /*
+            At the start of the computation of matrix(i, j) we have:
+                current[p]  = {  matrix(i, p)     for p < j
+                              {  matrix(i-1, p)   for p >= j
+                previous[p] = {  matrix(i-1, p)   for p < j - 2
+                              {  matrix(i-2, p)   for p >= j - 2
+                previous_cell          = matrix(i-1, j-1)
+                previous_previous_cell = matrix(i-1, j-2)
+
+            To compute matrix(i, j), we need to use the following:
+                matrix(i  , j-1) = current[j-1]
+                matrix(i-2, j-2) = previous[j-2]
+                matrix(i-1, j-1) = previous_cell
+                matrix(i-1, j  ) = current[j]
+            */
+
+            int cost     = (subject[i - 1] == query[j - 1]) ? 0 : 1;
+            current_cell = std::min({current[j]    + 1,
+                                     current[j-1]  + 1,
+                                     previous_cell + cost});
+
+            // Check for transpositions
+            if (i > 1 && j > 1 && subject[i - 1] == query[j - 2] && subject[i - 2] == query[j - 1]) {
+                current_cell = std::min(current_cell, previous[j-2] + cost);
+            }
+
+            /*
+            We compute current_cell = matrix(i, j) and then perform the update for the next iteration:
+                previous[j-2]          <-- previous_previous_cell := matrix(i-1, j-2)
+                previous_previous_cell <-- previous_cell          := matrix(i-1, j-1)
+                previous_cell          <-- current[j]             := matrix(i-1, j)
+                current[j]             <-- current_cell           := matrix(i, j)
+            */
+
+            if (j > 1) {
+                previous[j-2]      = previous_previous_cell;
+            }
+            previous_previous_cell = previous_cell;
+            previous_cell          = current[j];
+            current[j]             = current_cell;
+        }
+
+        // The update of `previous` runs two cells behind, so the loop stopped short of the last
+        // cell of the band but one. The next row's band can reach one cell further, and then its
+        // transposition check reads that cell.
+        previous[end_j-1] = previous_previous_cell;
+
+        instrument.row(i, start_j, end_j, current);
+
+        // See if we can make the band narrower based on the row just computed.
+        while(
+            // end_j < m && // This should always be true
+                end_j > 0
+                // Have to subtract one in the following as next character might make transposition
+                && current[end_j] + std::abs(end_j - i - m_n) - 1 > max
+                ) {
+            end_j--;
+        }
+        // Increment for next row
+        end_j = std::min(m, end_j + 1);
+
+        // The starting point is a little different. It is "sticky" unless we
+        // can prove it can shrink. Think of it as, both start and end do
+        // the most conservative thing.
+        while(
+                start_j <= end_j
+                // Have to subtract one in the following as next character might make transposition
+                && std::abs(i + m_n - start_j) + current[start_j] - 1 > max
+                ) {
+            start_j++;
+        }
+
+        if (end_j < start_j) {
+            instrument.early_exit(i);
+            return max + 1;
+        }
+    }
+
+    // Return the final Damerau-Levenshtein distance
+    current_cell = std::min(max + 1, current_cell);
+    instrument.done(current_cell);
+    return current_cell;
+}
+
+} // namespace core
+
+/// Checks that the workspace can hold the comparison, reporting to the instrument if not.
+template<class Instrument>
+inline bool fits(Workspace workspace, std::size_t m, bool transpositions, Instrument &instrument) {
+    if (workspace_size(m, transpositions) > workspace.size) {
+        instrument.buffer_exceeded();
+        return false;
+    }
+    return true;
+}
+
+/// The Levenshtein distance between `a` and `b`.
+template<class Instrument = NoInstrumentation>
+int edit_dist(std::string_view a, std::string_view b, Workspace workspace, Instrument &&instrument = Instrument{}) {
+    int result;
+    if (prealgorithm(a, b, UNBOUNDED, result, instrument)) return result;
+    if (!fits(workspace, b.length(), false, instrument)) return BUFFER_EXCEEDED;
+    return core::edit_dist(a, b, workspace.buffer, instrument);
+}
+
+/// The Damerau-Levenshtein (optimal string alignment) distance between `a` and `b`.
+template<class Instrument = NoInstrumentation>
+int edit_dist_t(std::string_view a, std::string_view b, Workspace workspace, Instrument &&instrument = Instrument{}) {
+    int result;
+    if (prealgorithm(a, b, UNBOUNDED, result, instrument)) return result;
+    if (!fits(workspace, b.length(), true, instrument)) return BUFFER_EXCEEDED;
+    return core::edit_dist_t(a, b, workspace.buffer, instrument);
+}
+
+/// The Levenshtein distance between `a` and `b` if it is at most `max`, otherwise `max + 1`.
+template<class Instrument = NoInstrumentation>
+int bounded_edit_dist(std::string_view a, std::string_view b, int max, Workspace workspace,
+                      Instrument &&instrument = Instrument{}) {
+    int result;
+    if (prealgorithm(a, b, max, result, instrument)) return result;
+    if (!fits(workspace, b.length(), false, instrument)) return BUFFER_EXCEEDED;
+    return core::bounded_edit_dist(a, b, max, workspace.buffer, instrument);
+}
+
+/// The Damerau-Levenshtein distance between `a` and `b` if it is at most `max`, otherwise `max + 1`.
+template<class Instrument = NoInstrumentation>
+int bounded_edit_dist_t(std::string_view a, std::string_view b, int max, Workspace workspace,
+                        Instrument &&instrument = Instrument{}) {
+    int result;
+    if (prealgorithm(a, b, max, result, instrument)) return result;
+    if (!fits(workspace, b.length(), true, instrument)) return BUFFER_EXCEEDED;
+    return core::bounded_edit_dist_t(a, b, max, workspace.buffer, instrument);
+}
+
+/// The similarity `1 - edit_dist_t(a, b)/max(|a|, |b|)` if it is at least `similarity`. Otherwise
+/// returns some smaller value (but never less than 0). Two empty strings have similarity 1.
+/// Returns `BUFFER_EXCEEDED` if the workspace is too small.
+template<class Instrument = NoInstrumentation>
+double similarity_t(std::string_view a, std::string_view b, double similarity, Workspace workspace,
+                    Instrument &&instrument = Instrument{}) {
+    const int m = static_cast<int>(std::max(a.length(), b.length()));
+    if (m == 0) return 1.0;
+
+    // The algorithm works with number of edits, a positive integer. For similarity, the
+    // number of edits permitted depends on the length of the longest string.
+    const int max = similarity_to_max_edits(similarity, m);
+    int distance  = bounded_edit_dist_t(a, b, max, workspace, instrument);
+    if (distance == BUFFER_EXCEEDED) return BUFFER_EXCEEDED;
+
+    // A distance of `max + 1` is the similarity analog of `max + 1`: smaller than the minimum
+    // required similarity. It must still be positive.
+    return std::max(0.0, edits_to_similarity(std::min(distance, max + 1), m));
+}
+
+} // namespace levenshtein
@@ -0,0 +1,76 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Splitting a buffer into lines without copying it.
+
+The word lists and name dumps we search are large, and most of the time spent reading them line by
+line with `std::getline` goes to copying characters into `std::string`s. These functions hand out
+`std::string_view`s into the original buffer instead. The newline search compares 16 bytes at a
+time with SSE2 where it is available, and falls back to `memchr` otherwise. A trailing `\r` is
+dropped from each line, so files with Windows line endings work as expected.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace levenshtein {
+
+/// The first `'\n'` in `[begin, end)`, or `end` if there is none.
+inline const char *find_newline(const char *begin, const char *end) {
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - begin >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        if (mask != 0) {
+            return begin + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        begin += 16;
+    }
+    while (begin < end && *begin != '\n') begin++;
+    return begin;
+#else
+    const void *found = std::memchr(begin, '\n', static_cast<std::size_t>(end - begin));
+    return found ? static_cast<const char *>(found) : end;
+#endif
+}
+
+/// The position just after the end of the line containing `position`, that is, just past its
+/// `'\n'`, or `text.length()` for the last line. Used to move an arbitrary split point of a
+/// buffer to a line boundary.
+inline std::size_t next_line_start(std::string_view text, std::size_t position) {
+    if (position >= text.length()) return text.length();
+    const char *newline = find_newline(text.data() + position, text.data() + text.length());
+    return newline == text.data() + text.length() ? text.length()
+                                                  : static_cast<std::size_t>(newline - text.data()) + 1;
+}
+
+/// Calls `f(line, offset)` for each line of `text`, where `offset` is the position of the start of
+/// the line in `text`. A final line without a newline is still a line; an empty `text` has none.
+template<class F>
+void for_each_line(std::string_view text, F &&f) {
+    const char *begin = text.data();
+    const char *end   = text.data() + text.length();
+    const char *line  = begin;
+    while (line < end) {
+        const char *newline = find_newline(line, end);
+        std::size_t length  = static_cast<std::size_t>(newline - line);
+        if (length > 0 && line[length - 1] == '\r') length--;
+        f(std::string_view{line, length}, static_cast<std::size_t>(line - begin));
+        if (newline == end) break;
+        line = newline + 1;
+    }
+}
+
+} // namespace levenshtein
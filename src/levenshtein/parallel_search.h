@@ -0,0 +1,267 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Closest-match search across threads.
+
+`min_edit_dist` is fast because its bound tightens as it finds closer matches: after the first
+good match, most comparisons exit after a row or two. Splitting the haystack across threads only
+keeps that advantage if the threads share the bound, so here they do. The best match so far lives
+in a single atomic word, distance in the high half and index in the low half. Every worker loads
+it before each comparison and publishes an improvement with a compare-and-swap. Because the word
+compares as (distance, index), the result is the same as the sequential `best_match()`: the
+smallest distance, and among equally close subjects the first one. The one exception is an exact
+match. Nothing can beat distance 0, so once any thread finds one, every worker stops after its
+current comparison, and the search returns whichever exact match was found first.
+
+The haystack is cut into fixed size chunks. Each worker starts with an equal share of the chunks
+and takes them from the front of its share. A worker that runs out steals the back half of
+another worker's remaining share, so a worker whose chunks happen to be expensive doesn't hold up
+the rest. A share is a half-open range of chunk indices packed into one atomic word, so the owner
+and the thieves can both update it with a compare-and-swap.
+
+A `LengthPartitionedDictionary` can stand in for the subjects, as in `batch.h`. The threads then
+share only its candidates, and report each match by its index in the dictionary's input.
+
+Unlike the kernels, these functions allocate (the threads, and a workspace per thread for
+queries too long for the bit-parallel kernel). The subjects are indexed with 32 bits.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "span.h"
+
+namespace levenshtein {
+
+struct SearchOptions {
+    /// The number of threads to use, including the calling thread. 0 means one per hardware thread.
+    unsigned threads = 0;
+    /// The number of subjects in a unit of work.
+    std::size_t chunk_size = 4096;
+};
+
+namespace detail {
+
+/// A half-open range `[front, back)` of chunk indices in one atomic word.
+class ChunkRange {
+public:
+    void assign(std::uint32_t front, std::uint32_t back) {
+        range.store(pack(front, back), std::memory_order_release);
+    }
+
+    /// Takes the chunk at the front. Returns `false` if the range is empty.
+    bool pop(std::uint32_t &chunk) {
+        std::uint64_t current = range.load(std::memory_order_acquire);
+        while (front_of(current) < back_of(current)) {
+            if (range.compare_exchange_weak(current, pack(front_of(current) + 1, back_of(current)),
+                                            std::memory_order_acq_rel)) {
+                chunk = front_of(current);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Takes the back half of the range (at least one chunk). Returns `false` if the range is empty.
+    bool steal(std::uint32_t &front, std::uint32_t &back) {
+        std::uint64_t current = range.load(std::memory_order_acquire);
+        while (front_of(current) < back_of(current)) {
+            std::uint32_t middle = front_of(current) + (back_of(current) - front_of(current))/2;
+            if (range.compare_exchange_weak(current, pack(front_of(current), middle), std::memory_order_acq_rel)) {
+                front = middle;
+                back  = back_of(current);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::atomic<std::uint64_t> range{0};
+
+    static std::uint64_t pack(std::uint32_t front, std::uint32_t back) {
+        return (std::uint64_t{front} << 32) | back;
+    }
+    static std::uint32_t front_of(std::uint64_t range) { return static_cast<std::uint32_t>(range >> 32); }
+    static std::uint32_t back_of(std::uint64_t range) { return static_cast<std::uint32_t>(range); }
+};
+
+/// The best match so far, as (distance, index) in one atomic word so that it can be compared and
+/// replaced as a unit.
+class SharedBest {
+public:
+    SharedBest(int distance, std::uint32_t index): best(pack(distance, index)) {}
+
+    std::uint64_t load() const { return best.load(std::memory_order_relaxed); }
+
+    /// Replaces the best match with (distance, index) if that is smaller.
+    void offer(int distance, std::uint32_t index) {
+        std::uint64_t candidate = pack(distance, index);
+        std::uint64_t current   = best.load(std::memory_order_relaxed);
+        while (candidate < current
+               && !best.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {}
+    }
+
+    static int distance_of(std::uint64_t best) { return static_cast<int>(best >> 32); }
+    static std::uint32_t index_of(std::uint64_t best) { return static_cast<std::uint32_t>(best); }
+
+private:
+    std::atomic<std::uint64_t> best;
+
+    static std::uint64_t pack(int distance, std::uint32_t index) {
+        return (static_cast<std::uint64_t>(distance) << 32) | index;
+    }
+};
+
+/// The subjects of a search, by position, each with the index it is reported by.
+class SpanHaystack {
+public:
+    explicit SpanHaystack(Span<const std::string_view> subjects): subjects(subjects) {}
+
+    std::size_t size() const { return subjects.size(); }
+    std::string_view operator[](std::size_t i) const { return subjects[i]; }
+    std::uint32_t id(std::size_t i) const { return static_cast<std::uint32_t>(i); }
+
+private:
+    Span<const std::string_view> subjects;
+};
+
+/// The candidates of a dictionary for a query and cutoff, reported by their index in the input the
+/// dictionary was built from.
+class DictionaryHaystack {
+public:
+    DictionaryHaystack(const LengthPartitionedDictionary &dictionary, std::string_view query, int k)
+        : dictionary(dictionary), range(dictionary.candidates(static_cast<int>(query.length()), k)) {}
+
+    std::size_t size() const { return range.size(); }
+    std::string_view operator[](std::size_t i) const { return dictionary[range.begin + i]; }
+    std::uint32_t id(std::size_t i) const { return dictionary.id(range.begin + i); }
+
+private:
+    const LengthPartitionedDictionary &dictionary;
+    LengthPartitionedDictionary::Range range;
+};
+
+template<bool transpositions, class Haystack>
+Match parallel_best_match(const PreparedQuery &query, const Haystack &subjects, int k, SearchOptions options) {
+    constexpr std::uint32_t NONE = static_cast<std::uint32_t>(-1);
+    const std::size_t count = subjects.size();
+    if (count == 0 || k < 0) return {Match::NOT_FOUND, k + 1};
+
+    const std::size_t chunk_size = std::max<std::size_t>(options.chunk_size, 1);
+    const std::size_t chunks     = (count + chunk_size - 1)/chunk_size;
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, chunks));
+
+    // Only queries too long for the bit-parallel kernel need a workspace.
+    int workspace_ints = 0;
+    if (!query.bit_parallel()) {
+        std::size_t longest = query.text().length();
+        for (std::size_t i = 0; i < count; i++) longest = std::max(longest, subjects[i].length());
+        workspace_ints = workspace_size(longest, transpositions);
+    }
+
+    std::unique_ptr<ChunkRange[]> shares{new ChunkRange[threads]};
+    for (unsigned worker = 0; worker < threads; worker++) {
+        shares[worker].assign(static_cast<std::uint32_t>(chunks*worker/threads),
+                              static_cast<std::uint32_t>(chunks*(worker + 1)/threads));
+    }
+    SharedBest best{k + 1, NONE};
+
+    auto work = [&](unsigned worker) {
+        Buffer buffer{workspace_ints};
+
+        auto search_chunk = [&](std::uint32_t chunk) {
+            const std::size_t end = std::min(count, (chunk + 1)*chunk_size);
+            for (std::size_t i = chunk*chunk_size; i < end; i++) {
+                if (i + PREFETCH_DISTANCE < end) prefetch(subjects[i + PREFETCH_DISTANCE].data());
+
+                std::uint64_t current = best.load();
+                if (SharedBest::distance_of(current) == 0) return false; // Someone found an exact match.
+                int bound = std::min(SharedBest::distance_of(current), k);
+                // A subject after the best match must be strictly closer to replace it.
+                const std::uint32_t id = subjects.id(i);
+                if (id > SharedBest::index_of(current)) bound--;
+
+                int distance = query.distance<transpositions>(subjects[i], bound, buffer);
+                if (distance != BUFFER_EXCEEDED && distance <= bound) {
+                    best.offer(distance, id);
+                }
+            }
+            return true;
+        };
+
+        std::uint32_t chunk;
+        for (;;) {
+            while (shares[worker].pop(chunk)) {
+                if (!search_chunk(chunk)) return;
+            }
+            // Out of work. Steal half of someone else's.
+            bool stole = false;
+            for (unsigned offset = 1; offset < threads && !stole; offset++) {
+                std::uint32_t front, back;
+                if (shares[(worker + offset) % threads].steal(front, back)) {
+                    shares[worker].assign(front, back);
+                    stole = true;
+                }
+            }
+            if (!stole) return;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned worker = 1; worker < threads; worker++) {
+        pool.emplace_back(work, worker);
+    }
+    work(0);
+    for (auto &thread: pool) thread.join();
+
+    std::uint64_t result = best.load();
+    if (SharedBest::index_of(result) == NONE) return {Match::NOT_FOUND, k + 1};
+    return {SharedBest::index_of(result), SharedBest::distance_of(result)};
+}
+
+} // namespace detail
+
+/// The same result as `best_match()`, using several threads.
+inline Match parallel_best_match(const PreparedQuery &query, Span<const std::string_view> subjects, int k,
+                                 SearchOptions options = {}) {
+    return detail::parallel_best_match<false>(query, detail::SpanHaystack{subjects}, k, options);
+}
+
+/// The same result as `best_match_t()`, using several threads.
+inline Match parallel_best_match_t(const PreparedQuery &query, Span<const std::string_view> subjects, int k,
+                                   SearchOptions options = {}) {
+    return detail::parallel_best_match<true>(query, detail::SpanHaystack{subjects}, k, options);
+}
+
+/// The same result as `best_match()` over a dictionary, using several threads. Only the
+/// candidates are split between the threads.
+inline Match parallel_best_match(const PreparedQuery &query, const LengthPartitionedDictionary &dictionary, int k,
+                                 SearchOptions options = {}) {
+    return detail::parallel_best_match<false>(query, detail::DictionaryHaystack{dictionary, query.text(), k}, k,
+                                              options);
+}
+
+/// The same result as `best_match_t()` over a dictionary, using several threads.
+inline Match parallel_best_match_t(const PreparedQuery &query, const LengthPartitionedDictionary &dictionary, int k,
+                                   SearchOptions options = {}) {
+    return detail::parallel_best_match<true>(query, detail::DictionaryHaystack{dictionary, query.text(), k}, k,
+                                             options);
+}
+
+} // namespace levenshtein
@@ -0,0 +1,207 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Incremental reuse of DP rows across consecutive subjects.
+
+When a constant query is compared against a sorted haystack (`ORDER BY name`), consecutive
+subjects share long prefixes. Row `i` of the DP matrix depends only on the first `i` characters of
+the subject (and on the query), so if the previous subject shares a prefix of length `p` with the
+current one, rows `0..p` are already known. `PrefixCache` keeps every row of the previous subject
+and resumes from the longest common prefix. For a sorted dictionary scan this recovers most of the
+benefit of a trie without building any index.
+
+To make the stored rows reusable, the band cannot depend on anything specific to a subject. The
+adaptive band of `bounded_edit_dist` depends on `m-n`, so it can't be used here. Instead we use
+the classic diagonal band `|i - j| <= max`. Within this band any computed value that is at most
+`max` is exact, and cells outside the band are known to exceed `max`. Values computed under a
+larger `max` remain valid under a smaller one. In a `min_edit_dist` query `max` only shrinks, so
+the cache is discarded only when the query string changes or `max` grows.
+
+Rows are computed over the subject (which changes from call to call) and columns over the query
+(which doesn't). Unlike the other kernels, this one never swaps the strings.
+
+The wider band makes each row somewhat more expensive than in the adaptive kernels, which is a bad
+trade when the haystack is not sorted. `prefers()` keeps a running measure of how much prefix
+the subjects actually share and declines when reuse is too low to pay for itself.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "instrument.h"
+
+namespace levenshtein {
+
+/// `transpositions` selects Damerau-Levenshtein (optimal string alignment, as in `edit_dist_t`)
+/// instead of Levenshtein distance.
+template<bool transpositions>
+class PrefixCache {
+public:
+    /// `max_cells` limits the size of the stored matrix, `(n+1)*(m+1)` cells.
+    explicit PrefixCache(std::size_t max_cells = std::size_t{1} << 22): max_cells(max_cells) {}
+
+    /// Compares `subject` with the previous subject and decides whether the incremental kernel
+    /// is worth using for it. If it returns `false`, the caller should compute the distance some
+    /// other way, and the cache remembers `subject` (without any rows) for the next comparison.
+    bool prefers(std::string_view query, std::string_view subject) {
+        std::size_t shared = common_prefix(subject, previous);
+
+        seen_characters   += subject.length();
+        shared_characters += shared;
+        // Exponential decay, so the decision follows the data if it stops (or starts) being sorted.
+        if (seen_characters > DECAY_THRESHOLD) {
+            seen_characters   /= 2;
+            shared_characters /= 2;
+        }
+
+        // Require roughly a third of each subject to be reused, on average.
+        bool worthwhile = 3*shared_characters >= seen_characters
+                          && reserve(subject.length(), query.length());
+        if (!worthwhile) {
+            previous.assign(subject);
+            rows_valid = 0;
+        }
+        return worthwhile;
+    }
+
+    /// Computes the distance between `query` and `subject` if it is at most `max`, otherwise
+    /// returns `max + 1`. Rows shared with the previous subject are not recomputed, and so aren't
+    /// reported to `instrument` (see `instrument.h`), whose `row()` gets only the rows computed.
+    template<class Instrument = NoInstrumentation>
+    int distance(std::string_view query, std::string_view subject, int max, Instrument &&instrument = Instrument{}) {
+        const int n = static_cast<int>(subject.length());
+        const int m = static_cast<int>(query.length());
+
+        // The stored rows are only valid for the same query and a band at least as wide.
+        if (query != this->query || max > band) {
+            this->query.assign(query);
+            rows_valid = 0;
+        }
+        band = max;
+
+        // Distance is at least the difference in the lengths of the strings.
+        if (std::abs(m - n) > max) {
+            instrument.length_exit();
+            return max + 1;
+        }
+        if (!reserve(subject.length(), query.length())) {
+            // Can't happen after `prefers()` returned `true`, but fail safe.
+            return max + 1;
+        }
+
+        // The longest prefix of `subject` whose rows we already have.
+        int resume = static_cast<int>(std::min<std::size_t>(common_prefix(subject, previous), rows_valid));
+        previous.assign(subject);
+        instrument.start(subject, query, max);
+
+        const int width = m + 1;
+        int *row0       = matrix.data();
+        if (resume == 0) {
+            // Row 0 is the distance from the empty string and is never outside the band.
+            for (int j = 0; j <= m; j++) row0[j] = j;
+        }
+
+        // The early exit uses a lower bound on the final distance: any path through (i, j) still
+        // has to make up the difference in the lengths of the remaining suffixes. Unlike the band,
+        // this depends on `n`, but it only decides when to stop, so the rows stay reusable. We
+        // keep the bounds of the two most recently computed rows.
+        const int m_n = m - n;
+        int previous_bound = 0;
+        int current_bound  = 0;
+
+        for (int i = resume + 1; i <= n; i++) {
+            int *current  = row0 + i*width;
+            int *above    = current - width;
+            int *above2   = current - 2*width; // Only read when i > 1
+
+            int start_j = std::max(1, i - max);
+            int end_j   = std::min(m, i + max);
+
+            // The cells just outside the band are read by this row and the next one. The first
+            // column is only inside the band while i <= max.
+            current[start_j - 1] = (start_j == 1) ? i : max + 1;
+            if (end_j < m) current[end_j + 1] = max + 1;
+
+            int bound = current[start_j - 1] + std::abs(start_j - 1 - i - m_n);
+            for (int j = start_j; j <= end_j; j++) {
+                int cost = (subject[i - 1] == query[j - 1]) ? 0 : 1;
+                int cell = std::min({above[j] + 1,
+                                     current[j - 1] + 1,
+                                     above[j - 1] + cost});
+                if (transpositions) {
+                    if (i > 1 && j > 1 && subject[i - 1] == query[j - 2] && subject[i - 2] == query[j - 1]) {
+                        cell = std::min(cell, above2[j - 2] + cost);
+                    }
+                }
+                current[j] = cell;
+                bound      = std::min(bound, cell + std::abs(j - i - m_n));
+            }
+            instrument.row(i, start_j, end_j, current);
+            previous_bound = current_bound;
+            current_bound  = bound;
+
+            // Every path to the last cell crosses this row (for transpositions, this row or the one
+            // before it), so if every cell's bound exceeds `max`, so does the final distance.
+            bool exceeded = transpositions
+                            ? (current_bound > max && previous_bound > max && i > resume + 1)
+                            : current_bound > max;
+            if (exceeded) {
+                rows_valid = static_cast<std::size_t>(i);
+                instrument.early_exit(i);
+                return max + 1;
+            }
+        }
+
+        rows_valid = static_cast<std::size_t>(n);
+        const int result = std::min(max + 1, row0[n*width + m]);
+        instrument.done(result);
+        return result;
+    }
+
+private:
+    /// `prefers()` forgets half of its history once this many subject characters have been seen.
+    static constexpr std::uint64_t DECAY_THRESHOLD = 1u << 16;
+
+    std::string      query;         // The query the stored rows were computed against
+    std::string      previous;      // The previous subject
+    std::vector<int> matrix;        // Rows 0..rows_valid of `previous`, each `query.length()+1` wide
+    std::size_t      rows_valid = 0;
+    int              band       = -1;
+    std::size_t      max_cells;
+
+    std::uint64_t seen_characters   = 0;
+    std::uint64_t shared_characters = 0;
+
+    static std::size_t common_prefix(std::string_view a, std::string_view b) {
+        auto mismatch = std::mismatch(a.begin(), a.end(), b.begin(), b.end());
+        return static_cast<std::size_t>(std::distance(a.begin(), mismatch.first));
+    }
+
+    /// Grows the matrix to hold an `n` by `m` comparison. Never throws.
+    bool reserve(std::size_t n, std::size_t m) {
+        std::size_t cells = (n + 1)*(m + 1);
+        if (cells > max_cells) return false;
+        if (cells <= matrix.size()) return true;
+        try {
+            // Keep the old contents: the stored rows move if the width changes, but in that case
+            // the query changed and they are discarded anyway.
+            matrix.resize(cells);
+        } catch (const std::bad_alloc &) {
+            return false;
+        }
+        return true;
+    }
+};
+
+} // namespace levenshtein
@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+An instrument that prints the part of the DP matrix a kernel actually computes, one row at a time.
+Cells to the left and right of the band are shown as `.`, except for the cells just outside the
+band, which are shown with the value `max + 1` the kernel assumes for them. The UDFs use this when
+compiled with `PRINT_DEBUG`.
+
+*/
+
+#pragma once
+
+#include <iostream>
+#include <string_view>
+
+#include "instrument.h"
+
+namespace levenshtein {
+
+class PrintMatrix: public NoInstrumentation {
+public:
+    explicit PrintMatrix(std::ostream &out = std::cout): out(out) {}
+
+    void start(std::string_view subject, std::string_view query, int max) {
+        this->subject = subject;
+        this->m       = static_cast<int>(query.length());
+        this->max     = max;
+
+        out << "subject: " << subject << '\n';
+        out << "query:   " << query << '\n';
+        out << "max: " << max << '\n';
+
+        // Print the matrix header
+        out << "     ";
+        for (int k = 0; k < m; k++) out << " " << query[k] << " ";
+        out << "\n  ";
+        for (int k = 0; k <= m; k++) out << (k < 10 ? " " : "") << k << " ";
+        out << "\n";
+    }
+
+    void row(int i, int start_j, int end_j, const int *row) {
+        // Print column header
+        out << subject[i - 1] << (i < 10 ? "  " : " ") << i << " ";
+        for (int k = 1; k <= start_j - 2; k++) out << " . ";
+        if (start_j > 1) out << (max < 9 ? " " : "") << max + 1 << " ";
+
+        for (int j = start_j; j <= end_j; j++) {
+            out << (row[j] < 10 ? " " : "") << row[j] << " ";
+        }
+
+        if (end_j < m) out << (max < 9 ? " " : "") << max + 1 << " ";
+        for (int k = end_j + 2; k <= m; k++) out << " . ";
+        out << "   " << start_j << " <= j <= " << end_j << "\n";
+    }
+
+    void early_exit(int i) {
+        out << "EMPTY BAND after row " << i << '\n';
+    }
+
+private:
+    std::ostream    &out;
+    std::string_view subject;
+    int              m   = 0;
+    int              max = 0;
+};
+
+} // namespace levenshtein
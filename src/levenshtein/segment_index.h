@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+The segment index behind the partition-based filter of `similarity_join.h` and `cluster.h`, after
+PassJoin (Li, Deng, Wang, and Feng 2011).
+
+Each indexed string is split into `k + 1` segments of (nearly) equal length. Any string within `k`
+edits of it must contain at least one of the segments unchanged, because `k` edits can touch at
+most `k` of them. Moreover, an unchanged segment can only have moved by the net number of
+insertions and deletions before it, and the rest of the length difference has to be made up after
+it, so a query only has to look up its substrings at a few starting positions per segment (the
+"position-aware" window of the paper). With transpositions, one edit can swap the last character
+of a segment with the first character of the next and so change two segments, so there are
+`2k + 1` segments instead. Transpositions don't move anything, so the windows are the same.
+
+The cutoff `k` can depend on the length of the indexed string, which is what a similarity
+threshold needs: the index is grouped by length anyway, and each length gets its own number of
+segments. Strings too short to split into that many non-empty segments are candidates for every
+query of a compatible length.
+
+The index refers to the indexed strings, which must outlive it, and numbers them with 32 bits.
+Building it can use several threads, each taking whole lengths.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "span.h"
+
+namespace levenshtein {
+namespace detail {
+
+/// `floor(a / 2)` for negative `a` too.
+constexpr int floor_half(int a) { return a >= 0 ? a/2 : -((1 - a)/2); }
+
+class SegmentIndex {
+public:
+    /// Indexes `strings` so that `candidates()` finds every string within `max_edits(length)` edits
+    /// of a query, where `length` is the length of the indexed string.
+    template<class MaxEdits>
+    SegmentIndex(Span<const std::string_view> strings, bool transpositions, MaxEdits &&max_edits,
+                 unsigned threads) {
+        std::size_t longest = 0;
+        for (auto string: strings) longest = std::max(longest, string.length());
+        by_length.resize(strings.empty() ? 0 : longest + 1);
+
+        std::vector<std::vector<std::uint32_t>> ids(by_length.size());
+        for (std::size_t id = 0; id < strings.size(); id++) {
+            ids[strings[id].length()].push_back(static_cast<std::uint32_t>(id));
+        }
+        for (std::size_t length = 0; length < by_length.size(); length++) {
+            by_length[length].k        = std::max(0, max_edits(static_cast<int>(length)));
+            by_length[length].segments = transpositions ? 2*by_length[length].k + 1 : by_length[length].k + 1;
+        }
+
+        // Each length is a separate set of maps, so threads can build different lengths at once.
+        std::atomic<std::size_t> next_length{0};
+        auto build = [&]() {
+            for (std::size_t length; (length = next_length.fetch_add(1)) < by_length.size();) {
+                Bucket &bucket = by_length[length];
+                if (length < static_cast<std::size_t>(bucket.segments)) {
+                    bucket.all = std::move(ids[length]);
+                    continue;
+                }
+                if (ids[length].empty()) continue;
+                bucket.maps.resize(static_cast<std::size_t>(bucket.segments));
+                for (std::uint32_t id: ids[length]) {
+                    for (int i = 0; i < bucket.segments; i++) {
+                        auto [start, size] = segment(static_cast<int>(length), bucket.segments, i);
+                        bucket.maps[static_cast<std::size_t>(i)][strings[id].substr(start, size)].push_back(id);
+                    }
+                }
+            }
+        };
+        threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(by_length.size())));
+        std::vector<std::thread> pool;
+        for (unsigned worker = 1; worker < threads; worker++) pool.emplace_back(build);
+        build();
+        for (auto &thread: pool) thread.join();
+    }
+
+    /// Appends to `candidates` every indexed string with length in `[shortest, longest]` that could
+    /// be within the cutoff for its length of `query`. May contain duplicates.
+    void candidates(std::string_view query, int shortest, int longest, std::vector<std::uint32_t> &candidates) const {
+        const int n = static_cast<int>(query.length());
+        shortest = std::max(shortest, 0);
+        longest  = std::min(longest, static_cast<int>(by_length.size()) - 1);
+
+        for (int length = shortest; length <= longest; length++) {
+            const Bucket &bucket = by_length[static_cast<std::size_t>(length)];
+            const int k     = bucket.k;
+            const int delta = n - length;
+            if (delta > k || -delta > k) continue;
+
+            candidates.insert(candidates.end(), bucket.all.begin(), bucket.all.end());
+            // A segment that survives unchanged is shifted by the net number of insertions before
+            // it, `shift`, and the edits after it have to make up the rest of the length
+            // difference, so `|shift| + |delta - shift| <= k`.
+            for (std::size_t i = 0; i < bucket.maps.size(); i++) {
+                auto [start, size] = segment(length, bucket.segments, static_cast<int>(i));
+                const auto &map = bucket.maps[i];
+                const int first = std::max(start - floor_half(k - delta), 0);
+                const int last  = std::min(start + floor_half(k + delta), n - size);
+                for (int position = first; position <= last; position++) {
+                    auto found = map.find(query.substr(static_cast<std::size_t>(position),
+                                                       static_cast<std::size_t>(size)));
+                    if (found != map.end()) {
+                        candidates.insert(candidates.end(), found->second.begin(), found->second.end());
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    struct Bucket {
+        int k        = 0;
+        int segments = 1;
+        /// Strings too short to have `segments` non-empty segments.
+        std::vector<std::uint32_t> all;
+        /// For each segment number, the strings by the text of that segment.
+        std::vector<std::unordered_map<std::string_view, std::vector<std::uint32_t>>> maps;
+    };
+
+    std::vector<Bucket> by_length;
+
+    /// The start and length of segment `i` of `segments` of a string of length `length`. The last
+    /// `length % segments` segments are one character longer than the others.
+    static std::pair<int, int> segment(int length, int segments, int i) {
+        const int size           = length/segments;
+        const int short_segments = segments - length % segments;
+        return {i*size + std::max(0, i - short_segments), size + (i >= short_segments ? 1 : 0)};
+    }
+};
+
+} // namespace detail
+} // namespace levenshtein
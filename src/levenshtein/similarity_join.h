@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Similarity join: every pair of strings, one from each of two lists, within `k` edits.
+
+Joining two lists with a nested loop compares every string with every other, which for lists of a
+few million names is trillions of comparisons. Almost all of them are pointless, and the
+partition-based filter of PassJoin (Li, Deng, Wang, and Feng 2011) skips them:
+
+ 1. Split each string of the right list into `k + 1` segments (`2k + 1` with transpositions) and
+    index the segments. Any string within `k` edits must contain one of them unchanged, at a
+    position not far from where it was. See `segment_index.h`.
+ 2. Each string of the left list looks up only the substrings that could be such a segment.
+ 3. Each pair that shares a segment is verified. The left string is prepared once (see
+    `batch.h`) and compared with each of its candidates, so short strings get the bit-parallel
+    kernel and long ones the banded kernels.
+
+The left list is processed in chunks by several threads, as in `parallel_search.h`. Results come
+back sorted by left index, then right index. The index refers to the right strings, so their
+characters must outlive the join, and numbers them with 32 bits. Like the parallel search, and
+unlike the kernels, the join allocates.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "levenshtein.h"
+#include "parallel_search.h"
+#include "segment_index.h"
+#include "span.h"
+
+namespace levenshtein {
+
+/// A pair found by `similarity_join()`: `left[left_index]` and `right[right_index]` are
+/// `distance` edits apart.
+struct JoinMatch {
+    std::size_t left_index;
+    std::size_t right_index;
+    int         distance;
+};
+
+namespace detail {
+
+template<bool transpositions>
+std::vector<JoinMatch> similarity_join(Span<const std::string_view> left, Span<const std::string_view> right,
+                                       int k, SearchOptions options) {
+    std::vector<JoinMatch> matches;
+    if (left.empty() || right.empty() || k < 0) return matches;
+
+    const std::size_t chunk_size = std::max<std::size_t>(options.chunk_size, 1);
+    const std::size_t chunks     = (left.size() + chunk_size - 1)/chunk_size;
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    const SegmentIndex index{right, transpositions, [k](int) { return k; }, threads};
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, chunks));
+
+    std::size_t longest = 0;
+    for (auto string: left) longest = std::max(longest, string.length());
+    for (auto string: right) longest = std::max(longest, string.length());
+    const int workspace_ints = workspace_size(longest, transpositions);
+
+    std::atomic<std::size_t> next_chunk{0};
+    std::mutex               matches_mutex;
+
+    auto work = [&]() {
+        Buffer                     buffer{workspace_ints};
+        std::vector<std::uint32_t> candidates;
+        std::vector<JoinMatch>     found;
+
+        for (std::size_t chunk; (chunk = next_chunk.fetch_add(1)) < chunks;) {
+            const std::size_t end = std::min(left.size(), (chunk + 1)*chunk_size);
+            for (std::size_t i = chunk*chunk_size; i < end; i++) {
+                candidates.clear();
+                const int n = static_cast<int>(left[i].length());
+                index.candidates(left[i], n - k, n + k, candidates);
+                // A pair can share several segments, but only needs verifying once.
+                std::sort(candidates.begin(), candidates.end());
+                candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+                const PreparedQuery query{left[i]};
+                for (std::uint32_t j: candidates) {
+                    int distance = query.distance<transpositions>(right[j], k, buffer);
+                    if (distance != BUFFER_EXCEEDED && distance <= k) found.push_back({i, j, distance});
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(matches_mutex);
+        matches.insert(matches.end(), found.begin(), found.end());
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned worker = 1; worker < threads; worker++) pool.emplace_back(work);
+    work();
+    for (auto &thread: pool) thread.join();
+
+    std::sort(matches.begin(), matches.end(), [](const JoinMatch &a, const JoinMatch &b) {
+        return a.left_index != b.left_index ? a.left_index < b.left_index : a.right_index < b.right_index;
+    });
+    return matches;
+}
+
+} // namespace detail
+
+/// Every pair `(left[i], right[j])` with Levenshtein distance at most `k`, sorted by `i` then `j`.
+/// `options.chunk_size` is the number of left strings in a unit of work.
+inline std::vector<JoinMatch> similarity_join(Span<const std::string_view> left, Span<const std::string_view> right,
+                                              int k, SearchOptions options = {}) {
+    return detail::similarity_join<false>(left, right, k, options);
+}
+
+/// As `similarity_join()`, but for Damerau-Levenshtein distance.
+inline std::vector<JoinMatch> similarity_join_t(Span<const std::string_view> left,
+                                                Span<const std::string_view> right, int k,
+                                                SearchOptions options = {}) {
+    return detail::similarity_join<true>(left, right, k, options);
+}
+
+} // namespace levenshtein
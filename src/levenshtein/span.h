@@ -0,0 +1,50 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+A minimal stand-in for C++20's `std::span`, since the project is built as C++17. Only what the
+batch interfaces need: a pointer and a length, iteration, indexing, and `subspan()`.
+
+This header does not depend on MySQL.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace levenshtein {
+
+template<class T>
+class Span {
+public:
+    Span() = default;
+    Span(T *data, std::size_t size): data_(data), size_(size) {}
+
+    /// Views any contiguous container with `data()` and `size()`, such as a `std::vector`.
+    template<class Container,
+             class = std::enable_if_t<std::is_convertible_v<decltype(std::declval<Container &>().data()), T *>>>
+    Span(Container &container): data_(container.data()), size_(container.size()) {}
+
+    T *data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T &operator[](std::size_t index) const { return data_[index]; }
+    T *begin() const { return data_; }
+    T *end() const { return data_ + size_; }
+
+    /// The `count` elements starting at `offset`, or as many as there are.
+    Span subspan(std::size_t offset, std::size_t count) const {
+        if (offset > size_) offset = size_;
+        if (count > size_ - offset) count = size_ - offset;
+        return {data_ + offset, count};
+    }
+
+private:
+    T          *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace levenshtein
@@ -31,10 +31,8 @@ where `Name` has edit distance within 6 of "Vladimir Iosifovich Levenshtein".
 
 */
 #include "common.h"
-
-#ifdef PRINT_DEBUG
-void printMatrix(const int* dp, int n, int m, const std::string_view& S1, const std::string_view& S2);
-#endif
+#include "levenshtein/dispatch.h"
+#include "levenshtein/prefix_cache.h"
 
 
 // Error messages.
@@ -65,10 +63,16 @@ UDF_SIGNATURES(min_edit_dist)
 struct MinEditDistPersistant {
     int max;
     int *buffer; // Takes ownership of this buffer
+    // Index of the argument that is a constant string, or -1 if neither or both are.
+    int constant_arg = -1;
+    // Rows of the previous subject, for when the haystack is sorted.
+    levenshtein::PrefixCache<false> prefix_cache;
+    // Chooses the kernel for the rows the cache doesn't take. See `levenshtein/dispatch.h`.
+    levenshtein::Dispatcher<false> dispatcher;
 
     MinEditDistPersistant(int max, int *buffer): max(max), buffer(buffer){}
 
-    ~MinEditDistPersistant(){ delete this->buffer; }
+    ~MinEditDistPersistant(){ delete[] this->buffer; }
 };
 
 [[maybe_unused]]
@@ -86,14 +90,24 @@ int min_edit_dist_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
 
 // Initialize persistent data
     int* buffer = new (std::nothrow) int[DAMLEV_MAX_EDIT_DIST];
-    MinEditDistPersistant *data = new (std::nothrow) MinEditDistPersistant(DAMLEV_MAX_EDIT_DIST, buffer);
+    MinEditDistPersistant *data = buffer ? new (std::nothrow) MinEditDistPersistant(DAMLEV_MAX_EDIT_DIST, buffer) : nullptr;
     // If memory allocation failed
-    if (!buffer || !data) {
+    if (!data) {
+        delete[] buffer;
         strncpy(message, MIN_EDIT_DIST_MEM_ERROR, MIN_EDIT_DIST_MEM_ERROR_LEN);
         return 1;
     }
     initid->ptr = reinterpret_cast<char*>(data);
 
+    // Constant arguments are already available in `_init`. If exactly one of the strings is a
+    // constant, it is the query and the other is the subject, which may share a prefix with the
+    // previous subject. (The cache checks the query itself, so a wrong guess costs only speed.)
+    if (args->args[0] && !args->args[1]) {
+        data->constant_arg = 0;
+    } else if (args->args[1] && !args->args[0]) {
+        data->constant_arg = 1;
+    }
+
     // There are two error states possible within the function itself:
     //    1. Negative max distance provided
     //    2. Buffer size required is greater than available buffer allocated.
@@ -118,9 +132,6 @@ long long min_edit_dist(UDF_INIT *initid, UDF_ARGS *args, [[maybe_unused]] char
 #ifdef PRINT_DEBUG
     std::cout << "min_edit_dist" << "\n";
 #endif
-#ifdef CAPTURE_METRICS
-    PerformanceMetrics &metrics = performance_metrics[4];
-#endif
 
     // Fetch persistent data
     MinEditDistPersistant *data = reinterpret_cast<MinEditDistPersistant *>(initid->ptr);
@@ -136,145 +147,49 @@ long long min_edit_dist(UDF_INIT *initid, UDF_ARGS *args, [[maybe_unused]] char
     // This code is common to algorithms with limits.
 #include "validate_max.h"
 
-    // The pre-algorithm code is the same for all algorithm variants. It handles
-    //     - basic setup & initialization
-    //     - trimming of common prefix/suffix
-#include "prealgorithm.h"
+    UdfInstrument instrument{4, args};
 
-    // Check if buffer size required exceeds available buffer size. This algorithm needs
-    // a buffer of size (m+1). Because of trimming, this may be smaller than the length
-    // of the longest string.
-    if( m+1 > DAMLEV_BUFFER_SIZE ) {
-#ifdef CAPTURE_METRICS
-        metrics.buffer_exceeded++;
-        metrics.total_time += call_timer.elapsed();
-#endif
-        return 0;
+    // Handle null strings
+    if (!args->args[0] || !args->args[1]) {
+        instrument.length_exit();
+        return instrument.returns(static_cast<long long>(std::max(args->lengths[0], args->lengths[1])));
     }
 
-    const int m_n    = m-n; // We use this a lot.
-    int current_cell = 0;
-
-    // Keeping track of start and end is slightly faster than keeping track of
-    // right/left band for reasons I don't understand.
-    // first cell computed
-    int start_j = 1;
-    // last cell computed, +1 because we start at second row (index 1)
-    int end_j   = std::min((max + m_n) / 2 + 1, m);
-
-#ifdef PRINT_DEBUG
-    // Print the matrix header
-    std::cout << "     ";
-    for(int k = 0; k < m; k++) std::cout << " " << query[k] << " ";
-    std::cout << "\n  ";
-    for(int k = 0; k <= m; k++) std::cout << (k < 10? " ": "") << k << " ";
-    std::cout << "\n";
-#endif
-
-    // Main loop to calculate the Levenshtein distance
-    for (int i = 1; i <= n; ++i) {
-        // We use only a single "row" instead of a full matrix. Let's call it cell[*].
-        // The current cell, cell[j], is matrix position (row, col) = (i, j).  To compute
-        // this cell, we need matrix(i-1, j), matrix(i, j-1), and matrix(i-1, j-1). When
-        // computing the current cell value,
-        //               (  matrix(i, p)    for p < j
-        //     cell[p] = |
-        //               (  matrix(i-1, p)   for p >= j.
-        // Thus, before we overwrite cell[j], it contains matrix(i-1, j). In the previous
-        // iteration, we overwrote matrix(i-1, j-1) with the value of matrix(i, j-1). Thus,
-        // we need to keep the value in cell[j] before overwriting it for use in the next
-        // iteration. We store it in the variable `previous_cell`. The invariant is that
-        // `previous_cell` = matrix(i-1, j-1).
-
-        // The order of these initializations is crucial. This comes first so the value in the buffer isn't overwritten.
-        int previous_cell = buffer[start_j-1];
-
-        // Initialize first column
-        // if (start_j == 1) // This line seems to make no difference.
-        buffer[0] = i;
-
-        // Assume anything outside the band contains more than max. The only cells outside the
-        // band we actually look at are positions (i,start_j-1) and  (i,end_j+1), so we
-        // pre-fill it with max + 1.
-        // if (start_j > 1) buffer[start_j-1] = max + 1;
-        // if (end_j   < m) buffer[end_j+1]   = max + 1;
-
-#ifdef PRINT_DEBUG
-        // Print column header
-        std::cout << subject[i - 1] << (i<10? "  ": " ") << i << " ";
-        for(int k = 1; k <= start_j-2; k++) std::cout << " . ";
-        if (start_j > 1) std::cout << (max < 9? " " : "")  << max + 1 << " ";
-#endif
-
-        // Main inner loop
-        for (int j = start_j; j <= end_j; ++j) {
-            int cost = (subject[i - 1] == query[j - 1]) ? 0 : 1;
-            // See the declaration of `previous_cell` for an explanation of this.
-            // `previous_cell` = matrix(i-1, j-1)
-            //       cell[j-1] = matrix(i, j-1)
-            //         cell[j] = matrix(i-1, j)
-            current_cell = std::min({buffer[j]   + 1,
-                                     buffer[j-1] + 1,
-                                     previous_cell + cost});
-
-#ifdef PRINT_DEBUG
-            std::cout << (current_cell < 10 ? " ": "") << current_cell << " ";
-#endif
-#ifdef CAPTURE_METRICS
-            metrics.cells_computed++;
-#endif
-
-            previous_cell = buffer[j];    // Save cell value for next iteration
-            buffer[j]     = current_cell; // Overwrite
+    int distance;
+    // If the haystack is sorted, resume from the longest prefix this subject shares with the
+    // previous one instead of starting over. See `levenshtein/prefix_cache.h`.
+    // Pairs the length filter rejects are cheaper to reject in the kernel, so they skip the cache.
+    if (data->constant_arg >= 0
+        && std::abs(static_cast<long long>(args->lengths[0]) - static_cast<long long>(args->lengths[1])) <= max
+        && data->prefix_cache.prefers(string_arg(args, data->constant_arg), string_arg(args, 1 - data->constant_arg))) {
+        // The cache keeps its rows itself, but is held to the same limit as the buffer.
+        if (std::min(args->lengths[0], args->lengths[1]) > 0
+            && !levenshtein::fits({buffer, DAMLEV_MAX_EDIT_DIST}, std::max(args->lengths[0], args->lengths[1]),
+                                  false, instrument)) {
+            return instrument.returns(0);
         }
-#ifdef PRINT_DEBUG
-        if (end_j < m) std::cout << (max < 9? " " : "") << max + 1 << " ";
-        for(int k = end_j+2; k <= m; k++) std::cout << " . ";
-        std::cout << "   " << start_j << " <= j <= " << end_j << "\n";
-#endif
-
-        // See if we can make the band narrower based on the row just computed.
-        while(
-            // end_j < m && // This should always be true
-                end_j > 0
-                && buffer[end_j] + std::abs(end_j - i - m_n) > max
-                ) {
-            end_j--;
+        distance = data->prefix_cache.distance(string_arg(args, data->constant_arg),
+                                               string_arg(args, 1 - data->constant_arg), max, instrument);
+    } else {
+        // The constant query is prepared on the first row that has it, since in `_init` the
+        // lengths of the arguments are only their maximum lengths.
+        if (data->constant_arg >= 0 && !data->dispatcher.has_constant_query()) {
+            data->dispatcher.set_constant_query(string_arg(args, data->constant_arg));
         }
-        // Increment for next row
-        end_j = std::min(m, end_j + 1);
-
-        // The starting point is a little different. It is "sticky" unless we
-        // can prove it can shrink. Think of it as, both start and end do
-        // the most conservative thing.
-        while(
-                start_j <= end_j
-                && std::abs(i + m_n - start_j) + buffer[start_j] > max
-                ) {
-            start_j++;
-        }
-
-        if (end_j < start_j) {
-#ifdef CAPTURE_METRICS
-            metrics.early_exit++;
-            metrics.algorithm_time += algorithm_timer.elapsed();
-            metrics.total_time += call_timer.elapsed();
-#endif
-#ifdef PRINT_DEBUG
-            std::cout << "EMPTY BAND: " << start_j << " <= j <= " << end_j << '\n';
-#endif
-            return max + 1;
+        // The kernels live in `levenshtein/levenshtein.h` and `levenshtein/batch.h`.
+        distance = data->dispatcher.distance(string_arg(args, 0), string_arg(args, 1), max,
+                                             {buffer, DAMLEV_MAX_EDIT_DIST}, instrument);
+        // The buffer is too small for these strings.
+        if (distance == levenshtein::BUFFER_EXCEEDED) {
+            return instrument.returns(0);
         }
     }
 
     // This line and the line fetching `data->max` at the top of the function are the only differences
     // between min_edit_dist and bounded_edit_dist.
-    data->max = std::min(current_cell, static_cast<int>(max));
+    if (distance <= max) {
+        data->max = distance;
+    }
 
-    // Return the final Levenshtein distance
-#ifdef CAPTURE_METRICS
-    metrics.algorithm_time += algorithm_timer.elapsed();
-    metrics.total_time += call_timer.elapsed();
-#endif
-    return std::min(max+1, current_cell);
+    return instrument.returns(distance);
 }
@@ -53,6 +53,7 @@ other rows will have `EditDist` equal to some other unspecified smaller number.
 
 */
 #include "common.h"
+#include "levenshtein/dispatch.h"
 
 // Error messages.
 // MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
@@ -82,23 +83,16 @@ UDF_SIGNATURES_TYPE(min_similarity_t, double)
 struct MinSimilarityTPersistant {
     double p;    // Only compute similarities that are at least p
     int *buffer; // Takes ownership of this buffer
+    // Index of the argument that is a constant string, or -1 if neither or both are.
+    int constant_arg = -1;
+    // Chooses the kernel for each call. See `levenshtein/dispatch.h`.
+    levenshtein::Dispatcher<true> dispatcher;
 
     MinSimilarityTPersistant(double similarity, int *buffer): p(similarity), buffer(buffer){}
 
-    ~MinSimilarityTPersistant(){ delete this->buffer; }
+    ~MinSimilarityTPersistant(){ delete[] this->buffer; }
 };
 
-/// Converts minimum allowed similarity to maximum allowed number of edits for a given string length.
-/// Assumes similarity is in the interval [0.0, 1.0].
-inline constexpr long long similarity_to_max_edits(double similarity, int length) {
-    return static_cast<int>((1.0 - similarity) * static_cast<double>(length));
-}
-/// The inverse of the above. Converts number of edits for a given string length to a similarity score.
-/// Guaranteed to return number in the interval [0.0, 1.0] for edits <= length.
-inline constexpr double edits_to_similarity(int edits, int length) {
-    return (1.0 - static_cast<double>(edits)/static_cast<double>(length));
-}
-
 [[maybe_unused]]
 int min_similarity_t_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
     // We require 3 arguments:
@@ -114,14 +108,23 @@ int min_similarity_t_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
 
     // Initialize persistent data
     int* buffer = new (std::nothrow) int[DAMLEV_MAX_EDIT_DIST];
-    MinSimilarityTPersistant *data = new (std::nothrow) MinSimilarityTPersistant(0.0, buffer);
+    MinSimilarityTPersistant *data = buffer ? new (std::nothrow) MinSimilarityTPersistant(0.0, buffer) : nullptr;
     // If memory allocation failed
-    if (!buffer || !data) {
+    if (!data) {
+        delete[] buffer;
         strncpy(message, MIN_SIMILARITY_T_MEM_ERROR, MIN_SIMILARITY_T_MEM_ERROR_LEN);
         return 1;
     }
     initid->ptr = reinterpret_cast<char*>(data);
 
+    // Constant arguments are already available in `_init`. If exactly one of the strings is a
+    // constant, it is the query, which the dispatcher prepares once for every row.
+    if (args->args[0] && !args->args[1]) {
+        data->constant_arg = 0;
+    } else if (args->args[1] && !args->args[0]) {
+        data->constant_arg = 1;
+    }
+
     // There are two error states possible within the function itself:
     //    1. Negative max distance provided
     //    2. Buffer size required is greater than available buffer allocated.
@@ -143,202 +146,42 @@ void min_similarity_t_deinit(UDF_INIT *initid) {
 
 [[maybe_unused]]
 double min_similarity_t(UDF_INIT *initid, UDF_ARGS *args, [[maybe_unused]] char *is_null, char *error) {
-
 #ifdef PRINT_DEBUG
     std::cout << "min_similarity_t" << "\n";
 #endif
-#ifdef CAPTURE_METRICS
-    PerformanceMetrics &metrics = performance_metrics[9];
-#endif
 
     // Fetch persistent data
     MinSimilarityTPersistant *data = reinterpret_cast<MinSimilarityTPersistant *>(initid->ptr);
-
-    // Retrieve the similarity and compute max.
+    int *buffer = data->buffer;
+    // Retrieve the similarity.
     double similarity = data->p;
 
 #include "validate_similarity.h"
 
-    // The algorithm works with number of edits, a positive integer. For similarity, the
-    // number of edits permitted depends on the length of the longest string.
-    int max = static_cast<int>(
-                similarity_to_max_edits(
-                        similarity,
-                        std::max(args->lengths[0], args->lengths[1])
-                )
-            );
-    int *buffer = data->buffer;
+    UdfInstrument instrument{6, args};
 
-    // The pre-algorithm code is the same for all algorithm variants. It handles
-    //     - basic setup & initialization
-    //     - trimming of common prefix/suffix
-#include "prealgorithm.h"
-
-    // Check if buffer size required exceeds available buffer size. This algorithm needs
-    // a buffer of size 2*(m+1). Because of trimming, m may be smaller than the length
-    // of the longest string.
-    if( 2*(m+1) > DAMLEV_BUFFER_SIZE ) {
-#ifdef CAPTURE_METRICS
-        metrics.buffer_exceeded++;
-        metrics.total_time += call_timer.elapsed();
-#endif
-        return 0;
+    // Handle null strings
+    if (!args->args[0] || !args->args[1]) {
+        instrument.length_exit();
+        return instrument.returns(static_cast<double>(std::max(args->lengths[0], args->lengths[1])));
     }
 
-    // We also use the following as the similarity analog of `max+1`. This is somewhat
-    // arbitrary, but we need to be able to return a similarity smaller than the
-    // minimum required similarity.
-    double max_result = (1.0-static_cast<double>(max+1)/static_cast<double>(m));
-    max_result = std::max(0.0, max_result); // Must be positive.
-
-    const int m_n = m-n; // We use this a lot.
-
-    // We keep track of only two rows for this algorithm. See below for details.
-    int *current  = buffer;
-    int *previous = buffer + m + 1;
-    std::iota(previous, previous + m + 1, 0);
-
-    int previous_previous_cell = 0;
-    int previous_cell          = 0;
-    int current_cell           = 0;
-
-    // Keeping track of start and end is slightly faster than keeping track of
-    // right/left band for reasons I don't understand.
-    // first cell computed
-    int start_j = 1;
-    // last cell computed, +1 because we start at second row (index 1)
-    int end_j   = std::min((max + m_n) / 2 + 1, m);
-
-#ifdef PRINT_DEBUG
-    // Print the matrix header
-    std::cout << "     ";
-    for(int k = 0; k < m; k++) std::cout << " " << query[k] << " ";
-    std::cout << "\n  ";
-    for(int k = 0; k <= m; k++) std::cout << (k < 10? " ": "") << k << " ";
-    std::cout << "\n";
-#endif
-
-    // Main loop to calculate the Damerau-Levenshtein distance
-    for (int i = 1; i <= n; ++i) {
-        // The order of these initializations is crucial. This comes first so the value in the buffer isn't overwritten.
-        previous_cell = current[start_j-1]; // = matrix(i-1, 0)
-
-        // Initialize first column
-        // if (start_j == 1) // This line seems to make no difference.
-        current[0] = i;
-
-        // Assume anything outside the band contains more than max. The only cells outside the
-        // band we actually look at are positions (i,start_j-1) and  (i,end_j+1), so we
-        // pre-fill it with max + 1.
-        // if (start_j > 1) buffer[start_j-1] = max + 1;
-        // if (end_j   < m) buffer[end_j+1]   = max + 1;
-
-#ifdef PRINT_DEBUG
-        // Print column header
-        std::cout << subject[i - 1] << (i<10? "  ": " ") << i << " ";
-        for(int k = 1; k <= start_j-2; k++) std::cout << " . ";
-        if (start_j > 1) std::cout << (max < 9? " " : "")  << max + 1 << " ";
-#endif
-
-        // Main inner loop
-        for (int j = start_j; j <= end_j; ++j) {
-            /*
-            At the start of the computation of matrix(i, j) we have:
-                current[p]  = {  matrix(i, p)     for p < j
-                              {  matrix(i-1, p)   for p >= j
-                previous[p] = {  matrix(i-1, p)   for p < j - 2
-                              {  matrix(i-2, p)   for p >= j - 2
-                previous_cell          = matrix(i-1, j-1)
-                previous_previous_cell = matrix(i-1, j-2)
-
-            To compute matrix(i, j), we need to use the following:
-                matrix(i  , j-1) = current[j-1]
-                matrix(i-2, j-2) = previous[j-2]
-                matrix(i-1, j-1) = previous_cell
-                matrix(i-1, j  ) = current[j]
-            */
-
-            int cost     = (subject[i - 1] == query[j - 1]) ? 0 : 1;
-            current_cell = std::min({current[j]    + 1,
-                                     current[j-1]  + 1,
-                                     previous_cell + cost});
-
-            // Check for transpositions
-            if (i > 1 && j > 1 && subject[i - 1] == query[j - 2] && subject[i - 2] == query[j - 1]) {
-                current_cell = std::min(current_cell, previous[j-2] + cost);
-            }
-
-            /*
-            We compute current_cell = matrix(i, j) and then perform the update for the next iteration:
-                previous[j-2]          <-- previous_previous_cell := matrix(i-1, j-2)
-                previous_previous_cell <-- previous_cell          := matrix(i-1, j-1)
-                previous_cell          <-- current[j]             := matrix(i-1, j)
-                current[j]             <-- current_cell           := matrix(i, j)
-            */
-
-            if(j>1){
-                previous[j-2]      = previous_previous_cell;
-            }
-            previous_previous_cell = previous_cell;
-            previous_cell          = current[j];
-            current[j]             = current_cell;
-
-#ifdef PRINT_DEBUG
-            std::cout << (current_cell < 10 ? " ": "") << current_cell << " ";
-#endif
-#ifdef CAPTURE_METRICS
-            metrics.cells_computed++;
-#endif
-        }
-#ifdef PRINT_DEBUG
-        if (end_j < m) std::cout << (max < 9? " " : "") << max + 1 << " ";
-        for(int k = end_j+2; k <= m; k++) std::cout << " . ";
-        std::cout << "   " << start_j << " <= j <= " << end_j << "\n";
-#endif
+    // The constant query is prepared on the first row that has it, since in `_init` the lengths
+    // of the arguments are only their maximum lengths.
+    if (data->constant_arg >= 0 && !data->dispatcher.has_constant_query()) {
+        data->dispatcher.set_constant_query(string_arg(args, data->constant_arg));
+    }
 
-        // See if we can make the band narrower based on the row just computed.
-        while(
-            // end_j < m && // This should always be true
-                end_j > 0
-                // Have to subtract one in the following as next character might make transposition
-                && current[end_j] + std::abs(end_j - i - m_n) - 1 > max
-                ) {
-            end_j--;
-        }
-        // Increment for next row
-        end_j = std::min(m, end_j + 1);
-
-        // The starting point is a little different. It is "sticky" unless we
-        // can prove it can shrink. Think of it as, both start and end do
-        // the most conservative thing.
-        while(
-                start_j <= end_j
-                // Have to subtract one in the following as next character might make transposition
-                && std::abs(i + m_n - start_j) + current[start_j] - 1 > max
-                ) {
-            start_j++;
-        }
-
-        if (end_j < start_j) {
-#ifdef CAPTURE_METRICS
-            metrics.early_exit++;
-            metrics.algorithm_time += algorithm_timer.elapsed();
-            metrics.total_time += call_timer.elapsed();
-#endif
-#ifdef PRINT_DEBUG
-            std::cout << "EMPTY BAND: " << start_j << " <= j <= " << end_j << '\n';
-#endif
-            return max_result;
-        }
+    // The kernels live in `levenshtein/levenshtein.h` and `levenshtein/batch.h`.
+    double result = data->dispatcher.similarity(string_arg(args, 0), string_arg(args, 1), similarity,
+                                                {buffer, DAMLEV_MAX_EDIT_DIST}, instrument);
+    // The buffer is too small for these strings.
+    if (result == levenshtein::BUFFER_EXCEEDED) {
+        return instrument.returns(0.0);
     }
 
-    // Compute and return the final similarity score
-    double result = (1.0-static_cast<double>(current_cell)/static_cast<double>(m));
-    result = std::max(0.0, result);
+    // Only similarities at least as large as this one are interesting from now on.
     data->p = std::max(similarity, result);
-#ifdef CAPTURE_METRICS
-    metrics.algorithm_time += algorithm_timer.elapsed();
-    metrics.total_time += call_timer.elapsed();
-#endif
-    return std::max(result, max_result);
+
+    return instrument.returns(result);
 }
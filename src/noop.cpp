@@ -76,7 +76,7 @@ int noop_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
 
 [[maybe_unused]]
 void noop_deinit(UDF_INIT *initid) {
-    delete reinterpret_cast<int*>(initid->ptr);
+    delete[] reinterpret_cast<int*>(initid->ptr);
 }
 
 [[maybe_unused]]
@@ -86,7 +86,7 @@ long long noop([[maybe_unused]] UDF_INIT *initid, [[maybe_unused]] UDF_ARGS *arg
     std::cout << "noop" << "\n";
 #endif
 #ifdef CAPTURE_METRICS
-    PerformanceMetrics &metrics = performance_metrics[10];
+    PerformanceMetrics &metrics = performance_metrics[9];
 #endif
 
 #ifdef EXCLUDE_PREPROCESSING_FROM_NOOP
@@ -75,6 +75,9 @@ long long postgres(UDF_INIT *initid, UDF_ARGS *args, [[maybe_unused]] char *is_n
     // Taken from prealgorithm //
 
 #ifdef CAPTURE_METRICS
+#ifdef CAPTURE_PERF_COUNTERS
+    PerfCounterScope perf_counters{metrics};
+#endif
     metrics.call_count++;
     Timer call_timer;
     call_timer.start();
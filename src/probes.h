@@ -0,0 +1,122 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Static tracepoints (USDT probes) in the UDFs, for tracing a live `mysqld` with `bpftrace`,
+`perf`, or SystemTap without rebuilding the plugin.
+
+A probe is a single `nop` in the code plus a note in the `.note.stapsdt` section of the library
+that says where the `nop` is and where to find the probe's arguments. Nothing runs unless a tracer
+is attached, in which case it replaces the `nop` with a breakpoint. So the probes cost nothing but
+keeping their arguments in registers or on the stack, which the UDFs already do.
+
+`UdfInstrument` in `common.h` fires these probes, all under the provider `damlev`, in each of the
+edit distance UDFs. The first argument is always the name of the UDF, as a C string.
+
+  - `entry(function, subject_length, query_length)`, when the arguments have been validated.
+  - `length_exit(function, subject_length, query_length)`, when the lengths alone decide the
+    result, including when an argument is NULL.
+  - `early_exit(function, row, cutoff)`, when the band of a banded kernel empties after `row`.
+  - `return(function, result, subject_length, query_length, cutoff, cells)`, on the way out.
+    `result` is what the UDF returns, in millionths for the similarity functions, or -1 if it
+    returned before computing one. `cutoff` is the bound the kernel was given, or -1 if no kernel
+    ran; `cells` is the number of cells of the DP matrix it computed.
+
+For example, the distribution of query lengths of the calls that exit early, and the calls of
+`min_edit_dist` that compute more than a million cells:
+
+    bpftrace -e 'usdt:/usr/lib/mysql/plugin/libdamlev.so:damlev:early_exit { @[str(arg0)] = hist(arg1); }'
+    bpftrace -e 'usdt:/usr/lib/mysql/plugin/libdamlev.so:damlev:return /arg5 > 1000000/ {
+                     printf("%s %d %d %d\n", str(arg0), arg2, arg3, arg4); }'
+
+We use `<sys/sdt.h>` from SystemTap if it is installed. Otherwise, on x86-64 and ARM64 ELF
+platforms, we write the same notes ourselves, with just what the tracers read. Elsewhere, and
+with `DISABLE_PROBES` defined, the probes compile to nothing.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(DISABLE_PROBES)
+#define DAMLEV_PROBES 0
+#elif defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define DAMLEV_PROBES 1
+#endif
+#endif
+
+#if !defined(DAMLEV_PROBES) && defined(__ELF__) && (defined(__x86_64__) || defined(__aarch64__)) \
+    && (defined(__GNUC__) || defined(__clang__))
+#define DAMLEV_PROBES 2
+#endif
+
+#ifndef DAMLEV_PROBES
+#define DAMLEV_PROBES 0
+#endif
+
+namespace probes {
+
+/// A probe argument as the 64-bit integer the tracers read.
+template<class Integer>
+inline std::int64_t argument(Integer value) { return static_cast<std::int64_t>(value); }
+
+} // namespace probes
+
+#if DAMLEV_PROBES == 1
+
+#include <sys/sdt.h>
+
+#define DAMLEV_PROBE3(name, function, a1, a2) \
+    STAP_PROBE3(damlev, name, function, probes::argument(a1), probes::argument(a2))
+#define DAMLEV_PROBE6(name, function, a1, a2, a3, a4, a5) \
+    STAP_PROBE6(damlev, name, function, probes::argument(a1), probes::argument(a2), probes::argument(a3), \
+                probes::argument(a4), probes::argument(a5))
+
+#elif DAMLEV_PROBES == 2
+
+// The note of one probe, in the format of SystemTap's `<sys/sdt.h>`: the address of the `nop`, the
+// address of `_.stapsdt.base` (which tools use to find how far the library was moved when it was
+// loaded), no semaphore, then the provider, the name, and the arguments as `SIZE@OPERAND`, where a
+// negative size is a signed argument.
+#define DAMLEV_PROBE_NOTE(name, arguments)                                          \
+    "990: nop\n"                                                                    \
+    ".pushsection .note.stapsdt, \"?\", \"note\"\n"                                 \
+    ".balign 4\n"                                                                   \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                              \
+    "991: .asciz \"stapsdt\"\n"                                                     \
+    "992: .balign 4\n"                                                              \
+    "993: .8byte 990b\n"                                                            \
+    ".8byte _.stapsdt.base\n"                                                       \
+    ".8byte 0\n"                                                                    \
+    ".asciz \"damlev\"\n"                                                           \
+    ".asciz \"" #name "\"\n"                                                        \
+    ".asciz \"" arguments "\"\n"                                                    \
+    "994: .balign 4\n"                                                              \
+    ".popsection\n"                                                                 \
+    ".ifndef _.stapsdt.base\n"                                                      \
+    ".pushsection .stapsdt.base, \"aG\", \"progbits\", .stapsdt.base, comdat\n"     \
+    ".weak _.stapsdt.base\n"                                                        \
+    ".hidden _.stapsdt.base\n"                                                      \
+    "_.stapsdt.base: .space 1\n"                                                    \
+    ".size _.stapsdt.base, 1\n"                                                     \
+    ".popsection\n"                                                                 \
+    ".endif\n"
+
+#define DAMLEV_PROBE3(name, function, x1, x2)                                       \
+    __asm__ __volatile__(DAMLEV_PROBE_NOTE(name, "8@%[f] -8@%[a1] -8@%[a2]")        \
+                         :: [f] "r"(function), [a1] "nor"(probes::argument(x1)),  \
+                            [a2] "nor"(probes::argument(x2)))
+#define DAMLEV_PROBE6(name, function, x1, x2, x3, x4, x5)                           \
+    __asm__ __volatile__(DAMLEV_PROBE_NOTE(name, "8@%[f] -8@%[a1] -8@%[a2] -8@%[a3] -8@%[a4] -8@%[a5]") \
+                         :: [f] "r"(function), [a1] "nor"(probes::argument(x1)),  \
+                            [a2] "nor"(probes::argument(x2)), [a3] "nor"(probes::argument(x3)), \
+                            [a4] "nor"(probes::argument(x4)), [a5] "nor"(probes::argument(x5)))
+
+#else
+
+#define DAMLEV_PROBE3(name, function, a1, a2) ((void) 0)
+#define DAMLEV_PROBE6(name, function, a1, a2, a3, a4, a5) ((void) 0)
+
+#endif
@@ -0,0 +1,163 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+The slowest calls of each function, kept with the runtime counters of `stats.h` and read with
+`SELECT damlev_slow_calls()` (see `stats.cpp`), so that the inputs that make a query slow can be
+found and reproduced with `compareoneoff`.
+
+Each thread keeps its own `SLOW_CALL_COUNT` slowest calls for each function. A call faster than the
+fastest of those costs a single comparison; a slower one replaces it. What we keep of a call is a
+`SlowCall`: the lengths, the bound, the cells computed, the width of the band in the last row
+computed, the cycles the call took, and a hash of each string. With `CAPTURE_SLOW_CALL_INPUTS`
+defined we also keep the first `SLOW_CALL_PREFIX` bytes of each string, which is enough to rerun
+most calls on words or names, but which also means `damlev_slow_calls()` shows data from your
+tables to whoever can call it. That is why it is off by default in the plugin.
+
+Only the owning thread writes a log, and readers on other threads don't take a lock: each slot is
+a seqlock, so a reader that catches a slot while it is being written reads it again. Resetting
+starts a new epoch. The calls of earlier epochs are ignored by readers, and each thread clears its
+own log when it first sees the new epoch.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+
+namespace runtime_stats {
+
+constexpr int SLOW_CALL_COUNT  = 8;
+constexpr int SLOW_CALL_PREFIX = 32;
+
+/// One slow call.
+struct SlowCall {
+    std::uint64_t cycles         = 0; // 0 for an empty slot
+    std::uint64_t epoch          = 0;
+    std::uint64_t cells          = 0;
+    std::uint64_t subject_hash   = 0;
+    std::uint64_t query_hash     = 0;
+    std::uint32_t subject_length = 0;
+    std::uint32_t query_length   = 0;
+    std::int32_t  cutoff         = -1; // -1 if the call never reached a kernel
+    std::int32_t  band_width     = -1; // -1 if the kernel doesn't report rows
+    std::uint32_t inputs_captured = 0; // Whether the prefixes below were filled in
+    std::uint32_t padding         = 0;
+    char          subject_prefix[SLOW_CALL_PREFIX] = {};
+    char          query_prefix[SLOW_CALL_PREFIX]   = {};
+
+    /// Whether `subject_prefix` and `query_prefix` hold all of the strings.
+    bool whole_inputs() const {
+        return inputs_captured && subject_length <= SLOW_CALL_PREFIX && query_length <= SLOW_CALL_PREFIX;
+    }
+};
+
+/// 64-bit FNV-1a, to tell calls with the same lengths apart without keeping the strings.
+inline std::uint64_t input_hash(std::string_view text) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c: text) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/// The epoch of the slow call logs. `Registry::reset()` in `stats.h` starts a new one.
+inline std::atomic<std::uint64_t> slow_call_epoch{1};
+
+/// A thread's slowest calls of one function.
+class SlowCallLog {
+public:
+    /// Whether a call that took `cycles` belongs in the log. Clears the log if a reset has started
+    /// a new epoch since the last call.
+    bool wants(std::uint64_t cycles) {
+        std::uint64_t current = slow_call_epoch.load(std::memory_order_relaxed);
+        if (current != epoch) {
+            epoch = current;
+            std::fill(std::begin(slot_cycles), std::end(slot_cycles), 0);
+            threshold = 0;
+        }
+        return cycles > threshold;
+    }
+
+    /// Replaces the fastest call in the log with `call`. Only after `wants(call.cycles)`.
+    void record(SlowCall call) {
+        int fastest = static_cast<int>(std::min_element(std::begin(slot_cycles), std::end(slot_cycles))
+                                       - std::begin(slot_cycles));
+        call.epoch = epoch;
+        slots[fastest].write(call);
+        slot_cycles[fastest] = call.cycles;
+        threshold = *std::min_element(std::begin(slot_cycles), std::end(slot_cycles));
+    }
+
+    /// Copies the calls of epoch `current` into `calls`, from any thread. Returns how many.
+    int load(SlowCall (&calls)[SLOW_CALL_COUNT], std::uint64_t current) const {
+        int count = 0;
+        for (const Slot &slot: slots) {
+            SlowCall call = slot.read();
+            if (call.cycles != 0 && call.epoch == current) calls[count++] = call;
+        }
+        return count;
+    }
+
+private:
+    static constexpr std::size_t WORDS = sizeof(SlowCall)/sizeof(std::uint64_t);
+    static_assert(sizeof(SlowCall)%sizeof(std::uint64_t) == 0, "SlowCall must be a whole number of words");
+
+    struct Slot {
+        std::atomic<std::uint64_t> sequence{0}; // Odd while the slot is being written
+        std::atomic<std::uint64_t> words[WORDS] = {};
+
+        void write(const SlowCall &call) {
+            std::uint64_t plain[WORDS];
+            std::memcpy(plain, &call, sizeof call);
+            std::uint64_t s = sequence.load(std::memory_order_relaxed);
+            sequence.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (std::size_t w = 0; w < WORDS; w++) words[w].store(plain[w], std::memory_order_relaxed);
+            sequence.store(s + 2, std::memory_order_release);
+        }
+
+        SlowCall read() const {
+            std::uint64_t plain[WORDS];
+            while (true) {
+                std::uint64_t before = sequence.load(std::memory_order_acquire);
+                if (before & 1) continue;
+                for (std::size_t w = 0; w < WORDS; w++) plain[w] = words[w].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence.load(std::memory_order_relaxed) == before) break;
+            }
+            SlowCall call;
+            std::memcpy(&call, plain, sizeof call);
+            return call;
+        }
+    };
+
+    // The owning thread's own copy of what it has written, so it never reads the slots back.
+    std::uint64_t epoch     = 0;
+    std::uint64_t threshold = 0;
+    std::uint64_t slot_cycles[SLOW_CALL_COUNT] = {};
+    Slot          slots[SLOW_CALL_COUNT];
+};
+
+/// Keeps the `SLOW_CALL_COUNT` slowest of `calls` and `more`, slowest first, in `calls`. Returns how
+/// many that is.
+inline int merge_slow_calls(SlowCall (&calls)[SLOW_CALL_COUNT], int count, const SlowCall *more, int more_count) {
+    SlowCall all[2*SLOW_CALL_COUNT];
+    std::copy(calls, calls + count, all);
+    std::copy(more, more + more_count, all + count);
+    int total = count + more_count;
+    int kept  = std::min(total, SLOW_CALL_COUNT);
+    std::partial_sort(all, all + kept, all + total,
+                      [](const SlowCall &a, const SlowCall &b) { return a.cycles > b.cycles; });
+    std::copy(all, all + kept, calls);
+    return kept;
+}
+
+} // namespace runtime_stats
@@ -0,0 +1,564 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+The edit distance functions as a SQLite loadable extension.
+
+Loading:
+
+    .load ./libdamlev_sqlite
+
+or `sqlite3_load_extension(db, "libdamlev_sqlite", nullptr, &error)` from C. The entry point is
+`sqlite3_damlevsqlite_init`, the name SQLite derives from the file name.
+
+Scalar functions, with the same meaning as the MySQL UDFs of the same names:
+
+    edit_dist(String1, String2)
+    edit_dist_t(String1, String2)
+    bounded_edit_dist(String1, String2, PosInt)
+    bounded_edit_dist_t(String1, String2, PosInt)
+    similarity_t(String1, String2, RealNum)
+    min_edit_dist(String1, String2, PosInt)
+    min_edit_dist_t(String1, String2, PosInt)
+    min_similarity_t(String1, String2, RealNum)
+    fuzzy_match(String1, String2, PosInt)     1 if edit_dist_t(String1, String2) <= PosInt, else 0
+
+A `NULL` argument gives a `NULL` result, as with SQLite's built-in functions. A negative maximum
+or a similarity outside [0, 1] is an error. Since SQLite allocates nothing per query for a scalar
+function, the workspace is a per-thread buffer that grows as needed, so there is no
+buffer-exceeded case. The `min_` functions keep the best result so far as auxiliary data of their
+third argument, which SQLite keeps for as long as the argument is a constant, so they tighten
+their cutoff over a query just as the UDFs do.
+
+The virtual table module `fuzzy` indexes a text column of another table for fuzzy search:
+
+    CREATE VIRTUAL TABLE taxa_fuzzy USING fuzzy(taxa, name, 2);
+    SELECT rowid, word, distance FROM taxa_fuzzy WHERE query = 'Salmo truta' AND k = 2;
+    SELECT rowid, word, distance FROM taxa_fuzzy('Salmo truta', 2);     -- The same.
+
+The arguments are the source table, the column, and the largest `k` the index is built for
+(default 2). Its columns are `word`, the text of the source column, and `distance`, the
+Damerau-Levenshtein distance (as `edit_dist_t`) to the query, with the hidden columns `query` and
+`k` (default: the `k` of the index) as the search parameters. The rowid is the rowid of the
+source row. A search with `k` up to that of the index looks up candidates in a segment index (see
+`levenshtein/segment_index.h`) and verifies only those. A larger `k` compares every word whose
+length is within `k` of the query's (see `levenshtein/dictionary.h`). Without
+a query, the table lists every word, with a `NULL` distance.
+
+SQLite only passes a function call to a virtual table as a search constraint if the function has
+two arguments, so `WHERE fuzzy_match(word, ?, 2)` can't be indexed. It still works, one row at a
+time, on any table. The hidden columns are the indexed spelling of the same thing.
+
+The index is a snapshot of the source column, taken when the virtual table is created or first
+used by a connection. It doesn't see later changes to the source table until the database is
+reopened.
+
+*/
+
+#include <sqlite3ext.h>
+SQLITE_EXTENSION_INIT1
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "levenshtein/batch.h"
+#include "levenshtein/dictionary.h"
+#include "levenshtein/levenshtein.h"
+#include "levenshtein/segment_index.h"
+
+namespace {
+
+// Scalar functions
+
+/// Scratch space for two strings, shared by all the functions called on this thread.
+levenshtein::Workspace workspace_for(std::string_view a, std::string_view b) {
+    thread_local levenshtein::Buffer buffer{0};
+    int needed = levenshtein::workspace_size(std::max(a.length(), b.length()), true);
+    if (needed > buffer.workspace().size) buffer = levenshtein::Buffer{needed};
+    return buffer;
+}
+
+std::string_view text_arg(sqlite3_value *value) {
+    const auto *text = reinterpret_cast<const char *>(sqlite3_value_text(value));
+    return {text ? text : "", static_cast<std::size_t>(sqlite3_value_bytes(value))};
+}
+
+bool any_null(int argc, sqlite3_value **argv) {
+    for (int i = 0; i < argc; i++) {
+        if (sqlite3_value_type(argv[i]) == SQLITE_NULL) return true;
+    }
+    return false;
+}
+
+/// The maximum distance in `value`. Returns false, after reporting the error, if it is negative.
+bool max_arg(sqlite3_context *context, sqlite3_value *value, int &max) {
+    sqlite3_int64 user_max = sqlite3_value_int64(value);
+    if (user_max < 0) {
+        sqlite3_result_error(context, "Maximum edit distance cannot be negative.", -1);
+        return false;
+    }
+    max = static_cast<int>(std::min<sqlite3_int64>(user_max, INT_MAX - 1));
+    return true;
+}
+
+/// The similarity in `value`. Returns false, after reporting the error, if it is out of range.
+bool similarity_arg(sqlite3_context *context, sqlite3_value *value, double &similarity) {
+    similarity = sqlite3_value_double(value);
+    if (!(similarity >= 0.0 && similarity <= 1.0)) {
+        sqlite3_result_error(context, "Similarity must be in the interval [0.0, 1.0].", -1);
+        return false;
+    }
+    return true;
+}
+
+template<bool transpositions>
+void edit_dist_function(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    if (any_null(argc, argv)) return;
+    std::string_view a = text_arg(argv[0]), b = text_arg(argv[1]);
+    try {
+        auto workspace = workspace_for(a, b);
+        sqlite3_result_int(context, transpositions ? levenshtein::edit_dist_t(a, b, workspace)
+                                                   : levenshtein::edit_dist(a, b, workspace));
+    } catch (const std::bad_alloc &) {
+        sqlite3_result_error_nomem(context);
+    }
+}
+
+template<bool transpositions>
+void bounded_edit_dist_function(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    if (any_null(argc, argv)) return;
+    int max;
+    if (!max_arg(context, argv[2], max)) return;
+    std::string_view a = text_arg(argv[0]), b = text_arg(argv[1]);
+    try {
+        auto workspace = workspace_for(a, b);
+        sqlite3_result_int(context, transpositions ? levenshtein::bounded_edit_dist_t(a, b, max, workspace)
+                                                   : levenshtein::bounded_edit_dist(a, b, max, workspace));
+    } catch (const std::bad_alloc &) {
+        sqlite3_result_error_nomem(context);
+    }
+}
+
+void similarity_t_function(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    if (any_null(argc, argv)) return;
+    double similarity;
+    if (!similarity_arg(context, argv[2], similarity)) return;
+    std::string_view a = text_arg(argv[0]), b = text_arg(argv[1]);
+    try {
+        sqlite3_result_double(context, levenshtein::similarity_t(a, b, similarity, workspace_for(a, b)));
+    } catch (const std::bad_alloc &) {
+        sqlite3_result_error_nomem(context);
+    }
+}
+
+template<class T>
+void delete_auxdata(void *data) { delete static_cast<T *>(data); }
+
+/// Remembers `value` as the new cutoff of the `min_` function in `context`.
+template<class T>
+void set_cutoff(sqlite3_context *context, T value) {
+    // Losing the cutoff for lack of memory only costs speed.
+    T *cutoff = new (std::nothrow) T(value);
+    if (cutoff) sqlite3_set_auxdata(context, 2, cutoff, delete_auxdata<T>);
+}
+
+template<bool transpositions>
+void min_edit_dist_function(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    if (any_null(argc, argv)) return;
+    int max;
+    if (!max_arg(context, argv[2], max)) return;
+    // The smallest distance so far in this query, if there was one.
+    if (const auto *best = static_cast<const int *>(sqlite3_get_auxdata(context, 2))) max = std::min(max, *best);
+
+    std::string_view a = text_arg(argv[0]), b = text_arg(argv[1]);
+    try {
+        auto workspace = workspace_for(a, b);
+        int distance = transpositions ? levenshtein::bounded_edit_dist_t(a, b, max, workspace)
+                                      : levenshtein::bounded_edit_dist(a, b, max, workspace);
+        if (distance <= max) set_cutoff(context, distance);
+        sqlite3_result_int(context, distance);
+    } catch (const std::bad_alloc &) {
+        sqlite3_result_error_nomem(context);
+    }
+}
+
+void min_similarity_t_function(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    if (any_null(argc, argv)) return;
+    double similarity;
+    if (!similarity_arg(context, argv[2], similarity)) return;
+    // The largest similarity so far in this query, if there was one.
+    if (const auto *best = static_cast<const double *>(sqlite3_get_auxdata(context, 2))) {
+        similarity = std::max(similarity, *best);
+    }
+
+    std::string_view a = text_arg(argv[0]), b = text_arg(argv[1]);
+    try {
+        double result = levenshtein::similarity_t(a, b, similarity, workspace_for(a, b));
+        if (result > similarity) set_cutoff(context, result);
+        sqlite3_result_double(context, result);
+    } catch (const std::bad_alloc &) {
+        sqlite3_result_error_nomem(context);
+    }
+}
+
+void fuzzy_match_function(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    if (any_null(argc, argv)) return;
+    int max;
+    if (!max_arg(context, argv[2], max)) return;
+    std::string_view a = text_arg(argv[0]), b = text_arg(argv[1]);
+    try {
+        sqlite3_result_int(context, levenshtein::bounded_edit_dist_t(a, b, max, workspace_for(a, b)) <= max);
+    } catch (const std::bad_alloc &) {
+        sqlite3_result_error_nomem(context);
+    }
+}
+
+// The `fuzzy` virtual table
+
+enum FuzzyColumn { WORD, DISTANCE, QUERY, K };
+
+/// `idxNum` bits chosen by `xBestIndex`.
+enum FuzzyPlan { HAS_QUERY = 1, HAS_K = 2 };
+
+/// Not enough memory to index the source column is reported as this.
+constexpr const char FUZZY_MEM_ERROR[] = "Failed to allocate memory for the fuzzy index.";
+
+struct FuzzyTable {
+    sqlite3_vtab base; // Must come first: SQLite only knows about this part.
+
+    int                           max_edits = 2;
+    std::string                   characters;
+    std::vector<sqlite3_int64>    rowids;
+    std::vector<std::string_view> words;
+    std::size_t                   longest = 0;
+    std::unique_ptr<levenshtein::detail::SegmentIndex> index;
+    // The words by length, for searches beyond what `index` covers
+    levenshtein::LengthPartitionedDictionary by_length;
+};
+
+struct FuzzyCursor {
+    sqlite3_vtab_cursor base; // Must come first.
+
+    /// The matching words and their distances, or every word with distance -1 when there's no query.
+    std::vector<std::pair<std::uint32_t, int>> rows;
+    std::size_t                                position = 0;
+    std::string                                query;
+    int                                        k        = 0;
+    bool                                       searched = false;
+};
+
+FuzzyTable *table_of(sqlite3_vtab *vtab) { return reinterpret_cast<FuzzyTable *>(vtab); }
+FuzzyCursor *cursor_of(sqlite3_vtab_cursor *cursor) { return reinterpret_cast<FuzzyCursor *>(cursor); }
+
+/// An argument of `CREATE VIRTUAL TABLE`, without any quotes around it.
+std::string unquote(const char *argument) {
+    std::string text{argument};
+    if (text.size() >= 2 && (text[0] == '\'' || text[0] == '"' || text[0] == '[' || text[0] == '`')) {
+        text = text.substr(1, text.size() - 2);
+    }
+    return text;
+}
+
+/// Copies the column into `table` and indexes it. Returns an SQLite result code.
+int load_words(sqlite3 *db, const char *schema, FuzzyTable &table, const std::string &source,
+               const std::string &column, char **error) {
+    char *sql = sqlite3_mprintf("SELECT rowid, \"%w\" FROM \"%w\".\"%w\"", column.c_str(), schema, source.c_str());
+    if (!sql) return SQLITE_NOMEM;
+    sqlite3_stmt *statement = nullptr;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &statement, nullptr);
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        *error = sqlite3_mprintf("fuzzy: %s", sqlite3_errmsg(db));
+        return rc;
+    }
+
+    // The characters are appended to one string, so views into it can only be made at the end.
+    std::vector<std::size_t> ends;
+    while ((rc = sqlite3_step(statement)) == SQLITE_ROW) {
+        if (sqlite3_column_type(statement, 1) == SQLITE_NULL) continue;
+        const auto *text = reinterpret_cast<const char *>(sqlite3_column_text(statement, 1));
+        table.characters.append(text, static_cast<std::size_t>(sqlite3_column_bytes(statement, 1)));
+        table.rowids.push_back(sqlite3_column_int64(statement, 0));
+        ends.push_back(table.characters.size());
+    }
+    sqlite3_finalize(statement);
+    if (rc != SQLITE_DONE) {
+        *error = sqlite3_mprintf("fuzzy: %s", sqlite3_errmsg(db));
+        return rc;
+    }
+
+    std::size_t start = 0;
+    for (std::size_t end: ends) {
+        table.words.emplace_back(table.characters.data() + start, end - start);
+        table.longest = std::max(table.longest, end - start);
+        start = end;
+    }
+    // Built for transpositions, which also covers Levenshtein distance, as that is never smaller.
+    const int max_edits = table.max_edits;
+    table.index.reset(new levenshtein::detail::SegmentIndex(table.words, true,
+                                                            [max_edits](int) { return max_edits; }, 1));
+    table.by_length = levenshtein::LengthPartitionedDictionary{table.words};
+    return SQLITE_OK;
+}
+
+int fuzzy_connect(sqlite3 *db, void *, int argc, const char *const *argv, sqlite3_vtab **vtab, char **error) {
+    // argv[0..2] are the module, database, and table names; the arguments follow.
+    if (argc < 5 || argc > 6) {
+        *error = sqlite3_mprintf("fuzzy: expected fuzzy(source_table, column [, max_edits])");
+        return SQLITE_ERROR;
+    }
+    std::unique_ptr<FuzzyTable> table{new (std::nothrow) FuzzyTable()};
+    if (!table) return SQLITE_NOMEM;
+    if (argc == 6) {
+        char *end;
+        long max_edits = std::strtol(unquote(argv[5]).c_str(), &end, 10);
+        if (*end != '\0' || max_edits < 0 || max_edits > 64) {
+            *error = sqlite3_mprintf("fuzzy: max_edits must be an integer from 0 to 64");
+            return SQLITE_ERROR;
+        }
+        table->max_edits = static_cast<int>(max_edits);
+    }
+
+    int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(word TEXT, distance INTEGER, query HIDDEN, k HIDDEN)");
+    if (rc != SQLITE_OK) return rc;
+
+    try {
+        rc = load_words(db, argv[1], *table, unquote(argv[3]), unquote(argv[4]), error);
+    } catch (const std::bad_alloc &) {
+        *error = sqlite3_mprintf("%s", FUZZY_MEM_ERROR);
+        rc = SQLITE_NOMEM;
+    }
+    if (rc != SQLITE_OK) return rc;
+
+    *vtab = &table.release()->base;
+    return SQLITE_OK;
+}
+
+int fuzzy_disconnect(sqlite3_vtab *vtab) {
+    delete table_of(vtab);
+    return SQLITE_OK;
+}
+
+int fuzzy_best_index(sqlite3_vtab *vtab, sqlite3_index_info *info) {
+    int query = -1, k = -1;
+    for (int i = 0; i < info->nConstraint; i++) {
+        const auto &constraint = info->aConstraint[i];
+        if (!constraint.usable || constraint.op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+        if (constraint.iColumn == QUERY) query = i;
+        if (constraint.iColumn == K) k = i;
+    }
+
+    const auto words = static_cast<double>(table_of(vtab)->words.size());
+    if (query < 0) {
+        // Every word. If there's a `k` constraint, it filters out all of them, as `k` is NULL.
+        info->idxNum        = 0;
+        info->estimatedCost = words + 1;
+        info->estimatedRows = static_cast<sqlite3_int64>(words);
+        return SQLITE_OK;
+    }
+
+    info->idxNum = HAS_QUERY;
+    info->aConstraintUsage[query].argvIndex = 1;
+    info->aConstraintUsage[query].omit      = 1;
+    if (k >= 0) {
+        info->idxNum |= HAS_K;
+        info->aConstraintUsage[k].argvIndex = 2;
+        info->aConstraintUsage[k].omit      = 1;
+    }
+    // An index lookup: much cheaper than the scan, whatever the size of the table.
+    info->estimatedCost = 10.0 + words/1000.0;
+    info->estimatedRows = 10;
+    return SQLITE_OK;
+}
+
+int fuzzy_open(sqlite3_vtab *, sqlite3_vtab_cursor **cursor) {
+    auto *fuzzy_cursor = new (std::nothrow) FuzzyCursor();
+    if (!fuzzy_cursor) return SQLITE_NOMEM;
+    *cursor = &fuzzy_cursor->base;
+    return SQLITE_OK;
+}
+
+int fuzzy_close(sqlite3_vtab_cursor *cursor) {
+    delete cursor_of(cursor);
+    return SQLITE_OK;
+}
+
+/// Fills `cursor.rows` with the words within `cursor.k` of `cursor.query`.
+void search(const FuzzyTable &table, FuzzyCursor &cursor) {
+    const levenshtein::PreparedQuery query{cursor.query};
+    levenshtein::Buffer buffer{query.bit_parallel() ? 0 : levenshtein::workspace_size(
+            std::max(table.longest, cursor.query.length()), true)};
+
+    const int n = static_cast<int>(cursor.query.length());
+    if (cursor.k > table.max_edits) {
+        // Beyond what the index covers. Only the words of a compatible length are compared, and
+        // the rows are put back in the order of the source.
+        table.by_length.for_each_candidate(cursor.query, cursor.k,
+                                           [&](std::string_view word, levenshtein::LengthPartitionedDictionary::Id i) {
+            int distance = query.distance<true>(word, cursor.k, buffer);
+            if (distance <= cursor.k) cursor.rows.emplace_back(i, distance);
+        });
+        std::sort(cursor.rows.begin(), cursor.rows.end());
+        return;
+    }
+
+    std::vector<std::uint32_t> candidates;
+    table.index->candidates(cursor.query, n - cursor.k, n + cursor.k, candidates);
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    for (std::uint32_t i: candidates) {
+        int distance = query.distance<true>(table.words[i], cursor.k, buffer);
+        if (distance <= cursor.k) cursor.rows.emplace_back(i, distance);
+    }
+}
+
+int fuzzy_filter(sqlite3_vtab_cursor *vtab_cursor, int idxNum, const char *, int argc, sqlite3_value **argv) {
+    FuzzyCursor      &cursor = *cursor_of(vtab_cursor);
+    const FuzzyTable &table  = *table_of(vtab_cursor->pVtab);
+    cursor.rows.clear();
+    cursor.position = 0;
+    cursor.searched = (idxNum & HAS_QUERY) != 0;
+
+    try {
+        if (!cursor.searched) {
+            cursor.rows.reserve(table.words.size());
+            for (std::size_t i = 0; i < table.words.size(); i++) cursor.rows.emplace_back(i, -1);
+            return SQLITE_OK;
+        }
+
+        // `query = NULL` or `k = NULL` matches nothing.
+        if (any_null(argc, argv)) return SQLITE_OK;
+        cursor.query = std::string(text_arg(argv[0]));
+        cursor.k     = table.max_edits;
+        if (idxNum & HAS_K) {
+            sqlite3_int64 k = sqlite3_value_int64(argv[1]);
+            if (k < 0) return SQLITE_OK;
+            cursor.k = static_cast<int>(std::min<sqlite3_int64>(k, INT_MAX - 1));
+        }
+        search(table, cursor);
+    } catch (const std::bad_alloc &) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+int fuzzy_next(sqlite3_vtab_cursor *cursor) {
+    cursor_of(cursor)->position++;
+    return SQLITE_OK;
+}
+
+int fuzzy_eof(sqlite3_vtab_cursor *cursor) {
+    return cursor_of(cursor)->position >= cursor_of(cursor)->rows.size();
+}
+
+int fuzzy_column(sqlite3_vtab_cursor *vtab_cursor, sqlite3_context *context, int column) {
+    const FuzzyCursor &cursor = *cursor_of(vtab_cursor);
+    const FuzzyTable  &table  = *table_of(vtab_cursor->pVtab);
+    const auto [index, distance] = cursor.rows[cursor.position];
+
+    switch (column) {
+        case WORD: {
+            std::string_view word = table.words[index];
+            sqlite3_result_text(context, word.data(), static_cast<int>(word.length()), SQLITE_TRANSIENT);
+            break;
+        }
+        case DISTANCE:
+            if (cursor.searched) sqlite3_result_int(context, distance);
+            break;
+        case QUERY:
+            if (cursor.searched) {
+                sqlite3_result_text(context, cursor.query.data(), static_cast<int>(cursor.query.length()),
+                                    SQLITE_TRANSIENT);
+            }
+            break;
+        case K:
+            if (cursor.searched) sqlite3_result_int(context, cursor.k);
+            break;
+        default:
+            break;
+    }
+    return SQLITE_OK;
+}
+
+int fuzzy_rowid(sqlite3_vtab_cursor *vtab_cursor, sqlite3_int64 *rowid) {
+    const FuzzyCursor &cursor = *cursor_of(vtab_cursor);
+    *rowid = table_of(vtab_cursor->pVtab)->rowids[cursor.rows[cursor.position].first];
+    return SQLITE_OK;
+}
+
+sqlite3_module fuzzy_module() {
+    sqlite3_module module{};
+    module.iVersion    = 0;
+    module.xCreate     = fuzzy_connect;
+    module.xConnect    = fuzzy_connect;
+    module.xBestIndex  = fuzzy_best_index;
+    module.xDisconnect = fuzzy_disconnect;
+    module.xDestroy    = fuzzy_disconnect;
+    module.xOpen       = fuzzy_open;
+    module.xClose      = fuzzy_close;
+    module.xFilter     = fuzzy_filter;
+    module.xNext       = fuzzy_next;
+    module.xEof        = fuzzy_eof;
+    module.xColumn     = fuzzy_column;
+    module.xRowid      = fuzzy_rowid;
+    return module;
+}
+
+#ifdef SQLITE_INNOCUOUS
+constexpr int PURE = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+constexpr int STATEFUL = SQLITE_UTF8 | SQLITE_INNOCUOUS;
+#else
+constexpr int PURE = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+constexpr int STATEFUL = SQLITE_UTF8;
+#endif
+
+struct ScalarFunction {
+    const char *name;
+    int         arguments;
+    int         flags;
+    void      (*function)(sqlite3_context *, int, sqlite3_value **);
+};
+
+// The `min_` functions depend on the rows before, so they are not deterministic.
+constexpr ScalarFunction SCALAR_FUNCTIONS[] = {
+        {"edit_dist",           2, PURE,     edit_dist_function<false>},
+        {"edit_dist_t",         2, PURE,     edit_dist_function<true>},
+        {"bounded_edit_dist",   3, PURE,     bounded_edit_dist_function<false>},
+        {"bounded_edit_dist_t", 3, PURE,     bounded_edit_dist_function<true>},
+        {"similarity_t",        3, PURE,     similarity_t_function},
+        {"min_edit_dist",       3, STATEFUL, min_edit_dist_function<false>},
+        {"min_edit_dist_t",     3, STATEFUL, min_edit_dist_function<true>},
+        {"min_similarity_t",    3, STATEFUL, min_similarity_t_function},
+        {"fuzzy_match",         3, PURE,     fuzzy_match_function},
+};
+
+} // namespace
+
+extern "C"
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+int sqlite3_damlevsqlite_init(sqlite3 *db, char **error, const sqlite3_api_routines *api) {
+    SQLITE_EXTENSION_INIT2(api);
+
+    for (const auto &function: SCALAR_FUNCTIONS) {
+        int rc = sqlite3_create_function(db, function.name, function.arguments, function.flags, nullptr,
+                                         function.function, nullptr, nullptr);
+        if (rc != SQLITE_OK) {
+            *error = sqlite3_mprintf("failed to register %s()", function.name);
+            return rc;
+        }
+    }
+
+    static const sqlite3_module module = fuzzy_module();
+    return sqlite3_create_module(db, "fuzzy", &module, nullptr);
+}
@@ -0,0 +1,282 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+`damlev_stats()` returns the runtime counters of every function in this library as JSON, and
+`damlev_slow_calls()` the slowest calls of each. `damlev_stats_reset()` sets them back to zero.
+
+Syntax:
+
+    damlev_stats();
+    damlev_slow_calls();
+    damlev_stats_reset();
+
+Returns: `damlev_stats()` returns a JSON object like
+
+    {"threads": 2, "functions": {"bounded_edit_dist": {"calls": 1000, "length_exits": 12,
+     "early_exits": 640, "cells": 21400, "buffer_exceeded": 0, "latency_ns": {"0-16": {"count": 990,
+     "p50": 59, "p90": 75, "p99": 135, "p999": 319}, "257+": {...}}}, ...}}
+
+with an entry for each function. The counts are since the plugin was loaded or the last
+`damlev_stats_reset()`, across all connections. `threads` is the number of server threads that
+currently hold counters. `latency_ns` has the percentiles of the time the calls took, in
+nanoseconds, for each class of length that had calls, by the length of the longer string. They
+are the upper limits of histogram buckets (see `latency.h`), so they are up to 1/8 too high.
+
+`damlev_slow_calls()` returns a JSON object with a list for each function of its slowest calls,
+slowest first, like
+
+    {"bounded_edit_dist_t": [{"ns": 48211, "subject_length": 1840, "query_length": 1795,
+     "cutoff": 900, "cells": 1650000, "band_width": 1801, "subject_hash": "8c1d0f54c39e2a61",
+     "query_hash": "02b7e4d1a9f35c80"}, ...], ...}
+
+`cutoff` is the bound the kernel was given, and `band_width` the number of cells in the last row
+it computed; either is -1 if the kernel didn't report it. The hashes are 64-bit FNV-1a of the
+strings. If the plugin was built with `CAPTURE_SLOW_CALL_INPUTS`, each call also has `subject` and
+`query`, the first 32 bytes of each string, with bytes outside of printable ASCII as `\u00XX`.
+See `slow_calls.h`.
+
+`damlev_stats_reset()` returns 1.
+
+Example Usage:
+
+    select damlev_stats();
+    select json_extract(damlev_stats(), '$.functions.min_edit_dist.early_exits');
+    select json_extract(damlev_slow_calls(), '$.min_edit_dist[0]');
+
+The counters are kept per thread and are always on; see `stats.h` for how they are kept cheap.
+A reset and calls that are running at the same time may or may not be counted before the reset.
+
+*/
+
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "common.h"
+
+constexpr const char DAMLEV_STATS_ARG_NUM_ERROR[] = "damlev_stats() takes no arguments.";
+constexpr const auto DAMLEV_STATS_ARG_NUM_ERROR_LEN = std::size(DAMLEV_STATS_ARG_NUM_ERROR) + 1;
+constexpr const char DAMLEV_STATS_MEM_ERROR[] = "Failed to allocate memory for damlev_stats function.";
+constexpr const auto DAMLEV_STATS_MEM_ERROR_LEN = std::size(DAMLEV_STATS_MEM_ERROR) + 1;
+constexpr const char DAMLEV_SLOW_CALLS_ARG_NUM_ERROR[] = "damlev_slow_calls() takes no arguments.";
+constexpr const auto DAMLEV_SLOW_CALLS_ARG_NUM_ERROR_LEN = std::size(DAMLEV_SLOW_CALLS_ARG_NUM_ERROR) + 1;
+constexpr const char DAMLEV_STATS_RESET_ARG_NUM_ERROR[] = "damlev_stats_reset() takes no arguments.";
+constexpr const auto DAMLEV_STATS_RESET_ARG_NUM_ERROR_LEN = std::size(DAMLEV_STATS_RESET_ARG_NUM_ERROR) + 1;
+
+extern "C" {
+[[maybe_unused]] int damlev_stats_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+[[maybe_unused]] void damlev_stats_deinit(UDF_INIT *initid);
+[[maybe_unused]] char *damlev_stats(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length,
+                                    char *is_null, char *error);
+[[maybe_unused]] int damlev_slow_calls_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+[[maybe_unused]] void damlev_slow_calls_deinit(UDF_INIT *initid);
+[[maybe_unused]] char *damlev_slow_calls(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length,
+                                         char *is_null, char *error);
+}
+UDF_SIGNATURES(damlev_stats_reset)
+
+
+[[maybe_unused]]
+int damlev_stats_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (args->arg_count != 0) {
+        strncpy(message, DAMLEV_STATS_ARG_NUM_ERROR, DAMLEV_STATS_ARG_NUM_ERROR_LEN);
+        return 1;
+    }
+
+    // The JSON is longer than the 255 bytes MySQL provides, so we keep our own buffer.
+    std::string *json = new (std::nothrow) std::string;
+    if (!json) {
+        strncpy(message, DAMLEV_STATS_MEM_ERROR, DAMLEV_STATS_MEM_ERROR_LEN);
+        return 1;
+    }
+    initid->ptr        = reinterpret_cast<char *>(json);
+    initid->max_length = 16384;
+    initid->maybe_null = 0;
+    initid->const_item = 0;
+    return 0;
+}
+
+[[maybe_unused]]
+void damlev_stats_deinit(UDF_INIT *initid) {
+    delete reinterpret_cast<std::string *>(initid->ptr);
+}
+
+/// Appends the percentiles of the `LENGTH_CLASS_COUNT` histograms of `latency` that have values.
+static void append_latency(std::string &json, const runtime_stats::LatencyCounts *latency, double cycles_per_ns) {
+    constexpr double FRACTIONS[]  = {0.5, 0.9, 0.99, 0.999};
+    constexpr const char *NAMES[] = {"p50", "p90", "p99", "p999"};
+
+    json.append("\"latency_ns\": {");
+    bool first = true;
+    for (int c = 0; c < runtime_stats::LENGTH_CLASS_COUNT; c++) {
+        std::uint64_t count = latency[c].count();
+        if (count == 0) continue;
+        char entry[64];
+        std::snprintf(entry, sizeof entry, "%s\"%s\": {\"count\": %llu", first ? "" : ", ",
+                      runtime_stats::LENGTH_CLASS_NAMES[c], static_cast<unsigned long long>(count));
+        json.append(entry);
+        for (int p = 0; p < 4; p++) {
+            double ns = static_cast<double>(latency[c].percentile(FRACTIONS[p]))/cycles_per_ns;
+            std::snprintf(entry, sizeof entry, ", \"%s\": %.0f", NAMES[p], ns);
+            json.append(entry);
+        }
+        json.append("}");
+        first = false;
+    }
+    json.append("}");
+}
+
+[[maybe_unused]]
+char *damlev_stats(UDF_INIT *initid, [[maybe_unused]] UDF_ARGS *args, [[maybe_unused]] char *result,
+                   unsigned long *length, [[maybe_unused]] char *is_null, char *error) {
+    std::string &json = *reinterpret_cast<std::string *>(initid->ptr);
+
+    try {
+        // About 80KB, too much for the stack of a server thread.
+        auto snapshot = std::make_unique<runtime_stats::Snapshot>();
+        std::size_t threads = runtime_stats::registry.read(*snapshot);
+        double cycles_per_ns = runtime_stats::cycles_per_ns();
+
+        char number[32];
+        std::snprintf(number, sizeof number, "%zu", threads);
+        json.assign("{\"threads\": ").append(number).append(", \"functions\": {");
+        for (int f = 0; f < runtime_stats::FUNCTION_COUNT; f++) {
+            const runtime_stats::Totals &totals = snapshot->functions[f];
+            char entry[320];
+            std::snprintf(entry, sizeof entry,
+                          "%s\"%s\": {\"calls\": %llu, \"length_exits\": %llu, \"early_exits\": %llu, "
+                          "\"cells\": %llu, \"buffer_exceeded\": %llu, ",
+                          f ? ", " : "", runtime_stats::FUNCTION_NAMES[f],
+                          static_cast<unsigned long long>(totals.calls),
+                          static_cast<unsigned long long>(totals.length_exits),
+                          static_cast<unsigned long long>(totals.early_exits),
+                          static_cast<unsigned long long>(totals.cells),
+                          static_cast<unsigned long long>(totals.buffer_exceeded));
+            json.append(entry);
+            append_latency(json, snapshot->latency[f], cycles_per_ns);
+            json.append("}");
+        }
+        json.append("}}");
+    } catch (const std::bad_alloc &) {
+        *error = 1;
+        return nullptr;
+    }
+
+    *length = json.length();
+    return json.data();
+}
+
+
+[[maybe_unused]]
+int damlev_slow_calls_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (args->arg_count != 0) {
+        strncpy(message, DAMLEV_SLOW_CALLS_ARG_NUM_ERROR, DAMLEV_SLOW_CALLS_ARG_NUM_ERROR_LEN);
+        return 1;
+    }
+
+    std::string *json = new (std::nothrow) std::string;
+    if (!json) {
+        strncpy(message, DAMLEV_STATS_MEM_ERROR, DAMLEV_STATS_MEM_ERROR_LEN);
+        return 1;
+    }
+    initid->ptr        = reinterpret_cast<char *>(json);
+    initid->max_length = 65535;
+    initid->maybe_null = 0;
+    initid->const_item = 0;
+    return 0;
+}
+
+[[maybe_unused]]
+void damlev_slow_calls_deinit(UDF_INIT *initid) {
+    delete reinterpret_cast<std::string *>(initid->ptr);
+}
+
+/// Appends `text` as the contents of a JSON string.
+static void append_escaped(std::string &json, const char *text, std::size_t length) {
+    for (std::size_t i = 0; i < length; i++) {
+        auto c = static_cast<unsigned char>(text[i]);
+        if (c == '"' || c == '\\') {
+            json.push_back('\\');
+            json.push_back(static_cast<char>(c));
+        } else if (c >= 0x20 && c < 0x7f) {
+            json.push_back(static_cast<char>(c));
+        } else {
+            char escape[8];
+            std::snprintf(escape, sizeof escape, "\\u%04x", c);
+            json.append(escape);
+        }
+    }
+}
+
+[[maybe_unused]]
+char *damlev_slow_calls(UDF_INIT *initid, [[maybe_unused]] UDF_ARGS *args, [[maybe_unused]] char *result,
+                        unsigned long *length, [[maybe_unused]] char *is_null, char *error) {
+    std::string &json = *reinterpret_cast<std::string *>(initid->ptr);
+
+    try {
+        auto slow_calls = std::make_unique<runtime_stats::SlowCalls>();
+        runtime_stats::registry.read(*slow_calls);
+        double cycles_per_ns = runtime_stats::cycles_per_ns();
+
+        json.assign("{");
+        for (int f = 0; f < runtime_stats::FUNCTION_COUNT; f++) {
+            json.append(f ? ", \"" : "\"").append(runtime_stats::FUNCTION_NAMES[f]).append("\": [");
+            for (int c = 0; c < slow_calls->counts[f]; c++) {
+                const runtime_stats::SlowCall &call = slow_calls->calls[f][c];
+                char entry[320];
+                std::snprintf(entry, sizeof entry,
+                              "%s{\"ns\": %.0f, \"subject_length\": %u, \"query_length\": %u, \"cutoff\": %d, "
+                              "\"cells\": %llu, \"band_width\": %d, \"subject_hash\": \"%016llx\", "
+                              "\"query_hash\": \"%016llx\"",
+                              c ? ", " : "", static_cast<double>(call.cycles)/cycles_per_ns,
+                              call.subject_length, call.query_length, call.cutoff,
+                              static_cast<unsigned long long>(call.cells), call.band_width,
+                              static_cast<unsigned long long>(call.subject_hash),
+                              static_cast<unsigned long long>(call.query_hash));
+                json.append(entry);
+                if (call.inputs_captured) {
+                    json.append(", \"subject\": \"");
+                    append_escaped(json, call.subject_prefix,
+                                   std::min<std::size_t>(call.subject_length, runtime_stats::SLOW_CALL_PREFIX));
+                    json.append("\", \"query\": \"");
+                    append_escaped(json, call.query_prefix,
+                                   std::min<std::size_t>(call.query_length, runtime_stats::SLOW_CALL_PREFIX));
+                    json.append("\"");
+                }
+                json.append("}");
+            }
+            json.append("]");
+        }
+        json.append("}");
+    } catch (const std::bad_alloc &) {
+        *error = 1;
+        return nullptr;
+    }
+
+    *length = json.length();
+    return json.data();
+}
+
+
+[[maybe_unused]]
+int damlev_stats_reset_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    if (args->arg_count != 0) {
+        strncpy(message, DAMLEV_STATS_RESET_ARG_NUM_ERROR, DAMLEV_STATS_RESET_ARG_NUM_ERROR_LEN);
+        return 1;
+    }
+    initid->maybe_null = 0;
+    initid->const_item = 0;
+    return 0;
+}
+
+[[maybe_unused]]
+void damlev_stats_reset_deinit([[maybe_unused]] UDF_INIT *initid) {}
+
+[[maybe_unused]]
+long long damlev_stats_reset([[maybe_unused]] UDF_INIT *initid, [[maybe_unused]] UDF_ARGS *args,
+                             [[maybe_unused]] char *is_null, [[maybe_unused]] char *error) {
+    runtime_stats::registry.reset();
+    return 1;
+}
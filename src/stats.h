@@ -0,0 +1,261 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Always-on runtime counters for the UDFs, read with `SELECT damlev_stats()` (see `stats.cpp`).
+
+Unlike the metrics of `CAPTURE_METRICS`, which are a test harness feature, these are compiled into
+the plugin MySQL loads, so they have to cost next to nothing and put up with many connections
+calling the functions at once. Each thread gets its own shard of counters the first time it calls
+a UDF. Within a shard, each function has its counters to itself on one cache line, which only
+that thread ever writes, so counting a call is a handful of plain adds to memory that is already
+in the thread's cache: no locks, no atomic read-modify-write, and no cache line bouncing between
+cores. The counters are still `std::atomic`, written with relaxed loads and stores, so that a
+reader on another thread never sees a torn value.
+
+Reading adds up the shards under a mutex, along with the totals of the threads that have exited,
+which fold their shard into them on the way out. Resetting doesn't touch the shards, which belong
+to their threads; it records the current totals, which later reads subtract.
+
+For each function we count the calls, the calls answered from the lengths alone, the early exits
+of the kernels, the cells of the DP matrix computed, and the calls whose strings didn't fit in the
+buffer. The cells are counted through the kernels' instrument (`levenshtein/instrument.h`): the
+banded kernels of `levenshtein/levenshtein.h` and the prefix cache `min_edit_dist` uses for a
+constant argument report the band of each row they compute, and the bit-parallel kernel of
+`levenshtein/batch.h` reports the whole columns it computes. Rows the prefix cache reuses aren't
+computed, so they aren't counted. We also keep a histogram of the latency of the calls for each
+function and class of length, described in `latency.h`, and the slowest calls of each function,
+described in `slow_calls.h`. The histograms are most of a shard, about 78KB of it.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "latency.h"
+#include "slow_calls.h"
+
+namespace runtime_stats {
+
+/// The functions, in the order of their slots in `performance_metrics` and `UdfInstrument`.
+constexpr int FUNCTION_COUNT = 8;
+constexpr const char *FUNCTION_NAMES[FUNCTION_COUNT] = {
+        "bounded_edit_dist",
+        "bounded_edit_dist_t",
+        "edit_dist",
+        "edit_dist_t",
+        "min_edit_dist",
+        "min_edit_dist_t",
+        "min_similarity_t",
+        "similarity_t",
+};
+
+/// A plain copy of one function's counters.
+struct Totals {
+    std::uint64_t calls           = 0;
+    std::uint64_t length_exits    = 0;
+    std::uint64_t early_exits     = 0;
+    std::uint64_t cells           = 0;
+    std::uint64_t buffer_exceeded = 0;
+
+    Totals &operator+=(const Totals &other) {
+        calls           += other.calls;
+        length_exits    += other.length_exits;
+        early_exits     += other.early_exits;
+        cells           += other.cells;
+        buffer_exceeded += other.buffer_exceeded;
+        return *this;
+    }
+
+    Totals &operator-=(const Totals &other) {
+        calls           -= other.calls;
+        length_exits    -= other.length_exits;
+        early_exits     -= other.early_exits;
+        cells           -= other.cells;
+        buffer_exceeded -= other.buffer_exceeded;
+        return *this;
+    }
+};
+
+/// One function's counters in one thread's shard. Only the owning thread writes them.
+struct alignas(64) Counters {
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> length_exits{0};
+    std::atomic<std::uint64_t> early_exits{0};
+    std::atomic<std::uint64_t> cells{0};
+    std::atomic<std::uint64_t> buffer_exceeded{0};
+
+    /// Adds `call` to the counters. Not a read-modify-write: this thread is the only writer.
+    void add(const Totals &call) {
+        bump(calls, call.calls);
+        bump(length_exits, call.length_exits);
+        bump(early_exits, call.early_exits);
+        bump(cells, call.cells);
+        bump(buffer_exceeded, call.buffer_exceeded);
+    }
+
+    Totals load() const {
+        Totals totals;
+        totals.calls           = calls.load(std::memory_order_relaxed);
+        totals.length_exits    = length_exits.load(std::memory_order_relaxed);
+        totals.early_exits     = early_exits.load(std::memory_order_relaxed);
+        totals.cells           = cells.load(std::memory_order_relaxed);
+        totals.buffer_exceeded = buffer_exceeded.load(std::memory_order_relaxed);
+        return totals;
+    }
+
+private:
+    static void bump(std::atomic<std::uint64_t> &counter, std::uint64_t amount) {
+        if (amount) counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+};
+
+struct Shard {
+    Counters         functions[FUNCTION_COUNT];
+    LatencyHistogram latency[FUNCTION_COUNT][LENGTH_CLASS_COUNT];
+    SlowCallLog      slow_calls[FUNCTION_COUNT];
+};
+
+/// The slowest calls of each function, slowest first.
+struct SlowCalls {
+    SlowCall calls[FUNCTION_COUNT][SLOW_CALL_COUNT];
+    int      counts[FUNCTION_COUNT] = {};
+
+    /// Merges in the calls of the current epoch in `shard`.
+    void add(const Shard &shard, std::uint64_t epoch) {
+        SlowCall more[SLOW_CALL_COUNT];
+        for (int f = 0; f < FUNCTION_COUNT; f++) {
+            int more_count = shard.slow_calls[f].load(more, epoch);
+            counts[f] = merge_slow_calls(calls[f], counts[f], more, more_count);
+        }
+    }
+};
+
+/// Everything in a shard, or the sum of shards, as plain numbers.
+struct Snapshot {
+    Totals        functions[FUNCTION_COUNT];
+    LatencyCounts latency[FUNCTION_COUNT][LENGTH_CLASS_COUNT];
+
+    /// Adds the current values of `shard`.
+    void add(const Shard &shard) {
+        LatencyCounts counts;
+        for (int f = 0; f < FUNCTION_COUNT; f++) {
+            functions[f] += shard.functions[f].load();
+            for (int c = 0; c < LENGTH_CLASS_COUNT; c++) {
+                shard.latency[f][c].load(counts);
+                latency[f][c] += counts;
+            }
+        }
+    }
+
+    Snapshot &operator-=(const Snapshot &other) {
+        for (int f = 0; f < FUNCTION_COUNT; f++) {
+            functions[f] -= other.functions[f];
+            for (int c = 0; c < LENGTH_CLASS_COUNT; c++) latency[f][c] -= other.latency[f][c];
+        }
+        return *this;
+    }
+};
+
+/// All the shards, and the totals of the threads that have exited.
+class Registry {
+public:
+    Shard *add_shard() {
+        Shard *shard = new Shard;
+        std::lock_guard<std::mutex> lock(mutex);
+        shards.push_back(shard);
+        return shard;
+    }
+
+    /// Folds an exiting thread's shard into the retired totals and frees it.
+    void retire_shard(Shard *shard) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            retired.add(*shard);
+            retired_slow_calls.add(*shard, slow_call_epoch.load(std::memory_order_relaxed));
+            for (auto &s: shards) {
+                if (s == shard) {
+                    s = shards.back();
+                    shards.pop_back();
+                    break;
+                }
+            }
+        }
+        delete shard;
+    }
+
+    /// The totals and histograms since the last `reset()`. Returns the number of live shards.
+    std::size_t read(Snapshot &snapshot) {
+        std::lock_guard<std::mutex> lock(mutex);
+        sum(snapshot);
+        snapshot -= offsets;
+        return shards.size();
+    }
+
+    /// The slowest calls of each function since the last `reset()`.
+    void read(SlowCalls &slow_calls) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::uint64_t epoch = slow_call_epoch.load(std::memory_order_relaxed);
+        slow_calls = retired_slow_calls;
+        for (const Shard *shard: shards) slow_calls.add(*shard, epoch);
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        sum(offsets);
+        slow_call_epoch.fetch_add(1, std::memory_order_relaxed);
+        retired_slow_calls = SlowCalls{};
+    }
+
+private:
+    std::mutex          mutex;
+    std::vector<Shard*> shards;
+    Snapshot            retired;
+    Snapshot            offsets;
+    SlowCalls           retired_slow_calls;
+
+    // Requires `mutex`.
+    void sum(Snapshot &snapshot) {
+        snapshot = retired;
+        for (const Shard *shard: shards) snapshot.add(*shard);
+    }
+};
+
+inline Registry registry;
+
+/// This thread's shard, or null before its first call.
+inline thread_local Shard *thread_shard = nullptr;
+
+/// Creates this thread's shard, to be retired when the thread exits.
+inline Shard *create_thread_shard() {
+    struct Owner {
+        Shard *shard = registry.add_shard();
+        ~Owner() {
+            thread_shard = nullptr;
+            registry.retire_shard(shard);
+        }
+    };
+    static thread_local Owner owner;
+    thread_shard = owner.shard;
+    return thread_shard;
+}
+
+/// The calling thread's shard. Allocates it on the thread's first call, and returns null if that
+/// fails.
+inline Shard *shard() {
+    Shard *shard = thread_shard;
+    if (!shard) {
+        try {
+            shard = create_thread_shard();
+        } catch (...) {
+            return nullptr;
+        }
+    }
+    return shard;
+}
+
+} // namespace runtime_stats
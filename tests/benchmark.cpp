@@ -3,8 +3,6 @@
 #include <string>
 #include <vector>
 #include <fstream>
-#include <boost/interprocess/file_mapping.hpp>
-#include <boost/interprocess/mapped_region.hpp>
 #include <sstream>
 #include <boost/range/iterator_range_core.hpp>
 #include <iomanip> // For output formatting
@@ -16,9 +14,13 @@
 #include "testharness.hpp"  // Include the test harness for LEV_FUNCTION macros
 #include "benchtime.hpp"
 #include "edit_operations.hpp"
+#include "error_models.hpp"
+#include "word_list.hpp"
 
-int benchmark_on_list(std::vector<std::string_view> &subject_words, std::vector<std::string_view> &mangled_words);
-std::vector<std::string> mangle_word_list(std::vector<std::string> &words, int max_edits);
+int benchmark_on_list(const std::vector<std::string_view> &subject_words, const std::vector<std::string_view> &mangled_words,
+                      long long max_distance);
+std::vector<std::string> mangle_word_list(const std::vector<std::string_view> &subject_words, int max_edits,
+                                          int max_edits_lower_bound);
 
 // Levenshtein
 UDF_SIGNATURES(edit_dist)
@@ -86,6 +88,9 @@ std::vector<UDF_Function> get_udf_functions() {
 #ifndef CAPTURE_METRICS
 // Custom function to format integers with comma separators
 std::string formatWithCommas(uint64_t value);
+// Latency percentiles and the slowest UDF calls, from the runtime counters in `stats.h`
+void print_latency();
+void print_slow_calls();
 #endif
 
 // region Benchmark with words from a file
@@ -127,67 +132,21 @@ void get_subsample(std::vector<std::string> &list, u_int64_t sample_size, std::v
 }
 
 
-/// Reads `max_total_words` from the wordlist file, randomly selects `max_subject_words` of that total, shuffles, and
-/// returns a vector of strings if successful. Returns empty vector on error.
-std::vector<std::string>
-generate_word_list_from_file(int max_total_words, std::string &primaryFilePath) {
-    // Define file paths and configurations
-    // std::string primaryFilePath = "taxonomic_names.csv";  // Primary file path
-    std::string fallbackFilePath = WORDS_PATH;//"words.txt";        // Default fallback file path
-
-    boost::interprocess::file_mapping text_file;
-    std::string_view openedFilePath;
-
-    // Attempt to open the primary file
-    try {
-        text_file = boost::interprocess::file_mapping(primaryFilePath.c_str(), boost::interprocess::read_only);
-        openedFilePath = primaryFilePath;
-    } catch (const boost::interprocess::interprocess_exception &ePrimary) {
-        try {
-            text_file = boost::interprocess::file_mapping(fallbackFilePath.c_str(), boost::interprocess::read_only);
-            openedFilePath = fallbackFilePath;
-        } catch (const boost::interprocess::interprocess_exception &eFallback) {
-            std::cerr << "Could not open fallback file " << fallbackFilePath << '.' << std::endl;
-            // Empty list indicates error state
-            return {};
-        }
-    }
-
-    // Create a mapped region for the file
-    boost::interprocess::mapped_region text_file_buffer(text_file, boost::interprocess::read_only);
+/// Opens the word list file at `primaryFilePath`, or `WORDS_PATH` if that can't be read, and indexes its first
+/// `max_total_words` words. The words are views into `word_list`, so it must outlive them. Returns false on error.
+bool open_word_list(WordList &word_list, int max_total_words, const std::string &primaryFilePath) {
+    std::string fallbackFilePath = WORDS_PATH;
 
-    std::cout << "Opened file: " << openedFilePath << "." << std::endl;
-
-    // Preprocess: Load words into a vector
-    std::vector<std::string> words;
-    words.reserve(max_total_words); // Reserve space to avoid frequent reallocations
-
-    // Load words
-    std::istringstream iss(
-            std::string(static_cast<const char *>(text_file_buffer.get_address()), text_file_buffer.get_size()));
-    std::string line;
-    for (int word_count=0; word_count < max_total_words && std::getline(iss, line); word_count++) {
-        // std::string_view trimmed_word = trim(line); // Remove leading and trailing whitespace
-        // std::string word = remove_internal_control_chars(trimmed_word); // Remove internal control characters
-
-        if (!line.empty()) {
-            words.push_back(line);
-        } else {
-            word_count--;
+    std::string_view openedFilePath = primaryFilePath;
+    if (!word_list.open(primaryFilePath, "benchmark", static_cast<std::size_t>(max_total_words))) {
+        openedFilePath = fallbackFilePath;
+        if (!word_list.open(fallbackFilePath, "benchmark", static_cast<std::size_t>(max_total_words))) {
+            return false;
         }
     }
-
-    std::cout << "Loaded " << words.size() << " words from the file." << std::endl;
-
-    // std::vector<std::string> subject_words;
-    //
-    // // Randomly sample max_subject_words from words to use as subject words
-    // if (words.size() > max_subject_words) {
-    //     subject_words = get_subsample(words, max_subject_words);
-    // } else {
-    //     subject_words = words;
-    // }
-    return words;
+    std::cout << "Opened file: " << openedFilePath << "." << std::endl;
+    std::cout << "Loaded " << word_list.size() << " words from the file." << std::endl;
+    return true;
 }
 
 
@@ -205,7 +164,8 @@ std::vector<std::string> generate_list_of_random_words(int word_count, int word_
 }
 
 /// Creates a new list with copies of strings from `words` that have been given `max_edits` and shuffled.
-std::vector<std::string> mangle_word_list(std::vector<std::string> &subject_words, int max_edits, int max_edits_lower_bound){
+std::vector<std::string> mangle_word_list(const std::vector<std::string_view> &subject_words, int max_edits,
+                                          int max_edits_lower_bound){
     std::vector<std::string> mangled_words;
     mangled_words.reserve(subject_words.size());
 
@@ -227,7 +187,8 @@ struct BenchmarkResult {
 
 
 
-int benchmark_on_list(std::vector<std::string> &subject_words, std::vector<std::string> &mangled_words, long long max_distance){
+int benchmark_on_list(const std::vector<std::string_view> &subject_words, const std::vector<std::string_view> &mangled_words,
+                      long long max_distance){
     std::cout << "Selected " << subject_words.size() << " subject words for testing." << std::endl;
 
     // Get the list of UDF functions
@@ -267,7 +228,7 @@ int benchmark_on_list(std::vector<std::string> &subject_words, std::vector<std::
         // Define argument types and other parameters
         args.arg_count = udf.arg_count;  // Number of arguments for this UDF
         args.arg_type = new Item_result[args.arg_count];
-        args.args = new char*[args.arg_count];
+        args.args = new char*[args.arg_count]();
         args.lengths = new unsigned long[args.arg_count];
 
         // Assign argument types based on arg_count
@@ -329,24 +290,24 @@ int benchmark_on_list(std::vector<std::string> &subject_words, std::vector<std::
                 //     std::cout << "FOUND EMPTY STRING" << '\n';
                 // }
                 if (udf.arg_count == 3) {
-                    args.args[0] = const_cast<char*>(subject.c_str());
+                    args.args[0] = const_cast<char*>(subject.data());
                     args.lengths[0] = subject.size();
 
-                    args.args[1] = const_cast<char*>(query.c_str());
+                    args.args[1] = const_cast<char*>(query.data());
                     args.lengths[1] = query.size();
 
                     args.args[2] = reinterpret_cast<char*>(&max_distance);
                     args.lengths[2] = sizeof(max_distance);
                 }
                 else if (udf.arg_count == 2) {
-                    args.args[0] = const_cast<char*>(subject.c_str());
+                    args.args[0] = const_cast<char*>(subject.data());
                     args.lengths[0] = subject.size();
 
-                    args.args[1] = const_cast<char*>(query.c_str());
+                    args.args[1] = const_cast<char*>(query.data());
                     args.lengths[1] = query.size();
                 }
                 else if (udf.arg_count == 1) {
-                    args.args[0] = const_cast<char*>(subject.c_str());
+                    args.args[0] = const_cast<char*>(subject.data());
                     args.lengths[0] = subject.size();
                 }
 
@@ -446,11 +407,28 @@ int benchmark_on_list(std::vector<std::string> &subject_words, std::vector<std::
 #ifdef CAPTURE_METRICS
     print_metrics();
 #endif
+    print_latency();
+    print_slow_calls();
     return 0;
 }
 
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[]) {
+void print_usage(FILE *out) {
+    std::fprintf(out,
+                 "Usage: benchmark [--errors MODEL] [--zipf EXPONENT] [--seed N] [--lengths MIN,MAX] [--words FILE]\n"
+                 "\n"
+                 "Without options, benchmarks the UDFs on random strings with uniform random edits.\n"
+                 "\n"
+                 "  --errors MODEL      Queries drawn from a haystack of names with errors from MODEL: uniform,\n"
+                 "                      ocr, keyboard, or learned:FILE (tab-separated correct/observed pairs)\n"
+                 "  --zipf EXPONENT     Skew of the query distribution over the haystack; 0 is uniform (default 1)\n"
+                 "  --seed N            Seed of the random numbers (default 1)\n"
+                 "  --lengths MIN,MAX   Lengths of the haystack strings (default 8,64)\n"
+                 "  --words FILE        The names the haystack is drawn from (default tests/taxanames)\n");
+}
+
+
+int main(int argc, char *argv[]) {
 #ifdef CAPTURE_METRICS
     initialize_metrics();
 #endif
@@ -465,21 +443,90 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[]) {
     int word_length             = 40;
     int word_length_lower_bound = -1; // -1 is disabled = all strings have length `word_length`
 
+    // For realistic data: queries drawn from a haystack of names. See error_models.hpp.
+    std::string  error_model;          // Empty is disabled = random strings with uniform edits
+    double       zipf_exponent   = 1.0;
+    unsigned     seed            = 1;  // Fixed, so every run benchmarks the same data
+    int          haystack_size   = 2000;
+    int          min_length      = 8;
+    int          max_length      = 64;
+    std::string  words_path      = TAXANAMES_PATH;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            print_usage(stdout);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            print_usage(stderr);
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (option == "--errors") {
+            error_model = value;
+        } else if (option == "--zipf") {
+            zipf_exponent = std::atof(value);
+        } else if (option == "--seed") {
+            seed = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (option == "--lengths") {
+            if (std::sscanf(value, "%d,%d", &min_length, &max_length) != 2 || min_length < 1 || max_length < min_length) {
+                print_usage(stderr);
+                return 1;
+            }
+        } else if (option == "--words") {
+            words_path = value;
+        } else {
+            print_usage(stderr);
+            return 1;
+        }
+    }
+    gen.seed(seed);
+
+    // The strings are benchmarked through views of the word list, which must outlive them, and of
+    // the strings made from it.
+    WordList                 word_list;
+    std::vector<std::string> generated_words;
+    std::vector<std::string> mangled_strings;
+    std::vector<std::string_view> subject_words;
+    if (!error_model.empty()) {
+        std::unique_ptr<ErrorModel> model = make_error_model(error_model);
+        if (!model) {
+            std::cerr << "Unknown error model or unreadable file: " << error_model << std::endl;
+            return 1;
+        }
+        if (!open_word_list(word_list, max_total_words, words_path) || word_list.empty()) return 1;
+        // The haystack is the column the UDF is called on, the inner loop; each query is a
+        // constant argument, the outer loop.
+        mangled_strings = draw_haystack(word_list.views(), haystack_size, min_length, max_length, gen);
+        generated_words = sample_queries(mangled_strings, max_subject_words, zipf_exponent, *model, max_edits,
+                                         max_edits_lower_bound, gen);
+        subject_words.assign(generated_words.begin(), generated_words.end());
+    } else {
 #ifndef USE_GENERATED_WORDS
-    std::vector<std::string> subject_words =
-            generate_word_list_from_file(max_subject_words, max_total_words);
+        if (!open_word_list(word_list, max_subject_words, words_path)) return 1;
+        subject_words = word_list.views();
 #else
-    std::vector<std::string> subject_words =
-            generate_list_of_random_words(max_subject_words, word_length, word_length_lower_bound);
+        generated_words = generate_list_of_random_words(max_subject_words, word_length, word_length_lower_bound);
+        subject_words.assign(generated_words.begin(), generated_words.end());
 #endif
-    std::vector<std::string> mangled_words =
-            mangle_word_list(subject_words, max_edits, max_edits_lower_bound);
+        mangled_strings = mangle_word_list(subject_words, max_edits, max_edits_lower_bound);
+    }
+    const std::vector<std::string_view> mangled_words(mangled_strings.begin(), mangled_strings.end());
 
     std::cout << std::right << std::setw(20) << "max_subject_words: " << max_subject_words << '\n';
     std::cout << std::right << std::setw(20) << "max_total_words: "   << max_total_words   << '\n';
     std::cout << std::right << std::setw(20) << "max_distance: "      << max_distance      << '\n';
     std::cout << std::right << std::setw(20) << "max_edits: "         << max_edits         << '\n';
-    std::cout << std::right << std::setw(20) << "word_length: "       << word_length       << std::endl;
+    std::cout << std::right << std::setw(20) << "seed: "              << seed              << '\n';
+    if (!error_model.empty()) {
+        std::cout << std::right << std::setw(20) << "error_model: "   << error_model       << '\n';
+        std::cout << std::right << std::setw(20) << "zipf_exponent: " << zipf_exponent     << '\n';
+        std::cout << std::right << std::setw(20) << "haystack: "      << haystack_size << " strings of "
+                  << min_length << " to " << max_length << " characters" << std::endl;
+    } else {
+        std::cout << std::right << std::setw(20) << "word_length: "   << word_length       << std::endl;
+    }
 
     return benchmark_on_list(subject_words, mangled_words, max_distance);
 }
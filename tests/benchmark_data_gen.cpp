@@ -16,6 +16,7 @@
 #include "testharness.hpp"  // Include the test harness for LEV_FUNCTION macros
 #include "benchtime.hpp"
 #include "edit_operations.hpp"
+#include "datasets.hpp"
 
 int benchmark_on_list(std::vector<std::string_view> &subject_words, std::vector<std::string_view> &mangled_words);
 std::vector<std::string> mangle_word_list(std::vector<std::string> &words, int max_edits);
@@ -102,29 +103,6 @@ std::string remove_internal_control_chars(const std::string_view s) {
     return result;
 }
 
-std::vector<std::string> get_subsample(std::vector<std::string> &list, u_int64_t sample_size, std::vector<std::string> &sample_list){
-    // std::random_device rd;
-    // std::mt19937 gen(rd());
-
-    if( sample_size > list.size()) {
-        std::cout << "Wrong sample size. sample_size: " << sample_size << "   list.size: " << list.size() << std::endl;
-    }
-    sample_size = std::min(sample_size, static_cast<u_int64_t>(list.size()));  // Prevent out-of-bounds access
-
-    // sample_list.reserve(sample_size);
-    for(int i=0; i < sample_size; i++){
-        sample_list.push_back(list[i]);
-    }
-    // std::sample(
-    //         list.begin(),
-    //         list.end(),
-    //         std::back_inserter(sample_list),
-    //         sample_size,
-    //         gen
-    // );
-}
-
-
 /// Reads `max_total_words` from the wordlist file, randomly selects `max_subject_words` of that total, shuffles, and
 /// returns a vector of strings if successful. Returns empty vector on error.
 std::vector<std::string>
@@ -176,15 +154,6 @@ generate_word_list_from_file(int max_total_words, std::string &primaryFilePath)
     }
 
     std::cout << "Loaded " << words.size() << " words from the file." << std::endl;
-
-    // std::vector<std::string> subject_words;
-    //
-    // // Randomly sample max_subject_words from words to use as subject words
-    // if (words.size() > max_subject_words) {
-    //     subject_words = get_subsample(words, max_subject_words);
-    // } else {
-    //     subject_words = words;
-    // }
     return words;
 }
 
@@ -347,7 +316,7 @@ std::vector<BenchmarkResult> benchmark_on_list(std::vector<std::string> &subject
                 char error[512] = {0};
 
                 // Call the UDF function directly
-                long long result = udf.func(&initid, &args, &is_null, error);
+                udf.func(&initid, &args, &is_null, error);
                 if (error[0] != '\0') {
                     std::cerr << "Error during UDF call (" << udf.name << "): " << error << std::endl;
                     // Optionally handle the error, e.g., continue or exit
@@ -441,6 +410,19 @@ std::vector<BenchmarkResult> benchmark_on_list(std::vector<std::string> &subject
 }
 
 
+void print_usage(FILE *out) {
+    std::fprintf(out,
+                 "Usage: benchmark_data_gen [--cache DIR] [--seed N] [--threads N] [--strings N]\n"
+                 "\n"
+                 "Times the UDFs over a grid of string length, cutoff, and edits, into benchmark_results.csv.\n"
+                 "\n"
+                 "  --cache DIR    Where the generated strings are kept (default " DATASET_CACHE_DIR ")\n"
+                 "  --seed N       Seed of the strings and edits (default 1)\n"
+                 "  --threads N    Threads generating the strings; 0 is one per core (default 0)\n"
+                 "  --strings N    Strings generated of each length (default 2000000)\n");
+}
+
+
 int main(int argc, char *argv[]) {
 #ifdef CAPTURE_METRICS
     initialize_metrics();
@@ -449,26 +431,43 @@ int main(int argc, char *argv[]) {
     int max_subject_words     = 2000; // Number of subject words to test
     int max_total_words       = 2000000; // Total number of words to load from file and sample from.
     // long long max_distance    = 5;    // The max given to the algorithms (NOT max number of edits)
-    int max_edits             = 5;    // The maximum number of edits used when mangling the strings (NOT algorithm limit)
     int max_edits_lower_bound = -1;   // -1 is disabled = do exactly max_edits
 
     // For randomly generated strings
-    int word_length             = 40;
     int word_length_lower_bound = -1; // -1 is disabled = all strings have length `word_length`
 
-#ifndef USE_GENERATED_WORDS
-    std::vector<std::string> subject_words =
-            generate_word_list_from_file(max_subject_words, max_total_words);
-#else
-    std::vector<std::string> words;
-    words.reserve(max_total_words);
-#endif
+    std::string cache_dir = DATASET_CACHE_DIR;
+    unsigned    seed      = 1;
+    unsigned    threads   = 0;
 
-    // std::cout << std::right << std::setw(20) << "max_subject_words: " << max_subject_words << '\n';
-    // std::cout << std::right << std::setw(20) << "max_total_words: "   << max_total_words   << '\n';
-    // std::cout << std::right << std::setw(20) << "max_distance: "      << max_distance      << '\n';
-    // std::cout << std::right << std::setw(20) << "max_edits: "         << max_edits         << '\n';
-    // std::cout << std::right << std::setw(20) << "word_length: "       << word_length       << std::endl;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            print_usage(stdout);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            print_usage(stderr);
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (option == "--cache") {
+            cache_dir = value;
+        } else if (option == "--seed") {
+            seed = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (option == "--threads") {
+            threads = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (option == "--strings") {
+            max_total_words = std::atoi(value);
+        } else {
+            print_usage(stderr);
+            return 1;
+        }
+    }
+    if (max_total_words < max_subject_words) {
+        print_usage(stderr);
+        return 1;
+    }
 
     std::vector<std::string> mangled_words;
     mangled_words.reserve(max_subject_words);
@@ -481,30 +480,36 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Loop over parameter ranges
-    // for (int dist = 2; dist <= 16; dist += 1) {
-    //     for (int edits = 1; edits <= 16; edits += 1) {
+    // Loop over parameter ranges. The strings of each length are generated, or read from the cache,
+    // once, and the subjects drawn from them and their edits are shared by every cutoff.
     for (int word_len = 100; word_len <= 250; word_len += 10) {
-        for (int dist = 2; dist <= std::min(word_len, 16); dist += 2) {
-            for (int edits = 2; edits <= 16; edits += 2) {
+        DatasetKey key;
+        key.count       = static_cast<std::uint64_t>(max_total_words);
+        key.length      = word_len;
+        key.lower_bound = word_length_lower_bound;
+        key.seed        = seed;
+
+        auto start_time = std::chrono::steady_clock::now();
+        Dataset words;
+        if (!words.open(key, cache_dir, threads)) return 1;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        std::cout << (words.generated() ? "Generated " : "Loaded ") << words.size() << " strings of length "
+                  << word_len << " in " << elapsed.count() << "s" << std::endl;
+
+        // The same subjects for the same length and seed, whatever ran before.
+        gen.seed(seed + static_cast<unsigned>(word_len));
+        std::uniform_int_distribution<std::uint64_t> index(0, words.size() - 1);
+        subject_words.clear();
+        for (int i = 0; i < max_subject_words; i++) subject_words.emplace_back(words[index(gen)]);
+
+        for (int edits = 2; edits <= 16; edits += 2) {
+            mangled_words.clear();
+            mangle_word_list(subject_words, edits, max_edits_lower_bound, mangled_words);
+
+            for (int dist = 2; dist <= std::min(word_len, 16); dist += 2) {
                 std::cout << "Testing with word_length = " << word_len
                           << ", max_distance = " << dist
                           << ", max_edits = " << edits << std::endl;
-                subject_words.clear();
-                mangled_words.clear();
-                words.clear();
-                words = generate_list_of_random_words(max_total_words, word_len, word_length_lower_bound);
-
-                std::sample(
-                        words.begin(),
-                        words.end(),
-                        std::back_inserter(subject_words),
-                        max_subject_words,
-                        gen
-                );
-
-                // generate_list_of_random_words(max_subject_words, word_len, word_length_lower_bound);
-                mangle_word_list(subject_words, edits, max_edits_lower_bound, mangled_words);
                 // Run the benchmark with the current parameters
                 auto results = benchmark_on_list(subject_words, mangled_words, dist);
 
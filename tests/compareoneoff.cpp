@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <iostream>
 #include <string>
 
@@ -165,10 +166,20 @@ int calculateLevDistance(const std::string& S1_input, const std::string& S2_inpu
     return dp[n][m];
 }
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[]) {
+// Usage: compareoneoff [STRING_A STRING_B [MAX]]
+// Without arguments, compares the strings above. `print_slow_calls()` prints the command line that
+// reruns a slow call this way.
+int main(int argc, char *argv[]) {
     initialize_metrics();
 
     int max_distance = 5;
+    if (argc >= 3) {
+        string_a = argv[1];
+        string_b = argv[2];
+    }
+    if (argc >= 4) {
+        max_distance = std::atoi(argv[3]);
+    }
 
     // We use `ALGORITHM_B` as the "expected" value, although this is somewhat arbitrary.
     ALGORITHM_B_SETUP();
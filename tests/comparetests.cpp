@@ -16,16 +16,16 @@ There are two ways to use this file.
 
 #include <gtest/gtest.h>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <algorithm>
-#include <boost/interprocess/mapped_region.hpp>
-#include <boost/interprocess/file_mapping.hpp>
 #include <sstream>
 
 #include "edit_operations.hpp"
 #include "metrics.hpp"
+#include "word_list.hpp"
 
 #ifndef WORDS_PATH
 #define WORDS_PATH "/usr/share/dict/words"
@@ -114,21 +114,6 @@ struct TestCase {
 int LOOP = 100000; // Adjust as necessary for testing speed
 std::vector<TestCase> failedTests; // Vector to store failed test cases
 
-std::vector<std::string> readWordsFromMappedFile(const boost::interprocess::mapped_region& region, unsigned maximumWords) {
-    const char* begin = static_cast<const char*>(region.get_address());
-    const char* end = begin + region.get_size();
-    std::string fileContent(begin, end);
-
-    std::istringstream iss(fileContent);
-    std::vector<std::string> words;
-    std::string word;
-    while (iss >> word && words.size() < maximumWords) {
-        words.push_back(word);
-    }
-
-    return words;
-}
-
 // Helper function to check if a value is within a given range.
 ::testing::AssertionResult IsBetweenInclusive(int val, int lower_bound, int upper_bound) {
     if ((val >= lower_bound) && (val <= upper_bound))
@@ -140,59 +125,43 @@ std::vector<std::string> readWordsFromMappedFile(const boost::interprocess::mapp
 // Fixture class for Google Test
 class LevenshteinTest : public ::testing::Test {
 protected:
-    std::vector<std::string> wordList;
+    WordList                      words;     // The word list file, if there is one
+    std::vector<std::string>      generated; // Otherwise random words
+    std::vector<std::string_view> wordList;
 
     /**
     Sets up the test fixture by initializing the word list used in the tests.
 
     This function is called before each test in the LevenshteinTest class.
-    It attempts to open a primary file containing words from the path
-    "tests/taxanames". If the primary file cannot be opened, it falls back
-    to a predefined fallback file path specified by WORDS_PATH. Both file
-    accesses are done using Boost's interprocess library to map the file
-    contents into memory for efficient reading.
-
-    If both file openings fail, the test will fail with an error message
-    indicating that the fallback file could not be opened. Upon successful
-    file access, the words are read into the `wordList` vector, limited by
-    the maximum size defined by word_count. This word list is then used
-    in the tests for string manipulation and comparison operations related
-    to the Levenshtein distance algorithm.
+    By default the words are 200,000 random strings of 20 characters. If the
+    environment variable `LEV_WORDS` is set, they are instead the first
+    200,000 lines of the file it names, for example `tests/taxanames` or
+    WORDS_PATH. The file is read with `WordList`, which maps it into memory,
+    and `wordList` holds views of its lines, so the words are not copied.
+
+    If the file can't be opened, the test fails with an error message.
+    This word list is then used in the tests for string manipulation and
+    comparison operations related to the Levenshtein distance algorithm.
     */
     void SetUp() override {
-        /*
-
-        std::string primaryFilePath = "tests/taxanames";
-        std::string fallbackFilePath = WORDS_PATH;
-        unsigned maximum_size = 200000;
-
-        boost::interprocess::file_mapping text_file;
-        boost::interprocess::mapped_region text_file_buffer;
-
-        try {
-            text_file = boost::interprocess::file_mapping(primaryFilePath.c_str(), boost::interprocess::read_only);
-            text_file_buffer = boost::interprocess::mapped_region(text_file, boost::interprocess::read_only);
-            std::cout << "Using words from " << primaryFilePath << std::endl;
-        } catch (const boost::interprocess::interprocess_exception&) {
-            try {
-                text_file = boost::interprocess::file_mapping(fallbackFilePath.c_str(), boost::interprocess::read_only);
-                text_file_buffer = boost::interprocess::mapped_region(text_file, boost::interprocess::read_only);
-                std::cout << "Using words from " << fallbackFilePath << std::endl;
-            } catch (const boost::interprocess::interprocess_exception&) {
-                FAIL() << "Could not open fallback file " << fallbackFilePath;
+        const std::size_t maximum_size = 200000;
+
+        if (const char *path = std::getenv("LEV_WORDS")) {
+            if (!words.open(path, "unittest", maximum_size)) {
+                FAIL() << "Could not open " << path;
             }
+            std::cout << "Using words from " << path << std::endl;
+            wordList = words.views();
+            return;
         }
-        wordList = readWordsFromMappedFile(text_file_buffer, maximum_size);
-        */
 
-        int word_count = 200000;
         int word_length = 20;
-        wordList.reserve(word_count);
+        generated.reserve(maximum_size);
 
         auto gen_word = [word_length](){return generateRandomString(word_length);};
 
-        std::generate_n(std::back_inserter(wordList), word_count, gen_word); // Fill the string
-
+        std::generate_n(std::back_inserter(generated), maximum_size, gen_word); // Fill the string
+        wordList.assign(generated.begin(), generated.end());
     }
 
 };
@@ -214,7 +183,7 @@ const int MAX_DISTANCE   = 5;
 const int MAX_EDITS_MADE = 5;
 
 template <typename Func>
-void RunLevenshteinTest(const char* function_name, Func applyEditFunc, const std::vector<std::string>& wordList, long long max_distance) {
+void RunLevenshteinTest(const char* function_name, Func applyEditFunc, const std::vector<std::string_view>& wordList, long long max_distance) {
     int failureCount = 0;
     for (int i = 0; i < LOOP; ++i) {
         std::string original = getUniformRandomString(wordList);
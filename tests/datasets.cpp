@@ -0,0 +1,177 @@
+/*!
+
+Synthetic datasets for the benchmark sweeps. See `datasets.hpp`.
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include <unistd.h>
+
+#include "datasets.hpp"
+#include "edit_operations.hpp"
+
+namespace {
+
+constexpr char          MAGIC[8] = {'D', 'A', 'M', 'L', 'E', 'V', 'D', 'S'};
+constexpr std::uint32_t VERSION  = 1;
+
+struct Header {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t length;
+    std::int32_t  lower_bound;
+    std::uint32_t seed;
+    std::uint64_t count;
+};
+
+/// The strings of one chunk, back to back, and where each ends.
+struct Chunk {
+    std::string                bytes;
+    std::vector<std::uint64_t> ends;
+};
+
+std::vector<Chunk> generate_chunks(const DatasetKey &key, unsigned threads) {
+    const std::uint64_t chunk_count = (key.count + DATASET_CHUNK - 1)/DATASET_CHUNK;
+    std::vector<Chunk> chunks(chunk_count);
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::uint64_t>(threads, std::max<std::uint64_t>(chunk_count, 1)));
+
+    std::atomic<std::uint64_t> next{0};
+    auto work = [&]() {
+        for (std::uint64_t c = next++; c < chunk_count; c = next++) {
+            std::seed_seq seeds{key.seed, static_cast<unsigned>(key.length), static_cast<unsigned>(key.lower_bound + 1),
+                                static_cast<unsigned>(c), static_cast<unsigned>(c >> 32)};
+            std::mt19937 rng{seeds};
+            const std::uint64_t strings = std::min(DATASET_CHUNK, key.count - c*DATASET_CHUNK);
+            Chunk &chunk = chunks[c];
+            chunk.bytes.reserve(strings*static_cast<std::uint64_t>(key.length));
+            chunk.ends.reserve(strings);
+            for (std::uint64_t i = 0; i < strings; i++) {
+                chunk.bytes += generateRandomString(key.length, key.lower_bound, rng);
+                chunk.ends.push_back(chunk.bytes.size());
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(work);
+    work();
+    for (auto &thread: pool) thread.join();
+    return chunks;
+}
+
+bool write_file(const std::string &path, const DatasetKey &key, const std::vector<Chunk> &chunks) {
+    // Written under a temporary name and renamed, so that a run that is interrupted, or another
+    // run generating the same dataset, never leaves a partial file under the real name. Thread ids
+    // repeat across processes, as under `ctest -j`, so the name has the process id as well.
+    const std::string temporary = path + ".tmp" + std::to_string(::getpid()) + "."
+                                  + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+        header.version     = VERSION;
+        header.length      = static_cast<std::uint32_t>(key.length);
+        header.lower_bound = key.lower_bound;
+        header.seed        = key.seed;
+        header.count       = key.count;
+        out.write(reinterpret_cast<const char *>(&header), sizeof header);
+
+        std::uint64_t base = 0;
+        const std::uint64_t zero = 0;
+        out.write(reinterpret_cast<const char *>(&zero), sizeof zero);
+        for (const Chunk &chunk: chunks) {
+            for (std::uint64_t end: chunk.ends) {
+                std::uint64_t offset = base + end;
+                out.write(reinterpret_cast<const char *>(&offset), sizeof offset);
+            }
+            base += chunk.bytes.size();
+        }
+        for (const Chunk &chunk: chunks) out.write(chunk.bytes.data(), static_cast<std::streamsize>(chunk.bytes.size()));
+        if (!out.flush()) {
+            std::fprintf(stderr, "dataset: can't write %s\n", temporary.c_str());
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::fprintf(stderr, "dataset: can't rename %s: %s\n", temporary.c_str(), error.message().c_str());
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string DatasetKey::file_name() const {
+    return "random_" + std::to_string(count) + "x" + std::to_string(length)
+           + (lower_bound >= 0 ? "-" + std::to_string(lower_bound) : std::string{}) + "_seed" + std::to_string(seed)
+           + ".bin";
+}
+
+bool Dataset::open(const DatasetKey &key, const std::string &cache_dir, unsigned threads) {
+    std::error_code error;
+    std::filesystem::create_directories(cache_dir, error);
+    if (error) {
+        std::fprintf(stderr, "dataset: can't create %s: %s\n", cache_dir.c_str(), error.message().c_str());
+        return false;
+    }
+    const std::string path = (std::filesystem::path(cache_dir)/key.file_name()).string();
+
+    was_generated = false;
+    if (std::filesystem::exists(path) && map(path, key)) return true;
+
+    if (!write_file(path, key, generate_chunks(key, threads))) return false;
+    was_generated = true;
+    return map(path, key);
+}
+
+bool Dataset::map(const std::string &path, const DatasetKey &key) {
+    offsets = nullptr;
+    strings = nullptr;
+    count   = 0;
+    if (!file.open(path, "dataset")) return false;
+
+    // Anything that doesn't match the key, or is cut short, is regenerated.
+    const std::string_view text = file.text();
+    Header header;
+    if (text.size() < sizeof header) return false;
+    std::memcpy(&header, text.data(), sizeof header);
+    if (std::memcmp(header.magic, MAGIC, sizeof MAGIC) != 0 || header.version != VERSION
+        || header.length != static_cast<std::uint32_t>(key.length) || header.lower_bound != key.lower_bound
+        || header.seed != key.seed || header.count != key.count) {
+        return false;
+    }
+    const std::uint64_t strings_start = sizeof header + (header.count + 1)*sizeof(std::uint64_t);
+    if (text.size() < strings_start) return false;
+    const auto *index = reinterpret_cast<const std::uint64_t *>(text.data() + sizeof header);
+    if (text.size() != strings_start + index[header.count]) return false;
+
+    offsets = index;
+    strings = text.data() + strings_start;
+    count   = header.count;
+    return true;
+}
+
+std::vector<std::string> generate_dataset(const DatasetKey &key, unsigned threads) {
+    std::vector<std::string> result;
+    result.reserve(key.count);
+    for (const Chunk &chunk: generate_chunks(key, threads)) {
+        std::uint64_t start = 0;
+        for (std::uint64_t end: chunk.ends) {
+            result.emplace_back(chunk.bytes, start, end - start);
+            start = end;
+        }
+    }
+    return result;
+}
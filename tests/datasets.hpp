@@ -0,0 +1,94 @@
+/*!
+
+Synthetic datasets for the benchmark sweeps, generated in parallel and cached on disk.
+
+`benchmark_data_gen` times the UDFs over a grid of string length, cutoff, and number of edits, on
+millions of random strings of each length. Generating those strings takes far longer than the
+benchmarks, so a `Dataset` is generated once per length, by as many threads as there are cores,
+and written to a binary file named after everything it was generated from. The next run, or the
+next point of the grid with the same length, maps the file instead.
+
+The strings are generated in chunks of `DATASET_CHUNK` strings, each from its own random number
+generator, seeded with the dataset's seed, length, and lower bound and the chunk's index. So a
+dataset is the same however many threads generate it, and different datasets don't share streams.
+
+The file is a header, the offset of each string and of the end of the last one as 64-bit
+integers, and then the strings, back to back:
+
+    char     magic[8];     "DAMLEVDS"
+    uint32_t version;
+    uint32_t length;
+    int32_t  lower_bound;
+    uint32_t seed;
+    uint64_t count;
+    uint64_t offsets[count + 1];
+    char     strings[offsets[count]];
+
+The file is native-endian, since it is a cache, not an interchange format.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../tools/mapped_file.h"
+
+/// The number of strings generated from one random number generator.
+constexpr std::uint64_t DATASET_CHUNK = 1 << 16;
+
+/// What a dataset is generated from, and so the name of its cache file.
+struct DatasetKey {
+    std::uint64_t count       = 0;
+    int           length      = 0;
+    int           lower_bound = -1; // -1 for strings of exactly `length`, as for `generateRandomString()`
+    unsigned      seed        = 1;
+
+    std::string file_name() const;
+};
+
+/// Random strings with the letter frequencies of `generateRandomString()`. See the top of this file.
+class Dataset {
+public:
+    /**
+    Maps the dataset's file in `cache_dir`, or if there isn't one, generates the dataset and
+    writes the file first.
+
+    @param key What to generate.
+    @param cache_dir Where the files are kept. Created if it doesn't exist.
+    @param threads The number of threads to generate with, or 0 for one per core.
+    @return False, after printing why, if the file can't be written or read.
+    */
+    bool open(const DatasetKey &key, const std::string &cache_dir, unsigned threads = 0);
+
+    std::uint64_t size() const { return count; }
+
+    std::string_view operator[](std::uint64_t i) const {
+        return {strings + offsets[i], static_cast<std::size_t>(offsets[i + 1] - offsets[i])};
+    }
+
+    /// Whether `open()` generated the dataset rather than finding it in the cache.
+    bool generated() const { return was_generated; }
+
+private:
+    bool map(const std::string &path, const DatasetKey &key);
+
+    MappedFile           file;
+    const std::uint64_t *offsets       = nullptr;
+    const char          *strings       = nullptr;
+    std::uint64_t        count         = 0;
+    bool                 was_generated = false;
+};
+
+/**
+Generates the strings of a dataset, without caching them.
+
+@param key What to generate.
+@param threads The number of threads to generate with, or 0 for one per core.
+@return The strings.
+*/
+std::vector<std::string> generate_dataset(const DatasetKey &key, unsigned threads = 0);
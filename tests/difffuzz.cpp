@@ -0,0 +1,977 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+`difffuzz`: check every kernel against a reference implementation on generated pairs of strings,
+from as many threads as there are cores, and shrink the first disagreement to a minimal case.
+
+Usage:
+
+    difffuzz [options]
+
+Options (lists are comma separated):
+
+    --kernels NAME,...   Kernels to check (default all; see below).
+    --threads N          Threads to fuzz on (default one per core).
+    --seconds S          Stop after this long (default 10; 0 for no limit).
+    --cases N            Stop after this many cases (default no limit).
+    --max-length L       The longest string generated (default 4097).
+    --seed S             Seed for the cases (default 1). Thread `t` draws from the seeds `S` and `t`.
+
+The reference is the textbook recurrence over the whole matrix, with no band, early exit, or bit
+parallelism, for Levenshtein and for optimal string alignment (OSA) distance. Every kernel is an
+optimization of one of the two, so a kernel that disagrees with it on any pair, after the
+conventions of `levenshtein.h` for empty strings, cutoffs, and workspaces that are too small,
+has a bug.
+
+A case is a subject, a query, a cutoff, a minimum similarity, the number of `int`s of workspace
+the library kernels get, and a previous subject with its own cutoff, for the kernels that keep
+state from one row to the next. The strings are drawn to be hard on the kernels rather than
+realistic:
+
+  - Over alphabets of 2, 4, 26, and all 256 byte values, including `\0`.
+  - Random strings, runs of one character, and short periods repeated (`abcabcab`).
+  - A query that is the subject with a few random edits, with its adjacent pairs swapped in a
+    chain, rotated by one, with its runs lengthened and shortened, or with characters added to
+    one end until the difference in length is about the cutoff; or an unrelated string.
+  - Lengths mostly short, but also on either side of 64 and 128, the word sizes of the
+    bit-parallel kernel, and of the sizes at which the UDFs' buffer runs out (2047 characters
+    for the transposition kernels and 4095 for the others, with the default `DAMLEV_BUFFER_SIZE`).
+  - Cutoffs from 0 through a few edits, around the difference in length, and beyond the length.
+  - Workspaces of exactly the size needed and one `int` short.
+  - A previous subject that shares a prefix with the subject, so the prefix caches reuse rows.
+
+The kernels:
+
+    edit_dist, edit_dist_t              The kernels of `levenshtein/levenshtein.h`.
+    bounded_edit_dist(_t)
+    similarity_t
+    prepared, prepared_t                `PreparedQuery::distance` of `levenshtein/batch.h`.
+    prefix_cache, prefix_cache_t        `PrefixCache::distance` of `levenshtein/prefix_cache.h`,
+                                        on the previous subject and then the subject.
+    dispatch, dispatch_t                `Dispatcher::distance` of `levenshtein/dispatch.h`, without
+                                        a constant query and with the query as the constant, in
+                                        both orders, and for `dispatch_t`, `similarity()` too.
+    edit_dist_udf, edit_dist_t_udf      The UDFs, through their C interface, with the query as a
+    bounded_edit_dist_udf               constant argument.
+    bounded_edit_dist_t_udf
+    similarity_t_udf
+    min_edit_dist, min_edit_dist_t      The UDFs that tighten their bound from row to row, on the
+    min_similarity_t                    previous subject and then the subject.
+
+The first disagreement stops the run. It is shrunk, by deleting characters, replacing them with
+`a`, and lowering the cutoffs for as long as the kernel still disagrees, and printed with what the
+kernel returned and what it should have. The exit status is 1 if there was a disagreement.
+
+Most cases are short, and a core checks about a billion kernel calls an hour, so an hour's run
+(`--seconds 3600`) on a machine with a few cores checks billions.
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../src/common.h"
+#include "levenshtein/batch.h"
+#include "levenshtein/dispatch.h"
+#include "levenshtein/prefix_cache.h"
+
+UDF_SIGNATURES(bounded_edit_dist)
+UDF_SIGNATURES(bounded_edit_dist_t)
+UDF_SIGNATURES(edit_dist)
+UDF_SIGNATURES(edit_dist_t)
+UDF_SIGNATURES(min_edit_dist)
+UDF_SIGNATURES(min_edit_dist_t)
+UDF_SIGNATURES_TYPE(similarity_t, double)
+UDF_SIGNATURES_TYPE(min_similarity_t, double)
+
+namespace {
+
+using levenshtein::BUFFER_EXCEEDED;
+
+struct Options {
+    std::vector<std::string> kernels;     // Empty for all
+    unsigned                 threads    = 0;
+    double                   seconds    = 10;
+    unsigned long long       cases      = 0;
+    int                      max_length = 4097;
+    unsigned                 seed       = 1;
+};
+
+// region Cases
+
+/// One comparison, and everything a kernel's result depends on. The stateful kernels are given
+/// `previous` with `previous_max` first, as the row before, and then `subject` with `max`.
+struct Case {
+    std::string subject;
+    std::string query;
+    int         max          = 0;
+    double      similarity   = 0;
+    int         workspace    = 0; // In `int`s, for the library kernels
+    std::string previous;
+    int         previous_max = 0;
+};
+
+/// The textbook recurrence over the whole matrix, keeping only the three rows it reads.
+class Reference {
+public:
+    int distance(std::string_view a, std::string_view b, bool transpositions) {
+        const int n = static_cast<int>(a.length());
+        const int m = static_cast<int>(b.length());
+        cells.resize(3*static_cast<std::size_t>(m + 1));
+        int *two_up = cells.data(), *up = two_up + m + 1, *row = up + m + 1;
+        std::iota(up, up + m + 1, 0);
+        for (int i = 1; i <= n; i++) {
+            row[0] = i;
+            for (int j = 1; j <= m; j++) {
+                int cost = (a[i - 1] == b[j - 1]) ? 0 : 1;
+                row[j] = std::min({up[j] + 1, row[j - 1] + 1, up[j - 1] + cost});
+                if (transpositions && i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) {
+                    row[j] = std::min(row[j], two_up[j - 2] + cost);
+                }
+            }
+            std::swap(two_up, up);
+            std::swap(up, row);
+        }
+        return up[m];
+    }
+
+private:
+    std::vector<int> cells;
+};
+
+/// The reference distances of a case, indexed by whether they allow transpositions.
+struct Truth {
+    int distance[2];
+    int previous[2];
+};
+
+Truth find_truth(const Case &c, Reference &reference, bool stateful) {
+    Truth truth{};
+    for (int t = 0; t < 2; t++) {
+        truth.distance[t] = reference.distance(c.subject, c.query, t);
+        truth.previous[t] = stateful ? reference.distance(c.previous, c.query, t) : 0;
+    }
+    return truth;
+}
+
+/// Draws the cases of one thread. See the top of this file.
+class Generator {
+public:
+    Generator(unsigned seed, unsigned thread, int max_length, int max_workspace)
+        : max_length(max_length), max_workspace(max_workspace) {
+        std::seed_seq seeds{seed, thread};
+        rng.seed(seeds);
+    }
+
+    Case next() {
+        Case c;
+        alphabet = ALPHABETS[pick(std::size(ALPHABETS))];
+
+        c.subject = subject(length());
+        c.query   = query(c.subject);
+        if (chance(0.5)) std::swap(c.subject, c.query);
+
+        const int n = static_cast<int>(std::min(c.subject.length(), c.query.length()));
+        const int m = static_cast<int>(std::max(c.subject.length(), c.query.length()));
+        c.max        = cutoff(m - n, m);
+        c.similarity = similarity(c.max, m);
+        c.workspace  = workspace(m);
+
+        const std::size_t shared = pick(c.subject.length() + 1);
+        switch (pick(4)) {
+            case 0:  c.previous = c.subject.substr(0, shared) + subject(between(0, 8)); break;
+            case 1:  c.previous = c.subject; break;
+            case 2:  c.previous = subject(length()); break;
+            default: break;
+        }
+        c.previous     = clamp(std::move(c.previous));
+        c.previous_max = chance(0.5) ? c.max : cutoff(0, m);
+        return c;
+    }
+
+private:
+    static constexpr std::string_view ALPHABETS[] = {"ab", "abcd", "abcdefghijklmnopqrstuvwxyz", ""}; // "" for all bytes
+    static constexpr int BIT_PARALLEL_EDGES[] = {63, 64, 65, 127, 128, 129};
+    // Either side of the largest strings the UDFs' buffers hold.
+    static constexpr int BUFFER_EDGES[] = {
+        DAMLEV_MAX_EDIT_DIST/2 - 2, DAMLEV_MAX_EDIT_DIST/2 - 1, DAMLEV_MAX_EDIT_DIST/2,
+        DAMLEV_MAX_EDIT_DIST - 2,   DAMLEV_MAX_EDIT_DIST - 1,   DAMLEV_MAX_EDIT_DIST,
+    };
+
+    std::mt19937_64  rng;
+    int              max_length;
+    int              max_workspace;
+    std::string_view alphabet;
+
+    std::size_t pick(std::size_t count) { return std::uniform_int_distribution<std::size_t>(0, count - 1)(rng); }
+    int between(int low, int high) { return std::uniform_int_distribution<int>(low, std::max(low, high))(rng); }
+    bool chance(double p) { return std::bernoulli_distribution(p)(rng); }
+
+    char character() {
+        return alphabet.empty() ? static_cast<char>(pick(256)) : alphabet[pick(alphabet.length())];
+    }
+
+    std::string clamp(std::string s) const {
+        if (static_cast<int>(s.length()) > max_length) s.resize(static_cast<std::size_t>(max_length));
+        return s;
+    }
+
+    int length() {
+        // The long ones cost milliseconds each in the reference, so they are rare.
+        double p = std::uniform_real_distribution<double>(0, 1)(rng);
+        int length;
+        if (p < 0.70)         length = between(0, 12);
+        else if (p < 0.92)    length = between(0, 40);
+        else if (p < 0.96)    length = between(0, 200);
+        else if (p < 0.99999) length = BIT_PARALLEL_EDGES[pick(std::size(BIT_PARALLEL_EDGES))];
+        else                  length = BUFFER_EDGES[pick(std::size(BUFFER_EDGES))];
+        return std::min(length, max_length);
+    }
+
+    std::string subject(int length) {
+        std::string s;
+        s.reserve(static_cast<std::size_t>(length));
+        switch (pick(3)) {
+            case 0: // Random
+                while (static_cast<int>(s.length()) < length) s += character();
+                break;
+            case 1: { // Runs of one character, now and then broken by another
+                const char run = character();
+                while (static_cast<int>(s.length()) < length) s += chance(0.9) ? run : character();
+                break;
+            }
+            default: { // A short period repeated
+                std::string period;
+                for (int p = between(1, 4); p > 0; p--) period += character();
+                while (static_cast<int>(s.length()) < length) s += period[s.length() % period.length()];
+                break;
+            }
+        }
+        return s;
+    }
+
+    /// One random substitution, insertion, deletion, or transposition of adjacent characters.
+    void edit(std::string &s) {
+        const std::size_t at = pick(s.length() + 1);
+        switch (pick(4)) {
+            case 0: if (at < s.length()) s[at] = character(); break;
+            case 1: s.insert(at, 1, character()); break;
+            case 2: if (at < s.length()) s.erase(at, 1); break;
+            default: if (at + 1 < s.length()) std::swap(s[at], s[at + 1]); break;
+        }
+    }
+
+    std::string query(const std::string &subject) {
+        std::string q = subject;
+        switch (pick(7)) {
+            case 0: // A few random edits
+                for (int e = between(0, 6); e > 0; e--) edit(q);
+                break;
+            case 1: // A chain of transpositions: `abcdef` to `badcfe`, or from some point on
+                for (std::size_t i = pick(2); i + 1 < q.length(); i += chance(0.8) ? 2 : 3) std::swap(q[i], q[i + 1]);
+                break;
+            case 2: // Rotated by one, which is a chain of overlapping transpositions
+                if (!q.empty()) std::rotate(q.begin(), q.begin() + (chance(0.5) ? 1 : static_cast<long>(q.length()) - 1), q.end());
+                break;
+            case 3: { // Runs lengthened and shortened
+                std::string runs;
+                for (char ch: q) {
+                    if (chance(0.9)) runs += ch;
+                    if (chance(0.1)) runs += ch;
+                }
+                q = std::move(runs);
+                break;
+            }
+            case 4: { // Characters added to one end, so that the lengths differ by about the cutoff
+                std::string extra = this->subject(between(0, 10));
+                q = chance(0.5) ? q + extra : extra + q;
+                if (chance(0.5)) edit(q);
+                break;
+            }
+            case 5: // Unrelated
+                q = this->subject(length());
+                break;
+            default: // Equal
+                break;
+        }
+        return clamp(std::move(q));
+    }
+
+    int cutoff(int difference, int longer) {
+        double p = std::uniform_real_distribution<double>(0, 1)(rng);
+        int max;
+        if (p < 0.6)       max = between(0, 8);
+        else if (p < 0.8)  max = difference + between(-1, 1);
+        else if (p < 0.95) max = between(0, longer + 2);
+        else               max = between(0, DAMLEV_MAX_EDIT_DIST);
+        return std::max(max, 0);
+    }
+
+    double similarity(int max, int longer) {
+        double p = std::uniform_real_distribution<double>(0, 1)(rng);
+        if (p < 0.5 && longer > 0) return std::max(0.0, levenshtein::edits_to_similarity(max, longer));
+        if (p < 0.8) return std::uniform_real_distribution<double>(0, 1)(rng);
+        return p < 0.9 ? 0.0 : 1.0;
+    }
+
+    int workspace(int longer) {
+        int size;
+        switch (pick(8)) {
+            case 0:  size = levenshtein::workspace_size(static_cast<std::size_t>(longer), true) - static_cast<int>(pick(2)); break;
+            case 1:  size = levenshtein::workspace_size(static_cast<std::size_t>(longer), false) - static_cast<int>(pick(2)); break;
+            default: size = max_workspace; break;
+        }
+        return std::clamp(size, 0, max_workspace);
+    }
+};
+
+// endregion Cases
+
+// region Kernels
+
+/// What a kernel checks against, besides the case itself.
+struct Scratch {
+    Reference        reference;
+    std::vector<int> workspace;
+};
+
+using Check = bool (*)(const Case &, const Truth &, Scratch &, std::string &report);
+
+struct Kernel {
+    const char *name;
+    Check       check;
+    bool        stateful; // Uses `previous`
+};
+
+// What the conventions at the top of `levenshtein.h` make of the true distance. The lengths
+// alone decide some comparisons before the workspace is looked at.
+
+int expect_bounded(const std::string &a, const std::string &b, int distance, int max, int workspace,
+                   bool transpositions) {
+    const int n = static_cast<int>(std::min(a.length(), b.length()));
+    const int m = static_cast<int>(std::max(a.length(), b.length()));
+    if (n == 0) return m;
+    if (m - n > max) return max + 1;
+    if (levenshtein::workspace_size(static_cast<std::size_t>(m), transpositions) > workspace) return BUFFER_EXCEEDED;
+    return std::min(distance, max + 1);
+}
+
+int expect_unbounded(const std::string &a, const std::string &b, int distance, int workspace, bool transpositions) {
+    const std::size_t m = std::max(a.length(), b.length());
+    if (a.empty() || b.empty()) return static_cast<int>(m);
+    if (levenshtein::workspace_size(m, transpositions) > workspace) return BUFFER_EXCEEDED;
+    return distance;
+}
+
+double expect_similarity(const std::string &a, const std::string &b, int distance, double similarity, int workspace) {
+    const int m = static_cast<int>(std::max(a.length(), b.length()));
+    if (m == 0) return 1.0;
+    const int max      = levenshtein::similarity_to_max_edits(similarity, m);
+    const int bounded  = expect_bounded(a, b, distance, max, workspace, true);
+    if (bounded == BUFFER_EXCEEDED) return BUFFER_EXCEEDED;
+    return std::max(0.0, levenshtein::edits_to_similarity(std::min(bounded, max + 1), m));
+}
+
+std::string describe(long long value) { return std::to_string(value); }
+
+std::string describe(double value) {
+    char text[32];
+    std::snprintf(text, sizeof text, "%.17g", value);
+    return text;
+}
+
+/// Compares a result with what it should have been, and says how they differ if they do.
+template<class T>
+bool agree(T got, T expected, std::string &report, const char *call = "") {
+    if (got == expected) return true;
+    report = std::string(call) + "returned " + describe(got) + ", expected " + describe(expected);
+    return false;
+}
+
+bool init_failed(std::string &report) {
+    report = "init failed";
+    return false;
+}
+
+levenshtein::Workspace workspace(const Case &c, Scratch &scratch) {
+    return {scratch.workspace.data(), c.workspace};
+}
+
+template<bool transpositions>
+bool check_edit_dist(const Case &c, const Truth &truth, Scratch &scratch, std::string &report) {
+    const long long got = transpositions ? levenshtein::edit_dist_t(c.subject, c.query, workspace(c, scratch))
+                                         : levenshtein::edit_dist(c.subject, c.query, workspace(c, scratch));
+    return agree<long long>(got, expect_unbounded(c.subject, c.query, truth.distance[transpositions], c.workspace, transpositions),
+                 report);
+}
+
+template<bool transpositions>
+bool check_bounded_edit_dist(const Case &c, const Truth &truth, Scratch &scratch, std::string &report) {
+    const long long got = transpositions
+                          ? levenshtein::bounded_edit_dist_t(c.subject, c.query, c.max, workspace(c, scratch))
+                          : levenshtein::bounded_edit_dist(c.subject, c.query, c.max, workspace(c, scratch));
+    return agree<long long>(got, expect_bounded(c.subject, c.query, truth.distance[transpositions], c.max, c.workspace,
+                                     transpositions), report);
+}
+
+bool check_similarity_t(const Case &c, const Truth &truth, Scratch &scratch, std::string &report) {
+    return agree(levenshtein::similarity_t(c.subject, c.query, c.similarity, workspace(c, scratch)),
+                 expect_similarity(c.subject, c.query, truth.distance[1], c.similarity, c.workspace), report);
+}
+
+template<bool transpositions>
+bool check_prepared(const Case &c, const Truth &truth, Scratch &scratch, std::string &report) {
+    const levenshtein::PreparedQuery prepared{c.query};
+    // The bit-parallel kernel doesn't use the workspace.
+    const int workspace_used = prepared.bit_parallel() ? std::numeric_limits<int>::max() : c.workspace;
+    return agree<long long>(prepared.distance<transpositions>(c.subject, c.max, workspace(c, scratch)),
+                 expect_bounded(c.subject, c.query, truth.distance[transpositions], c.max, workspace_used,
+                                transpositions), report);
+}
+
+template<bool transpositions>
+bool check_prefix_cache(const Case &c, const Truth &truth, Scratch &, std::string &report) {
+    levenshtein::PrefixCache<transpositions> cache;
+    // Not the conventions of the other kernels: an empty string is within the cutoff or not like
+    // any other, and a comparison too large for the cache returns `max + 1`.
+    auto expect = [](const std::string &subject, const std::string &query, int distance, int max) {
+        const std::size_t n = subject.length(), m = query.length();
+        if (std::max(n, m) - std::min(n, m) > static_cast<std::size_t>(max)) return max + 1;
+        if ((n + 1)*(m + 1) > std::size_t{1} << 22) return max + 1;
+        return std::min(distance, max + 1);
+    };
+    return agree<long long>(cache.distance(c.query, c.previous, c.previous_max),
+                 expect(c.previous, c.query, truth.previous[transpositions], c.previous_max), report,
+                 "on the previous subject ")
+           && agree<long long>(cache.distance(c.query, c.subject, c.max),
+                    expect(c.subject, c.query, truth.distance[transpositions], c.max), report);
+}
+
+template<bool transpositions>
+bool check_dispatch(const Case &c, const Truth &truth, Scratch &scratch, std::string &report) {
+    levenshtein::Dispatcher<transpositions> dispatcher;
+    // The bit-parallel kernels don't use the workspace.
+    auto expect = [&](const std::string &a, const std::string &b) {
+        const bool banded = dispatcher.choose(a, b, c.max) == levenshtein::DispatchKernel::banded;
+        return expect_bounded(a, b, truth.distance[transpositions], c.max,
+                              banded ? c.workspace : std::numeric_limits<int>::max(), transpositions);
+    };
+    if (!agree<long long>(dispatcher.distance(c.subject, c.query, c.max, workspace(c, scratch)),
+                          expect(c.subject, c.query), report, "without a constant query ")) {
+        return false;
+    }
+    if (!dispatcher.set_constant_query(c.query)) return init_failed(report);
+    if (!agree<long long>(dispatcher.distance(c.subject, c.query, c.max, workspace(c, scratch)),
+                          expect(c.subject, c.query), report, "with the query constant ")
+        || !agree<long long>(dispatcher.distance(c.query, c.subject, c.max, workspace(c, scratch)),
+                             expect(c.query, c.subject), report, "with the query constant and first ")) {
+        return false;
+    }
+    if constexpr (transpositions) {
+        const int  m      = static_cast<int>(std::max(c.subject.length(), c.query.length()));
+        const int  max    = levenshtein::similarity_to_max_edits(c.similarity, m);
+        const bool banded = m == 0
+                            || dispatcher.choose(c.subject, c.query, max) == levenshtein::DispatchKernel::banded;
+        return agree(dispatcher.similarity(c.subject, c.query, c.similarity, workspace(c, scratch)),
+                     expect_similarity(c.subject, c.query, truth.distance[1], c.similarity,
+                                       banded ? c.workspace : std::numeric_limits<int>::max()),
+                     report, "for the similarity ");
+    }
+    return true;
+}
+
+/// A UDF in a statement of its own: `init` with the query as a constant argument, as the
+/// server does for `f(name, 'query', k)`, then any number of rows, then `deinit`.
+class Statement {
+public:
+    enum class Limit { none, cutoff, similarity };
+
+    Statement(int (*init)(UDF_INIT *, UDF_ARGS *, char *), void (*deinit)(UDF_INIT *), Limit limit,
+              const std::string &query)
+        : deinit(deinit) {
+        std::memset(&args, 0, sizeof args);
+        std::memset(&initid, 0, sizeof initid);
+        types[0] = types[1] = STRING_RESULT;
+        types[2]  = limit == Limit::similarity ? REAL_RESULT : INT_RESULT;
+        values[1] = const_cast<char *>(query.data());
+        lengths[1] = query.length();
+        values[2] = limit == Limit::similarity ? reinterpret_cast<char *>(&similarity)
+                                               : reinterpret_cast<char *>(&cutoff);
+        args.arg_count = limit == Limit::none ? 2 : 3;
+        args.arg_type  = types;
+        args.args      = values;
+        args.lengths   = lengths;
+        char message[MYSQL_ERRMSG_SIZE];
+        initialized = init(&initid, &args, message) == 0;
+    }
+
+    ~Statement() {
+        if (initialized) deinit(&initid);
+    }
+
+    Statement(const Statement &) = delete;
+    Statement &operator=(const Statement &) = delete;
+
+    bool ok() const { return initialized; }
+
+    long long row(long long (*function)(UDF_INIT *, UDF_ARGS *, char *, char *), const std::string &subject,
+                  long long max = 0) {
+        set_subject(subject);
+        cutoff = max;
+        return function(&initid, &args, &is_null, &error);
+    }
+
+    double row(double (*function)(UDF_INIT *, UDF_ARGS *, char *, char *), const std::string &subject,
+               double minimum) {
+        set_subject(subject);
+        similarity = minimum;
+        return function(&initid, &args, &is_null, &error);
+    }
+
+private:
+    void set_subject(const std::string &subject) {
+        values[0]  = const_cast<char *>(subject.data());
+        lengths[0] = subject.length();
+    }
+
+    void (*deinit)(UDF_INIT *);
+    UDF_INIT      initid;
+    UDF_ARGS      args;
+    Item_result   types[3];
+    char         *values[3]  = {nullptr, nullptr, nullptr};
+    unsigned long lengths[3] = {0, 0, 0};
+    long long     cutoff     = 0;
+    double        similarity = 0;
+    char          is_null    = 0;
+    char          error      = 0;
+    bool          initialized;
+};
+
+// The UDFs return 0 when their buffer is too small, and clamp the cutoff to its size.
+
+long long udf_result(int expected) {
+    return expected == BUFFER_EXCEEDED ? 0 : expected;
+}
+
+template<bool transpositions>
+bool check_edit_dist_udf(const Case &c, const Truth &truth, Scratch &, std::string &report) {
+    Statement statement{transpositions ? &edit_dist_t_init : &edit_dist_init,
+                        transpositions ? &edit_dist_t_deinit : &edit_dist_deinit, Statement::Limit::none, c.query};
+    if (!statement.ok()) return init_failed(report);
+    return agree<long long>(statement.row(transpositions ? &edit_dist_t : &edit_dist, c.subject),
+                 udf_result(expect_unbounded(c.subject, c.query, truth.distance[transpositions], DAMLEV_MAX_EDIT_DIST,
+                                             transpositions)), report);
+}
+
+template<bool transpositions>
+bool check_bounded_edit_dist_udf(const Case &c, const Truth &truth, Scratch &, std::string &report) {
+    Statement statement{transpositions ? &bounded_edit_dist_t_init : &bounded_edit_dist_init,
+                        transpositions ? &bounded_edit_dist_t_deinit : &bounded_edit_dist_deinit,
+                        Statement::Limit::cutoff, c.query};
+    if (!statement.ok()) return init_failed(report);
+    const int max = std::min(c.max, DAMLEV_MAX_EDIT_DIST);
+    return agree<long long>(statement.row(transpositions ? &bounded_edit_dist_t : &bounded_edit_dist, c.subject, c.max),
+                 udf_result(expect_bounded(c.subject, c.query, truth.distance[transpositions], max,
+                                           DAMLEV_MAX_EDIT_DIST, transpositions)), report);
+}
+
+bool check_similarity_t_udf(const Case &c, const Truth &truth, Scratch &, std::string &report) {
+    Statement statement{&similarity_t_init, &similarity_t_deinit, Statement::Limit::similarity, c.query};
+    if (!statement.ok()) return init_failed(report);
+    const double expected = expect_similarity(c.subject, c.query, truth.distance[1], c.similarity, DAMLEV_MAX_EDIT_DIST);
+    return agree(statement.row(&similarity_t, c.subject, c.similarity), expected == BUFFER_EXCEEDED ? 0.0 : expected,
+                 report);
+}
+
+/// `min_edit_dist(_t)` on the previous subject and then the subject. The bound starts at the
+/// buffer size and drops to each distance within it. Where the buffer is too small, the prefix
+/// cache may still answer, so either answer is right.
+template<bool transpositions>
+bool check_min_edit_dist(const Case &c, const Truth &truth, Scratch &, std::string &report) {
+    Statement statement{transpositions ? &min_edit_dist_t_init : &min_edit_dist_init,
+                        transpositions ? &min_edit_dist_t_deinit : &min_edit_dist_deinit,
+                        Statement::Limit::cutoff, c.query};
+    if (!statement.ok()) return init_failed(report);
+
+    int bound = DAMLEV_MAX_EDIT_DIST;
+    const struct { const std::string &subject; int max; int distance; const char *call; } rows[] = {
+        {c.previous, c.previous_max, truth.previous[transpositions], "on the previous subject "},
+        {c.subject,  c.max,          truth.distance[transpositions], ""},
+    };
+    for (const auto &row: rows) {
+        const int max      = std::min(row.max, bound);
+        const int expected = expect_bounded(row.subject, c.query, row.distance, max, DAMLEV_MAX_EDIT_DIST,
+                                            transpositions);
+        const long long got = statement.row(transpositions ? &min_edit_dist_t : &min_edit_dist, row.subject, row.max);
+        if (expected == BUFFER_EXCEEDED) {
+            const int answered = std::min(row.distance, max + 1);
+            // Which one it was decides the bound for the next row, unless they are the same.
+            if (got != 0 && got != answered) return agree<long long>(got, answered, report, row.call);
+            if (answered == 0) return true;
+            if (got == 0) continue;
+        } else if (!agree<long long>(got, expected, report, row.call)) {
+            return false;
+        }
+        if (got <= max) bound = static_cast<int>(got);
+    }
+    return true;
+}
+
+/// `min_similarity_t` on the previous subject and then the subject. The minimum starts at 0
+/// and rises to each similarity above it.
+bool check_min_similarity_t(const Case &c, const Truth &truth, Scratch &, std::string &report) {
+    Statement statement{&min_similarity_t_init, &min_similarity_t_deinit, Statement::Limit::similarity, c.query};
+    if (!statement.ok()) return init_failed(report);
+
+    double minimum = 0.0;
+    const struct { const std::string &subject; int distance; const char *call; } rows[] = {
+        {c.previous, truth.previous[1], "on the previous subject "},
+        {c.subject,  truth.distance[1], ""},
+    };
+    for (const auto &row: rows) {
+        const double similarity = std::max(c.similarity, minimum);
+        const double expected   = expect_similarity(row.subject, c.query, row.distance, similarity, DAMLEV_MAX_EDIT_DIST);
+        const double got        = statement.row(&min_similarity_t, row.subject, c.similarity);
+        if (!agree(got, expected == BUFFER_EXCEEDED ? 0.0 : expected, report, row.call)) return false;
+        if (expected != BUFFER_EXCEEDED) minimum = std::max(similarity, got);
+    }
+    return true;
+}
+
+const std::vector<Kernel> &all_kernels() {
+    static const std::vector<Kernel> kernels = {
+        {"edit_dist",               &check_edit_dist<false>,             false},
+        {"edit_dist_t",             &check_edit_dist<true>,              false},
+        {"bounded_edit_dist",       &check_bounded_edit_dist<false>,     false},
+        {"bounded_edit_dist_t",     &check_bounded_edit_dist<true>,      false},
+        {"similarity_t",            &check_similarity_t,                 false},
+        {"prepared",                &check_prepared<false>,              false},
+        {"prepared_t",              &check_prepared<true>,               false},
+        {"prefix_cache",            &check_prefix_cache<false>,          true},
+        {"prefix_cache_t",          &check_prefix_cache<true>,           true},
+        {"dispatch",                &check_dispatch<false>,              false},
+        {"dispatch_t",              &check_dispatch<true>,               false},
+        {"edit_dist_udf",           &check_edit_dist_udf<false>,         false},
+        {"edit_dist_t_udf",         &check_edit_dist_udf<true>,          false},
+        {"bounded_edit_dist_udf",   &check_bounded_edit_dist_udf<false>, false},
+        {"bounded_edit_dist_t_udf", &check_bounded_edit_dist_udf<true>,  false},
+        {"similarity_t_udf",        &check_similarity_t_udf,             false},
+        {"min_edit_dist",           &check_min_edit_dist<false>,         true},
+        {"min_edit_dist_t",         &check_min_edit_dist<true>,          true},
+        {"min_similarity_t",        &check_min_similarity_t,             true},
+    };
+    return kernels;
+}
+
+// endregion Kernels
+
+// region Shrinking
+
+bool fails(const Kernel &kernel, const Case &c, Scratch &scratch, std::string &report) {
+    return !kernel.check(c, find_truth(c, scratch.reference, kernel.stateful), scratch, report);
+}
+
+/// Smaller versions of `c`, roughly the most promising first: chunks of the strings deleted, from
+/// all the strings at once and from each alone, then characters replaced with `a` or `b`
+/// everywhere, or with `a` in one place, then lower cutoffs.
+std::vector<Case> simplifications(const Case &c, bool stateful) {
+    std::vector<std::string Case::*> strings = {&Case::subject, &Case::query};
+    if (stateful) strings.push_back(&Case::previous);
+    std::vector<Case> smaller;
+
+    std::size_t longest = 0;
+    for (auto field: strings) longest = std::max(longest, (c.*field).length());
+    for (std::size_t chunk = longest; chunk > 0; chunk /= 2) {
+        for (std::size_t at = 0; at < longest; at += chunk) {
+            // The same characters from every string, counting from the start and from the end,
+            // which keeps what the strings share lined up. Then from each string alone.
+            for (bool from_end: {false, true}) {
+                Case candidate = c;
+                for (auto field: strings) {
+                    std::string &s = candidate.*field;
+                    if (at >= s.length()) continue;
+                    s.erase(from_end ? s.length() - std::min(s.length(), at + chunk) : at, std::min(chunk, s.length() - at));
+                }
+                smaller.push_back(std::move(candidate));
+            }
+            for (auto field: strings) {
+                if (at >= (c.*field).length()) continue;
+                Case candidate = c;
+                (candidate.*field).erase(at, chunk);
+                smaller.push_back(std::move(candidate));
+            }
+        }
+    }
+
+    for (char to: {'a', 'b'}) {
+        for (int ch = to + 1; ch < 256; ch++) {
+            bool used = false;
+            Case candidate = c;
+            for (auto field: strings) {
+                for (char &x: candidate.*field) {
+                    if (static_cast<unsigned char>(x) == ch) {
+                        x    = to;
+                        used = true;
+                    }
+                }
+            }
+            if (used) smaller.push_back(std::move(candidate));
+        }
+    }
+    for (auto field: strings) {
+        for (std::size_t at = 0; at < (c.*field).length(); at++) {
+            if (static_cast<unsigned char>((c.*field)[at]) <= 'a') continue;
+            Case candidate = c;
+            (candidate.*field)[at] = 'a';
+            smaller.push_back(std::move(candidate));
+        }
+    }
+
+    for (int max = 0; max < c.max; max++) {
+        Case candidate = c;
+        candidate.max = max;
+        smaller.push_back(std::move(candidate));
+    }
+    for (int max = 0; stateful && max < c.previous_max; max++) {
+        Case candidate = c;
+        candidate.previous_max = max;
+        smaller.push_back(std::move(candidate));
+    }
+    return smaller;
+}
+
+/// Replaces `c` with the smallest case it can find on which `kernel` still fails, one
+/// simplification at a time, and sets `report` to how it fails on that one.
+void shrink(const Kernel &kernel, Case &c, Scratch &scratch, std::string &report) {
+    if (!kernel.stateful) {
+        // Only the stateful kernels look at the previous subject, so it is no part of the case.
+        c.previous.clear();
+        c.previous_max = 0;
+    }
+    for (bool progress = true; progress;) {
+        progress = false;
+        for (Case &candidate: simplifications(c, kernel.stateful)) {
+            std::string candidate_report;
+            if (fails(kernel, candidate, scratch, candidate_report)) {
+                c        = std::move(candidate);
+                report   = std::move(candidate_report);
+                progress = true;
+                break;
+            }
+        }
+    }
+}
+
+// endregion Shrinking
+
+// region Input and output
+
+/// `s` as a C string literal.
+std::string quoted(const std::string &s) {
+    std::string out = "\"";
+    for (unsigned char ch: s) {
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += static_cast<char>(ch);
+        } else if (ch >= 0x20 && ch < 0x7f) {
+            out += static_cast<char>(ch);
+        } else {
+            char escape[8];
+            std::snprintf(escape, sizeof escape, "\\%03o", ch); // Octal, which stops after three digits
+            out += escape;
+        }
+    }
+    return out + "\"";
+}
+
+void print_case(const Kernel &kernel, const Case &c, const std::string &report) {
+    std::printf("    subject    %s (%zu characters)\n", quoted(c.subject).c_str(), c.subject.length());
+    std::printf("    query      %s (%zu characters)\n", quoted(c.query).c_str(), c.query.length());
+    std::printf("    max        %d\n", c.max);
+    std::printf("    similarity %.17g\n", c.similarity);
+    std::printf("    workspace  %d ints\n", c.workspace);
+    if (kernel.stateful) {
+        std::printf("    previous   %s (%zu characters), max %d\n", quoted(c.previous).c_str(), c.previous.length(),
+                    c.previous_max);
+    }
+    std::printf("    %s\n", report.c_str());
+}
+
+void print_usage(FILE *out) {
+    std::fputs("Usage: difffuzz [--kernels NAME,...] [--threads N] [--seconds S] [--cases N] [--max-length L]\n"
+               "                [--seed S]\n"
+               "Check every kernel against the textbook algorithm on generated pairs of strings, and shrink\n"
+               "the first disagreement to a minimal case.\n", out);
+}
+
+std::vector<std::string> split(const char *text) {
+    std::vector<std::string> items;
+    std::string list = text;
+    for (std::size_t start = 0; start <= list.length();) {
+        std::size_t comma = std::min(list.find(',', start), list.length());
+        items.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+bool parse_number(const char *text, double &value) {
+    char *end;
+    value = std::strtod(text, &end);
+    return end != text && *end == '\0' && value >= 0;
+}
+
+bool parse_arguments(int argc, char *argv[], Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if (argument == "-h" || argument == "--help") {
+            print_usage(stdout);
+            std::exit(0);
+        }
+        if (i + 1 >= argc) return false;
+        const char *value = argv[++i];
+        double number = 0;
+        bool ok = argument == "--kernels" || parse_number(value, number);
+        if (argument == "--kernels") {
+            options.kernels = split(value);
+        } else if (argument == "--threads") {
+            options.threads = static_cast<unsigned>(number);
+        } else if (argument == "--seconds") {
+            options.seconds = number;
+        } else if (argument == "--cases") {
+            options.cases = static_cast<unsigned long long>(number);
+        } else if (argument == "--max-length") {
+            options.max_length = static_cast<int>(std::min(number, 1e6));
+        } else if (argument == "--seed") {
+            options.seed = static_cast<unsigned>(number);
+        } else {
+            return false;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// endregion Input and output
+
+/// The first disagreement of any thread.
+struct Failure {
+    std::mutex         mutex;
+    const Kernel      *kernel = nullptr;
+    Case               c;
+    std::string        report;
+    unsigned           thread = 0;
+    unsigned long long index  = 0;
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parse_arguments(argc, argv, options)) {
+        print_usage(stderr);
+        return 2;
+    }
+
+    std::vector<const Kernel *> kernels;
+    for (const auto &kernel: all_kernels()) {
+        if (options.kernels.empty()
+            || std::find(options.kernels.begin(), options.kernels.end(), kernel.name) != options.kernels.end()) {
+            kernels.push_back(&kernel);
+        }
+    }
+    for (const auto &name: options.kernels) {
+        bool known = std::any_of(all_kernels().begin(), all_kernels().end(),
+                                 [&](const Kernel &kernel) { return name == kernel.name; });
+        if (!known) {
+            std::fprintf(stderr, "difffuzz: unknown kernel '%s'\n", name.c_str());
+            return 2;
+        }
+    }
+    const bool stateful = std::any_of(kernels.begin(), kernels.end(), [](const Kernel *k) { return k->stateful; });
+
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    const int max_workspace = levenshtein::workspace_size(static_cast<std::size_t>(options.max_length), true);
+
+    std::atomic<bool>               stop{false};
+    std::atomic<unsigned long long> cases{0};
+    Failure                         failure;
+
+    auto fuzz = [&](unsigned thread) {
+        Generator generator{options.seed, thread, options.max_length, max_workspace};
+        Scratch   scratch;
+        scratch.workspace.resize(static_cast<std::size_t>(max_workspace));
+        std::string report;
+        // The shared counter is updated in batches, so the threads don't fight over its cache line.
+        constexpr unsigned long long BATCH = 256;
+        unsigned long long index = 0;
+        for (; !stop.load(std::memory_order_relaxed); index++) {
+            if (index % BATCH == 0 && index > 0) {
+                unsigned long long total = cases.fetch_add(BATCH, std::memory_order_relaxed) + BATCH;
+                if (options.cases && total >= options.cases) stop = true;
+            }
+            const Case  c     = generator.next();
+            const Truth truth = find_truth(c, scratch.reference, stateful);
+            for (const Kernel *kernel: kernels) {
+                if (kernel->check(c, truth, scratch, report)) continue;
+                std::lock_guard<std::mutex> lock{failure.mutex};
+                if (!failure.kernel) {
+                    failure.kernel = kernel;
+                    failure.c      = c;
+                    failure.report = report;
+                    failure.thread = thread;
+                    failure.index  = index;
+                }
+                stop = true;
+                break;
+            }
+        }
+        cases.fetch_add(index % BATCH, std::memory_order_relaxed);
+    };
+
+    std::printf("Checking %zu kernels on %u threads\n", kernels.size(), threads);
+    std::fflush(stdout);
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) pool.emplace_back(fuzz, t);
+    for (double next_report = 10; !stop;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (options.seconds > 0 && elapsed >= options.seconds) stop = true;
+        if (elapsed >= next_report) {
+            std::printf("%8.0fs %16llu cases\n", elapsed, cases.load());
+            std::fflush(stdout);
+            next_report += 10;
+        }
+    }
+    for (auto &thread: pool) thread.join();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double total = static_cast<double>(cases.load());
+    std::printf("%.0f cases, %.0f kernel calls in %.1fs: %.0f cases/s, %.2f billion calls/hour\n", total,
+                total*static_cast<double>(kernels.size()), elapsed, total/elapsed,
+                total*static_cast<double>(kernels.size())/elapsed*3600/1e9);
+
+    if (!failure.kernel) return 0;
+    std::printf("\n%s disagrees with the reference on case %llu of thread %u:\n", failure.kernel->name, failure.index,
+                failure.thread);
+    print_case(*failure.kernel, failure.c, failure.report);
+    Scratch scratch;
+    scratch.workspace.resize(static_cast<std::size_t>(max_workspace));
+    shrink(*failure.kernel, failure.c, scratch, failure.report);
+    std::printf("\nShrunk to:\n");
+    print_case(*failure.kernel, failure.c, failure.report);
+    return 1;
+}
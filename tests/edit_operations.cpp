@@ -138,16 +138,20 @@ If the list is empty, an empty string is returned.
 @param wordList A vector of strings from which to select a random string.
 @return A random string selected from the wordList, or an empty string if the list is empty.
 */
-std::string getUniformRandomString(const std::vector<std::string>& wordList) {
+std::string getUniformRandomString(const std::vector<std::string_view>& wordList) {
     if (wordList.empty()) return "";
     int index = getRandomInt(0, wordList.size() - 1);
-    return wordList[index];
+    return std::string{wordList[index]};
 }
 
 /// Generate a random letter based on letter frequencies in written English.
 char getRandomLetter() {
+    return getRandomLetter(gen);
+}
+
+char getRandomLetter(std::mt19937 &rng) {
     std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    double randomValue = distribution(gen);
+    double randomValue = distribution(rng);
 
     for (std::size_t i = 0; i < 26; ++i) {
         if (randomValue < cumulativeFrequencies[i]) {
@@ -161,18 +165,22 @@ char getRandomLetter() {
 /// Generate a random string of the given length based on letter
 /// frequencies in written English.
 std::string generateRandomString(int length, int lower_bound) {
+    return generateRandomString(length, lower_bound, gen);
+}
+
+std::string generateRandomString(int length, int lower_bound, std::mt19937 &rng) {
     // If the user is giving a range of lengths instead of a single length...
     if (lower_bound >= 0) {
         // ...then randomly choose a length in that range.
         std::uniform_int_distribution<int> distribution(lower_bound, length);
-        length = distribution(gen);
+        length = distribution(rng);
     }
 
     std::string result;
     result.reserve(length);
 
     for (int i = 0; i < length; ++i) {
-        result += getRandomLetter();
+        result += getRandomLetter(rng);
     }
     return result;
 }
@@ -7,6 +7,7 @@ Utility functions to apply random edits to a string in place.
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <random>
 
@@ -72,17 +73,22 @@ If the list is empty, an empty string is returned.
 @param wordList A vector of strings from which to select a random string.
 @return A random string selected from the wordList, or an empty string if the list is empty.
 */
-std::string getUniformRandomString(const std::vector<std::string>& wordList);
+std::string getUniformRandomString(const std::vector<std::string_view>& wordList);
 
 /// Generate a random string of the given length based on letter
 /// frequencies in written English.
 std::string generateRandomString(int length, int lower_bound=-1);
 
+/// `generateRandomString()` drawing from `rng` instead of the global `gen`, for generating
+/// strings on several threads at once.
+std::string generateRandomString(int length, int lower_bound, std::mt19937 &rng);
+
 /// Only return 0 for empty strings. Otherwise, return at least 1.
 int getRandomEditCount(const std::string& str, int maximum_edits);
 
 /// Generate a random letter based on letter frequencies in written English.
 char getRandomLetter();
+char getRandomLetter(std::mt19937 &rng);
 
 /// Insert a string into another string at a random location
 std::string randomlyInsertString(const std::string& base, const std::string& to_insert);
@@ -0,0 +1,313 @@
+/*!
+
+Realistic data for the benchmarks. See `error_models.hpp`.
+
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <tuple>
+
+#include "error_models.hpp"
+
+namespace {
+
+const std::string LETTERS = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+/// A random integer in the closed interval [min, max].
+int random_int(int min, int max, std::mt19937 &rng) {
+    return std::uniform_int_distribution<int>(min, max)(rng);
+}
+
+char random_letter(std::mt19937 &rng) {
+    return LETTERS[static_cast<std::size_t>(random_int(0, static_cast<int>(LETTERS.size()) - 1, rng))];
+}
+
+/// Picks an index of `cumulative`, a running sum of weights, in proportion to the weights.
+std::size_t pick_weighted(const std::vector<double> &cumulative, std::mt19937 &rng) {
+    double value = std::uniform_real_distribution<double>(0.0, cumulative.back())(rng);
+    auto   it    = std::upper_bound(cumulative.begin(), cumulative.end(), value);
+    return static_cast<std::size_t>(std::min(it - cumulative.begin(), static_cast<std::ptrdiff_t>(cumulative.size()) - 1));
+}
+
+/// One edit of the uniform model.
+void uniform_edit(std::string &text, std::mt19937 &rng) {
+    const int length = static_cast<int>(text.length());
+    switch (random_int(0, 3, rng)) {
+        case 0:
+            if (length > 0) text.erase(static_cast<std::size_t>(random_int(0, length - 1, rng)), 1);
+            break;
+        case 1:
+            text.insert(static_cast<std::size_t>(random_int(0, length, rng)), 1, random_letter(rng));
+            break;
+        case 2:
+            if (length > 0) text[static_cast<std::size_t>(random_int(0, length - 1, rng))] = random_letter(rng);
+            break;
+        default:
+            if (length > 1) {
+                std::size_t position = static_cast<std::size_t>(random_int(0, length - 2, rng));
+                std::swap(text[position], text[position + 1]);
+            }
+    }
+}
+
+/// A uniform substitution, the fallback of the other models.
+void substitute_any(std::string &text, std::mt19937 &rng) {
+    if (text.empty()) return;
+    text[static_cast<std::size_t>(random_int(0, static_cast<int>(text.length()) - 1, rng))] = random_letter(rng);
+}
+
+struct Confusion {
+    const char *read;  // What is on the page
+    const char *as;    // What OCR reads
+    double      weight;
+};
+
+const Confusion OCR_CONFUSIONS[] = {
+    {"m", "rn", 4}, {"rn", "m", 4}, {"l", "1", 3}, {"1", "l", 2}, {"l", "I", 2}, {"I", "l", 2},
+    {"O", "0", 2},  {"0", "O", 2},  {"o", "0", 1}, {"d", "cl", 2}, {"cl", "d", 2}, {"w", "vv", 1},
+    {"vv", "w", 1}, {"e", "c", 2},  {"c", "e", 2}, {"h", "b", 1}, {"b", "h", 1},  {"n", "u", 1},
+    {"u", "n", 1},  {"n", "ri", 1}, {"ri", "n", 1}, {"h", "li", 1}, {"i", "l", 2},  {"f", "t", 1},
+    {"t", "f", 1},  {"a", "o", 1},  {"S", "5", 1}, {"5", "S", 1}, {"B", "8", 1},  {"8", "B", 1},
+    {"g", "q", 1},  {" ", "", 2},   {".", ",", 1},
+};
+
+const char *const KEYBOARD_ROWS[] = {"1234567890-=", "qwertyuiop[]", "asdfghjkl;'", "zxcvbnm,./"};
+
+/// The keys next to `key` on a QWERTY keyboard: either side, and the two that touch it in the
+/// rows above and below, which are staggered.
+std::string neighbors(char key) {
+    const char lower = static_cast<char>(std::tolower(static_cast<unsigned char>(key)));
+    std::string result;
+    for (int row = 0; row < 4; row++) {
+        const char *position = std::strchr(KEYBOARD_ROWS[row], lower);
+        if (lower == '\0' || position == nullptr) continue;
+        const int column = static_cast<int>(position - KEYBOARD_ROWS[row]);
+        auto add = [&](int r, int c) {
+            if (r < 0 || r > 3 || c < 0 || c >= static_cast<int>(std::strlen(KEYBOARD_ROWS[r]))) return;
+            char neighbor = KEYBOARD_ROWS[r][c];
+            result.push_back(std::isupper(static_cast<unsigned char>(key))
+                             ? static_cast<char>(std::toupper(static_cast<unsigned char>(neighbor))) : neighbor);
+        };
+        add(row, column - 1);
+        add(row, column + 1);
+        add(row - 1, column);
+        add(row - 1, column + 1);
+        add(row + 1, column - 1);
+        add(row + 1, column);
+        break;
+    }
+    return result;
+}
+
+} // namespace
+
+std::string UniformErrors::apply(std::string_view text, int edits, std::mt19937 &rng) const {
+    std::string result(text);
+    for (int e = 0; e < edits && !result.empty(); e++) uniform_edit(result, rng);
+    return result;
+}
+
+std::string OcrErrors::apply(std::string_view text, int edits, std::mt19937 &rng) const {
+    std::string result(text);
+    std::vector<std::pair<const Confusion *, std::size_t>> candidates;
+    std::vector<double> cumulative;
+    for (int e = 0; e < edits; e++) {
+        candidates.clear();
+        cumulative.clear();
+        double sum = 0;
+        for (const Confusion &confusion: OCR_CONFUSIONS) {
+            const std::string_view read = confusion.read;
+            for (std::size_t at = result.find(read); at != std::string::npos; at = result.find(read, at + 1)) {
+                candidates.emplace_back(&confusion, at);
+                cumulative.push_back(sum += confusion.weight);
+            }
+        }
+        if (candidates.empty()) {
+            substitute_any(result, rng);
+            continue;
+        }
+        auto [confusion, at] = candidates[pick_weighted(cumulative, rng)];
+        result.replace(at, std::strlen(confusion->read), confusion->as);
+    }
+    return result;
+}
+
+std::string KeyboardErrors::apply(std::string_view text, int edits, std::mt19937 &rng) const {
+    std::string result(text);
+    for (int e = 0; e < edits && !result.empty(); e++) {
+        const int         length   = static_cast<int>(result.length());
+        const std::size_t position = static_cast<std::size_t>(random_int(0, length - 1, rng));
+        const std::string keys     = neighbors(result[position]);
+        const int         kind     = random_int(0, 99, rng);
+        if (kind < 55 || (kind < 70 && keys.empty())) {
+            // The key next to the intended one, instead of it
+            if (keys.empty()) {
+                substitute_any(result, rng);
+            } else {
+                result[position] = keys[static_cast<std::size_t>(random_int(0, static_cast<int>(keys.size()) - 1, rng))];
+            }
+        } else if (kind < 70) {
+            // The key next to the intended one as well as it, on either side
+            char extra = keys[static_cast<std::size_t>(random_int(0, static_cast<int>(keys.size()) - 1, rng))];
+            result.insert(position + static_cast<std::size_t>(random_int(0, 1, rng)), 1, extra);
+        } else if (kind < 85 || length < 2) {
+            result.erase(position, 1);
+        } else {
+            const std::size_t first = std::min(position, static_cast<std::size_t>(length - 2));
+            std::swap(result[first], result[first + 1]);
+        }
+    }
+    return result;
+}
+
+LearnedErrors::LearnedErrors(const std::vector<std::pair<std::string, std::string>> &pairs) {
+    std::map<std::tuple<Kind, char, char>, double> counts;
+    std::vector<int> table;
+
+    for (const auto &[correct, observed]: pairs) {
+        // The full optimal string alignment table, to trace the edits back through.
+        const std::size_t n = correct.length(), m = observed.length(), width = m + 1;
+        table.assign((n + 1)*width, 0);
+        auto at = [&](std::size_t i, std::size_t j) -> int & { return table[i*width + j]; };
+        for (std::size_t i = 0; i <= n; i++) at(i, 0) = static_cast<int>(i);
+        for (std::size_t j = 0; j <= m; j++) at(0, j) = static_cast<int>(j);
+        for (std::size_t i = 1; i <= n; i++) {
+            for (std::size_t j = 1; j <= m; j++) {
+                int cost = correct[i - 1] == observed[j - 1] ? 0 : 1;
+                at(i, j) = std::min({at(i - 1, j) + 1, at(i, j - 1) + 1, at(i - 1, j - 1) + cost});
+                if (i > 1 && j > 1 && correct[i - 1] == observed[j - 2] && correct[i - 2] == observed[j - 1]) {
+                    at(i, j) = std::min(at(i, j), at(i - 2, j - 2) + 1);
+                }
+            }
+        }
+
+        std::size_t i = n, j = m;
+        while (i > 0 || j > 0) {
+            const int here = at(i, j);
+            if (i > 0 && j > 0 && correct[i - 1] == observed[j - 1] && here == at(i - 1, j - 1)) {
+                i--, j--;
+            } else if (i > 0 && j > 0 && here == at(i - 1, j - 1) + 1) {
+                counts[{Kind::substitution, correct[i - 1], observed[j - 1]}]++;
+                i--, j--;
+            } else if (i > 1 && j > 1 && correct[i - 1] == observed[j - 2] && correct[i - 2] == observed[j - 1]
+                       && here == at(i - 2, j - 2) + 1) {
+                counts[{Kind::transposition, correct[i - 2], correct[i - 1]}]++;
+                i -= 2, j -= 2;
+            } else if (j > 0 && here == at(i, j - 1) + 1) {
+                counts[{Kind::insertion, '\0', observed[j - 1]}]++;
+                j--;
+            } else {
+                counts[{Kind::deletion, correct[i - 1], '\0'}]++;
+                i--;
+            }
+        }
+    }
+
+    double sum = 0;
+    for (const auto &[key, count]: counts) {
+        edits.push_back({std::get<0>(key), std::get<1>(key), std::get<2>(key), count});
+        cumulative.push_back(sum += count);
+        total += static_cast<std::size_t>(count);
+    }
+}
+
+std::string LearnedErrors::apply(std::string_view text, int count, std::mt19937 &rng) const {
+    // How many times to draw an edit that doesn't fit the string before giving up on this one.
+    constexpr int TRIES = 16;
+
+    std::string result(text);
+    std::vector<std::size_t> positions;
+    for (int e = 0; e < count; e++) {
+        bool applied = false;
+        for (int attempt = 0; attempt < TRIES && !edits.empty() && !applied; attempt++) {
+            const Edit &edit = edits[pick_weighted(cumulative, rng)];
+            if (edit.kind == Kind::insertion) {
+                result.insert(static_cast<std::size_t>(random_int(0, static_cast<int>(result.length()), rng)), 1, edit.to);
+                applied = true;
+                continue;
+            }
+            positions.clear();
+            for (std::size_t p = 0; p < result.length(); p++) {
+                if (result[p] != edit.from) continue;
+                if (edit.kind == Kind::transposition && (p + 1 >= result.length() || result[p + 1] != edit.to)) continue;
+                positions.push_back(p);
+            }
+            if (positions.empty()) continue;
+            std::size_t p = positions[static_cast<std::size_t>(random_int(0, static_cast<int>(positions.size()) - 1, rng))];
+            switch (edit.kind) {
+                case Kind::substitution:  result[p] = edit.to; break;
+                case Kind::deletion:      result.erase(p, 1); break;
+                case Kind::transposition: std::swap(result[p], result[p + 1]); break;
+                case Kind::insertion:     break;
+            }
+            applied = true;
+        }
+        if (!applied) substitute_any(result, rng);
+    }
+    return result;
+}
+
+std::unique_ptr<ErrorModel> make_error_model(const std::string &spec) {
+    if (spec == "uniform") return std::make_unique<UniformErrors>();
+    if (spec == "ocr") return std::make_unique<OcrErrors>();
+    if (spec == "keyboard") return std::make_unique<KeyboardErrors>();
+
+    const std::string prefix = "learned:";
+    if (spec.compare(0, prefix.size(), prefix) != 0) return nullptr;
+    std::ifstream file(spec.substr(prefix.size()));
+    if (!file) return nullptr;
+    std::vector<std::pair<std::string, std::string>> pairs;
+    for (std::string line; std::getline(file, line);) {
+        std::size_t tab = line.find('\t');
+        if (tab != std::string::npos) pairs.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+    }
+    return std::make_unique<LearnedErrors>(pairs);
+}
+
+ZipfSampler::ZipfSampler(std::size_t n, double exponent, std::mt19937 &rng): index_of_rank(n) {
+    double sum = 0;
+    cumulative.reserve(n);
+    for (std::size_t rank = 0; rank < n; rank++) {
+        cumulative.push_back(sum += 1.0/std::pow(static_cast<double>(rank + 1), exponent));
+    }
+    std::iota(index_of_rank.begin(), index_of_rank.end(), std::size_t{0});
+    std::shuffle(index_of_rank.begin(), index_of_rank.end(), rng);
+}
+
+std::size_t ZipfSampler::operator()(std::mt19937 &rng) const {
+    return index_of_rank[pick_weighted(cumulative, rng)];
+}
+
+std::vector<std::string> draw_haystack(const std::vector<std::string_view> &words, int count, int min_length,
+                                       int max_length, std::mt19937 &rng) {
+    std::vector<std::string> haystack;
+    haystack.reserve(static_cast<std::size_t>(std::max(count, 0)));
+    const int last_word = static_cast<int>(words.size()) - 1;
+    for (int i = 0; i < count; i++) {
+        const std::size_t length = static_cast<std::size_t>(random_int(min_length, max_length, rng));
+        std::string text{words[static_cast<std::size_t>(random_int(0, last_word, rng))]};
+        while (text.length() < length) text.append(" ").append(words[static_cast<std::size_t>(random_int(0, last_word, rng))]);
+        text.resize(length);
+        haystack.push_back(std::move(text));
+    }
+    return haystack;
+}
+
+std::vector<std::string> sample_queries(const std::vector<std::string> &haystack, int count, double zipf_exponent,
+                                        const ErrorModel &model, int max_edits, int min_edits, std::mt19937 &rng) {
+    std::vector<std::string> queries;
+    if (haystack.empty()) return queries;
+    queries.reserve(static_cast<std::size_t>(std::max(count, 0)));
+    ZipfSampler sampler{haystack.size(), zipf_exponent, rng};
+    for (int i = 0; i < count; i++) {
+        int edits = min_edits >= 0 ? random_int(min_edits, max_edits, rng) : max_edits;
+        queries.push_back(model.apply(haystack[sampler(rng)], edits, rng));
+    }
+    return queries;
+}
@@ -0,0 +1,164 @@
+/*!
+
+Realistic data for the benchmarks: models of the errors real queries have, Zipfian sampling of
+queries over a haystack, and haystacks of varying length drawn from a word list.
+
+`apply_random_edits()` in `edit_operations.hpp` spreads insertions, deletions, substitutions, and
+transpositions of random letters evenly over a string. Real errors aren't like that. OCR confuses
+shapes (`rn` and `m`, `l` and `1`), typists hit the key next to the one they meant, and some
+queries are far more common than others. The distance a kernel sees, and so how early it can
+stop, depends on all of that. So here are `ErrorModel`s for each kind of error, one learned from
+pairs of correct and observed strings, and `sample_queries()`, which draws queries from a haystack
+with a Zipf distribution and puts errors in them.
+
+Everything here takes its random number generator as an argument, so that a benchmark seeded with
+a fixed value makes the same data every run.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// A kind of error to put into strings.
+class ErrorModel {
+public:
+    virtual ~ErrorModel() = default;
+
+    /// The name `make_error_model()` knows this model by.
+    virtual std::string name() const = 0;
+
+    /**
+    Applies `edits` errors to a copy of `text`.
+
+    An error is one event of the model, which is not always one edit: OCR reading `m` as `rn` is
+    two. Models fall back to a uniform substitution when nothing in `text` fits them.
+
+    @param text The string to put errors into.
+    @param edits The number of errors.
+    @param rng The source of randomness.
+    @return The string with the errors.
+    */
+    virtual std::string apply(std::string_view text, int edits, std::mt19937 &rng) const = 0;
+};
+
+/// Insertions, deletions, substitutions, and transpositions of random letters, evenly, as
+/// `apply_random_edits()` does.
+class UniformErrors: public ErrorModel {
+public:
+    std::string name() const override { return "uniform"; }
+    std::string apply(std::string_view text, int edits, std::mt19937 &rng) const override;
+};
+
+/// Characters and pairs of characters that OCR reads as others, like `rn` for `m`, `l` for `1`,
+/// `cl` for `d`, and a dropped space, weighted by how often they happen.
+class OcrErrors: public ErrorModel {
+public:
+    std::string name() const override { return "ocr"; }
+    std::string apply(std::string_view text, int edits, std::mt19937 &rng) const override;
+};
+
+/// Typing errors on a QWERTY keyboard: a key next to the intended one instead of it or as well as
+/// it, a key not pressed, and two keys pressed out of order.
+class KeyboardErrors: public ErrorModel {
+public:
+    std::string name() const override { return "keyboard"; }
+    std::string apply(std::string_view text, int edits, std::mt19937 &rng) const override;
+};
+
+/// Errors in the proportions found in pairs of correct and observed strings.
+class LearnedErrors: public ErrorModel {
+public:
+    /**
+    Learns the model from `pairs` of (correct, observed) strings.
+
+    Each pair is aligned with the optimal string alignment (Damerau-Levenshtein) distance, and
+    every edit of the alignment is counted: which character was substituted by which, which were
+    inserted and deleted, and which pairs were transposed. Errors are then drawn in proportion to
+    those counts.
+
+    @param pairs The aligned pairs.
+    */
+    explicit LearnedErrors(const std::vector<std::pair<std::string, std::string>> &pairs);
+
+    std::string name() const override { return "learned"; }
+    std::string apply(std::string_view text, int edits, std::mt19937 &rng) const override;
+
+    /// The number of edits learned. A model with none falls back to uniform substitutions.
+    std::size_t edit_count() const { return total; }
+
+private:
+    enum class Kind { substitution, insertion, deletion, transposition };
+
+    struct Edit {
+        Kind   kind;
+        char   from; // The character substituted or deleted, or the first of a transposed pair
+        char   to;   // The replacement, the character inserted, or the second of a transposed pair
+        double count;
+    };
+
+    std::vector<Edit>   edits;
+    std::vector<double> cumulative; // Of the counts, for sampling
+    std::size_t         total = 0;
+};
+
+/**
+Makes an error model from its name: `uniform`, `ocr`, `keyboard`, or `learned:FILE`, where `FILE`
+has one pair per line, the correct string and the observed one separated by a tab.
+
+@param spec The name of the model.
+@return The model, or null if `spec` is unknown or the file can't be read.
+*/
+std::unique_ptr<ErrorModel> make_error_model(const std::string &spec);
+
+/// Draws indices `0..n-1` with probability proportional to `1/(rank + 1)^exponent`, where the rank
+/// of each index is fixed by a shuffle at construction, so the popular items are spread over the
+/// haystack. An exponent of 0 is uniform; search logs are typically around 1.
+class ZipfSampler {
+public:
+    ZipfSampler(std::size_t n, double exponent, std::mt19937 &rng);
+
+    std::size_t operator()(std::mt19937 &rng) const;
+
+private:
+    std::vector<double>      cumulative;
+    std::vector<std::size_t> index_of_rank;
+};
+
+/**
+Draws a haystack of `count` strings from `words`, with lengths uniform in `[min_length, max_length]`.
+
+Each string is a random word, followed by more random words, separated by spaces, until it is
+long enough, and then cut to its length. So a haystack from a list of names can have strings much
+longer, or more evenly spread in length, than the names themselves.
+
+@param words The words to draw from. Must not be empty.
+@param count The number of strings.
+@param min_length The shortest string.
+@param max_length The longest string.
+@param rng The source of randomness.
+@return The haystack.
+*/
+std::vector<std::string> draw_haystack(const std::vector<std::string_view> &words, int count, int min_length,
+                                       int max_length, std::mt19937 &rng);
+
+/**
+Draws `count` queries from `haystack` with a Zipf distribution and puts errors into each.
+
+@param haystack The strings searched for.
+@param count The number of queries.
+@param zipf_exponent The exponent of the Zipf distribution; 0 for uniform.
+@param model The errors to put into the queries.
+@param max_edits The most errors in a query.
+@param min_edits The fewest errors in a query, or -1 for exactly `max_edits`.
+@param rng The source of randomness.
+@return The queries.
+*/
+std::vector<std::string> sample_queries(const std::vector<std::string> &haystack, int count, double zipf_exponent,
+                                        const ErrorModel &model, int max_edits, int min_edits, std::mt19937 &rng);
@@ -0,0 +1,421 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+`hostbench`: call the UDFs the way `mysqld` does, from many connections at once, and report how
+throughput and tail latency scale with the number of connections.
+
+Usage:
+
+    hostbench [options]
+
+Options (lists are comma separated):
+
+    --functions NAME,...  UDFs to run (default all; see below).
+    --connections N,...   Numbers of concurrent connections (default 1,2,4,8).
+    --statements N        Statements each connection runs (default 50).
+    --rows N              Rows each statement scans (default 2000).
+    --arguments KIND,...  constant, column, or both (default constant,column).
+    --cutoff K            The maximum distance of the bounded functions (default 2).
+    --similarity S        The minimum similarity of the similarity functions (default 0.8).
+    --errors MODEL        The errors in the queries, as for `make_error_model()` (default ocr).
+    --words FILE          The table, one row per line (default tests/taxanames).
+    --seed S              Seed for the queries and statement offsets (default 1).
+
+`benchmark` and `microbench` call each UDF on one thread with one `UDF_INIT`. The server does not:
+each connection runs its own statements, and for each statement calls `init` with its own
+`UDF_INIT`, the function once per row, and `deinit`. So this harness starts a thread per
+connection and has each run its statements at the same moment. A statement is
+
+    SELECT f(name, 'query', cutoff) FROM table LIMIT offset, rows
+
+with a query drawn from the table with a Zipf distribution and the errors of `--errors` put into
+it (see `error_models.hpp`), and a random offset. As in the server, a constant argument is
+already in `args->args` when `init` is called, and a column argument is a null pointer until the
+first row. With `--arguments column`, the query is passed as if it came from a column, so `init`
+doesn't see it; the rows are the same. The difference is what the functions gain from knowing
+the query up front, like the prefix cache of `min_edit_dist`.
+
+For each function, kind of argument, and number of connections, we print the aggregate
+throughput, the throughput per connection relative to that of the first number of connections,
+usually one (1.00 is perfect scaling), the 50th, 99th, and 99.9th percentile latency of a call as
+the host sees it, and the mean cost of `init` and `deinit` per statement. Calls are timed with the
+cycle counter of `latency.h` into a histogram per connection. Falling efficiency with latencies
+that don't grow means there are fewer cores than connections; falling efficiency with growing
+latencies means the connections are getting in each other's way, through the allocator in
+`init`, or through cache lines they share.
+
+The functions:
+
+    bounded_edit_dist, bounded_edit_dist_t, min_edit_dist, min_edit_dist_t, postgres, noop
+                                        With the cutoff.
+    edit_dist, edit_dist_t              With two arguments.
+    similarity_t, min_similarity_t      With the similarity.
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../src/common.h"
+#include "error_models.hpp"
+
+UDF_SIGNATURES(bounded_edit_dist)
+UDF_SIGNATURES(bounded_edit_dist_t)
+UDF_SIGNATURES(edit_dist)
+UDF_SIGNATURES(edit_dist_t)
+UDF_SIGNATURES(min_edit_dist)
+UDF_SIGNATURES(min_edit_dist_t)
+UDF_SIGNATURES(postgres)
+UDF_SIGNATURES(noop)
+UDF_SIGNATURES_TYPE(similarity_t, double)
+UDF_SIGNATURES_TYPE(min_similarity_t, double)
+
+namespace {
+
+struct Options {
+    std::vector<std::string> functions;   // Empty for all
+    std::vector<int>         connections = {1, 2, 4, 8};
+    std::vector<bool>        constant    = {true, false};
+    int                      statements  = 50;
+    int                      rows        = 2000;
+    long long                cutoff      = 2;
+    double                   similarity  = 0.8;
+    std::string              errors      = "ocr";
+    std::string              words       = TAXANAMES_PATH;
+    unsigned                 seed        = 1;
+};
+
+/// The third argument of a function, if it has one.
+enum class Limit { none, cutoff, similarity };
+
+struct Function {
+    const char *name;
+    Limit       limit;
+    int       (*init)(UDF_INIT *, UDF_ARGS *, char *);
+    long long (*integer)(UDF_INIT *, UDF_ARGS *, char *, char *);
+    double    (*real)(UDF_INIT *, UDF_ARGS *, char *, char *);
+    void      (*deinit)(UDF_INIT *);
+};
+
+const std::vector<Function> &all_functions() {
+    static const std::vector<Function> functions = {
+        {"bounded_edit_dist",   Limit::cutoff,     &bounded_edit_dist_init,   &bounded_edit_dist,   nullptr,
+         &bounded_edit_dist_deinit},
+        {"bounded_edit_dist_t", Limit::cutoff,     &bounded_edit_dist_t_init, &bounded_edit_dist_t, nullptr,
+         &bounded_edit_dist_t_deinit},
+        {"edit_dist",           Limit::none,       &edit_dist_init,           &edit_dist,           nullptr,
+         &edit_dist_deinit},
+        {"edit_dist_t",         Limit::none,       &edit_dist_t_init,         &edit_dist_t,         nullptr,
+         &edit_dist_t_deinit},
+        {"min_edit_dist",       Limit::cutoff,     &min_edit_dist_init,       &min_edit_dist,       nullptr,
+         &min_edit_dist_deinit},
+        {"min_edit_dist_t",     Limit::cutoff,     &min_edit_dist_t_init,     &min_edit_dist_t,     nullptr,
+         &min_edit_dist_t_deinit},
+        {"similarity_t",        Limit::similarity, &similarity_t_init,        nullptr,              &similarity_t,
+         &similarity_t_deinit},
+        {"min_similarity_t",    Limit::similarity, &min_similarity_t_init,    nullptr,              &min_similarity_t,
+         &min_similarity_t_deinit},
+        {"postgres",            Limit::cutoff,     &postgres_init,            &postgres,            nullptr,
+         &postgres_deinit},
+        {"noop",                Limit::cutoff,     &noop_init,                &noop,                nullptr,
+         &noop_deinit},
+    };
+    return functions;
+}
+
+/// What every connection reads: the table, and the query and offset of each statement.
+struct Workload {
+    std::vector<std::string> table;
+    std::vector<std::string> queries; // One per statement of a connection, shared by the connections
+    std::vector<std::size_t> offsets;
+};
+
+/// What one connection measured. Each connection fills its own, on its own stack, and hands it
+/// over when it is done, so that the harness itself shares no cache lines between connections.
+struct ConnectionResult {
+    runtime_stats::LatencyCounts calls;
+    std::uint64_t                init_cycles = 0;
+    std::uint64_t                statements  = 0;
+    std::uint64_t                failed      = 0;
+};
+
+// region Running
+
+/// One connection: its statements, one after another, each with its own `UDF_INIT`.
+void run_connection(const Function &function, const Options &options, bool constant, const Workload &workload,
+                    int connection, ConnectionResult &result) {
+    const unsigned argument_count = function.limit == Limit::none ? 2 : 3;
+    long long      cutoff         = options.cutoff;
+    double         similarity     = options.similarity;
+    Item_result    types[3]       = {STRING_RESULT, STRING_RESULT,
+                                     function.limit == Limit::similarity ? REAL_RESULT : INT_RESULT};
+    char          *values[3]      = {nullptr, nullptr, function.limit == Limit::similarity
+                                                       ? reinterpret_cast<char *>(&similarity)
+                                                       : reinterpret_cast<char *>(&cutoff)};
+    unsigned long  lengths[3]     = {0, 0, function.limit == Limit::similarity ? sizeof similarity : sizeof cutoff};
+    char           maybe_null[3]  = {1, 0, 0};
+    UDF_ARGS args;
+    std::memset(&args, 0, sizeof args);
+    args.arg_count  = argument_count;
+    args.arg_type   = types;
+    args.args       = values;
+    args.lengths    = lengths;
+    args.maybe_null = maybe_null;
+
+    ConnectionResult local;
+    char message[MYSQL_ERRMSG_SIZE];
+    char is_null = 0, error = 0;
+    const std::size_t table_size = workload.table.size();
+    for (int statement = 0; statement < options.statements; statement++) {
+        // Connections start at different statements, so they don't all search for the same query.
+        const std::size_t s     = (static_cast<std::size_t>(statement) + static_cast<std::size_t>(connection)*7919)
+                                  % workload.queries.size();
+        const std::string &query = workload.queries[s];
+
+        values[0]  = nullptr;
+        lengths[0] = 0;
+        values[1]  = constant ? const_cast<char *>(query.data()) : nullptr;
+        lengths[1] = constant ? query.length() : 0;
+
+        UDF_INIT initid;
+        std::memset(&initid, 0, sizeof initid);
+        std::uint64_t started = runtime_stats::read_cycles();
+        if (function.init(&initid, &args, message) != 0) {
+            local.failed++;
+            continue;
+        }
+        local.init_cycles += runtime_stats::read_cycles() - started;
+
+        values[1]  = const_cast<char *>(query.data());
+        lengths[1] = query.length();
+        for (int row = 0; row < options.rows; row++) {
+            const std::string &name = workload.table[(workload.offsets[s] + static_cast<std::size_t>(row)) % table_size];
+            values[0]  = const_cast<char *>(name.data());
+            lengths[0] = name.length();
+
+            std::uint64_t before = runtime_stats::read_cycles();
+            if (function.integer) {
+                function.integer(&initid, &args, &is_null, &error);
+            } else {
+                function.real(&initid, &args, &is_null, &error);
+            }
+            local.calls.buckets[runtime_stats::latency_bucket(runtime_stats::read_cycles() - before)]++;
+        }
+
+        started = runtime_stats::read_cycles();
+        function.deinit(&initid);
+        local.init_cycles += runtime_stats::read_cycles() - started;
+        local.statements++;
+    }
+    result = local;
+}
+
+/// The totals of one function, kind of argument, and number of connections.
+struct Run {
+    ConnectionResult total;
+    double           seconds = 0;
+};
+
+Run run(const Function &function, const Options &options, bool constant, const Workload &workload, int connections) {
+    std::vector<ConnectionResult> results(static_cast<std::size_t>(connections));
+    std::vector<std::thread>      threads;
+    std::atomic<int>              ready{0};
+    std::atomic<bool>             go{false};
+
+    for (int c = 0; c < connections; c++) {
+        threads.emplace_back([&, c]() {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            run_connection(function, options, constant, workload, c, results[static_cast<std::size_t>(c)]);
+        });
+    }
+    while (ready.load() < connections) std::this_thread::yield();
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &thread: threads) thread.join();
+
+    Run total;
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const auto &result: results) {
+        total.total.calls       += result.calls;
+        total.total.init_cycles += result.init_cycles;
+        total.total.statements  += result.statements;
+        total.total.failed      += result.failed;
+    }
+    return total;
+}
+
+// endregion Running
+
+// region Input and output
+
+void print_usage(FILE *out) {
+    std::fputs("Usage: hostbench [--functions NAME,...] [--connections N,...] [--statements N] [--rows N]\n"
+               "                 [--arguments constant,column] [--cutoff K] [--similarity S] [--errors MODEL]\n"
+               "                 [--words FILE] [--seed S]\n"
+               "Call the UDFs as the server does, from several connections at once, and report throughput\n"
+               "and tail latency by the number of connections.\n", out);
+}
+
+bool parse_int(const char *text, int &value) {
+    char *end;
+    long parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || parsed < 0 || parsed > (1L << 24)) return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+std::vector<std::string> split(const char *text) {
+    std::vector<std::string> items;
+    std::string list = text;
+    for (std::size_t start = 0; start <= list.length();) {
+        std::size_t comma = std::min(list.find(',', start), list.length());
+        items.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+bool parse_arguments(int argc, char *argv[], Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if (argument == "-h" || argument == "--help") {
+            print_usage(stdout);
+            std::exit(0);
+        }
+        if (i + 1 >= argc) return false;
+        const char *value = argv[++i];
+        bool ok = true;
+        if (argument == "--functions") {
+            options.functions = split(value);
+        } else if (argument == "--connections") {
+            options.connections.clear();
+            for (const auto &item: split(value)) {
+                int connections;
+                ok = ok && parse_int(item.c_str(), connections) && connections > 0;
+                options.connections.push_back(connections);
+            }
+        } else if (argument == "--arguments") {
+            options.constant.clear();
+            for (const auto &item: split(value)) {
+                ok = ok && (item == "constant" || item == "column");
+                options.constant.push_back(item == "constant");
+            }
+        } else if (argument == "--statements") {
+            ok = parse_int(value, options.statements) && options.statements > 0;
+        } else if (argument == "--rows") {
+            ok = parse_int(value, options.rows) && options.rows > 0;
+        } else if (argument == "--cutoff") {
+            int cutoff;
+            ok = parse_int(value, cutoff);
+            options.cutoff = cutoff;
+        } else if (argument == "--similarity") {
+            char *end;
+            options.similarity = std::strtod(value, &end);
+            ok = end != value && *end == '\0' && options.similarity >= 0 && options.similarity <= 1;
+        } else if (argument == "--errors") {
+            options.errors = value;
+        } else if (argument == "--words") {
+            options.words = value;
+        } else if (argument == "--seed") {
+            int seed;
+            ok = parse_int(value, seed);
+            options.seed = static_cast<unsigned>(seed);
+        } else {
+            return false;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// endregion Input and output
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parse_arguments(argc, argv, options)) {
+        print_usage(stderr);
+        return 2;
+    }
+
+    std::vector<const Function *> functions;
+    for (const auto &function: all_functions()) {
+        if (options.functions.empty()
+            || std::find(options.functions.begin(), options.functions.end(), function.name) != options.functions.end()) {
+            functions.push_back(&function);
+        }
+    }
+    for (const auto &name: options.functions) {
+        bool known = std::any_of(all_functions().begin(), all_functions().end(),
+                                 [&](const Function &function) { return name == function.name; });
+        if (!known) {
+            std::fprintf(stderr, "hostbench: unknown function '%s'\n", name.c_str());
+            return 2;
+        }
+    }
+
+    std::unique_ptr<ErrorModel> model = make_error_model(options.errors);
+    if (!model) {
+        std::fprintf(stderr, "hostbench: unknown error model or unreadable file '%s'\n", options.errors.c_str());
+        return 2;
+    }
+
+    Workload workload;
+    std::ifstream file(options.words);
+    for (std::string line; std::getline(file, line);) {
+        if (!line.empty()) workload.table.push_back(std::move(line));
+    }
+    if (workload.table.empty()) {
+        std::fprintf(stderr, "hostbench: no rows in '%s'\n", options.words.c_str());
+        return 2;
+    }
+    std::mt19937 rng{options.seed};
+    workload.queries = sample_queries(workload.table, options.statements, 1.0, *model, 2, 1, rng);
+    std::uniform_int_distribution<std::size_t> offset(0, workload.table.size() - 1);
+    for (int s = 0; s < options.statements; s++) workload.offsets.push_back(offset(rng));
+
+    const double ns_per_cycle = 1.0/runtime_stats::cycles_per_ns();
+    std::printf("%zu rows in the table; %d statements of %d rows per connection; %u hardware threads\n\n",
+                workload.table.size(), options.statements, options.rows, std::thread::hardware_concurrency());
+    std::printf("%-20s %-9s %5s %14s %10s %9s %9s %9s %12s\n", "function", "arguments", "conns", "calls/s",
+                "efficiency", "p50 ns", "p99 ns", "p99.9 ns", "init+deinit");
+    for (const Function *function: functions) {
+        for (bool constant: options.constant) {
+            double single = 0; // Throughput of one connection
+            for (int connections: options.connections) {
+                Run result = run(*function, options, constant, workload, connections);
+                if (result.total.failed) {
+                    std::fprintf(stderr, "hostbench: init of %s failed\n", function->name);
+                    return 1;
+                }
+                const double calls      = static_cast<double>(result.total.calls.count());
+                const double throughput = result.seconds > 0 ? calls/result.seconds : 0;
+                if (connections == options.connections.front()) single = throughput/connections;
+                std::printf("%-20s %-9s %5d %14.0f %10.2f %9.0f %9.0f %9.0f %10.0fns\n", function->name,
+                            constant ? "constant" : "column", connections, throughput,
+                            single > 0 ? throughput/(single*connections) : 0.0,
+                            static_cast<double>(result.total.calls.percentile(0.50))*ns_per_cycle,
+                            static_cast<double>(result.total.calls.percentile(0.99))*ns_per_cycle,
+                            static_cast<double>(result.total.calls.percentile(0.999))*ns_per_cycle,
+                            result.total.statements
+                            ? static_cast<double>(result.total.init_cycles)*ns_per_cycle
+                              /static_cast<double>(result.total.statements) : 0.0);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,748 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Tests for the standalone pieces under `src/levenshtein/`. Unlike `comparetests.cpp`, these do not
+go through the UDF calling convention and do not need `mysql.h`.
+
+*/
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "datasets.hpp"
+#include "edit_operations.hpp"
+#include "error_models.hpp"
+#include "word_list.hpp"
+#include "levenshtein/band_trace.h"
+#include "levenshtein/batch.h"
+#include "levenshtein/cluster.h"
+#include "levenshtein/dictionary.h"
+#include "levenshtein/parallel_search.h"
+#include "levenshtein/levenshtein.h"
+#include "levenshtein/lines.h"
+#include "levenshtein/prefix_cache.h"
+#include "levenshtein/similarity_join.h"
+
+using levenshtein::LengthPartitionedDictionary;
+
+/// The textbook full-matrix algorithm, used as the reference for everything else in this file.
+int reference_distance(std::string_view a, std::string_view b, bool transpositions) {
+    const int n = static_cast<int>(a.length());
+    const int m = static_cast<int>(b.length());
+    std::vector<std::vector<int>> dp(n + 1, std::vector<int>(m + 1, 0));
+    for (int i = 0; i <= n; i++) dp[i][0] = i;
+    for (int j = 0; j <= m; j++) dp[0][j] = j;
+    for (int i = 1; i <= n; i++) {
+        for (int j = 1; j <= m; j++) {
+            int cost = (a[i - 1] == b[j - 1]) ? 0 : 1;
+            dp[i][j] = std::min({dp[i - 1][j] + 1, dp[i][j - 1] + 1, dp[i - 1][j - 1] + cost});
+            if (transpositions && i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) {
+                dp[i][j] = std::min(dp[i][j], dp[i - 2][j - 2] + cost);
+            }
+        }
+    }
+    return dp[n][m];
+}
+
+/// A sorted list of words with long shared prefixes, like a dictionary scanned `ORDER BY name`.
+std::vector<std::string> sorted_word_list(int count) {
+    std::vector<std::string> words;
+    std::string stem = generateRandomString(12);
+    for (int i = 0; i < count; i++) {
+        if (i % 25 == 0) stem = generateRandomString(12);
+        words.push_back(stem + apply_random_edits(generateRandomString(6, 1), 2));
+    }
+    std::sort(words.begin(), words.end());
+    return words;
+}
+
+TEST(LengthPartitionedDictionary, PreservesEntriesAndIds) {
+    std::vector<std::string> words{"gamma", "be", "", "alpha", "x", "delta", "epsilon", "pi"};
+    LengthPartitionedDictionary dictionary{words};
+
+    ASSERT_EQ(dictionary.size(), words.size());
+    EXPECT_EQ(dictionary.max_length(), 7);
+    for (std::size_t position = 0; position < dictionary.size(); position++) {
+        EXPECT_EQ(dictionary[position], words[dictionary.id(position)]);
+        // Entries are in nondecreasing order of length.
+        if (position > 0) {
+            EXPECT_LE(dictionary[position - 1].length(), dictionary[position].length());
+        }
+    }
+    EXPECT_EQ(dictionary.bucket(5).size(), 3u);
+    EXPECT_TRUE(dictionary.bucket(3).empty());
+    EXPECT_TRUE(dictionary.bucket(100).empty());
+}
+
+TEST(LengthPartitionedDictionary, CandidatesAreExactlyTheCompatibleLengths) {
+    std::vector<std::string> words;
+    for (int i = 0; i < 2000; i++) {
+        words.push_back(generateRandomString(30, 1));
+    }
+    LengthPartitionedDictionary dictionary{words};
+
+    for (int query_length: {0, 1, 5, 15, 29, 30, 31, 40}) {
+        for (int k: {0, 1, 2, 5}) {
+            std::vector<bool> seen(words.size(), false);
+            std::size_t count = 0;
+            dictionary.for_each_candidate(std::string(query_length, 'a'), k,
+                [&](std::string_view entry, LengthPartitionedDictionary::Id id) {
+                    EXPECT_EQ(entry, words[id]);
+                    seen[id] = true;
+                    count++;
+                });
+
+            std::size_t expected = 0;
+            for (std::size_t id = 0; id < words.size(); id++) {
+                bool compatible = std::abs(static_cast<int>(words[id].length()) - query_length) <= k;
+                EXPECT_EQ(seen[id], compatible) << words[id] << " for m=" << query_length << " k=" << k;
+                expected += compatible;
+            }
+            EXPECT_EQ(count, expected);
+            EXPECT_EQ(dictionary.candidates(query_length, k).size(), expected);
+        }
+    }
+}
+
+TEST(LengthPartitionedDictionary, Empty) {
+    LengthPartitionedDictionary dictionary{std::vector<std::string>{}};
+    EXPECT_TRUE(dictionary.empty());
+    EXPECT_TRUE(dictionary.candidates(5, 2).empty());
+    dictionary.for_each_candidate("query", 2, [](std::string_view, LengthPartitionedDictionary::Id) {
+        ADD_FAILURE() << "An empty dictionary has no candidates.";
+    });
+}
+
+template<bool transpositions>
+void check_prefix_cache_against_reference() {
+    std::vector<std::string> words = sorted_word_list(3000);
+    levenshtein::PrefixCache<transpositions> cache;
+
+    for (int trial = 0; trial < 5; trial++) {
+        std::string query = apply_random_edits(words[trial*500], 3);
+        // Imitate `min_edit_dist`: the bound tightens as closer matches are found.
+        int max = 6;
+        int reused = 0;
+        for (const auto &subject: words) {
+            int expected = std::min(max + 1, reference_distance(query, subject, transpositions));
+            int actual;
+            if (cache.prefers(query, subject)) {
+                actual = cache.distance(query, subject, max);
+                reused++;
+            } else {
+                actual = expected;
+            }
+            ASSERT_EQ(actual, expected) << query << " vs " << subject << " max=" << max;
+            max = std::min(max, actual);
+        }
+        // The list is sorted, so the cache should have been used nearly all the time.
+        EXPECT_GT(reused, static_cast<int>(words.size())/2);
+    }
+}
+
+TEST(PrefixCache, LevenshteinMatchesReference) {
+    check_prefix_cache_against_reference<false>();
+}
+
+TEST(PrefixCache, DamerauLevenshteinMatchesReference) {
+    check_prefix_cache_against_reference<true>();
+}
+
+TEST(PrefixCache, DeclinesUnsortedInput) {
+    levenshtein::PrefixCache<false> cache;
+    int preferred = 0;
+    for (int i = 0; i < 1000; i++) {
+        preferred += cache.prefers("query", generateRandomString(20));
+    }
+    EXPECT_LT(preferred, 50);
+}
+
+TEST(Kernels, UnboundedMatchReference) {
+    levenshtein::Buffer buffer{levenshtein::workspace_size(40, true)};
+    for (int trial = 0; trial < 2000; trial++) {
+        std::string a = generateRandomString(20, 1);
+        std::string b = apply_random_edits(a, trial % 8);
+        EXPECT_EQ(levenshtein::edit_dist(a, b, buffer), reference_distance(a, b, false)) << a << " vs " << b;
+        EXPECT_EQ(levenshtein::edit_dist_t(a, b, buffer), reference_distance(a, b, true)) << a << " vs " << b;
+    }
+}
+
+TEST(Kernels, BoundedAgreeWithUnbounded) {
+    levenshtein::Buffer buffer{levenshtein::workspace_size(40, true)};
+    for (int trial = 0; trial < 2000; trial++) {
+        std::string a = generateRandomString(20, 1);
+        std::string b = apply_random_edits(a, trial % 8);
+        int max = trial % 6;
+        // The convention for an empty string is to return the length of the other one.
+        int cap = (a.empty() || b.empty()) ? std::max(a.length(), b.length()) : max + 1;
+        EXPECT_EQ(levenshtein::bounded_edit_dist(a, b, max, buffer),
+                  std::min(cap, levenshtein::edit_dist(a, b, buffer))) << a << " vs " << b << " max=" << max;
+    }
+}
+
+// Found by `difffuzz`: the banded kernel read a cell of the row two back that it hadn't stored,
+// where a transposition was needed just beyond the end of the previous row's band.
+TEST(Kernels, BandedTranspositionAtTheEdgeOfTheBand) {
+    levenshtein::Buffer buffer{levenshtein::workspace_size(40, true)};
+    EXPECT_EQ(levenshtein::bounded_edit_dist_t("aba", "aab", 1, buffer), 1);
+    EXPECT_EQ(levenshtein::bounded_edit_dist_t("^^^^^^^^^^^^^^|^", "^^^^^^^^^^^^^^^|", 1, buffer), 1);
+    for (int trial = 0; trial < 2000; trial++) {
+        std::string a = generateRandomString(20, 1);
+        std::string b = apply_random_edits(a, trial % 8);
+        int max = trial % 6;
+        int cap = (a.empty() || b.empty()) ? std::max(a.length(), b.length()) : max + 1;
+        EXPECT_EQ(levenshtein::bounded_edit_dist_t(a, b, max, buffer),
+                  std::min(cap, reference_distance(a, b, true))) << a << " vs " << b << " max=" << max;
+    }
+}
+
+// The same bug, as `min_edit_dist_t` met it: once the best distance so far is the cutoff, a pair
+// at exactly that distance came back as `max + 1`. Strings this long always take the banded kernel.
+TEST(Kernels, BandedTranspositionAtTheCutoff) {
+    levenshtein::Buffer buffer{levenshtein::workspace_size(160, true)};
+    const std::string a = "abaabaabbbbbbababbaabbaabbabbaabaaaabbabababaaabbbabaabbbaabbbbbbbbbbbbbaaabbaabbaaaab"
+                          "abbbabbabaaaaababbabbaabbaabaabaabbaaaaababbaabaaabbbabbabbb";
+    std::string b = a;
+    std::swap(b[12], b[13]);
+    EXPECT_EQ(levenshtein::bounded_edit_dist_t(a, b, 1, buffer), 1);
+
+    for (int trial = 0; trial < 500; trial++) {
+        std::string s = generateRandomString(146, 1);
+        std::string t = apply_random_edits(s, 1 + trial % 4);
+        int distance  = reference_distance(s, t, true);
+        EXPECT_EQ(levenshtein::bounded_edit_dist_t(s, t, distance, buffer), distance) << s << " vs " << t;
+    }
+}
+
+TEST(Kernels, SimilarityIsOneForEqualStrings) {
+    levenshtein::Buffer buffer{levenshtein::workspace_size(20, true)};
+    EXPECT_DOUBLE_EQ(levenshtein::similarity_t("", "", 0.9, buffer), 1.0);
+    EXPECT_DOUBLE_EQ(levenshtein::similarity_t("levenshtein", "levenshtein", 0.9, buffer), 1.0);
+    EXPECT_DOUBLE_EQ(levenshtein::similarity_t("abcd", "abdc", 0.5, buffer), 0.75);
+    // Below the threshold the result is smaller than the threshold, but never negative.
+    double low = levenshtein::similarity_t("abcd", "wxyz", 0.5, buffer);
+    EXPECT_LT(low, 0.5);
+    EXPECT_GE(low, 0.0);
+}
+
+TEST(Kernels, ReportBufferExceeded) {
+    levenshtein::Buffer small{8};
+    EXPECT_EQ(levenshtein::edit_dist("a", "abcdefghij", small), levenshtein::BUFFER_EXCEEDED);
+    EXPECT_EQ(levenshtein::bounded_edit_dist_t("abcdefghi", "abcdefghij", 3, small), levenshtein::BUFFER_EXCEEDED);
+    // Pairs decided by their lengths alone never touch the workspace.
+    EXPECT_EQ(levenshtein::bounded_edit_dist("a", "abcdefghij", 3, small), 4);
+    EXPECT_EQ(levenshtein::edit_dist("", "abcdefghij", small), 10);
+}
+
+/// Counts every hook, to check that the kernels call them.
+struct CountingInstrument: levenshtein::NoInstrumentation {
+    int length_exits = 0, buffer_exceeded_count = 0, starts = 0, rows = 0, early_exits = 0, dones = 0;
+    long long column_cells = 0;
+
+    void length_exit() { length_exits++; }
+    void buffer_exceeded() { buffer_exceeded_count++; }
+    void start(std::string_view, std::string_view, int) { starts++; }
+    void row(int, int, int, const int *) { rows++; }
+    void columns(int count, int height) { column_cells += static_cast<long long>(count)*height; }
+    void early_exit(int) { early_exits++; }
+    void done(int) { dones++; }
+};
+
+TEST(Kernels, CallInstrumentHooks) {
+    levenshtein::Buffer buffer{levenshtein::workspace_size(20, true)};
+    CountingInstrument counts;
+
+    levenshtein::bounded_edit_dist("kitten", "sitting", 5, buffer, counts);
+    EXPECT_EQ(counts.starts, 1);
+    EXPECT_EQ(counts.rows, 6);
+    EXPECT_EQ(counts.dones, 1);
+
+    levenshtein::bounded_edit_dist_t("aaaaaaaa", "bbbbbbbb", 1, buffer, counts);
+    EXPECT_EQ(counts.early_exits, 1);
+
+    levenshtein::bounded_edit_dist("a", "abcdefg", 1, buffer, counts);
+    EXPECT_EQ(counts.length_exits, 1);
+    EXPECT_EQ(counts.dones, 1);
+
+    // The bit-parallel kernel reports the columns it computed instead of rows.
+    const int rows = counts.rows;
+    const levenshtein::PreparedQuery prepared{"sitting"};
+    prepared.distance<false>("kitten", 5, buffer, counts);
+    EXPECT_EQ(counts.rows, rows);
+    EXPECT_EQ(counts.column_cells, 6*7);
+    EXPECT_EQ(counts.dones, 2);
+
+    prepared.distance<true>("bbbbbbbb", 1, buffer, counts);
+    EXPECT_EQ(counts.early_exits, 2);
+    EXPECT_LT(counts.column_cells, 6*7 + 8*7);
+}
+
+TEST(BandTrace, ProfileCountsCells) {
+    levenshtein::Buffer buffer{levenshtein::workspace_size(20, true)};
+    levenshtein::BandTrace   trace;
+    levenshtein::BandProfile profile;
+
+    trace.reset();
+    levenshtein::bounded_edit_dist("kitten", "sitting", 5, buffer, trace);
+    EXPECT_EQ(trace.widths.size(), 6u);
+    EXPECT_EQ(trace.exit_row, -1);
+    profile.add(trace);
+
+    trace.reset();
+    levenshtein::bounded_edit_dist_t("aaaaaaaa", "bbbbbbbb", 1, buffer, trace);
+    EXPECT_GT(trace.exit_row, 0);
+    profile.add(trace);
+
+    trace.reset();
+    levenshtein::bounded_edit_dist("a", "abcdefg", 1, buffer, trace);
+    EXPECT_TRUE(trace.length_exited);
+    profile.add(trace);
+
+    // The bit-parallel kernel has no band, so it is counted apart from the banded calls.
+    trace.reset();
+    levenshtein::PreparedQuery{"sitting"}.distance<false>("kitten", 5, buffer, trace);
+    EXPECT_TRUE(trace.bit_parallel);
+    EXPECT_TRUE(trace.widths.empty());
+    profile.add(trace);
+
+    EXPECT_EQ(profile.calls, 4u);
+    EXPECT_EQ(profile.length_exits, 1u);
+    EXPECT_EQ(profile.traced, 2u);
+    EXPECT_EQ(profile.bit_parallel, 1u);
+    EXPECT_EQ(profile.cells_bit_parallel, 6u*7u);
+    EXPECT_EQ(profile.early_exits, 1u);
+    EXPECT_EQ(profile.cells_full, 6u*7u + 8u*8u);
+    EXPECT_LE(profile.cells_dynamic, profile.cells_skewed);
+    EXPECT_LE(profile.cells_skewed, profile.cells_tight);
+    EXPECT_LE(profile.cells_tight, profile.cells_constant);
+    EXPECT_LE(profile.cells_constant, profile.cells_full);
+}
+
+// n = 4 rows, m = 6 columns, max = 3, so m-n = 2. Counted by hand, row by row:
+//   2*max + 1:        [1,4] [1,5] [1,6] [1,6]  ->  4 + 5 + 6 + 6 = 21
+//   max + m-n + 1:    [1,3] [1,4] [1,5] [2,6]  ->  3 + 4 + 5 + 5 = 17
+//   skewed, 0 left:   [1,3] [2,4] [3,5] [4,6]  ->  3 + 3 + 3 + 3 = 12
+TEST(BandTrace, ProfileCountsTheBandsOfTheDocument) {
+    levenshtein::BandTrace trace;
+    trace.reset();
+    trace.start("abcd", "abcdef", 3);
+    for (int i = 1; i <= 4; i++) trace.row(i, i, i, nullptr);
+
+    levenshtein::BandProfile profile;
+    profile.add(trace);
+    EXPECT_EQ(profile.cells_full, 24u);
+    EXPECT_EQ(profile.cells_constant, 21u);
+    EXPECT_EQ(profile.cells_tight, 17u);
+    EXPECT_EQ(profile.cells_skewed, 12u);
+    EXPECT_EQ(profile.cells_dynamic, 4u);
+}
+
+template<bool transpositions>
+void check_batch_against_reference(int query_length) {
+    std::vector<std::string> words;
+    std::string stem = generateRandomString(query_length);
+    for (int i = 0; i < 500; i++) {
+        words.push_back(i % 2 ? apply_random_edits(stem, i % 7) : generateRandomString(query_length + 3));
+    }
+    words.push_back("");
+    std::vector<std::string_view> subjects(words.begin(), words.end());
+    std::string query = apply_random_edits(stem, 1);
+    levenshtein::PreparedQuery prepared{query};
+
+    levenshtein::Buffer buffer{levenshtein::workspace_size(2*query_length + 10, true)};
+    std::vector<int> out(subjects.size());
+    for (int k: {0, 1, 3, 8, 1000}) {
+        if (transpositions) {
+            levenshtein::distances_t(prepared, subjects, k, out.data(), buffer);
+        } else {
+            levenshtein::distances(prepared, subjects, k, out.data(), buffer);
+        }
+        for (std::size_t i = 0; i < subjects.size(); i++) {
+            int expected;
+            if (query.empty() || subjects[i].empty()) {
+                // The convention for an empty string is to return the length of the other one.
+                expected = static_cast<int>(std::max(query.length(), subjects[i].length()));
+            } else if (prepared.bit_parallel()) {
+                expected = std::min(k + 1, reference_distance(query, subjects[i], transpositions));
+            } else {
+                // Long queries use the single-pair kernels, so the results must be identical.
+                expected = transpositions ? levenshtein::bounded_edit_dist_t(query, subjects[i], k, buffer)
+                                          : levenshtein::bounded_edit_dist(query, subjects[i], k, buffer);
+            }
+            ASSERT_EQ(out[i], expected) << query << " vs " << subjects[i] << " k=" << k;
+        }
+
+        levenshtein::Match match = transpositions ? levenshtein::best_match_t(prepared, subjects, k, buffer)
+                                                  : levenshtein::best_match(prepared, subjects, k, buffer);
+        auto best = std::min_element(out.begin(), out.end());
+        if (*best <= k) {
+            EXPECT_EQ(match.index, static_cast<std::size_t>(best - out.begin()));
+            EXPECT_EQ(match.distance, *best);
+        } else {
+            EXPECT_EQ(match.index, levenshtein::Match::NOT_FOUND);
+            EXPECT_EQ(match.distance, k + 1);
+        }
+    }
+}
+
+TEST(Batch, BitParallelLevenshtein) {
+    for (int length: {1, 5, 20, 63, 64}) check_batch_against_reference<false>(length);
+}
+
+TEST(Batch, BitParallelDamerauLevenshtein) {
+    for (int length: {1, 5, 20, 63, 64}) check_batch_against_reference<true>(length);
+}
+
+TEST(Batch, LongQueriesFallBack) {
+    ASSERT_FALSE(levenshtein::PreparedQuery(std::string(65, 'a')).bit_parallel());
+    check_batch_against_reference<false>(100);
+    check_batch_against_reference<true>(100);
+}
+
+template<bool transpositions>
+void check_parallel_against_sequential(const std::vector<std::string_view> &subjects, const std::string &query, int k) {
+    levenshtein::Buffer buffer{levenshtein::workspace_size(200, true)};
+    levenshtein::Match expected = transpositions ? levenshtein::best_match_t(query, subjects, k, buffer)
+                                                 : levenshtein::best_match(query, subjects, k, buffer);
+    for (unsigned threads: {1u, 2u, 3u, 8u}) {
+        for (std::size_t chunk_size: {1u, 7u, 64u, 100000u}) {
+            levenshtein::SearchOptions options{threads, chunk_size};
+            levenshtein::Match actual = transpositions
+                                        ? levenshtein::parallel_best_match_t(query, subjects, k, options)
+                                        : levenshtein::parallel_best_match(query, subjects, k, options);
+            ASSERT_EQ(actual.distance, expected.distance) << threads << " threads, chunks of " << chunk_size;
+            // Exact matches stop the search early, so which one is found depends on timing.
+            if (expected.distance > 0) {
+                ASSERT_EQ(actual.index, expected.index) << threads << " threads, chunks of " << chunk_size;
+            } else {
+                ASSERT_EQ(subjects[actual.index], query);
+            }
+        }
+    }
+}
+
+TEST(ParallelSearch, MatchesSequentialBestMatch) {
+    std::vector<std::string> words;
+    std::string stem = generateRandomString(15, 1);
+    for (int i = 0; i < 3000; i++) {
+        words.push_back(i % 10 ? generateRandomString(20, 1) : apply_random_edits(stem, 1 + i % 4));
+    }
+    std::vector<std::string_view> subjects(words.begin(), words.end());
+
+    for (int k: {0, 2, 5}) {
+        check_parallel_against_sequential<false>(subjects, stem, k);
+        check_parallel_against_sequential<true>(subjects, stem, k);
+    }
+    // An exact match, and a query too long for the bit-parallel kernel.
+    check_parallel_against_sequential<false>(subjects, words[1234], 3);
+    check_parallel_against_sequential<true>(subjects, stem + std::string(60, 'x'), 100);
+}
+
+template<bool transpositions>
+void check_dictionary_against_span(const std::vector<std::string_view> &subjects, const std::string &query) {
+    LengthPartitionedDictionary dictionary{subjects};
+    levenshtein::PreparedQuery prepared{query};
+    levenshtein::Buffer buffer{levenshtein::workspace_size(200, true)};
+    std::vector<int> expected(subjects.size()), actual(subjects.size(), -2);
+    for (int k: {0, 1, 2, 5, 100}) {
+        if (transpositions) {
+            levenshtein::distances_t(prepared, subjects, k, expected.data(), buffer);
+            levenshtein::distances_t(prepared, dictionary, k, actual.data(), buffer);
+        } else {
+            levenshtein::distances(prepared, subjects, k, expected.data(), buffer);
+            levenshtein::distances(prepared, dictionary, k, actual.data(), buffer);
+        }
+        ASSERT_EQ(actual, expected) << query << " k=" << k;
+
+        levenshtein::Match sequential = transpositions ? levenshtein::best_match_t(prepared, subjects, k, buffer)
+                                                       : levenshtein::best_match(prepared, subjects, k, buffer);
+        levenshtein::Match match = transpositions ? levenshtein::best_match_t(prepared, dictionary, k, buffer)
+                                                  : levenshtein::best_match(prepared, dictionary, k, buffer);
+        ASSERT_EQ(match.index, sequential.index) << query << " k=" << k;
+        ASSERT_EQ(match.distance, sequential.distance) << query << " k=" << k;
+
+        levenshtein::SearchOptions options{3, 5};
+        levenshtein::Match parallel = transpositions
+                                      ? levenshtein::parallel_best_match_t(prepared, dictionary, k, options)
+                                      : levenshtein::parallel_best_match(prepared, dictionary, k, options);
+        ASSERT_EQ(parallel.distance, sequential.distance) << query << " k=" << k;
+        // Exact matches stop the search early, so which one is found depends on timing.
+        if (sequential.distance > 0) {
+            ASSERT_EQ(parallel.index, sequential.index) << query << " k=" << k;
+        } else if (sequential.index != levenshtein::Match::NOT_FOUND) {
+            ASSERT_EQ(subjects[parallel.index], query);
+        }
+    }
+}
+
+TEST(LengthPartitionedDictionary, SearchesMatchTheSpan) {
+    std::vector<std::string> words;
+    std::string stem = generateRandomString(12, 1);
+    for (int i = 0; i < 2000; i++) {
+        // Duplicates and near misses at several lengths, so that ties have to be broken by index.
+        words.push_back(i % 3 ? generateRandomString(4 + i % 17, 1) : apply_random_edits(stem, i % 5));
+    }
+    words.push_back("");
+    words.push_back(stem);
+    std::vector<std::string_view> subjects(words.begin(), words.end());
+
+    for (const std::string &query: {stem, apply_random_edits(stem, 2), std::string{}, stem + std::string(70, 'q')}) {
+        check_dictionary_against_span<false>(subjects, query);
+        check_dictionary_against_span<true>(subjects, query);
+    }
+}
+
+TEST(ParallelSearch, EmptyHaystack) {
+    std::vector<std::string_view> subjects;
+    levenshtein::Match match = levenshtein::parallel_best_match("query", subjects, 3);
+    EXPECT_EQ(match.index, levenshtein::Match::NOT_FOUND);
+    EXPECT_EQ(match.distance, 4);
+}
+
+TEST(Lines, SplitAtNewlines) {
+    // Long enough that the vectorized search crosses several blocks.
+    std::string text = "alpha\r\n\n" + std::string(40, 'x') + "\nlast";
+    std::vector<std::pair<std::string, std::size_t>> lines;
+    levenshtein::for_each_line(text, [&](std::string_view line, std::size_t offset) {
+        lines.emplace_back(std::string(line), offset);
+    });
+    ASSERT_EQ(lines.size(), 4u);
+    EXPECT_EQ(lines[0], std::make_pair(std::string("alpha"), std::size_t{0}));
+    EXPECT_EQ(lines[1], std::make_pair(std::string(), std::size_t{7}));
+    EXPECT_EQ(lines[2], std::make_pair(std::string(40, 'x'), std::size_t{8}));
+    EXPECT_EQ(lines[3], std::make_pair(std::string("last"), std::size_t{49}));
+
+    EXPECT_EQ(levenshtein::next_line_start(text, 10), 49u);
+    EXPECT_EQ(levenshtein::next_line_start(text, 50), text.length());
+
+    int count = 0;
+    levenshtein::for_each_line("", [&](std::string_view, std::size_t) { count++; });
+    levenshtein::for_each_line("one\n", [&](std::string_view, std::size_t) { count++; });
+    EXPECT_EQ(count, 1);
+}
+
+template<bool transpositions>
+void check_join_against_nested_loop(const std::vector<std::string_view> &left,
+                                    const std::vector<std::string_view> &right, int k) {
+    levenshtein::Buffer buffer{200};
+    std::vector<levenshtein::JoinMatch> expected;
+    for (std::size_t i = 0; i < left.size(); i++) {
+        for (std::size_t j = 0; j < right.size(); j++) {
+            int distance = transpositions ? levenshtein::edit_dist_t(left[i], right[j], buffer)
+                                          : levenshtein::edit_dist(left[i], right[j], buffer);
+            if (distance <= k) expected.push_back({i, j, distance});
+        }
+    }
+
+    levenshtein::SearchOptions options{3, 50};
+    auto actual = transpositions ? levenshtein::similarity_join_t(left, right, k, options)
+                                 : levenshtein::similarity_join(left, right, k, options);
+    ASSERT_EQ(actual.size(), expected.size()) << "k = " << k;
+    for (std::size_t m = 0; m < expected.size(); m++) {
+        ASSERT_EQ(actual[m].left_index, expected[m].left_index);
+        ASSERT_EQ(actual[m].right_index, expected[m].right_index);
+        ASSERT_EQ(actual[m].distance, expected[m].distance);
+    }
+}
+
+TEST(SimilarityJoin, MatchesNestedLoop) {
+    std::vector<std::string> left_words, right_words;
+    for (int i = 0; i < 300; i++) {
+        left_words.push_back(generateRandomString(i % 12));
+    }
+    for (int i = 0; i < 300; i++) {
+        // Mostly near copies of left strings, with a few very short strings.
+        right_words.push_back(i % 7 ? apply_random_edits(left_words[(i*37) % 300], i % 4)
+                                    : generateRandomString(i % 3));
+    }
+    std::vector<std::string_view> left(left_words.begin(), left_words.end());
+    std::vector<std::string_view> right(right_words.begin(), right_words.end());
+
+    for (int k: {0, 1, 2, 3}) {
+        check_join_against_nested_loop<false>(left, right, k);
+        check_join_against_nested_loop<true>(left, right, k);
+    }
+}
+
+/// Connected components of the pairs `linked(i, j)`, by brute force, labelled like `cluster()`.
+template<class Linked>
+std::vector<std::uint32_t> reference_clusters(std::size_t count, Linked linked) {
+    std::vector<std::uint32_t> labels(count);
+    for (std::size_t i = 0; i < count; i++) labels[i] = static_cast<std::uint32_t>(i);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (std::size_t i = 0; i < count; i++) {
+            for (std::size_t j = i + 1; j < count; j++) {
+                if (labels[i] != labels[j] && linked(i, j)) {
+                    std::uint32_t low = std::min(labels[i], labels[j]);
+                    labels[i] = labels[j] = low;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return labels;
+}
+
+TEST(Cluster, MatchesConnectedComponents) {
+    std::vector<std::string> words;
+    for (int i = 0; i < 60; i++) {
+        std::string stem = generateRandomString(3 + i % 10);
+        words.push_back(stem);
+        for (int copy = 0; copy < i % 4; copy++) words.push_back(apply_random_edits(stem, 2));
+    }
+    words.push_back("");
+    words.push_back("");
+    words.push_back("a");
+    std::vector<std::string_view> strings(words.begin(), words.end());
+    levenshtein::Buffer buffer{200};
+    levenshtein::SearchOptions options{3, 16};
+
+    for (int k: {0, 1, 2}) {
+        auto expected = reference_clusters(strings.size(), [&](std::size_t i, std::size_t j) {
+            return levenshtein::edit_dist(strings[i], strings[j], buffer) <= k;
+        });
+        EXPECT_EQ(levenshtein::cluster(strings, k, options), expected) << "k = " << k;
+
+        auto expected_t = reference_clusters(strings.size(), [&](std::size_t i, std::size_t j) {
+            return levenshtein::edit_dist_t(strings[i], strings[j], buffer) <= k;
+        });
+        EXPECT_EQ(levenshtein::cluster_t(strings, k, options), expected_t) << "k = " << k;
+    }
+
+    for (double similarity: {0.6, 0.8, 1.0}) {
+        auto expected = reference_clusters(strings.size(), [&](std::size_t i, std::size_t j) {
+            int length = static_cast<int>(std::max(strings[i].length(), strings[j].length()));
+            int edits  = levenshtein::edit_dist_t(strings[i], strings[j], buffer);
+            return length == 0 || levenshtein::edits_to_similarity(edits, length) >= similarity;
+        });
+        EXPECT_EQ(levenshtein::cluster_similarity_t(strings, similarity, options), expected)
+                << "similarity = " << similarity;
+    }
+}
+
+TEST(ErrorModels, SameSeedSameData) {
+    const std::vector<std::string_view> words = {"Acer", "rubrum", "Quercus", "alba", "Pinus", "strobus", "var.", "L."};
+    for (const char *spec: {"uniform", "ocr", "keyboard"}) {
+        auto model = make_error_model(spec);
+        ASSERT_NE(model, nullptr) << spec;
+        EXPECT_EQ(model->name(), spec);
+
+        std::mt19937 first{7}, second{7};
+        auto haystack = draw_haystack(words, 50, 5, 30, first);
+        EXPECT_EQ(haystack, draw_haystack(words, 50, 5, 30, second));
+        EXPECT_EQ(sample_queries(haystack, 100, 1.0, *model, 3, 1, first),
+                  sample_queries(haystack, 100, 1.0, *model, 3, 1, second)) << spec;
+        for (const std::string &text: haystack) {
+            EXPECT_GE(text.length(), 5u);
+            EXPECT_LE(text.length(), 30u);
+        }
+    }
+    EXPECT_EQ(make_error_model("gaussian"), nullptr);
+    EXPECT_EQ(make_error_model("learned:/nonexistent/pairs.tsv"), nullptr);
+}
+
+TEST(ErrorModels, OcrConfusesShapes) {
+    OcrErrors model;
+    std::mt19937 rng{3};
+    // Each of these has exactly one confusion that applies to it.
+    EXPECT_EQ(model.apply("rm", 1, rng), "rrn");
+    EXPECT_EQ(model.apply("vv", 1, rng), "w");
+    EXPECT_EQ(model.apply("xdx", 1, rng), "xclx");
+    // One event is at most two edits.
+    const std::string name = "Lemna minor var. rotundata";
+    for (int trial = 0; trial < 100; trial++) {
+        EXPECT_LE(reference_distance(name, model.apply(name, 1, rng), false), 2);
+    }
+}
+
+TEST(ErrorModels, LearnedReproducesTheEditsItSaw) {
+    std::vector<std::pair<std::string, std::string>> pairs;
+    for (int i = 0; i < 20; i++) pairs.emplace_back("a" + std::string(i % 5, 'x') + "b", "e" + std::string(i % 5, 'x') + "b");
+    LearnedErrors model{pairs};
+    EXPECT_EQ(model.edit_count(), 20u);
+
+    std::mt19937 rng{11};
+    EXPECT_EQ(model.apply("xaxa", 2, rng), "xexe");
+    // Nothing to substitute: falls back to a uniform substitution.
+    EXPECT_EQ(reference_distance("zzz", model.apply("zzz", 1, rng), false), 1);
+    EXPECT_EQ(LearnedErrors{{}}.apply("zzz", 1, rng).length(), 3u);
+}
+
+TEST(ErrorModels, ZipfIsSkewed) {
+    std::mt19937 rng{5};
+    ZipfSampler zipf{1000, 1.0, rng}, uniform{1000, 0.0, rng};
+    std::vector<int> zipf_counts(1000), uniform_counts(1000);
+    for (int i = 0; i < 100000; i++) {
+        zipf_counts[zipf(rng)]++;
+        uniform_counts[uniform(rng)]++;
+    }
+    // The most popular of 1000 items gets 1/H(1000), about 13%, of a Zipf distribution with exponent 1.
+    int top = *std::max_element(zipf_counts.begin(), zipf_counts.end());
+    EXPECT_GT(top, 11000);
+    EXPECT_LT(top, 15000);
+    EXPECT_LT(*std::max_element(uniform_counts.begin(), uniform_counts.end()), 250);
+}
+
+TEST(WordList, IndexesLinesWithoutCopying) {
+    const std::string path = ::testing::TempDir() + "word_list_test.txt";
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    const std::string long_line(40, 'x');
+    std::fputs(("Abalistes\n\nAbalistes stellaris\r\n" + long_line + "\n\r\nAbbottina").c_str(), file);
+    std::fclose(file);
+
+    WordList words;
+    ASSERT_TRUE(words.open(path, "librarytest"));
+    std::vector<std::string_view> expected = {"Abalistes", "Abalistes stellaris", long_line, "Abbottina"};
+    EXPECT_EQ(words.views(), expected);
+    EXPECT_EQ(words.strings(2), std::vector<std::string>(expected.begin(), expected.begin() + 2));
+
+    ASSERT_TRUE(words.open(path, "librarytest", 3));
+    EXPECT_EQ(words.size(), 3u);
+    EXPECT_EQ(words[2], long_line);
+    std::remove(path.c_str());
+
+    EXPECT_FALSE(words.open(path, "librarytest"));
+    EXPECT_TRUE(words.empty());
+}
+
+TEST(Datasets, SameWhateverTheThreadsAndCached) {
+    DatasetKey key;
+    key.count       = 2*DATASET_CHUNK + 5;
+    key.length      = 6;
+    key.lower_bound = 2;
+    key.seed        = 3;
+    const std::vector<std::string> expected = generate_dataset(key, 1);
+    ASSERT_EQ(expected.size(), key.count);
+    EXPECT_EQ(generate_dataset(key, 3), expected);
+    for (const std::string &text: expected) {
+        EXPECT_GE(text.length(), 2u);
+        EXPECT_LE(text.length(), 6u);
+    }
+
+    const std::string cache = ::testing::TempDir() + "datasets_test";
+    std::filesystem::remove_all(cache);
+    for (bool generated: {true, false}) {
+        Dataset dataset;
+        ASSERT_TRUE(dataset.open(key, cache, 2));
+        EXPECT_EQ(dataset.generated(), generated);
+        ASSERT_EQ(dataset.size(), key.count);
+        for (std::uint64_t i = 0; i < key.count; i += 997) EXPECT_EQ(dataset[i], expected[i]) << i;
+        EXPECT_EQ(dataset[key.count - 1], expected.back());
+    }
+    key.seed = 4;
+    Dataset other;
+    ASSERT_TRUE(other.open(key, cache, 2));
+    EXPECT_TRUE(other.generated());
+    int same = 0;
+    for (std::uint64_t i = 0; i < 100; i++) same += other[i] == expected[i];
+    EXPECT_LT(same, 50);
+    std::filesystem::remove_all(cache);
+}
@@ -3,15 +3,32 @@ Copyright (C) 2024 Robert Jacobson
 Distributed under the MIT License. See License.txt for details.
 */
 #include "metrics.hpp"
+#include "../src/stats.h"
 #include <iostream>
+#include <memory>
 #include <iomanip> // for std::setw
 #include <locale>
 #include <sstream>
 #include <cmath>
+#include <stdexcept>
+#include <string_view>
+
+#if defined(__linux__) && defined(CAPTURE_PERF_COUNTERS)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 // Global array to hold performance metrics for each algorithm
 PerformanceMetrics performance_metrics[ALGORITHM_COUNT];
 
+#ifdef TRACE_BAND
+levenshtein::BandTrace band_traces[ALGORITHM_COUNT];
+levenshtein::BandProfile band_profiles[ALGORITHM_COUNT];
+#endif
+
 // Algorithm names
 // ToDo: Surely there is a better way to do this.
 const char *algorithm_names[ALGORITHM_COUNT] = {
@@ -45,21 +62,170 @@ void initialize_metrics() {
         performance_metrics[i].total_time             = 0;
         performance_metrics[i].buffer_exceeded        = 0;
         performance_metrics[i].call_count             = 0;
+        for (auto &count: performance_metrics[i].perf_counters) count = 0;
 
         performance_metrics[i].algorithm_name = algorithm_names[i]; // Point directly to the string literal
     }
+#ifdef CAPTURE_PERF_COUNTERS
+    if (!perf_counters_open()) {
+        std::cout << "CAPTURE_PERF_COUNTERS defined, but no hardware counters are available." << "\n";
+    }
+#endif
 }
 
 // Custom function to format integers with comma separators
 std::string formatWithCommas(uint64_t value) {
     // std::locale locale("");
     std::ostringstream oss;
-    oss.imbue(std::locale("en_US.UTF-8")); // Use the user's locale
+    try {
+        oss.imbue(std::locale("en_US.UTF-8")); // Use the user's locale
+    } catch (const std::runtime_error &) {
+        // The locale isn't installed. Print the number without separators.
+    }
     oss << std::fixed << value; // Convert the integer to a fixed format
     return oss.str();
 }
 
 
+// region Hardware counters
+
+// The counters are one group led by the first that opens, so that a single `read()` gets all of
+// them at the same instant. `group_position[c]` is where counter `c` is in the group, or -1.
+namespace {
+#if defined(__linux__) && defined(CAPTURE_PERF_COUNTERS)
+int group_leader = -1;
+int group_size   = 0;
+#endif
+int group_position[PERF_COUNTER_COUNT] = {-1, -1, -1, -1, -1};
+}
+
+bool perf_counters_open() {
+#if defined(__linux__) && defined(CAPTURE_PERF_COUNTERS)
+    if (group_leader >= 0) return true;
+
+    constexpr uint64_t L1D_READ_MISS = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                       | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    constexpr uint64_t LL_READ_MISS  = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                       | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const struct { uint32_t type; uint64_t config; } events[PERF_COUNTER_COUNT] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, L1D_READ_MISS},
+            {PERF_TYPE_HW_CACHE, LL_READ_MISS},
+    };
+
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof attr);
+        attr.size           = sizeof attr;
+        attr.type           = events[c].type;
+        attr.config         = events[c].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled       = group_leader < 0; // The group starts when its leader is enabled.
+
+        int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_leader, 0));
+        if (fd < 0) continue;
+        if (group_leader < 0) group_leader = fd;
+        group_position[c] = group_size++;
+    }
+    if (group_leader < 0) return false;
+
+    ioctl(group_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool perf_counter_available(int counter) {
+    return counter >= 0 && counter < PERF_COUNTER_COUNT && group_position[counter] >= 0;
+}
+
+void perf_counters_read(uint64_t values[PERF_COUNTER_COUNT]) {
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) values[c] = 0;
+#if defined(__linux__) && defined(CAPTURE_PERF_COUNTERS)
+    if (group_leader < 0) return;
+
+    // The layout of a group read: the number of events, the times enabled and running, then the
+    // values in the order the events were opened.
+    uint64_t data[3 + PERF_COUNTER_COUNT];
+    if (read(group_leader, data, sizeof data) < static_cast<ssize_t>((3 + group_size)*sizeof(uint64_t))) return;
+    const uint64_t enabled = data[1], running = data[2];
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (group_position[c] < 0) continue;
+        uint64_t value = data[3 + group_position[c]];
+        // If the group was only on the hardware part of the time, extrapolate.
+        if (running > 0 && running < enabled) {
+            value = static_cast<uint64_t>(static_cast<double>(value)*static_cast<double>(enabled)/static_cast<double>(running));
+        }
+        values[c] = value;
+    }
+#endif
+}
+
+namespace {
+
+/// Prints `count/per` to two decimal places in a column of width `width`, or "n/a".
+void print_rate(bool available, uint64_t count, uint64_t per, int width) {
+    std::ostringstream cell;
+    if (available && per > 0) {
+        cell << std::fixed << std::setprecision(2) << static_cast<double>(count)/static_cast<double>(per);
+    } else {
+        cell << "n/a";
+    }
+    std::cout << std::setw(width) << cell.str();
+}
+
+/// A second table with the hardware counters per call and per DP cell, and instructions per
+/// cycle. A high IPC with many cycles per cell means a kernel does too much work per cell; a low
+/// IPC with many cache misses means it is waiting on memory; many branch misses per cell is the
+/// cost of a data-dependent band.
+void print_perf_counters() {
+    bool any = false;
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) any = any || perf_counter_available(c);
+    if (!any) return;
+
+    std::cout << "\n" << std::right << std::setw(20) << "Algorithm"
+              << std::setw(6) << "Per"
+              << std::setw(12) << "Cycles"
+              << std::setw(14) << "Instructions"
+              << std::setw(15) << "Branch Misses"
+              << std::setw(12) << "L1D Misses"
+              << std::setw(12) << "LLC Misses"
+              << std::setw(8) << "IPC"
+              << std::endl;
+    std::cout << std::string(99, '-') << std::endl;
+
+    for (int i = 0; i < ALGORITHM_COUNT; i++) {
+        const PerformanceMetrics &metrics = performance_metrics[i];
+        if (metrics.call_count == 0) continue;
+        const int widths[PERF_COUNTER_COUNT] = {12, 14, 15, 12, 12};
+
+        std::cout << std::setw(20) << metrics.algorithm_name << std::setw(6) << "call";
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            print_rate(perf_counter_available(c), metrics.perf_counters[c], metrics.call_count, widths[c]);
+        }
+        print_rate(perf_counter_available(PERF_CYCLES) && perf_counter_available(PERF_INSTRUCTIONS),
+                   metrics.perf_counters[PERF_INSTRUCTIONS], metrics.perf_counters[PERF_CYCLES], 8);
+        std::cout << std::endl;
+
+        std::cout << std::setw(20) << "" << std::setw(6) << "cell";
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            print_rate(perf_counter_available(c), metrics.perf_counters[c], metrics.cells_computed, widths[c]);
+        }
+        std::cout << std::endl;
+    }
+}
+
+} // namespace
+
+// endregion Hardware counters
+
+
 void print_metrics() {
     // Print table header
     std::cout << std::right << std::setw(20) << "Algorithm"
@@ -88,4 +254,113 @@ void print_metrics() {
                       << std::endl;
         }
     }
+
+    print_perf_counters();
+
+#ifdef TRACE_BAND
+    for (int i = 0; i < ALGORITHM_COUNT; i++) {
+        if (band_profiles[i].calls == 0) continue;
+        std::cout << "\n";
+        band_profiles[i].print(std::cout, performance_metrics[i].algorithm_name);
+    }
+#endif
+}
+
+
+// region Latency percentiles
+
+void print_latency() {
+    auto snapshot = std::make_unique<runtime_stats::Snapshot>();
+    runtime_stats::registry.read(*snapshot);
+    double cycles_per_ns = runtime_stats::cycles_per_ns();
+
+    std::cout << "\n" << std::right << std::setw(20) << "Algorithm"
+              << std::setw(9) << "Length"
+              << std::setw(12) << "Calls"
+              << std::setw(11) << "p50 (ns)"
+              << std::setw(11) << "p90 (ns)"
+              << std::setw(11) << "p99 (ns)"
+              << std::setw(12) << "p999 (ns)"
+              << std::endl;
+    std::cout << std::string(86, '-') << std::endl;
+
+    for (int f = 0; f < runtime_stats::FUNCTION_COUNT; f++) {
+        for (int c = 0; c < runtime_stats::LENGTH_CLASS_COUNT; c++) {
+            const runtime_stats::LatencyCounts &latency = snapshot->latency[f][c];
+            uint64_t count = latency.count();
+            if (count == 0) continue;
+            std::cout << std::setw(20) << runtime_stats::FUNCTION_NAMES[f]
+                      << std::setw(9) << runtime_stats::LENGTH_CLASS_NAMES[c]
+                      << std::setw(12) << formatWithCommas(count);
+            for (double fraction: {0.5, 0.9, 0.99}) {
+                std::cout << std::setw(11) << std::llround(static_cast<double>(latency.percentile(fraction))/cycles_per_ns);
+            }
+            std::cout << std::setw(12) << std::llround(static_cast<double>(latency.percentile(0.999))/cycles_per_ns)
+                      << std::endl;
+        }
+    }
+}
+
+// endregion Latency percentiles
+
+
+// region Slow calls
+
+namespace {
+
+/// `text` quoted for a POSIX shell.
+std::string shell_quote(std::string_view text) {
+    std::string quoted = "'";
+    for (char c: text) {
+        if (c == '\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    return quoted + "'";
 }
+
+} // namespace
+
+void print_slow_calls() {
+    auto slow_calls = std::make_unique<runtime_stats::SlowCalls>();
+    runtime_stats::registry.read(*slow_calls);
+    double cycles_per_ns = runtime_stats::cycles_per_ns();
+
+    std::cout << "\n" << std::right << std::setw(20) << "Algorithm"
+              << std::setw(12) << "Time (ns)"
+              << std::setw(9) << "Subject"
+              << std::setw(9) << "Query"
+              << std::setw(8) << "Cutoff"
+              << std::setw(14) << "Cells"
+              << std::setw(7) << "Band"
+              << std::setw(18) << "Subject Hash"
+              << std::setw(18) << "Query Hash"
+              << std::endl;
+    std::cout << std::string(115, '-') << std::endl;
+
+    for (int f = 0; f < runtime_stats::FUNCTION_COUNT; f++) {
+        for (int c = 0; c < slow_calls->counts[f]; c++) {
+            const runtime_stats::SlowCall &call = slow_calls->calls[f][c];
+            std::ostringstream hashes;
+            hashes << std::hex << std::setfill('0') << std::setw(16) << call.subject_hash
+                   << "  " << std::setw(16) << call.query_hash;
+            std::cout << std::setw(20) << runtime_stats::FUNCTION_NAMES[f]
+                      << std::setw(12) << std::llround(static_cast<double>(call.cycles)/cycles_per_ns)
+                      << std::setw(9) << call.subject_length
+                      << std::setw(9) << call.query_length
+                      << std::setw(8) << call.cutoff
+                      << std::setw(14) << formatWithCommas(call.cells)
+                      << std::setw(7) << call.band_width
+                      << std::setw(36) << hashes.str()
+                      << std::endl;
+            // The command that reruns the call, when we have all of both strings.
+            if (call.whole_inputs()) {
+                std::cout << std::setw(20) << "" << "  compareoneoff "
+                          << shell_quote({call.subject_prefix, call.subject_length}) << " "
+                          << shell_quote({call.query_prefix, call.query_length}) << " "
+                          << call.cutoff << std::endl;
+            }
+        }
+    }
+}
+
+// endregion Slow calls
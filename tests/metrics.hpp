@@ -3,8 +3,22 @@
 #include <cstdint> // for uint64_t
 #include <string>
 
+#ifdef TRACE_BAND
+#include "../src/levenshtein/band_trace.h"
+#endif
+
 #define ALGORITHM_COUNT 10
 
+/// The hardware counters recorded with `CAPTURE_PERF_COUNTERS`, Linux only. See `perf_counters_open()`.
+enum PerfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,   // L1 data cache read misses
+    PERF_LLC_MISSES,   // Last level cache read misses
+    PERF_COUNTER_COUNT
+};
+
 typedef struct {
     uint64_t cells_computed;         // Number of cells computed in the matrix
     uint64_t early_exit;             // Number of early exit occurrences
@@ -13,6 +27,7 @@ typedef struct {
     double total_time;               // Total time for execution (in some unit)
     uint64_t buffer_exceeded;        // Number of times the algorithm was called with strings that couldn't fit within the buffer
     uint64_t call_count;             // Number of times the algorithm is called
+    uint64_t perf_counters[PERF_COUNTER_COUNT]; // Hardware events during calls, with CAPTURE_PERF_COUNTERS
     const char *algorithm_name;      // Name of the algorithm
 } PerformanceMetrics;
 
@@ -22,9 +37,61 @@ extern PerformanceMetrics performance_metrics[ALGORITHM_COUNT];
 // Algorithm names
 extern const char *algorithm_names[ALGORITHM_COUNT];
 
+#ifdef TRACE_BAND
+// With `TRACE_BAND`, the UDFs trace the band of each call of the banded kernels into `band_traces`
+// and add the traces up in `band_profiles`, which `print_metrics()` prints. See
+// `levenshtein/band_trace.h`.
+extern levenshtein::BandTrace band_traces[ALGORITHM_COUNT];
+extern levenshtein::BandProfile band_profiles[ALGORITHM_COUNT];
+#endif
+
 // Function to initialize all performance metrics
 void initialize_metrics();
 
 std::string formatWithCommas(uint64_t value);
 
 void print_metrics();
+
+/// Prints the percentiles of the latency of the calls of each UDF by length class, from the
+/// histograms the runtime counters of `stats.h` always keep, whether or not `CAPTURE_METRICS` is
+/// defined.
+void print_latency();
+
+/// Prints the slowest calls of each UDF, from the logs of `slow_calls.h`, and for those whose
+/// strings were captured whole (with `CAPTURE_SLOW_CALL_INPUTS`), the `compareoneoff` command line
+/// that reruns them.
+void print_slow_calls();
+
+/// Opens the hardware counters for the calling thread, which is the one whose calls are counted.
+/// Called by `initialize_metrics()` when `CAPTURE_PERF_COUNTERS` is defined. Counters the CPU or
+/// the kernel doesn't allow (see `/proc/sys/kernel/perf_event_paranoid`) are left out, and their
+/// columns print as "n/a". Returns whether any counter could be opened.
+bool perf_counters_open();
+
+/// Whether counter `counter` is being counted.
+bool perf_counter_available(int counter);
+
+/// The current value of each counter since `perf_counters_open()`, scaled up if the kernel had to
+/// share the hardware with other events. Unavailable counters read as 0.
+void perf_counters_read(uint64_t values[PERF_COUNTER_COUNT]);
+
+/// Adds the hardware events between its construction and destruction to `metrics`. Reading the
+/// counters is a system call, which costs more than a short comparison, so wall times with
+/// `CAPTURE_PERF_COUNTERS` are inflated. The counts themselves are of user space only.
+class PerfCounterScope {
+public:
+    explicit PerfCounterScope(PerformanceMetrics &metrics): metrics(metrics) { perf_counters_read(start); }
+
+    ~PerfCounterScope() {
+        uint64_t end[PERF_COUNTER_COUNT];
+        perf_counters_read(end);
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) metrics.perf_counters[i] += end[i] - start[i];
+    }
+
+    PerfCounterScope(const PerfCounterScope &) = delete;
+    PerfCounterScope &operator=(const PerfCounterScope &) = delete;
+
+private:
+    PerformanceMetrics &metrics;
+    uint64_t start[PERF_COUNTER_COUNT];
+};
@@ -0,0 +1,903 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+`microbench`: time each kernel over a grid of data shapes and write the results as JSON.
+
+Usage:
+
+    microbench [options]
+
+Options (lists are comma separated):
+
+    --lengths L,...      Query lengths (default 8,16,32,64,128).
+    --cutoffs K,...      Cutoffs passed to the bounded kernels (default 1,2,4,8).
+    --edits E,...        Number of random edits between query and subject (default 0,1,2,4,8).
+    --alphabets A,...    Alphabet sizes, at most 62 (default 4,26).
+    --kernels NAME,...   Kernels to run (default all; see below).
+    --pairs N            Pairs per grid point (default 4096).
+    --group-size N       Subjects per query (default 64).
+    --min-time-ms T      Time each trial for at least this long (default 50).
+    --trials N           Number of timed trials per point (default 1).
+    --warmup-ms T        Run each point untimed for this long first (default 0: one pass).
+    --pin-cpu N          Run on CPU N only (Linux).
+    --seed S             Seed for the generated strings (default 1).
+    --output FILE        Write the JSON here instead of to standard output.
+    --overhead           Break the time of a UDF call down into its parts instead (see below).
+    --calibrate          Measure the cost table of `levenshtein/dispatch.h` instead (see below).
+
+For each point of the grid, `pairs` strings of the given length are generated over the first
+`alphabet` characters of `[a-zA-Z0-9]`, in groups of `group-size` subjects sharing a query. Each
+subject is its query with `edits` random substitutions, insertions, deletions, and adjacent
+transpositions applied, so the distance is usually, but not always, `edits`: edits can cancel,
+and a transposition is two Levenshtein edits. The mean actual distances are reported with the
+results. Every kernel then runs over the same pairs: once, or for `warmup-ms`, to warm up, and
+then `trials` times as many passes as it takes to fill `min-time-ms`. The trials go round the
+whole grid, so that each point's samples are spread over the run. Each trial's time per pair is
+kept in `samples`, and `ns_per_pair` is their median. Several trials, on a pinned CPU, are what
+`tools/bench_compare.py` needs to tell a regression from noise.
+
+The kernels:
+
+    edit_dist, edit_dist_t              The unbounded kernels of `levenshtein/levenshtein.h`.
+    bounded_edit_dist(_t)               The banded kernels.
+    similarity_t                        With the similarity corresponding to the cutoff.
+    prepared, prepared_t                `PreparedQuery::distance` of `levenshtein/batch.h`, which
+                                        is bit-parallel for queries of up to 64 characters.
+    prepared_each(_t)                   The same, preparing the query again for every pair, as
+                                        when it isn't a constant.
+    dispatch, dispatch_t                `Dispatcher::distance` of `levenshtein/dispatch.h`, with the
+                                        query of each group as the constant query.
+    min_edit_dist(_t)                   The UDFs, one `init` per query, so the cutoff tightens
+                                        over the group as it does in a query.
+    postgres, noop                      The UDFs used for comparison in `doc/Benchmarks.md`.
+
+Library kernels are called directly and UDFs through their C interface, as MySQL calls them;
+`interface` in the output says which. The unbounded kernels ignore the cutoff, so they run once
+per length, edit count, and alphabet and have a `null` cutoff.
+
+Besides the time per pair, each library kernel is run once more with a counting instrument (see
+`levenshtein/instrument.h`) to find the number of DP cells it computes per pair and how often it
+exits early, either from the lengths alone or because the band emptied. For the bit-parallel
+kernel, the cells are those of the columns it processed, so its rate is comparable to the
+others'. UDFs can't be instrumented from outside, so these are `null` for them.
+
+With `--overhead`, the kernels are fixed to the five below, which take a call of
+`bounded_edit_dist` apart, and instead of the JSON a table gives, for each point, the time of each
+part of the call and the share of the call that isn't the kernel:
+
+    noop                    Dispatch: the call through the UDF interface, which returns at once.
+    udf_shim                `bounded_edit_dist` without the kernel: `validate_max.h`, the null
+                            checks, the string views, and the runtime counters and probes of
+                            `UdfInstrument`. Less `noop`, this is the shim.
+    udf_convert             `udf_shim` returning a similarity, as `similarity_t` does. Less
+                            `udf_shim`, this is the conversion of the result.
+    dispatch                The kernel, called directly through the `Dispatcher` the UDF uses (see
+                            `levenshtein/dispatch.h`), with the query as its constant.
+    bounded_edit_dist_udf   The whole UDF. Less the shim and the kernel, what is left is the cost
+                            of the instrument's hooks in the kernel.
+
+The defaults are then lengths 4,8,10,16,32,64,128,256, which span the length classes of
+`latency.h`, cutoff 2, 1 edit, and the alphabet of 26; `--lengths` and the others still apply.
+The times are differences of medians, so run several `--trials` and pin the CPU.
+
+With `--calibrate`, the lengths and cutoffs are fixed to the classes of `DISPATCH_LENGTHS` and
+`DISPATCH_CUTOFFS`, the kernels to the banded, `prepared_each`, and `prepared` kernels with and
+without transpositions, and instead of the JSON the output is a new `dispatch_costs.h`: each
+kernel's time per pair at each length and cutoff, averaged over the edits (default 1,4,16) and
+alphabets. The `calibrate-dispatch` target runs it and writes the table into the source tree.
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../src/common.h"
+#include "levenshtein/batch.h"
+#include "levenshtein/dispatch.h"
+
+UDF_SIGNATURES(bounded_edit_dist)
+UDF_SIGNATURES(min_edit_dist)
+UDF_SIGNATURES(min_edit_dist_t)
+UDF_SIGNATURES(postgres)
+UDF_SIGNATURES(noop)
+
+namespace {
+
+constexpr char ALPHABET[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+constexpr int  MAX_ALPHABET = static_cast<int>(sizeof ALPHABET) - 1;
+
+struct Options {
+    std::vector<int>         lengths    = {8, 16, 32, 64, 128};
+    std::vector<int>         cutoffs    = {1, 2, 4, 8};
+    std::vector<int>         edits      = {0, 1, 2, 4, 8};
+    std::vector<int>         alphabets  = {4, 26};
+    std::vector<std::string> kernels;   // Empty for all
+    int                      pairs      = 4096;
+    int                      group_size = 64;
+    int                      min_time_ms = 50;
+    int                      trials     = 1;
+    int                      warmup_ms  = 0;
+    int                      pin_cpu    = -1;
+    unsigned                 seed       = 1;
+    std::string              output;
+    bool                     overhead   = false;
+    bool                     calibrate  = false;
+};
+
+/// The defaults of `--overhead`: one line of lengths, since the overhead is about short strings.
+Options overhead_options() {
+    Options options;
+    options.lengths   = {4, 8, 10, 16, 32, 64, 128, 256};
+    options.cutoffs   = {2};
+    options.edits     = {1};
+    options.alphabets = {26};
+    options.kernels   = {"noop", "udf_shim", "udf_convert", "dispatch", "bounded_edit_dist_udf"};
+    options.overhead  = true;
+    return options;
+}
+
+/// The defaults of `--calibrate`. The lengths and cutoffs are the classes of the cost table.
+Options calibrate_options() {
+    Options options;
+    options.lengths.assign(std::begin(levenshtein::DISPATCH_LENGTHS), std::end(levenshtein::DISPATCH_LENGTHS));
+    options.cutoffs.assign(std::begin(levenshtein::DISPATCH_CUTOFFS), std::end(levenshtein::DISPATCH_CUTOFFS));
+    options.edits     = {1, 4, 16};
+    options.kernels   = {"bounded_edit_dist", "prepared_each", "prepared",
+                         "bounded_edit_dist_t", "prepared_each_t", "prepared_t"};
+    options.calibrate = true;
+    return options;
+}
+
+/// The pairs of one grid point: each query with its subjects.
+struct Group {
+    std::string              query;
+    std::vector<std::string> subjects;
+};
+
+struct Workload {
+    std::vector<Group> groups;
+    std::size_t        pairs   = 0;
+    std::size_t        longest = 0;
+};
+
+// region Generating the pairs
+
+std::string random_string(int length, int alphabet, std::mt19937 &rng) {
+    std::uniform_int_distribution<int> character(0, alphabet - 1);
+    std::string result(static_cast<std::size_t>(length), ' ');
+    for (auto &c: result) c = ALPHABET[character(rng)];
+    return result;
+}
+
+/// Applies `edits` random edits to `text`. A substitution always changes the character, unless
+/// the alphabet has only one.
+std::string mutate(std::string text, int edits, int alphabet, std::mt19937 &rng) {
+    std::uniform_int_distribution<int> operation(0, 3);
+    std::uniform_int_distribution<int> character(0, alphabet - 1);
+    for (int edit = 0; edit < edits; edit++) {
+        int op = operation(rng);
+        if (text.length() < 2 && op == 3) op = 1;
+        if (text.empty() && op != 1) op = 1;
+        switch (op) {
+            case 0: { // Substitution
+                std::size_t i = std::uniform_int_distribution<std::size_t>(0, text.length() - 1)(rng);
+                char replacement = ALPHABET[character(rng)];
+                if (alphabet > 1) {
+                    while (replacement == text[i]) replacement = ALPHABET[character(rng)];
+                }
+                text[i] = replacement;
+                break;
+            }
+            case 1: { // Insertion
+                std::size_t i = std::uniform_int_distribution<std::size_t>(0, text.length())(rng);
+                text.insert(text.begin() + static_cast<std::ptrdiff_t>(i), ALPHABET[character(rng)]);
+                break;
+            }
+            case 2: { // Deletion
+                std::size_t i = std::uniform_int_distribution<std::size_t>(0, text.length() - 1)(rng);
+                text.erase(i, 1);
+                break;
+            }
+            default: { // Transposition
+                std::size_t i = std::uniform_int_distribution<std::size_t>(0, text.length() - 2)(rng);
+                std::swap(text[i], text[i + 1]);
+                break;
+            }
+        }
+    }
+    return text;
+}
+
+Workload generate(const Options &options, int length, int edits, int alphabet, std::mt19937 &rng) {
+    Workload workload;
+    const int group_size = std::max(1, std::min(options.group_size, options.pairs));
+    for (int remaining = options.pairs; remaining > 0; remaining -= group_size) {
+        Group group;
+        group.query = random_string(length, alphabet, rng);
+        for (int i = 0; i < std::min(group_size, remaining); i++) {
+            group.subjects.push_back(mutate(group.query, edits, alphabet, rng));
+            workload.longest = std::max(workload.longest, group.subjects.back().length());
+        }
+        workload.longest = std::max(workload.longest, group.query.length());
+        workload.pairs  += group.subjects.size();
+        workload.groups.push_back(std::move(group));
+    }
+    return workload;
+}
+
+// endregion Generating the pairs
+
+// region Kernels
+
+/// Counts the work a kernel does. For the bit-parallel kernel, which reports columns instead of
+/// rows, the cells are the query length times the number of subject characters processed.
+struct CountingInstrument: public levenshtein::NoInstrumentation {
+    long long calls       = 0;
+    long long cells       = 0;
+    long long length_exits = 0;
+    long long early_exits = 0;
+
+    void length_exit() { length_exits++; }
+    void row(int, int start_j, int end_j, const int *) { cells += end_j - start_j + 1; }
+    void columns(int count, int height) { cells += static_cast<long long>(count)*height; }
+    void early_exit(int) { early_exits++; }
+};
+
+enum class Kind { edit_dist, edit_dist_t, bounded_edit_dist, bounded_edit_dist_t, similarity_t, prepared,
+                  prepared_t, prepared_each, prepared_each_t, dispatch, dispatch_t, udf };
+
+struct Kernel {
+    const char *name;
+    Kind        kind;
+    bool        bounded;
+    // Only for `Kind::udf`
+    int       (*init)(UDF_INIT *, UDF_ARGS *, char *)         = nullptr;
+    long long (*function)(UDF_INIT *, UDF_ARGS *, char *, char *) = nullptr;
+    void      (*deinit)(UDF_INIT *)                            = nullptr;
+    double    (*real)(UDF_INIT *, UDF_ARGS *, char *, char *)     = nullptr; // Instead of `function`
+};
+
+/// `bounded_edit_dist` up to the kernel, and then returning without calling it: the part of a UDF
+/// call that is the same whatever the kernel. See `--overhead`.
+long long udf_shim(UDF_INIT *initid, UDF_ARGS *args, [[maybe_unused]] char *is_null, char *error) {
+    [[maybe_unused]] int *buffer = reinterpret_cast<int *>(initid->ptr);
+    int max = static_cast<int>(std::min(static_cast<int>(*(reinterpret_cast<long long *>(args->args[2]))),
+                                        DAMLEV_MAX_EDIT_DIST));
+#include "../src/validate_max.h"
+
+    UdfInstrument instrument{0, args};
+    if (!args->args[0] || !args->args[1]) {
+        instrument.length_exit();
+        return instrument.returns(static_cast<long long>(std::max(args->lengths[0], args->lengths[1])));
+    }
+    std::string_view subject = string_arg(args, 0), query = string_arg(args, 1);
+    return instrument.returns(static_cast<long long>(subject.length() + query.length()));
+}
+
+/// `udf_shim`, converting a distance to a similarity and returning that, as `similarity_t` does.
+double udf_convert(UDF_INIT *initid, UDF_ARGS *args, [[maybe_unused]] char *is_null, char *error) {
+    [[maybe_unused]] int *buffer = reinterpret_cast<int *>(initid->ptr);
+    int max = static_cast<int>(std::min(static_cast<int>(*(reinterpret_cast<long long *>(args->args[2]))),
+                                        DAMLEV_MAX_EDIT_DIST));
+#include "../src/validate_max.h"
+
+    UdfInstrument instrument{0, args};
+    if (!args->args[0] || !args->args[1]) {
+        instrument.length_exit();
+        return instrument.returns(0.0);
+    }
+    std::string_view subject = string_arg(args, 0), query = string_arg(args, 1);
+    // The length difference stands in for the distance the kernel would have returned.
+    const int longest  = static_cast<int>(std::max(subject.length(), query.length()));
+    const int distance = std::min(static_cast<int>(longest - std::min(subject.length(), query.length())), max + 1);
+    return instrument.returns(longest ? std::max(0.0, levenshtein::edits_to_similarity(distance, longest)) : 1.0);
+}
+
+const std::vector<Kernel> &all_kernels() {
+    static const std::vector<Kernel> kernels = {
+        {"edit_dist",           Kind::edit_dist,           false},
+        {"edit_dist_t",         Kind::edit_dist_t,         false},
+        {"bounded_edit_dist",   Kind::bounded_edit_dist,   true},
+        {"bounded_edit_dist_t", Kind::bounded_edit_dist_t, true},
+        {"similarity_t",        Kind::similarity_t,        true},
+        {"prepared",            Kind::prepared,            true},
+        {"prepared_t",          Kind::prepared_t,          true},
+        {"prepared_each",       Kind::prepared_each,       true},
+        {"prepared_each_t",     Kind::prepared_each_t,     true},
+        {"dispatch",            Kind::dispatch,            true},
+        {"dispatch_t",          Kind::dispatch_t,          true},
+        {"min_edit_dist",       Kind::udf, true, &min_edit_dist_init,   &min_edit_dist,   &min_edit_dist_deinit},
+        {"min_edit_dist_t",     Kind::udf, true, &min_edit_dist_t_init, &min_edit_dist_t, &min_edit_dist_t_deinit},
+        {"postgres",            Kind::udf, true, &postgres_init,        &postgres,        &postgres_deinit},
+        {"noop",                Kind::udf, true, &noop_init,            &noop,            &noop_deinit},
+        {"bounded_edit_dist_udf", Kind::udf, true, &bounded_edit_dist_init, &bounded_edit_dist,
+         &bounded_edit_dist_deinit},
+        {"udf_shim",            Kind::udf, true, &bounded_edit_dist_init, &udf_shim, &bounded_edit_dist_deinit},
+        {"udf_convert",         Kind::udf, true, &bounded_edit_dist_init, nullptr,   &bounded_edit_dist_deinit,
+         &udf_convert},
+    };
+    return kernels;
+}
+
+/// One pass of a library kernel over the workload. Returns a checksum, so that the compiler
+/// can't discard the calls.
+template<class Instrument>
+long long run_library(Kind kind, const Workload &workload, int cutoff, levenshtein::Workspace workspace,
+                      Instrument &instrument) {
+    long long sum = 0;
+    for (const auto &group: workload.groups) {
+        const std::string_view query = group.query;
+        switch (kind) {
+            case Kind::edit_dist:
+                for (const auto &subject: group.subjects) sum += levenshtein::edit_dist(subject, query, workspace, instrument);
+                break;
+            case Kind::edit_dist_t:
+                for (const auto &subject: group.subjects) sum += levenshtein::edit_dist_t(subject, query, workspace, instrument);
+                break;
+            case Kind::bounded_edit_dist:
+                for (const auto &subject: group.subjects) {
+                    sum += levenshtein::bounded_edit_dist(subject, query, cutoff, workspace, instrument);
+                }
+                break;
+            case Kind::bounded_edit_dist_t:
+                for (const auto &subject: group.subjects) {
+                    sum += levenshtein::bounded_edit_dist_t(subject, query, cutoff, workspace, instrument);
+                }
+                break;
+            case Kind::similarity_t: {
+                const double threshold = query.empty() ? 1.0
+                                                       : levenshtein::edits_to_similarity(cutoff, static_cast<int>(query.length()));
+                for (const auto &subject: group.subjects) {
+                    sum += levenshtein::similarity_t(subject, query, threshold, workspace, instrument) >= threshold;
+                }
+                break;
+            }
+            case Kind::prepared: {
+                const levenshtein::PreparedQuery prepared{query};
+                for (const auto &subject: group.subjects) {
+                    sum += prepared.distance<false>(subject, cutoff, workspace, instrument);
+                }
+                break;
+            }
+            case Kind::prepared_t: {
+                const levenshtein::PreparedQuery prepared{query};
+                for (const auto &subject: group.subjects) {
+                    sum += prepared.distance<true>(subject, cutoff, workspace, instrument);
+                }
+                break;
+            }
+            case Kind::prepared_each:
+                for (const auto &subject: group.subjects) {
+                    const levenshtein::PreparedQuery prepared{query};
+                    sum += prepared.distance<false>(subject, cutoff, workspace, instrument);
+                }
+                break;
+            case Kind::prepared_each_t:
+                for (const auto &subject: group.subjects) {
+                    const levenshtein::PreparedQuery prepared{query};
+                    sum += prepared.distance<true>(subject, cutoff, workspace, instrument);
+                }
+                break;
+            case Kind::dispatch: {
+                levenshtein::Dispatcher<false> dispatcher;
+                dispatcher.set_constant_query(query);
+                for (const auto &subject: group.subjects) {
+                    sum += dispatcher.distance(subject, query, cutoff, workspace, instrument);
+                }
+                break;
+            }
+            case Kind::dispatch_t: {
+                levenshtein::Dispatcher<true> dispatcher;
+                dispatcher.set_constant_query(query);
+                for (const auto &subject: group.subjects) {
+                    sum += dispatcher.distance(subject, query, cutoff, workspace, instrument);
+                }
+                break;
+            }
+            case Kind::udf:
+                break;
+        }
+    }
+    return sum;
+}
+
+/// One pass of a UDF over the workload: for each group, `init` with the query as a constant
+/// argument, one call per subject, and `deinit`. Returns a checksum, or -1 if `init` failed.
+long long run_udf(const Kernel &kernel, const Workload &workload, long long cutoff) {
+    Item_result   types[3]   = {STRING_RESULT, STRING_RESULT, INT_RESULT};
+    char         *values[3]  = {nullptr, nullptr, reinterpret_cast<char *>(&cutoff)};
+    unsigned long lengths[3] = {0, 0, sizeof cutoff};
+    UDF_ARGS args;
+    std::memset(&args, 0, sizeof args);
+    args.arg_count = 3;
+    args.arg_type  = types;
+    args.args      = values;
+    args.lengths   = lengths;
+
+    long long sum = 0;
+    char message[512];
+    char is_null = 0, error = 0;
+    for (const auto &group: workload.groups) {
+        values[0]  = nullptr;
+        values[1]  = const_cast<char *>(group.query.data());
+        lengths[1] = group.query.length();
+
+        UDF_INIT initid;
+        std::memset(&initid, 0, sizeof initid);
+        if (kernel.init(&initid, &args, message) != 0) return -1;
+        for (const auto &subject: group.subjects) {
+            values[0]  = const_cast<char *>(subject.data());
+            lengths[0] = subject.length();
+            sum += kernel.real ? static_cast<long long>(kernel.real(&initid, &args, &is_null, &error)*1e6)
+                               : kernel.function(&initid, &args, &is_null, &error);
+        }
+        kernel.deinit(&initid);
+    }
+    return sum;
+}
+
+// endregion Kernels
+
+// region Measuring
+
+struct Result {
+    const Kernel       *kernel;
+    const Workload     *workload;
+    int                 length;
+    int                 cutoff;               // -1 for the unbounded kernels
+    int                 edits;
+    int                 alphabet;
+    double              mean_distance;
+    double              mean_distance_t;
+    long long           repetitions = 0;      // Passes, summed over the trials
+    std::vector<double> samples;              // ns/pair of each trial
+    double              ns_per_pair = 0;      // The median of the samples
+    bool                counted     = false;  // Whether the next three are known
+    double              cells_per_pair   = 0;
+    double              length_exit_rate = 0;
+    double              early_exit_rate  = 0;
+};
+
+volatile long long sink;
+
+/// Runs `pass` repeatedly for `milliseconds`, but at least once. Returns the mean time per pass in
+/// nanoseconds, and adds the number of passes to `repetitions`.
+template<class Pass>
+double time_passes(Pass &&pass, int milliseconds, long long &repetitions) {
+    using clock = std::chrono::steady_clock;
+    const auto min_time = std::chrono::milliseconds(milliseconds);
+    const auto start    = clock::now();
+    auto       elapsed  = clock::duration::zero();
+    long long  passes   = 0;
+    do {
+        sink = pass();
+        passes++;
+        elapsed = clock::now() - start;
+    } while (elapsed < min_time);
+    repetitions += passes;
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())
+           /static_cast<double>(passes);
+}
+
+/// Runs passes of the result's kernel over its workload for `milliseconds`. Returns the mean time
+/// per pass in nanoseconds.
+double run_for(Result &result, int milliseconds, levenshtein::Buffer &buffer, long long &repetitions) {
+    const Kernel &kernel = *result.kernel;
+    const int     cutoff = std::max(result.cutoff, 0);
+    if (kernel.kind == Kind::udf) {
+        return time_passes([&]() { return run_udf(kernel, *result.workload, cutoff); }, milliseconds, repetitions);
+    }
+    levenshtein::NoInstrumentation none;
+    return time_passes([&]() { return run_library(kernel.kind, *result.workload, cutoff, buffer.workspace(), none); },
+                       milliseconds, repetitions);
+}
+
+/// Fills in the cells and exit rates of a library kernel with a counting pass.
+void count(Result &result, levenshtein::Buffer &buffer) {
+    if (result.kernel->kind == Kind::udf) return;
+    CountingInstrument counter;
+    run_library(result.kernel->kind, *result.workload, std::max(result.cutoff, 0), buffer.workspace(), counter);
+    const auto pairs = static_cast<double>(result.workload->pairs);
+    result.counted          = true;
+    result.cells_per_pair   = static_cast<double>(counter.cells)/pairs;
+    result.length_exit_rate = static_cast<double>(counter.length_exits)/pairs;
+    result.early_exit_rate  = static_cast<double>(counter.early_exits)/pairs;
+}
+
+/// Warms up every result, then times `options.trials` trials of each. The trials are interleaved:
+/// each round times every result once, so that a slow stretch of the machine, such as another
+/// process waking up, spreads over all of them as noise instead of landing on a few as a shift.
+void measure(std::vector<Result> &results, const Options &options, levenshtein::Buffer &buffer) {
+    for (auto &result: results) {
+        long long warmup = 0;
+        run_for(result, options.warmup_ms, buffer, warmup);
+        count(result, buffer);
+    }
+    for (int trial = 0; trial < options.trials; trial++) {
+        std::fprintf(stderr, "trial %d of %d\n", trial + 1, options.trials);
+        for (auto &result: results) {
+            double pass_ns = run_for(result, options.min_time_ms, buffer, result.repetitions);
+            result.samples.push_back(pass_ns/static_cast<double>(result.workload->pairs));
+        }
+    }
+    for (auto &result: results) {
+        std::vector<double> sorted = result.samples;
+        std::sort(sorted.begin(), sorted.end());
+        const std::size_t middle = sorted.size()/2;
+        result.ns_per_pair = sorted.size() % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle])/2;
+    }
+}
+
+/// Whether a UDF can compare strings this long with its fixed buffer.
+bool udf_fits(std::size_t longest) {
+    return levenshtein::workspace_size(longest, true) <= DAMLEV_MAX_EDIT_DIST
+           && 2*(static_cast<int>(longest) + 1) <= DAMLEV_BUFFER_SIZE;
+}
+
+// endregion Measuring
+
+// region Input and output
+
+void print_usage(FILE *out) {
+    std::fputs("Usage: microbench [--lengths L,...] [--cutoffs K,...] [--edits E,...] [--alphabets A,...]\n"
+               "                  [--kernels NAME,...] [--pairs N] [--group-size N] [--min-time-ms T]\n"
+               "                  [--trials N] [--warmup-ms T] [--pin-cpu N] [--seed S] [--output FILE]\n"
+               "                  [--overhead | --calibrate]\n"
+               "Time each kernel over a grid of string lengths, cutoffs, edit counts, and alphabet sizes,\n"
+               "and write the results as JSON, or with --overhead, a table of the parts of a UDF call, or\n"
+               "with --calibrate, the cost table of levenshtein/dispatch.h.\n", out);
+}
+
+bool parse_int(const char *text, int &value) {
+    char *end;
+    long parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || parsed < 0 || parsed > (1L << 24)) return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool parse_list(const char *text, std::vector<int> &values) {
+    values.clear();
+    std::string list = text;
+    for (std::size_t start = 0; start <= list.length();) {
+        std::size_t comma = std::min(list.find(',', start), list.length());
+        int value;
+        if (!parse_int(list.substr(start, comma - start).c_str(), value)) return false;
+        values.push_back(value);
+        start = comma + 1;
+    }
+    return !values.empty();
+}
+
+bool parse_arguments(int argc, char *argv[], Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if (argument == "-h" || argument == "--help") {
+            print_usage(stdout);
+            std::exit(0);
+        }
+        // Applied by `main()` before the other options
+        if (argument == "--overhead" || argument == "--calibrate") continue;
+        if (i + 1 >= argc) return false;
+        const char *value = argv[++i];
+        bool ok = true;
+        if (argument == "--lengths") {
+            ok = parse_list(value, options.lengths);
+        } else if (argument == "--cutoffs") {
+            ok = parse_list(value, options.cutoffs);
+        } else if (argument == "--edits") {
+            ok = parse_list(value, options.edits);
+        } else if (argument == "--alphabets") {
+            ok = parse_list(value, options.alphabets);
+            for (int alphabet: options.alphabets) ok = ok && alphabet >= 1 && alphabet <= MAX_ALPHABET;
+        } else if (argument == "--kernels") {
+            options.kernels.clear();
+            std::string list = value;
+            for (std::size_t start = 0; start <= list.length();) {
+                std::size_t comma = std::min(list.find(',', start), list.length());
+                options.kernels.push_back(list.substr(start, comma - start));
+                start = comma + 1;
+            }
+        } else if (argument == "--pairs") {
+            ok = parse_int(value, options.pairs) && options.pairs > 0;
+        } else if (argument == "--group-size") {
+            ok = parse_int(value, options.group_size) && options.group_size > 0;
+        } else if (argument == "--min-time-ms") {
+            ok = parse_int(value, options.min_time_ms);
+        } else if (argument == "--trials") {
+            ok = parse_int(value, options.trials) && options.trials > 0;
+        } else if (argument == "--warmup-ms") {
+            ok = parse_int(value, options.warmup_ms);
+        } else if (argument == "--pin-cpu") {
+            ok = parse_int(value, options.pin_cpu);
+        } else if (argument == "--seed") {
+            int seed;
+            ok = parse_int(value, seed);
+            options.seed = static_cast<unsigned>(seed);
+        } else if (argument == "--output") {
+            options.output = value;
+        } else {
+            return false;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+void print_int_list(FILE *out, const std::vector<int> &values) {
+    std::fputc('[', out);
+    for (std::size_t i = 0; i < values.size(); i++) std::fprintf(out, i ? ",%d" : "%d", values[i]);
+    std::fputc(']', out);
+}
+
+/// Writes a number, or `null` if it isn't known.
+void print_number(FILE *out, bool known, double value) {
+    if (known) {
+        std::fprintf(out, "%.6g", value);
+    } else {
+        std::fputs("null", out);
+    }
+}
+
+void write_json(FILE *out, const Options &options, const std::vector<const Kernel *> &kernels,
+                const std::vector<Result> &results) {
+    std::fputs("{\n  \"benchmark\": \"microbench\",\n  \"config\": {\"lengths\": ", out);
+    print_int_list(out, options.lengths);
+    std::fputs(", \"cutoffs\": ", out);
+    print_int_list(out, options.cutoffs);
+    std::fputs(", \"edits\": ", out);
+    print_int_list(out, options.edits);
+    std::fputs(", \"alphabets\": ", out);
+    print_int_list(out, options.alphabets);
+    std::fputs(", \"kernels\": [", out);
+    for (std::size_t i = 0; i < kernels.size(); i++) std::fprintf(out, i ? ", \"%s\"" : "\"%s\"", kernels[i]->name);
+    std::fprintf(out, "], \"pairs\": %d, \"group_size\": %d, \"min_time_ms\": %d, \"trials\": %d, "
+                      "\"warmup_ms\": %d, \"pin_cpu\": ",
+                 options.pairs, options.group_size, options.min_time_ms, options.trials, options.warmup_ms);
+    print_number(out, options.pin_cpu >= 0, options.pin_cpu);
+    std::fprintf(out, ", \"seed\": %u, \"buffer_size\": %d},\n  \"results\": [", options.seed, DAMLEV_BUFFER_SIZE);
+
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        std::fprintf(out, "%s\n    {\"kernel\": \"%s\", \"interface\": \"%s\", \"length\": %d, \"cutoff\": ",
+                     i ? "," : "", r.kernel->name, r.kernel->kind == Kind::udf ? "udf" : "library", r.length);
+        print_number(out, r.cutoff >= 0, r.cutoff);
+        std::fprintf(out, ", \"edits\": %d, \"alphabet\": %d, \"pairs\": %zu, \"mean_distance\": %.4g, "
+                          "\"mean_distance_t\": %.4g, \"repetitions\": %lld, \"ns_per_pair\": %.6g, \"samples\": [",
+                     r.edits, r.alphabet, r.workload->pairs, r.mean_distance, r.mean_distance_t, r.repetitions, r.ns_per_pair);
+        for (std::size_t s = 0; s < r.samples.size(); s++) std::fprintf(out, s ? ", %.6g" : "%.6g", r.samples[s]);
+        std::fputs("], \"cells_per_pair\": ", out);
+        print_number(out, r.counted, r.cells_per_pair);
+        std::fputs(", \"cells_per_ns\": ", out);
+        print_number(out, r.counted && r.ns_per_pair > 0, r.cells_per_pair/r.ns_per_pair);
+        std::fputs(", \"length_exit_rate\": ", out);
+        print_number(out, r.counted, r.length_exit_rate);
+        std::fputs(", \"early_exit_rate\": ", out);
+        print_number(out, r.counted, r.early_exit_rate);
+        std::fputc('}', out);
+    }
+    std::fputs("\n  ]\n}\n", out);
+}
+
+/// The median time of `kernel` at the point of `point`, or -1 if it wasn't run there.
+double time_at(const std::vector<Result> &results, const Result &point, const char *kernel) {
+    for (const Result &r: results) {
+        if (r.workload == point.workload && r.cutoff == point.cutoff && std::strcmp(r.kernel->name, kernel) == 0) {
+            return r.ns_per_pair;
+        }
+    }
+    return -1;
+}
+
+/// The table of `--overhead`: for each point, the parts of a call of `bounded_edit_dist`.
+void write_overhead(FILE *out, const std::vector<Result> &results) {
+    std::fprintf(out, "%-7s %6s %6s %5s %9s %9s %9s %9s %9s %9s %9s\n", "class", "length", "cutoff", "edits",
+                 "dispatch", "shim", "convert", "kernel", "hooks", "udf", "overhead");
+    for (const Result &point: results) {
+        if (std::strcmp(point.kernel->name, "bounded_edit_dist_udf") != 0) continue;
+        const double dispatch = time_at(results, point, "noop");
+        const double shim     = time_at(results, point, "udf_shim");
+        const double convert  = time_at(results, point, "udf_convert");
+        // The UDF chooses its kernel with a `Dispatcher`, so its kernel time is the dispatcher's.
+        const double kernel   = time_at(results, point, "dispatch");
+        const double udf      = point.ns_per_pair;
+        // Times in ns per call. Each part is the difference of two medians, so small parts can
+        // come out slightly negative.
+        std::fprintf(out, "%-7s %6d %6d %5d %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8.0f%%\n",
+                     runtime_stats::LENGTH_CLASS_NAMES[runtime_stats::length_class(point.workload->longest)],
+                     point.length, point.cutoff, point.edits, dispatch, shim - dispatch, convert - shim, kernel,
+                     udf - shim - kernel, udf, udf > 0 ? 100.0*(udf - kernel)/udf : 0.0);
+    }
+}
+
+/// The mean time of `kernel` at a length and cutoff, over the edits and alphabets.
+double mean_time(const std::vector<Result> &results, const char *kernel, int length, int cutoff) {
+    double sum = 0;
+    int    n   = 0;
+    for (const Result &r: results) {
+        if (r.length == length && r.cutoff == cutoff && std::strcmp(r.kernel->name, kernel) == 0) {
+            sum += r.ns_per_pair;
+            n++;
+        }
+    }
+    return n ? sum/n : 0;
+}
+
+/// The output of `--calibrate`: `dispatch_costs.h`.
+void write_calibration(FILE *out, const Options &options, const std::vector<Result> &results) {
+    // The kernels measured for each `DispatchKernel`, without and with transpositions.
+    static const char *const KERNELS[2][levenshtein::DISPATCH_KERNEL_COUNT] = {
+        {"bounded_edit_dist",   "prepared_each",   "prepared"},
+        {"bounded_edit_dist_t", "prepared_each_t", "prepared_t"},
+    };
+    std::fputs("/*\n"
+               "Copyright (C) 2024 Robert Jacobson\n"
+               "Distributed under the MIT License. See License.txt for details.\n"
+               "\n"
+               "Generated by `microbench --calibrate`; see `dispatch.h`. Do not edit.\n"
+               "\n", out);
+    std::fputs("Edits ", out);
+    print_int_list(out, options.edits);
+    std::fputs(", alphabets ", out);
+    print_int_list(out, options.alphabets);
+    std::fprintf(out, ", %d pairs in groups of %d, %d trials of %d ms.\n"
+                      "\n"
+                      "*/\n"
+                      "\n"
+                      "#pragma once\n"
+                      "\n"
+                      "namespace levenshtein {\n"
+                      "\n"
+                      "/// Nanoseconds per call of each `DispatchKernel` by transpositions, length class, and cutoff class.\n"
+                      "constexpr float DISPATCH_COSTS[2][%d][%d][%d] = {\n",
+                 options.pairs, options.group_size, options.trials, options.min_time_ms,
+                 levenshtein::DISPATCH_KERNEL_COUNT, levenshtein::DISPATCH_LENGTH_CLASSES,
+                 levenshtein::DISPATCH_CUTOFF_CLASSES);
+    for (int t = 0; t < 2; t++) {
+        std::fprintf(out, "    { // %s\n", t ? "Damerau-Levenshtein" : "Levenshtein");
+        for (int k = 0; k < levenshtein::DISPATCH_KERNEL_COUNT; k++) {
+            std::fprintf(out, "        { // %s: %s\n", levenshtein::DISPATCH_KERNEL_NAMES[k], KERNELS[t][k]);
+            for (int l = 0; l < levenshtein::DISPATCH_LENGTH_CLASSES; l++) {
+                std::fputs("            {", out);
+                for (int c = 0; c < levenshtein::DISPATCH_CUTOFF_CLASSES; c++) {
+                    std::fprintf(out, "%s%.1ff", c ? ", " : "",
+                                 mean_time(results, KERNELS[t][k], levenshtein::DISPATCH_LENGTHS[l],
+                                           levenshtein::DISPATCH_CUTOFFS[c]));
+                }
+                std::fprintf(out, "}, // length <= %d\n", levenshtein::DISPATCH_LENGTHS[l]);
+            }
+            std::fputs("        },\n", out);
+        }
+        std::fputs("    },\n", out);
+    }
+    std::fputs("};\n\n} // namespace levenshtein\n", out);
+}
+
+// endregion Input and output
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (std::string_view(argv[i]) == "--overhead") options = overhead_options();
+        if (std::string_view(argv[i]) == "--calibrate") options = calibrate_options();
+    }
+    const Options fixed = options;
+    if (!parse_arguments(argc, argv, options)) {
+        print_usage(stderr);
+        return 2;
+    }
+    // The tables need exactly their kernels, and the cost table its classes.
+    if (options.overhead || options.calibrate) options.kernels = fixed.kernels;
+    if (options.calibrate) {
+        options.lengths = fixed.lengths;
+        options.cutoffs = fixed.cutoffs;
+    }
+
+    std::vector<const Kernel *> kernels;
+    for (const auto &kernel: all_kernels()) {
+        if (options.kernels.empty()
+            || std::find(options.kernels.begin(), options.kernels.end(), kernel.name) != options.kernels.end()) {
+            kernels.push_back(&kernel);
+        }
+    }
+    for (const auto &name: options.kernels) {
+        bool known = std::any_of(all_kernels().begin(), all_kernels().end(),
+                                 [&](const Kernel &kernel) { return name == kernel.name; });
+        if (!known) {
+            std::fprintf(stderr, "microbench: unknown kernel '%s'\n", name.c_str());
+            return 2;
+        }
+    }
+
+    if (options.pin_cpu >= 0) {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(options.pin_cpu, &cpus);
+        if (sched_setaffinity(0, sizeof cpus, &cpus) != 0) {
+            std::perror("microbench: --pin-cpu");
+            return 2;
+        }
+#else
+        std::fputs("microbench: --pin-cpu is only supported on Linux; ignoring it\n", stderr);
+#endif
+    }
+
+    FILE *out = stdout;
+    if (!options.output.empty() && !(out = std::fopen(options.output.c_str(), "w"))) {
+        std::perror(options.output.c_str());
+        return 2;
+    }
+
+    // Every workload is generated up front, since the trials go round all of them.
+    std::mt19937         rng{options.seed};
+    std::deque<Workload> workloads;
+    std::vector<Result>  results;
+    std::size_t          longest = 0;
+    for (int length: options.lengths) {
+        for (int edits: options.edits) {
+            for (int alphabet: options.alphabets) {
+                const Workload &workload = workloads.emplace_back(generate(options, length, edits, alphabet, rng));
+                longest = std::max(longest, workload.longest);
+                levenshtein::Buffer buffer{levenshtein::workspace_size(workload.longest, true)};
+
+                // The distances the edits actually produced.
+                long long distance = 0, distance_t = 0;
+                for (const auto &group: workload.groups) {
+                    for (const auto &subject: group.subjects) {
+                        distance   += levenshtein::edit_dist(subject, group.query, buffer);
+                        distance_t += levenshtein::edit_dist_t(subject, group.query, buffer);
+                    }
+                }
+
+                for (const Kernel *kernel: kernels) {
+                    if (kernel->kind == Kind::udf && !udf_fits(workload.longest)) continue;
+                    // The unbounded kernels only need one cutoff.
+                    const std::size_t cutoffs = kernel->bounded ? options.cutoffs.size() : 1;
+                    for (std::size_t c = 0; c < cutoffs; c++) {
+                        Result result;
+                        result.kernel          = kernel;
+                        result.workload        = &workload;
+                        result.length          = length;
+                        result.cutoff          = kernel->bounded ? options.cutoffs[c] : -1;
+                        result.edits           = edits;
+                        result.alphabet        = alphabet;
+                        result.mean_distance   = static_cast<double>(distance)/static_cast<double>(workload.pairs);
+                        result.mean_distance_t = static_cast<double>(distance_t)/static_cast<double>(workload.pairs);
+                        results.push_back(std::move(result));
+                    }
+                }
+            }
+        }
+    }
+
+    levenshtein::Buffer buffer{levenshtein::workspace_size(longest, true)};
+    measure(results, options, buffer);
+
+    if (options.overhead) {
+        write_overhead(out, results);
+    } else if (options.calibrate) {
+        write_calibration(out, options, results);
+    } else {
+        write_json(out, options, kernels, results);
+    }
+    if (out != stdout && std::fclose(out) != 0) {
+        std::perror(options.output.c_str());
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+Tests of the SQLite extension, loaded into an in-memory database the way an application would load
+it. The expected values come from the header-only library.
+
+*/
+
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "edit_operations.hpp"
+#include "levenshtein/levenshtein.h"
+
+namespace {
+
+class Database {
+public:
+    Database() {
+        sqlite3_open(":memory:", &db);
+        sqlite3_enable_load_extension(db, 1);
+        char *error = nullptr;
+        if (sqlite3_load_extension(db, DAMLEV_SQLITE_PATH, nullptr, &error) != SQLITE_OK) {
+            ADD_FAILURE() << "Loading the extension failed: " << (error ? error : "");
+            sqlite3_free(error);
+        }
+    }
+    ~Database() { sqlite3_close(db); }
+
+    void execute(const std::string &sql) {
+        char *error = nullptr;
+        EXPECT_EQ(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error), SQLITE_OK) << (error ? error : "");
+        sqlite3_free(error);
+    }
+
+    /// The rows of a query with `text` bound to every parameter, as strings (NULL as "NULL").
+    std::vector<std::vector<std::string>> rows(const std::string &sql, const std::string &text = "") {
+        std::vector<std::vector<std::string>> result;
+        sqlite3_stmt *statement = nullptr;
+        EXPECT_EQ(sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, nullptr), SQLITE_OK) << sqlite3_errmsg(db);
+        for (int i = 1; i <= sqlite3_bind_parameter_count(statement); i++) {
+            sqlite3_bind_text(statement, i, text.data(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+        }
+        int rc;
+        while ((rc = sqlite3_step(statement)) == SQLITE_ROW) {
+            std::vector<std::string> row;
+            for (int column = 0; column < sqlite3_column_count(statement); column++) {
+                const auto *value = reinterpret_cast<const char *>(sqlite3_column_text(statement, column));
+                row.emplace_back(value ? value : "NULL");
+            }
+            result.push_back(std::move(row));
+        }
+        EXPECT_EQ(rc, SQLITE_DONE) << sqlite3_errmsg(db);
+        sqlite3_finalize(statement);
+        return result;
+    }
+
+    std::string value(const std::string &sql) {
+        auto result = rows(sql);
+        return result.empty() || result[0].empty() ? "" : result[0][0];
+    }
+
+private:
+    sqlite3 *db = nullptr;
+};
+
+} // namespace
+
+TEST(Sqlite, ScalarFunctions) {
+    Database db;
+    EXPECT_EQ(db.value("SELECT edit_dist('kitten', 'sitting')"), "3");
+    EXPECT_EQ(db.value("SELECT edit_dist_t('Salmo truta', 'Salmo turta')"), "1");
+    EXPECT_EQ(db.value("SELECT edit_dist('Salmo truta', 'Salmo turta')"), "2");
+    EXPECT_EQ(db.value("SELECT bounded_edit_dist('kitten', 'sitting', 1)"), "2");
+    EXPECT_EQ(db.value("SELECT bounded_edit_dist_t('ab', 'ba', 1)"), "1");
+    EXPECT_EQ(db.value("SELECT similarity_t('abcd', 'abce', 0.5)"), "0.75");
+    EXPECT_EQ(db.value("SELECT fuzzy_match('Salmo trutta', 'Salmo truta', 1)"), "1");
+    EXPECT_EQ(db.value("SELECT fuzzy_match('Salmo trutta', 'Salmon', 1)"), "0");
+    EXPECT_EQ(db.value("SELECT edit_dist(NULL, 'a')"), "NULL");
+
+    // Longer than any buffer a UDF would have.
+    std::string long_a(5000, 'a'), long_b = long_a + "b";
+    EXPECT_EQ(db.value("SELECT edit_dist('" + long_a + "', '" + long_b + "')"), "1");
+}
+
+TEST(Sqlite, MinEditDistTightensOverAQuery) {
+    Database db;
+    db.execute("CREATE TABLE names(name TEXT);"
+               "INSERT INTO names VALUES ('Salmon'), ('Salmo truta'), ('Salmo trutta'), ('Salmo trout');");
+    // Once the exact match is found, later rows only have to beat distance 0.
+    auto result = db.rows("SELECT name, min_edit_dist(name, 'Salmo trutta', 5) FROM names ORDER BY rowid");
+    ASSERT_EQ(result.size(), 4u);
+    EXPECT_EQ(result[1][1], "1");
+    EXPECT_EQ(result[2][1], "0");
+    EXPECT_EQ(result[3][1], "1");
+}
+
+TEST(Sqlite, FuzzyTableMatchesScan) {
+    Database db;
+    std::vector<std::string> words;
+    std::string stem = generateRandomString(12);
+    db.execute("CREATE TABLE words(word TEXT)");
+    for (int i = 0; i < 500; i++) {
+        std::string word = i % 3 ? generateRandomString(i % 16) : apply_random_edits(stem, i % 5);
+        db.rows("INSERT INTO words VALUES (?)", word);
+        words.push_back(word);
+    }
+    db.execute("CREATE VIRTUAL TABLE words_fuzzy USING fuzzy(words, word, 2)");
+
+    levenshtein::Buffer buffer{100};
+    for (int k: {0, 1, 2, 4}) {
+        std::vector<std::vector<std::string>> expected;
+        for (std::size_t i = 0; i < words.size(); i++) {
+            int distance = levenshtein::edit_dist_t(words[i], stem, buffer);
+            if (distance <= k) expected.push_back({std::to_string(i + 1), words[i], std::to_string(distance)});
+        }
+        auto actual = db.rows("SELECT rowid, word, distance FROM words_fuzzy WHERE query = ? AND k = "
+                              + std::to_string(k) + " ORDER BY rowid", stem);
+        EXPECT_EQ(actual, expected) << "k = " << k;
+    }
+
+    // The default `k` is that of the index, and the table-valued function spelling is the same.
+    EXPECT_EQ(db.rows("SELECT rowid FROM words_fuzzy(?) ORDER BY rowid", stem),
+              db.rows("SELECT rowid FROM words_fuzzy WHERE query = ? AND k = 2 ORDER BY rowid", stem));
+
+    // The search uses the index instead of listing every word.
+    auto plan = db.rows("EXPLAIN QUERY PLAN SELECT rowid FROM words_fuzzy WHERE query = ? AND k = 1", stem);
+    ASSERT_FALSE(plan.empty());
+    EXPECT_NE(plan[0].back().find("VIRTUAL TABLE INDEX 3"), std::string::npos) << plan[0].back();
+
+    // Without a query, every word, with no distance.
+    EXPECT_EQ(db.value("SELECT count(*) FROM words_fuzzy WHERE distance IS NULL"), "500");
+}
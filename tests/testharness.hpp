@@ -48,7 +48,7 @@ void LEV_SETUP(){
 
     // Initialize UDF_ARGS
     LEV_ARGS->arg_type    = new Item_result[LEV_ALGORITHM_COUNT];
-    LEV_ARGS->args        = new char*[LEV_ALGORITHM_COUNT];
+    LEV_ARGS->args        = new char*[LEV_ALGORITHM_COUNT]();
     LEV_ARGS->lengths     = new unsigned long[2]; // There are only ever two strings
     LEV_ARGS->arg_count   = LEV_ALGORITHM_COUNT;
     LEV_ARGS->arg_type[0] = STRING_RESULT;
@@ -2,11 +2,11 @@
 #include <iostream>
 #include <string>
 
+#include "testharness.hpp"
+
 #define xstr(s) str(s)
 #define str(s) #s
 
-#include "testharness.hpp"
-
 std::string string_a {"Acanthemblemaria greenfieldi"};
 std::string string_b {"Praeformosania intermedia fan123g"};
 
@@ -106,6 +106,9 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[]) {
     long long result3 = 0;
     long long result4 = 0;
 
+#ifdef CAPTURE_METRICS
+    initialize_metrics();
+#endif
 
     LEV_SETUP();
     std::cout << "Subject is Search Term: " <<  std::endl;
@@ -132,6 +135,11 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[]) {
 
 
     LEV_TEARDOWN();
+#ifdef CAPTURE_METRICS
+    print_metrics();
+    print_latency();
+    print_slow_calls();
+#endif
 
     result3 = calculateDamLevDistance(a, b, c);
     std::cout << xstr(calculateDamLevDistance) "(" << a << ", " << b << ") =  " << result3 << std::endl;
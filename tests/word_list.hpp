@@ -0,0 +1,86 @@
+/*!
+
+A word list, one word per line, read without copying it.
+
+Reading a list of 2 million names with `std::getline` copies the file into a string stream and
+then each line into its own `std::string`, which takes seconds and twice the memory of the file.
+`WordList` maps the file instead, finds the newlines with `levenshtein::find_newline()`, which
+compares 16 bytes at a time, and keeps only where each line starts and how long it is. The words
+are `std::string_view`s into the mapping, valid as long as the `WordList` is.
+
+Empty lines are skipped, and a trailing `\r` is dropped from each line, as `for_each_line()` does.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../src/levenshtein/lines.h"
+#include "../tools/mapped_file.h"
+
+class WordList {
+public:
+    /**
+    Maps `path` and indexes its lines.
+
+    @param path The file.
+    @param program The name to prefix an error message with.
+    @param max_words Index at most this many words, and stop reading there.
+    @return False, after printing why, if the file can't be read.
+    */
+    bool open(const std::string &path, const char *program,
+              std::size_t max_words = std::numeric_limits<std::size_t>::max()) {
+        lines.clear();
+        if (!file.open(path, program)) return false;
+
+        const std::string_view text = file.text();
+        const char *begin = text.data(), *end = text.data() + text.length();
+        for (const char *line = begin; line < end && lines.size() < max_words;) {
+            const char *newline = levenshtein::find_newline(line, end);
+            std::size_t length  = static_cast<std::size_t>(newline - line);
+            if (length > 0 && line[length - 1] == '\r') length--;
+            if (length > 0) lines.push_back({static_cast<std::size_t>(line - begin), static_cast<std::uint32_t>(length)});
+            line = newline + 1;
+        }
+        return true;
+    }
+
+    std::size_t size() const { return lines.size(); }
+    bool empty() const { return lines.empty(); }
+
+    std::string_view operator[](std::size_t i) const {
+        return file.text().substr(lines[i].offset, lines[i].length);
+    }
+
+    /// All the words, as views into the file.
+    std::vector<std::string_view> views() const {
+        std::vector<std::string_view> words;
+        words.reserve(lines.size());
+        for (std::size_t i = 0; i < lines.size(); i++) words.push_back((*this)[i]);
+        return words;
+    }
+
+    /// Copies of the first `count` words, for code that needs to own them.
+    std::vector<std::string> strings(std::size_t count = std::numeric_limits<std::size_t>::max()) const {
+        std::vector<std::string> words;
+        words.reserve(std::min(count, lines.size()));
+        for (std::size_t i = 0; i < lines.size() && i < count; i++) words.emplace_back((*this)[i]);
+        return words;
+    }
+
+private:
+    struct Line {
+        std::size_t   offset;
+        std::uint32_t length;
+    };
+
+    MappedFile        file;
+    std::vector<Line> lines;
+};
@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+# Copyright (C) 2024 Robert Jacobson
+# Distributed under the MIT License. See License.txt for details.
+"""
+Compare two sets of `microbench` results and flag the significant regressions.
+
+Usage:
+
+    bench_compare.py [options] BASELINE.json CURRENT.json
+
+Each result is identified by its kernel and grid point (length, cutoff, edits, alphabet). For each
+one present in both files, we compare the per-trial times in `samples`:
+
+  - the median of each, with a 95% confidence interval for it from the order statistics;
+  - the ratio of the medians, current over baseline, with a 95% bootstrap confidence interval;
+  - a one-sided Mann-Whitney U test of whether the current times are larger.
+
+A point is a regression if the test is significant at `--alpha` and the median ratio is more than
+`1 + --threshold`. That is, the slowdown has to be both real and big enough to matter. Only the
+kernels named with `--gate` (by default `min_edit_dist` and `bounded_edit_dist_t`) make the exit
+status nonzero; regressions in the others are reported but don't fail the comparison. Results need
+several trials (`microbench --trials`) for the test to mean anything. Even when every current time
+is larger than every baseline time, the test can't reach `--alpha` with too few: at the default of
+0.01 it takes 5 trials per side (3 per side give p = 0.04 at best). We warn when a point has fewer
+trials than `--alpha` needs, and don't test points with fewer than 3.
+
+Exit status: 0 if no gated kernel regressed, 1 if one did, 2 on error.
+
+Uses only the standard library.
+"""
+
+import argparse
+import json
+import math
+import random
+import statistics
+import sys
+
+DEFAULT_GATE = ["min_edit_dist", "bounded_edit_dist_t"]
+MIN_SAMPLES = 3
+
+
+def load(path):
+    """Returns the results of `path` by (kernel, length, cutoff, edits, alphabet)."""
+    with open(path) as file:
+        data = json.load(file)
+    if data.get("benchmark") != "microbench":
+        raise ValueError(f"{path} is not microbench output")
+    results = {}
+    for result in data["results"]:
+        key = (result["kernel"], result["length"], result["cutoff"], result["edits"], result["alphabet"])
+        results[key] = result["samples"] or [result["ns_per_pair"]]
+    return results
+
+
+def median_interval(samples, confidence=0.95):
+    """A distribution-free confidence interval for the median, from the order statistics. With
+    too few samples for the requested confidence, the whole range."""
+    values = sorted(samples)
+    n = len(values)
+    # The largest k such that P(Binomial(n, 1/2) < k) <= (1 - confidence)/2.
+    tail = (1 - confidence)/2
+    cumulative, k = 0.0, 0
+    while k < n and cumulative + math.comb(n, k)/2**n <= tail:
+        cumulative += math.comb(n, k)/2**n
+        k += 1
+    if k == 0:
+        return values[0], values[-1]
+    return values[k - 1], values[n - k]
+
+
+def ratio_interval(baseline, current, resamples=2000, confidence=0.95, seed=1):
+    """A bootstrap confidence interval for median(current)/median(baseline)."""
+    rng = random.Random(seed)
+    ratios = []
+    for _ in range(resamples):
+        b = statistics.median(rng.choices(baseline, k=len(baseline)))
+        c = statistics.median(rng.choices(current, k=len(current)))
+        ratios.append(c/b if b > 0 else math.inf)
+    ratios.sort()
+    low = int(resamples*(1 - confidence)/2)
+    return ratios[low], ratios[resamples - 1 - low]
+
+
+def mann_whitney_greater(baseline, current):
+    """The p-value of a one-sided Mann-Whitney U test that `current` tends to be larger than
+    `baseline`, by the normal approximation with a continuity and tie correction."""
+    n1, n2 = len(current), len(baseline)
+    combined = sorted([(value, 0) for value in current] + [(value, 1) for value in baseline])
+
+    # Midranks, and the tie correction term.
+    ranks = [0.0]*len(combined)
+    ties = 0.0
+    i = 0
+    while i < len(combined):
+        j = i
+        while j + 1 < len(combined) and combined[j + 1][0] == combined[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j)/2 + 1
+        t = j - i + 1
+        ties += t**3 - t
+        i = j + 1
+
+    rank_sum = sum(rank for rank, (_, side) in zip(ranks, combined) if side == 0)
+    u = rank_sum - n1*(n1 + 1)/2
+    n = n1 + n2
+    variance = n1*n2/12*((n + 1) - ties/(n*(n - 1)))
+    if variance <= 0:
+        return 1.0
+    z = (u - n1*n2/2 - 0.5)/math.sqrt(variance)
+    return 0.5*math.erfc(z/math.sqrt(2))
+
+
+def min_significant_samples(alpha):
+    """The fewest trials per side with which the test can be significant at `alpha`, which is
+    when the two sides don't overlap at all."""
+    n = MIN_SAMPLES
+    while mann_whitney_greater(list(range(n)), list(range(n, 2*n))) >= alpha and n < 1000:
+        n += 1
+    return n
+
+
+def compare(baseline, current, alpha, threshold):
+    """Yields one row per point present in both result sets."""
+    for key in sorted(baseline.keys() & current.keys(), key=str):
+        b, c = baseline[key], current[key]
+        b_median, c_median = statistics.median(b), statistics.median(c)
+        ratio = c_median/b_median if b_median > 0 else math.inf
+        enough = len(b) >= MIN_SAMPLES and len(c) >= MIN_SAMPLES
+        p = mann_whitney_greater(b, c) if enough else 1.0
+        yield {
+            "key":          key,
+            "baseline":     b_median,
+            "baseline_ci":  median_interval(b),
+            "current":      c_median,
+            "current_ci":   median_interval(c),
+            "ratio":        ratio,
+            "ratio_ci":     ratio_interval(b, c) if enough else (ratio, ratio),
+            "p":            p,
+            "regression":   p < alpha and ratio > 1 + threshold,
+            "samples":      min(len(b), len(c)),
+        }
+
+
+def format_key(key):
+    kernel, length, cutoff, edits, alphabet = key
+    cutoff = "-" if cutoff is None else cutoff
+    return f"{kernel} n={length} k={cutoff} e={edits} a={alphabet}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two sets of microbench results.")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--alpha", type=float, default=0.01,
+                        help="significance level of the test (default 0.01)")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="smallest slowdown that counts, as a fraction (default 0.05)")
+    parser.add_argument("--gate", default=",".join(DEFAULT_GATE),
+                        help="comma-separated kernels whose regressions fail the comparison "
+                             f"(default {','.join(DEFAULT_GATE)}; empty for all)")
+    parser.add_argument("--all", action="store_true", help="print every point, not just the changes")
+    arguments = parser.parse_args()
+
+    try:
+        baseline = load(arguments.baseline)
+        current = load(arguments.current)
+    except (OSError, ValueError, KeyError) as error:
+        print(f"bench_compare: {error}", file=sys.stderr)
+        return 2
+
+    gate = {kernel for kernel in arguments.gate.split(",") if kernel}
+    rows = list(compare(baseline, current, arguments.alpha, arguments.threshold))
+    if not rows:
+        print("bench_compare: the result sets have no points in common", file=sys.stderr)
+        return 2
+
+    needed = min_significant_samples(arguments.alpha)
+    too_few = sum(row["samples"] < needed for row in rows)
+    if too_few:
+        print(f"bench_compare: {too_few} points have fewer than the {needed} trials per side it takes to be "
+              f"significant at alpha={arguments.alpha:g}; they can't be flagged", file=sys.stderr)
+
+    failed = []
+    print(f"{'point':<44} {'baseline ns':>22} {'current ns':>22} {'ratio':>20} {'p':>8}")
+    for row in rows:
+        significant = row["p"] < arguments.alpha
+        if not (arguments.all or row["regression"] or significant):
+            continue
+        b_low, b_high = row["baseline_ci"]
+        c_low, c_high = row["current_ci"]
+        r_low, r_high = row["ratio_ci"]
+        gated = not gate or row["key"][0] in gate
+        mark = ""
+        if row["regression"]:
+            mark = "  REGRESSION" if gated else "  regression (not gated)"
+            if gated:
+                failed.append(row)
+        print(f"{format_key(row['key']):<44} "
+              f"{row['baseline']:>8.1f} [{b_low:>5.1f},{b_high:>5.1f}] "
+              f"{row['current']:>8.1f} [{c_low:>5.1f},{c_high:>5.1f}] "
+              f"{row['ratio']:>6.3f} [{r_low:.3f},{r_high:.3f}] {row['p']:>8.2g}{mark}")
+
+    unmatched = len(baseline.keys() ^ current.keys())
+    print(f"\n{len(rows)} points compared, {unmatched} in only one set, "
+          f"{sum(row['regression'] for row in rows)} regressions, {len(failed)} in gated kernels.")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
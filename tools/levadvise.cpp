@@ -0,0 +1,486 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+`levadvise`: recommend a cutoff and a kernel from a sample of real data.
+
+Usage:
+
+    levadvise [options] HAYSTACK QUERIES
+
+Options:
+
+    -t            Count transpositions as one edit (Damerau-Levenshtein distance, as `edit_dist_t`).
+    -r RECALL     The fraction of queries whose closest line the cutoff should find (default 0.95).
+    -K N          The largest cutoff to consider (default 8).
+    -n N          The number of haystack lines to time the kernels on (default 10000).
+    -m N          The number of queries to use (default 200).
+    -j N          Number of threads for finding the closest lines (default: one per hardware thread).
+    --seed N      The seed for sampling the lines and queries (default 1).
+    --output FILE Also write the recommendation as JSON to FILE.
+    --json        Print the JSON instead of the report.
+    -h, --help    Show this message.
+
+`HAYSTACK` is a sample of what is searched, one string per line, ideally all of it; `QUERIES` is
+a sample of what is searched for. The closest line to each query is taken to be its true match.
+
+`doc/Benchmarks.md` shows that the banded kernels are fastest when the cutoff is the number of
+edits actually separating a query from its match, and slow down quickly as it grows past that.
+So `levadvise` first finds the distance from each query to its closest line in the whole
+haystack, with `parallel_best_match()` over a `LengthPartitionedDictionary` of it, which only
+compares the lines whose length is within `-K` of the query's. From their distribution it finds
+the recall of each cutoff up to `-K`: the fraction of queries whose closest line is within it.
+Queries with no line within `-K` count as misses. The recommended cutoff is the smallest with at
+least the target recall.
+
+It then times each kernel with each cutoff, one query at a time against a random sample of the
+haystack, as a UDF with a constant argument runs:
+
+    edit_dist(_t)            The unbounded kernel, which doesn't depend on the cutoff.
+    bounded_edit_dist(_t)    The banded kernel, which the UDFs `bounded_edit_dist(_t)` and
+                             `min_edit_dist(_t)` use.
+    prepared(_t)             `PreparedQuery` of `levenshtein/batch.h`, bit-parallel for queries of
+                             up to 64 characters, which `levgrep` and the SQLite extension use.
+
+and counts how often the banded kernel exits from the lengths alone or because its band emptied.
+Everything is also broken down by the length class of the query, the same classes as the latency
+of `damlev_stats()`, each with its own recommended cutoff and fastest kernel at that cutoff.
+
+The report is a few tables on standard output. The JSON has the same numbers:
+
+    {"distance": "levenshtein", "target_recall": 0.95, "queries": 200, "cutoff": 2, "recall": 0.96,
+     "length_classes": [{"class": "0-16", "queries": 120, "cutoff": 2, "recall": 0.97,
+                         "kernel": "prepared", "ns_per_pair": {"edit_dist": 190.2, ...}}, ...],
+     "cutoffs": [{"cutoff": 0, "recall": 0.31, "length_exit_rate": 0.62, "early_exit_rate": 0.37,
+                  "ns_per_pair": {"edit_dist": 201.7, ...}}, ...]}
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "latency.h"
+#include "levenshtein/lines.h"
+#include "levenshtein/parallel_search.h"
+#include "mapped_file.h"
+
+namespace {
+
+using runtime_stats::LENGTH_CLASS_COUNT;
+using runtime_stats::LENGTH_CLASS_NAMES;
+
+/// Larger values of `-K` are clamped to this. Each cutoff is another pass of every kernel.
+constexpr int MAX_CUTOFF = 64;
+
+struct Options {
+    std::string                haystack;
+    std::string                queries;
+    std::string                output;
+    bool                       transpositions = false;
+    bool                       json           = false;
+    double                     recall         = 0.95;
+    int                        max_cutoff     = 8;
+    long                       lines          = 10000;
+    long                       query_count    = 200;
+    unsigned long              seed           = 1;
+    levenshtein::SearchOptions search;
+};
+
+enum Kernel { EDIT_DIST, BOUNDED_EDIT_DIST, PREPARED, KERNEL_COUNT };
+
+const char *kernel_name(Kernel kernel, bool transpositions) {
+    static const char *const names[2][KERNEL_COUNT] = {
+        {"edit_dist", "bounded_edit_dist", "prepared"},
+        {"edit_dist_t", "bounded_edit_dist_t", "prepared_t"},
+    };
+    return names[transpositions][kernel];
+}
+
+void print_usage(FILE *out) {
+    std::fputs("Usage: levadvise [-t] [-r RECALL] [-K N] [-n N] [-m N] [-j N] [--seed N] [--output FILE] [--json]\n"
+               "                 HAYSTACK QUERIES\n"
+               "Recommend a cutoff and kernel for searching HAYSTACK for strings like QUERIES.\n"
+               "  -t             count transpositions as one edit (Damerau-Levenshtein)\n"
+               "  -r RECALL      fraction of closest lines the cutoff should find (default 0.95)\n"
+               "  -K N           largest cutoff to consider (default 8)\n"
+               "  -n N           haystack lines to time the kernels on (default 10000)\n"
+               "  -m N           queries to use (default 200)\n"
+               "  -j N           threads for finding the closest lines\n"
+               "  --seed N       seed for the samples (default 1)\n"
+               "  --output FILE  also write the recommendation as JSON to FILE\n"
+               "  --json         print the JSON instead of the report\n", out);
+}
+
+/// Parses the command line. Returns false on a usage error.
+bool parse_arguments(int argc, char *argv[], Options &options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if ((argument == "-K" || argument == "-n" || argument == "-m" || argument == "-j" || argument == "--seed")
+            && i + 1 < argc) {
+            char *end;
+            long value = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || value < 0) return false;
+            if (argument == "-K") {
+                options.max_cutoff = static_cast<int>(std::min<long>(value, MAX_CUTOFF));
+            } else if (argument == "-n") {
+                options.lines = value;
+            } else if (argument == "-m") {
+                options.query_count = value;
+            } else if (argument == "-j") {
+                options.search.threads = static_cast<unsigned>(value);
+            } else {
+                options.seed = static_cast<unsigned long>(value);
+            }
+        } else if (argument == "-r" && i + 1 < argc) {
+            char *end;
+            options.recall = std::strtod(argv[++i], &end);
+            if (*end != '\0' || !(options.recall >= 0.0 && options.recall <= 1.0)) return false;
+        } else if (argument == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (argument == "-t") {
+            options.transpositions = true;
+        } else if (argument == "--json") {
+            options.json = true;
+        } else if (argument == "-h" || argument == "--help") {
+            print_usage(stdout);
+            std::exit(0);
+        } else if (argument.size() > 1 && argument[0] == '-') {
+            return false;
+        } else {
+            positional.emplace_back(argument);
+        }
+    }
+    if (positional.size() != 2) return false;
+    options.haystack = positional[0];
+    options.queries  = positional[1];
+    return true;
+}
+
+/// Up to `count` of `lines`, chosen at random but kept in their original order.
+std::vector<std::string_view> sample(const std::vector<std::string_view> &lines, long count, std::mt19937_64 &rng) {
+    if (static_cast<std::size_t>(count) >= lines.size()) return lines;
+    std::vector<std::size_t> indices(lines.size());
+    for (std::size_t i = 0; i < indices.size(); i++) indices[i] = i;
+    std::shuffle(indices.begin(), indices.end(), rng);
+    indices.resize(static_cast<std::size_t>(count));
+    std::sort(indices.begin(), indices.end());
+    std::vector<std::string_view> sampled;
+    for (std::size_t i: indices) sampled.push_back(lines[i]);
+    return sampled;
+}
+
+/// Counts the exits of the banded kernel.
+struct ExitCounter: public levenshtein::NoInstrumentation {
+    long long length_exits = 0;
+    long long early_exits  = 0;
+
+    void length_exit() { length_exits++; }
+    void early_exit(int) { early_exits++; }
+};
+
+/// What was measured for one cutoff, overall or for one length class.
+struct Measurement {
+    long long queries          = 0; // Whose closest line is within the cutoff, for the recall
+    double    ns[KERNEL_COUNT] = {};
+    long long pairs            = 0; // Timed per kernel
+    long long length_exits     = 0;
+    long long early_exits      = 0;
+
+    double ns_per_pair(int kernel) const { return pairs ? ns[kernel]/static_cast<double>(pairs) : 0.0; }
+    double rate(long long count) const { return pairs ? static_cast<double>(count)/static_cast<double>(pairs) : 0.0; }
+
+    Measurement &operator+=(const Measurement &other) {
+        queries      += other.queries;
+        pairs        += other.pairs;
+        length_exits += other.length_exits;
+        early_exits  += other.early_exits;
+        for (int k = 0; k < KERNEL_COUNT; k++) ns[k] += other.ns[k];
+        return *this;
+    }
+};
+
+/// Everything measured. `by_class[c][k]` is for queries of length class `c` with cutoff `k`.
+struct Profile {
+    int                      max_cutoff = 0;
+    long long                queries    = 0;
+    long long                class_queries[LENGTH_CLASS_COUNT] = {};
+    std::vector<long long>   closest;       // Queries by distance to the closest line
+    long long                unmatched  = 0; // No line within the largest cutoff
+    std::vector<Measurement> by_class[LENGTH_CLASS_COUNT];
+
+    Measurement overall(int cutoff) const {
+        Measurement total;
+        for (const auto &measurements: by_class) total += measurements[static_cast<std::size_t>(cutoff)];
+        return total;
+    }
+};
+
+/// The recommendation for one length class, or for all of them.
+struct Advice {
+    int    cutoff = -1;
+    double recall = 0.0;
+    Kernel kernel = BOUNDED_EDIT_DIST;
+};
+
+/// Where the checksums of the passes go, so that the compiler can't discard the calls.
+volatile long long sink;
+
+/// The time to run `pass`, in nanoseconds. `pass` returns a checksum, which is added to `sum`.
+template<class Pass>
+double time_pass(Pass &&pass, long long &sum) {
+    auto start = std::chrono::steady_clock::now();
+    sum += pass();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<bool transpositions>
+Profile measure(const Options &options, const std::vector<std::string_view> &haystack,
+                const std::vector<std::string_view> &queries, const std::vector<std::string_view> &timed) {
+    Profile profile;
+    profile.max_cutoff = options.max_cutoff;
+    profile.queries    = static_cast<long long>(queries.size());
+    profile.closest.assign(static_cast<std::size_t>(options.max_cutoff) + 1, 0);
+    for (auto &measurements: profile.by_class) measurements.resize(static_cast<std::size_t>(options.max_cutoff) + 1);
+
+    std::size_t longest = 0;
+    for (std::string_view line: timed) longest = std::max(longest, line.length());
+    for (std::string_view query: queries) longest = std::max(longest, query.length());
+    levenshtein::Buffer buffer{levenshtein::workspace_size(longest, true)};
+    // Lines whose length is more than `-K` from a query's can't be its match, so the search for the
+    // closest line only looks at the others.
+    const levenshtein::LengthPartitionedDictionary dictionary{haystack};
+
+    long long sum = 0;
+    for (std::string_view query: queries) {
+        const int length_class = runtime_stats::length_class(query.length());
+        profile.class_queries[length_class]++;
+        std::vector<Measurement> &measurements = profile.by_class[length_class];
+
+        const levenshtein::PreparedQuery prepared{query};
+        levenshtein::Match match = transpositions
+                ? levenshtein::parallel_best_match_t(prepared, dictionary, options.max_cutoff, options.search)
+                : levenshtein::parallel_best_match(prepared, dictionary, options.max_cutoff, options.search);
+        if (match.index == levenshtein::Match::NOT_FOUND) {
+            profile.unmatched++;
+        } else {
+            profile.closest[static_cast<std::size_t>(match.distance)]++;
+        }
+
+        // The unbounded kernel is the same at every cutoff.
+        double unbounded = time_pass([&]() {
+            long long s = 0;
+            for (std::string_view line: timed) {
+                s += transpositions ? levenshtein::edit_dist_t(line, query, buffer)
+                                    : levenshtein::edit_dist(line, query, buffer);
+            }
+            return s;
+        }, sum);
+
+        for (int k = 0; k <= options.max_cutoff; k++) {
+            Measurement &measurement = measurements[static_cast<std::size_t>(k)];
+            if (match.index != levenshtein::Match::NOT_FOUND && match.distance <= k) measurement.queries++;
+            measurement.pairs += static_cast<long long>(timed.size());
+            measurement.ns[EDIT_DIST] += unbounded;
+            measurement.ns[BOUNDED_EDIT_DIST] += time_pass([&]() {
+                long long s = 0;
+                for (std::string_view line: timed) {
+                    s += transpositions ? levenshtein::bounded_edit_dist_t(line, query, k, buffer)
+                                        : levenshtein::bounded_edit_dist(line, query, k, buffer);
+                }
+                return s;
+            }, sum);
+            measurement.ns[PREPARED] += time_pass([&]() {
+                long long s = 0;
+                for (std::string_view line: timed) s += prepared.distance<transpositions>(line, k, buffer);
+                return s;
+            }, sum);
+
+            ExitCounter exits;
+            for (std::string_view line: timed) {
+                sum += transpositions ? levenshtein::bounded_edit_dist_t(line, query, k, buffer, exits)
+                                      : levenshtein::bounded_edit_dist(line, query, k, buffer, exits);
+            }
+            measurement.length_exits += exits.length_exits;
+            measurement.early_exits  += exits.early_exits;
+        }
+    }
+    sink = sum;
+    return profile;
+}
+
+/// The smallest cutoff that reaches `target` recall among `queries` queries, or the largest if
+/// none does, and the fastest kernel at that cutoff.
+Advice advise(const std::vector<Measurement> &measurements, long long queries, double target) {
+    Advice advice;
+    if (queries == 0) return advice;
+    for (std::size_t k = 0; k < measurements.size(); k++) {
+        advice.cutoff = static_cast<int>(k);
+        advice.recall = static_cast<double>(measurements[k].queries)/static_cast<double>(queries);
+        if (advice.recall >= target) break;
+    }
+    const Measurement &at = measurements[static_cast<std::size_t>(advice.cutoff)];
+    for (int kernel = 0; kernel < KERNEL_COUNT; kernel++) {
+        if (at.ns_per_pair(kernel) < at.ns_per_pair(advice.kernel)) advice.kernel = static_cast<Kernel>(kernel);
+    }
+    return advice;
+}
+
+void print_report(const Options &options, const Profile &profile, std::size_t haystack_size, std::size_t timed_size) {
+    const bool t = options.transpositions;
+    std::printf("%lld queries against %zu lines (kernels timed on %zu of them), %s distance\n\n",
+                profile.queries, haystack_size, timed_size, t ? "Damerau-Levenshtein" : "Levenshtein");
+
+    std::printf("Distance to the closest line\n  distance   queries  cumulative\n");
+    long long cumulative = 0;
+    for (std::size_t d = 0; d < profile.closest.size(); d++) {
+        cumulative += profile.closest[d];
+        std::printf("  %8zu  %8lld  %9.1f%%\n", d, profile.closest[d],
+                    100.0*static_cast<double>(cumulative)/static_cast<double>(profile.queries));
+    }
+    std::printf("  %8s  %8lld\n\n", ("> " + std::to_string(profile.max_cutoff)).c_str(), profile.unmatched);
+
+    std::printf("By cutoff, all queries                      ns per pair\n"
+                "  cutoff   recall  length exits  early exits  %12s %20s %12s\n",
+                kernel_name(EDIT_DIST, t), kernel_name(BOUNDED_EDIT_DIST, t), kernel_name(PREPARED, t));
+    std::vector<Measurement> overall;
+    for (int k = 0; k <= profile.max_cutoff; k++) {
+        overall.push_back(profile.overall(k));
+        const Measurement &m = overall.back();
+        std::printf("  %6d  %6.1f%%  %11.1f%%  %10.1f%%  %12.1f %20.1f %12.1f\n", k,
+                    100.0*static_cast<double>(m.queries)/static_cast<double>(profile.queries),
+                    100.0*m.rate(m.length_exits), 100.0*m.rate(m.early_exits),
+                    m.ns_per_pair(EDIT_DIST), m.ns_per_pair(BOUNDED_EDIT_DIST), m.ns_per_pair(PREPARED));
+    }
+
+    Advice advice = advise(overall, profile.queries, options.recall);
+    std::printf("\nRecommended cutoff: %d, which finds the closest line of %.1f%% of the queries (target %.1f%%).\n",
+                advice.cutoff, 100.0*advice.recall, 100.0*options.recall);
+    if (advice.recall < options.recall) {
+        std::printf("No cutoff up to %d reaches the target; try a larger -K.\n", profile.max_cutoff);
+    }
+    std::printf("Fastest kernel at that cutoff: %s.\n\n", kernel_name(advice.kernel, t));
+
+    std::printf("By length class of the query                ns per pair at the cutoff\n"
+                "  class    queries  cutoff   recall  %12s %20s %12s  fastest\n",
+                kernel_name(EDIT_DIST, t), kernel_name(BOUNDED_EDIT_DIST, t), kernel_name(PREPARED, t));
+    for (int c = 0; c < LENGTH_CLASS_COUNT; c++) {
+        if (profile.class_queries[c] == 0) continue;
+        Advice class_advice = advise(profile.by_class[c], profile.class_queries[c], options.recall);
+        const Measurement &m = profile.by_class[c][static_cast<std::size_t>(class_advice.cutoff)];
+        std::printf("  %-7s %8lld  %6d  %6.1f%%  %12.1f %20.1f %12.1f  %s\n", LENGTH_CLASS_NAMES[c],
+                    profile.class_queries[c], class_advice.cutoff, 100.0*class_advice.recall,
+                    m.ns_per_pair(EDIT_DIST), m.ns_per_pair(BOUNDED_EDIT_DIST), m.ns_per_pair(PREPARED),
+                    kernel_name(class_advice.kernel, t));
+    }
+}
+
+void write_ns_per_pair(FILE *out, const Measurement &m, bool transpositions) {
+    std::fputs("{", out);
+    for (int kernel = 0; kernel < KERNEL_COUNT; kernel++) {
+        std::fprintf(out, "%s\"%s\": %.1f", kernel ? ", " : "", kernel_name(static_cast<Kernel>(kernel), transpositions),
+                     m.ns_per_pair(kernel));
+    }
+    std::fputs("}", out);
+}
+
+void write_json(FILE *out, const Options &options, const Profile &profile) {
+    const bool t = options.transpositions;
+    std::vector<Measurement> overall;
+    for (int k = 0; k <= profile.max_cutoff; k++) overall.push_back(profile.overall(k));
+    Advice advice = advise(overall, profile.queries, options.recall);
+
+    std::fprintf(out, "{\"distance\": \"%s\", \"target_recall\": %g, \"queries\": %lld, \"unmatched\": %lld, "
+                      "\"cutoff\": %d, \"recall\": %.4f, \"kernel\": \"%s\",\n \"length_classes\": [",
+                 t ? "damerau_levenshtein" : "levenshtein", options.recall, profile.queries, profile.unmatched,
+                 advice.cutoff, advice.recall, kernel_name(advice.kernel, t));
+    bool first = true;
+    for (int c = 0; c < LENGTH_CLASS_COUNT; c++) {
+        if (profile.class_queries[c] == 0) continue;
+        Advice class_advice = advise(profile.by_class[c], profile.class_queries[c], options.recall);
+        std::fprintf(out, "%s\n  {\"class\": \"%s\", \"queries\": %lld, \"cutoff\": %d, \"recall\": %.4f, "
+                          "\"kernel\": \"%s\", \"ns_per_pair\": ",
+                     first ? "" : ",", LENGTH_CLASS_NAMES[c], profile.class_queries[c], class_advice.cutoff,
+                     class_advice.recall, kernel_name(class_advice.kernel, t));
+        write_ns_per_pair(out, profile.by_class[c][static_cast<std::size_t>(class_advice.cutoff)], t);
+        std::fputs("}", out);
+        first = false;
+    }
+    std::fputs("],\n \"cutoffs\": [", out);
+    for (int k = 0; k <= profile.max_cutoff; k++) {
+        const Measurement &m = overall[static_cast<std::size_t>(k)];
+        std::fprintf(out, "%s\n  {\"cutoff\": %d, \"recall\": %.4f, \"length_exit_rate\": %.4f, "
+                          "\"early_exit_rate\": %.4f, \"ns_per_pair\": ",
+                     k ? "," : "", k, static_cast<double>(m.queries)/static_cast<double>(profile.queries),
+                     m.rate(m.length_exits), m.rate(m.early_exits));
+        write_ns_per_pair(out, m, t);
+        std::fputs("}", out);
+    }
+    std::fputs("]}\n", out);
+}
+
+/// Maps `name` and collects its lines. Returns false (after printing why) if it can't be read.
+bool read_lines(const std::string &name, MappedFile &file, std::vector<std::string_view> &lines) {
+    if (!file.open(name, "levadvise")) return false;
+    levenshtein::for_each_line(file.text(), [&](std::string_view line, std::size_t) { lines.push_back(line); });
+    if (lines.empty()) {
+        std::fprintf(stderr, "levadvise: %s has no lines\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parse_arguments(argc, argv, options)) {
+        print_usage(stderr);
+        return 2;
+    }
+
+    MappedFile haystack_file, queries_file;
+    std::vector<std::string_view> haystack, all_queries;
+    if (!read_lines(options.haystack, haystack_file, haystack)
+        || !read_lines(options.queries, queries_file, all_queries)) {
+        return 2;
+    }
+    if (haystack.size() > static_cast<std::size_t>(UINT32_MAX)) {
+        std::fprintf(stderr, "levadvise: %s has more than 2^32 lines\n", options.haystack.c_str());
+        return 2;
+    }
+
+    std::mt19937_64 rng(options.seed);
+    std::vector<std::string_view> queries = sample(all_queries, options.query_count, rng);
+    std::vector<std::string_view> timed   = sample(haystack, options.lines, rng);
+    if (queries.empty() || timed.empty()) {
+        std::fprintf(stderr, "levadvise: -m and -n must be at least 1\n");
+        return 2;
+    }
+
+    Profile profile = options.transpositions ? measure<true>(options, haystack, queries, timed)
+                                             : measure<false>(options, haystack, queries, timed);
+
+    if (options.json) {
+        write_json(stdout, options, profile);
+    } else {
+        print_report(options, profile, haystack.size(), timed.size());
+    }
+    if (!options.output.empty()) {
+        FILE *out = std::fopen(options.output.c_str(), "w");
+        if (!out) {
+            std::perror(options.output.c_str());
+            return 2;
+        }
+        write_json(out, options, profile);
+        std::fclose(out);
+    }
+    return 0;
+}
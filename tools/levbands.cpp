@@ -0,0 +1,166 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+`levbands`: profile how the band of the banded kernels narrows on the lines of a file.
+
+Usage:
+
+    levbands [options] FILE
+
+Options:
+
+    -k N        The bound given to the kernels (default 2).
+    -q QUERY    Compare QUERY with every line, as a UDF with a constant argument does. Without it,
+                compare random pairs of lines.
+    -m          With -q, lower the bound to the smallest distance found so far, as `min_edit_dist`
+                does.
+    -n N        The number of random pairs (default 100000).
+    --seed N    The seed for the random pairs (default 1).
+    -h, --help  Show this message.
+
+For each of `bounded_edit_dist` and `bounded_edit_dist_t`, prints the mean width of the band at
+each tenth of the rows, where the band emptied, and how many cells the kernel computed next to the
+cells of the constant-width bands of `doc/OptimizatingEditDistance.md`. See
+`levenshtein/band_trace.h`.
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "levenshtein/band_trace.h"
+#include "levenshtein/levenshtein.h"
+#include "levenshtein/lines.h"
+#include "mapped_file.h"
+
+namespace {
+
+struct Options {
+    std::string   file;
+    std::string   query;
+    bool          has_query = false;
+    bool          shrink    = false;
+    int           k         = 2;
+    long          pairs     = 100000;
+    unsigned long seed      = 1;
+};
+
+void print_usage(FILE *out) {
+    std::fputs("Usage: levbands [-k N] [-q QUERY [-m]] [-n N] [--seed N] FILE\n"
+               "Profile the band of the banded kernels on the lines of FILE.\n"
+               "  -k N        the bound given to the kernels (default 2)\n"
+               "  -q QUERY    compare QUERY with every line instead of random pairs of lines\n"
+               "  -m          with -q, lower the bound to the best distance so far (min_edit_dist)\n"
+               "  -n N        number of random pairs (default 100000)\n"
+               "  --seed N    seed for the random pairs (default 1)\n", out);
+}
+
+/// Parses the command line. Returns false on a usage error.
+bool parse_arguments(int argc, char *argv[], Options &options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if ((argument == "-k" || argument == "-n" || argument == "--seed") && i + 1 < argc) {
+            char *end;
+            long value = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || value < 0) return false;
+            if (argument == "-k") {
+                if (value > 1 << 20) return false;
+                options.k = static_cast<int>(value);
+            } else if (argument == "-n") {
+                options.pairs = value;
+            } else {
+                options.seed = static_cast<unsigned long>(value);
+            }
+        } else if (argument == "-q" && i + 1 < argc) {
+            options.query     = argv[++i];
+            options.has_query = true;
+        } else if (argument == "-m") {
+            options.shrink = true;
+        } else if (argument == "-h" || argument == "--help") {
+            print_usage(stdout);
+            std::exit(0);
+        } else if (argument.size() > 1 && argument[0] == '-') {
+            return false;
+        } else {
+            positional.emplace_back(argument);
+        }
+    }
+    if (positional.size() != 1 || (options.shrink && !options.has_query)) return false;
+    options.file = positional[0];
+    return true;
+}
+
+/// Runs one kernel on one pair with `trace`, and adds the trace to `profile`.
+template<class Kernel>
+int profile_call(Kernel kernel, std::string_view a, std::string_view b, int max, std::vector<int> &buffer,
+                 levenshtein::BandTrace &trace, levenshtein::BandProfile &profile) {
+    std::size_t needed = static_cast<std::size_t>(levenshtein::workspace_size(std::max(a.length(), b.length()), true));
+    if (buffer.size() < needed) buffer.resize(needed);
+    trace.reset();
+    int distance = kernel(a, b, max, levenshtein::Workspace{buffer.data(), static_cast<int>(buffer.size())}, trace);
+    profile.add(trace);
+    return distance;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parse_arguments(argc, argv, options)) {
+        print_usage(stderr);
+        return 2;
+    }
+
+    MappedFile file;
+    if (!file.open(options.file, "levbands")) return 2;
+    std::vector<std::string_view> lines;
+    levenshtein::for_each_line(file.text(), [&](std::string_view line, std::size_t) { lines.push_back(line); });
+    if (lines.empty()) {
+        std::fprintf(stderr, "levbands: %s has no lines\n", options.file.c_str());
+        return 2;
+    }
+
+    auto levenshtein_kernel = [](std::string_view a, std::string_view b, int max, levenshtein::Workspace workspace,
+                                 levenshtein::BandTrace &trace) {
+        return levenshtein::bounded_edit_dist(a, b, max, workspace, trace);
+    };
+    auto damerau_kernel = [](std::string_view a, std::string_view b, int max, levenshtein::Workspace workspace,
+                             levenshtein::BandTrace &trace) {
+        return levenshtein::bounded_edit_dist_t(a, b, max, workspace, trace);
+    };
+
+    std::vector<int>         buffer;
+    levenshtein::BandTrace   trace;
+    levenshtein::BandProfile levenshtein_profile, damerau_profile;
+
+    if (options.has_query) {
+        int levenshtein_max = options.k, damerau_max = options.k;
+        for (std::string_view line: lines) {
+            int distance = profile_call(levenshtein_kernel, line, options.query, levenshtein_max, buffer, trace,
+                                        levenshtein_profile);
+            if (options.shrink && distance >= 0 && distance < levenshtein_max) levenshtein_max = distance;
+            distance = profile_call(damerau_kernel, line, options.query, damerau_max, buffer, trace, damerau_profile);
+            if (options.shrink && distance >= 0 && distance < damerau_max) damerau_max = distance;
+        }
+    } else {
+        std::mt19937_64 rng(options.seed);
+        std::uniform_int_distribution<std::size_t> pick(0, lines.size() - 1);
+        for (long p = 0; p < options.pairs; p++) {
+            std::string_view a = lines[pick(rng)], b = lines[pick(rng)];
+            profile_call(levenshtein_kernel, a, b, options.k, buffer, trace, levenshtein_profile);
+            profile_call(damerau_kernel, a, b, options.k, buffer, trace, damerau_profile);
+        }
+    }
+
+    levenshtein_profile.print(std::cout, "bounded_edit_dist");
+    std::cout << "\n";
+    damerau_profile.print(std::cout, "bounded_edit_dist_t");
+    return 0;
+}
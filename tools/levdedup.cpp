@@ -0,0 +1,121 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+`levdedup`: group the lines of a file into clusters of near duplicates.
+
+Usage:
+
+    levdedup [options] FILE
+
+Options:
+
+    -k N        Link lines within N edits of each other (default 2).
+    -s P        Instead, link lines with `similarity_t` at least P, a number between 0 and 1.
+    -t          Count transpositions as one edit (Damerau-Levenshtein distance). Implied by -s.
+    -j N        Number of threads (default: one per hardware thread).
+    -h, --help  Show this message.
+
+For each line of the file, in order, prints
+
+    LINE:CLUSTER
+
+where `LINE` is the line number, starting at 1, and `CLUSTER` is the number of the first line of
+its cluster. A line with no near duplicates is its own cluster. Clusters are the connected
+components of the links, so two lines can share a cluster without being linked directly. See
+`levenshtein/cluster.h` for how the links are found without comparing every pair of lines.
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "levenshtein/cluster.h"
+#include "levenshtein/lines.h"
+#include "mapped_file.h"
+
+namespace {
+
+struct Options {
+    std::string                file;
+    int                        k              = 2;
+    double                     similarity     = -1.0; // Negative when clustering by edits
+    bool                       transpositions = false;
+    levenshtein::SearchOptions search;
+};
+
+void print_usage(FILE *out) {
+    std::fputs("Usage: levdedup [-k N | -s P] [-t] [-j N] FILE\n"
+               "Print the cluster of near duplicates of each line of FILE.\n"
+               "  -k N        link lines within N edits (default 2)\n"
+               "  -s P        link lines with similarity_t at least P instead\n"
+               "  -t          count transpositions as one edit (Damerau-Levenshtein)\n"
+               "  -j N        number of threads\n", out);
+}
+
+/// Parses the command line. Returns false on a usage error.
+bool parse_arguments(int argc, char *argv[], Options &options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if ((argument == "-k" || argument == "-j") && i + 1 < argc) {
+            char *end;
+            long value = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || value < 0 || value > 1024) return false;
+            if (argument == "-k") {
+                options.k = static_cast<int>(value);
+            } else {
+                options.search.threads = static_cast<unsigned>(value);
+            }
+        } else if (argument == "-s" && i + 1 < argc) {
+            char *end;
+            options.similarity = std::strtod(argv[++i], &end);
+            if (*end != '\0' || !(options.similarity >= 0.0 && options.similarity <= 1.0)) return false;
+        } else if (argument == "-t") {
+            options.transpositions = true;
+        } else if (argument == "-h" || argument == "--help") {
+            print_usage(stdout);
+            std::exit(0);
+        } else if (argument.size() > 1 && argument[0] == '-') {
+            return false;
+        } else {
+            positional.emplace_back(argument);
+        }
+    }
+    if (positional.size() != 1) return false;
+    options.file = positional[0];
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parse_arguments(argc, argv, options)) {
+        print_usage(stderr);
+        return 2;
+    }
+
+    MappedFile file;
+    if (!file.open(options.file, "levdedup")) return 2;
+    // Blank lines are kept so that indices are line numbers minus one.
+    std::vector<std::string_view> lines;
+    levenshtein::for_each_line(file.text(), [&](std::string_view line, std::size_t) { lines.push_back(line); });
+
+    std::vector<std::uint32_t> clusters;
+    if (options.similarity >= 0.0) {
+        clusters = levenshtein::cluster_similarity_t(lines, options.similarity, options.search);
+    } else if (options.transpositions) {
+        clusters = levenshtein::cluster_t(lines, options.k, options.search);
+    } else {
+        clusters = levenshtein::cluster(lines, options.k, options.search);
+    }
+
+    for (std::size_t i = 0; i < clusters.size(); i++) {
+        std::printf("%zu:%lu\n", i + 1, static_cast<unsigned long>(clusters[i]) + 1);
+    }
+    return 0;
+}
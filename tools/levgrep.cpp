@@ -0,0 +1,267 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+`levgrep`: print the lines of a file within a given edit distance of a query.
+
+Usage:
+
+    levgrep [options] QUERY FILE...
+
+Options:
+
+    -k N        Maximum number of edits (default 2).
+    -t          Count transpositions as one edit (Damerau-Levenshtein distance, as `edit_dist_t`).
+    -b, --best  Only print the closest lines, like `min_edit_dist` in `ORDER BY` form.
+    -j N        Number of threads (default: one per hardware thread).
+    -h, --help  Show this message.
+
+Each match is printed as
+
+    [FILE:]OFFSET:DISTANCE:LINE
+
+where `OFFSET` is the byte offset of the start of the line. The file name is printed when there is
+more than one file. As with `grep`, the exit status is 0 if any line matched, 1 if none did, and 2
+on error.
+
+Each file is memory-mapped and cut into blocks at line boundaries. Threads take blocks in turn and
+compare every line in the block against the query, which is prepared once for the whole run (see
+`levenshtein/batch.h`). Lines are `std::string_view`s into the mapping; nothing is copied. Output
+is written in file order as soon as all earlier blocks are done. With `--best`, the threads share
+the best distance found so far as their cutoff, and the closest lines are printed at the end.
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "levenshtein/batch.h"
+#include "levenshtein/lines.h"
+#include "mapped_file.h"
+
+namespace {
+
+/// Roughly how much of a file each unit of work covers.
+constexpr std::size_t BLOCK_SIZE = std::size_t{1} << 20;
+/// Larger values of `-k` are clamped to this, which is more than any line needs.
+constexpr int MAX_EDITS = 1 << 20;
+
+struct Options {
+    std::string              query;
+    std::vector<std::string> files;
+    int                      k              = 2;
+    bool                     transpositions = false;
+    bool                     best           = false;
+    unsigned                 threads        = 0;
+};
+
+/// A line within `max` of the query, kept for `--best`.
+struct Candidate {
+    std::size_t      file;
+    std::size_t      offset;
+    int              distance;
+    std::string_view line;
+};
+
+/// One memory-mapped input file, split into blocks.
+struct Input {
+    MappedFile               file;
+    std::string_view         text;
+    std::vector<std::size_t> block_starts; // Plus one past the end
+};
+
+void print_usage(FILE *out) {
+    std::fputs("Usage: levgrep [-k N] [-t] [-b|--best] [-j N] QUERY FILE...\n"
+               "Print the lines of FILE within N edits (default 2) of QUERY.\n"
+               "  -k N        maximum number of edits\n"
+               "  -t          count transpositions as one edit (Damerau-Levenshtein)\n"
+               "  -b, --best  only print the closest lines\n"
+               "  -j N        number of threads\n", out);
+}
+
+/// Parses the command line. Returns false on a usage error.
+bool parse_arguments(int argc, char *argv[], Options &options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if ((argument == "-k" || argument == "-j") && i + 1 < argc) {
+            char *end;
+            long value = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || value < 0) return false;
+            if (argument == "-k") {
+                options.k = static_cast<int>(std::min<long>(value, MAX_EDITS));
+            } else {
+                options.threads = static_cast<unsigned>(value);
+            }
+        } else if (argument == "-t") {
+            options.transpositions = true;
+        } else if (argument == "-b" || argument == "--best") {
+            options.best = true;
+        } else if (argument == "-h" || argument == "--help") {
+            print_usage(stdout);
+            std::exit(0);
+        } else if (argument.size() > 1 && argument[0] == '-') {
+            return false;
+        } else {
+            positional.emplace_back(argument);
+        }
+    }
+    if (positional.size() < 2) return false;
+    options.query = positional[0];
+    options.files.assign(positional.begin() + 1, positional.end());
+    return true;
+}
+
+/// Maps `name` and splits it into blocks. Returns false (after printing why) if it can't be read.
+bool open_input(const std::string &name, Input &input) {
+    if (!input.file.open(name, "levgrep")) return false;
+    input.text = input.file.text();
+
+    for (std::size_t start = 0; start < input.text.length();
+         start = levenshtein::next_line_start(input.text, start + BLOCK_SIZE - 1)) {
+        input.block_starts.push_back(start);
+    }
+    input.block_starts.push_back(input.text.length());
+    return true;
+}
+
+/// Prints the output of each block in order as they become ready.
+class OrderedOutput {
+public:
+    explicit OrderedOutput(std::size_t blocks): outputs(blocks), ready(blocks, false) {}
+
+    void finish(std::size_t block, std::string output) {
+        std::lock_guard<std::mutex> lock(mutex);
+        outputs[block] = std::move(output);
+        ready[block]   = true;
+        while (next < ready.size() && ready[next]) {
+            std::fwrite(outputs[next].data(), 1, outputs[next].size(), stdout);
+            std::string().swap(outputs[next]);
+            next++;
+        }
+    }
+
+private:
+    std::mutex               mutex;
+    std::vector<std::string> outputs;
+    std::vector<bool>        ready;
+    std::size_t              next = 0;
+};
+
+template<bool transpositions>
+int search(const Options &options, std::vector<Input> &inputs) {
+    const levenshtein::PreparedQuery query{options.query};
+    const bool show_names = inputs.size() > 1;
+
+    // All the blocks of all the files, in order, as (file, block) pairs.
+    std::vector<std::pair<std::size_t, std::size_t>> blocks;
+    for (std::size_t file = 0; file < inputs.size(); file++) {
+        for (std::size_t block = 0; block + 1 < inputs[file].block_starts.size(); block++) {
+            blocks.emplace_back(file, block);
+        }
+    }
+
+    std::atomic<std::size_t> next_block{0};
+    std::atomic<int>         bound{options.k};     // Only tightens with --best
+    std::atomic<bool>        any_match{false};
+    OrderedOutput            output{blocks.size()};
+    std::mutex               candidates_mutex;
+    std::vector<Candidate>   candidates;
+
+    auto work = [&]() {
+        levenshtein::Buffer    buffer{0};
+        std::string            text;
+        std::vector<Candidate> found;
+        char                   prefix[64];
+
+        for (std::size_t b; (b = next_block.fetch_add(1)) < blocks.size();) {
+            const Input &input = inputs[blocks[b].first];
+            std::size_t begin  = input.block_starts[blocks[b].second];
+            std::size_t end    = input.block_starts[blocks[b].second + 1];
+            text.clear();
+
+            auto lines = input.text.substr(begin, end - begin);
+            levenshtein::for_each_line(lines, [&](std::string_view line, std::size_t offset) {
+                // Only queries too long for the bit-parallel kernel use the workspace.
+                if (!query.bit_parallel()) {
+                    int needed = levenshtein::workspace_size(std::max(line.length(), options.query.length()), true);
+                    if (needed > buffer.workspace().size) buffer = levenshtein::Buffer{needed};
+                }
+                int max      = options.best ? bound.load(std::memory_order_relaxed) : options.k;
+                int distance = query.distance<transpositions>(line, max, buffer);
+                if (distance == levenshtein::BUFFER_EXCEEDED || distance > max) return;
+
+                any_match.store(true, std::memory_order_relaxed);
+                if (options.best) {
+                    // Tighten the shared bound. Ties are kept, so the bound never drops below them.
+                    int current = bound.load(std::memory_order_relaxed);
+                    while (distance < current && !bound.compare_exchange_weak(current, distance)) {}
+                    found.push_back({blocks[b].first, begin + offset, distance, line});
+                } else {
+                    if (show_names) text.append(input.file.file_name()).push_back(':');
+                    int length = std::snprintf(prefix, sizeof prefix, "%zu:%d:", begin + offset, distance);
+                    text.append(prefix, static_cast<std::size_t>(length)).append(line).push_back('\n');
+                }
+            });
+
+            if (!options.best) output.finish(b, std::move(text));
+        }
+
+        if (options.best) {
+            std::lock_guard<std::mutex> lock(candidates_mutex);
+            candidates.insert(candidates.end(), found.begin(), found.end());
+        }
+    };
+
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(threads, blocks.size())));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(work);
+    work();
+    for (auto &thread: pool) thread.join();
+
+    if (options.best) {
+        // Candidates were found under a bound that only ever went down, so the closest lines are
+        // exactly those at the final bound.
+        int best = bound.load();
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+            return a.file != b.file ? a.file < b.file : a.offset < b.offset;
+        });
+        for (const auto &candidate: candidates) {
+            if (candidate.distance != best) continue;
+            if (show_names) std::printf("%s:", inputs[candidate.file].file.file_name().c_str());
+            std::printf("%zu:%d:%.*s\n", candidate.offset, candidate.distance,
+                        static_cast<int>(candidate.line.length()), candidate.line.data());
+        }
+    }
+
+    return any_match.load() ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parse_arguments(argc, argv, options)) {
+        print_usage(stderr);
+        return 2;
+    }
+
+    std::vector<Input> inputs(options.files.size());
+    bool ok = true;
+    for (std::size_t i = 0; i < options.files.size(); i++) {
+        ok = open_input(options.files[i], inputs[i]) && ok;
+    }
+
+    int status = options.transpositions ? search<true>(options, inputs) : search<false>(options, inputs);
+    std::fflush(stdout);
+    return ok ? status : 2;
+}
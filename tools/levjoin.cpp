@@ -0,0 +1,119 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+`levjoin`: print every pair of lines, one from each of two files, within a given edit distance.
+
+Usage:
+
+    levjoin [options] LEFT RIGHT
+
+Options:
+
+    -k N        Maximum number of edits (default 2).
+    -t          Count transpositions as one edit (Damerau-Levenshtein distance, as `edit_dist_t`).
+    -j N        Number of threads (default: one per hardware thread).
+    -h, --help  Show this message.
+
+Each pair is printed as
+
+    LEFT_LINE:RIGHT_LINE:DISTANCE
+
+where the line numbers start at 1, sorted by left line and then right line. This is the result of
+
+    SELECT l.line, r.line, edit_dist_t(l.name, r.name) FROM l, r WHERE edit_dist_t(l.name, r.name) <= 2;
+
+without comparing every line with every other. See `levenshtein/similarity_join.h` for how. The
+exit status is 0 if any pair was found, 1 if none was, and 2 on error.
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "levenshtein/lines.h"
+#include "levenshtein/similarity_join.h"
+#include "mapped_file.h"
+
+namespace {
+
+struct Options {
+    std::string                left;
+    std::string                right;
+    int                        k              = 2;
+    bool                       transpositions = false;
+    levenshtein::SearchOptions search;
+};
+
+void print_usage(FILE *out) {
+    std::fputs("Usage: levjoin [-k N] [-t] [-j N] LEFT RIGHT\n"
+               "Print the pairs of lines of LEFT and RIGHT within N edits (default 2) of each other.\n"
+               "  -k N        maximum number of edits\n"
+               "  -t          count transpositions as one edit (Damerau-Levenshtein)\n"
+               "  -j N        number of threads\n", out);
+}
+
+/// Parses the command line. Returns false on a usage error.
+bool parse_arguments(int argc, char *argv[], Options &options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if ((argument == "-k" || argument == "-j") && i + 1 < argc) {
+            char *end;
+            long value = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || value < 0 || value > 1024) return false;
+            if (argument == "-k") {
+                options.k = static_cast<int>(value);
+            } else {
+                options.search.threads = static_cast<unsigned>(value);
+            }
+        } else if (argument == "-t") {
+            options.transpositions = true;
+        } else if (argument == "-h" || argument == "--help") {
+            print_usage(stdout);
+            std::exit(0);
+        } else if (argument.size() > 1 && argument[0] == '-') {
+            return false;
+        } else {
+            positional.emplace_back(argument);
+        }
+    }
+    if (positional.size() != 2) return false;
+    options.left  = positional[0];
+    options.right = positional[1];
+    return true;
+}
+
+/// Every line of `file`, blank ones included so that indices are line numbers minus one.
+std::vector<std::string_view> lines_of(const MappedFile &file) {
+    std::vector<std::string_view> lines;
+    levenshtein::for_each_line(file.text(), [&](std::string_view line, std::size_t) { lines.push_back(line); });
+    return lines;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parse_arguments(argc, argv, options)) {
+        print_usage(stderr);
+        return 2;
+    }
+
+    MappedFile left_file, right_file;
+    if (!left_file.open(options.left, "levjoin") || !right_file.open(options.right, "levjoin")) return 2;
+    std::vector<std::string_view> left  = lines_of(left_file);
+    std::vector<std::string_view> right = lines_of(right_file);
+
+    std::vector<levenshtein::JoinMatch> matches =
+            options.transpositions ? levenshtein::similarity_join_t(left, right, options.k, options.search)
+                                   : levenshtein::similarity_join(left, right, options.k, options.search);
+
+    for (const auto &match: matches) {
+        std::printf("%zu:%zu:%d\n", match.left_index + 1, match.right_index + 1, match.distance);
+    }
+    return matches.empty() ? 1 : 0;
+}
@@ -0,0 +1,49 @@
+/*
+Copyright (C) 2024 Robert Jacobson
+Distributed under the MIT License. See License.txt for details.
+
+A read-only memory-mapped input file for the command line tools.
+
+*/
+
+#pragma once
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+class MappedFile {
+public:
+    /// Maps `name`. Returns false (after printing why, prefixed with `program`) if it can't be read.
+    bool open(const std::string &name, const char *program) {
+        this->name = name;
+        try {
+            file     = boost::interprocess::file_mapping(name.c_str(), boost::interprocess::read_only);
+            region   = boost::interprocess::mapped_region(file, boost::interprocess::read_only);
+            contents = {static_cast<const char *>(region.get_address()), region.get_size()};
+        } catch (const boost::interprocess::interprocess_exception &e) {
+            // An empty file can't be mapped, but it is a perfectly good file with no lines.
+            FILE *probe = std::fopen(name.c_str(), "rb");
+            bool empty  = probe && std::fgetc(probe) == EOF;
+            if (probe) std::fclose(probe);
+            if (!empty) {
+                std::fprintf(stderr, "%s: %s: %s\n", program, name.c_str(), e.what());
+                return false;
+            }
+            contents = {};
+        }
+        return true;
+    }
+
+    const std::string &file_name() const { return name; }
+    std::string_view text() const { return contents; }
+
+private:
+    std::string                        name;
+    boost::interprocess::file_mapping  file;
+    boost::interprocess::mapped_region region;
+    std::string_view                   contents;
+};